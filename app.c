@@ -56,6 +56,10 @@
 #include "src/irq.h"
 #include "src/oscillators.h"
 #include "src/timers.h"
+#include "src/sw_timer.h"
+#include "src/active_object.h"
+#include "src/profiler.h"
+#include "src/journal.h"
 #include "src/scheduler.h"
 #include "src/i2c.h"
 #include "src/led.h"
@@ -168,6 +172,14 @@ SL_WEAK void app_init(void)
     init_oscillators();
     init_timer();
     init_i2c();
+    init_profiler();
+
+    // application interrupts only post events and deferred work, they run at a lower
+    // priority than the radio so the link layer can always preempt them
+    NVIC_SetPriority(LETIMER0_IRQn, APP_IRQ_PRIORITY);
+    NVIC_SetPriority(GPIO_EVEN_IRQn, APP_IRQ_PRIORITY);
+    NVIC_SetPriority(GPIO_ODD_IRQn, APP_IRQ_PRIORITY);
+    NVIC_SetPriority(I2C0_IRQn, APP_IRQ_PRIORITY);
 
     NVIC_ClearPendingIRQ(LETIMER0_IRQn);
     NVIC_EnableIRQ(LETIMER0_IRQn);
@@ -176,16 +188,8 @@ SL_WEAK void app_init(void)
     NVIC_EnableIRQ(GPIO_EVEN_IRQn);
     NVIC_EnableIRQ(GPIO_ODD_IRQn);
 
-    // configure settings for heart sensor
-    init_heart_sensor();
-
-    timer_wait_us_polled(2000000);
-
-    // turn it off until next interrupt
-    #ifdef LOW_POWER_MODE
-    turn_off_heart_sensor();
-    #endif
-
+    // the heart sensor is brought up by the state machine after the boot event,
+    // so advertising doesn't wait on the sensor hub reset and configuration
 
 }
 
@@ -223,12 +227,11 @@ SL_WEAK void app_process_action(void)
   //         later assignments.
 
 
-    //LOG_INFO("TEST TIMER @ %d", letimerMilliseconds());
+    PROFILE_LOOP_BEGIN();
 
+    //LOG_INFO("TEST TIMER @ %d", letimerMilliseconds());
 
-    #ifndef LOW_POWER_MODE
-    pulse_LED();
-    #endif
+    PROFILE_LOOP_END();
 
 }
 
@@ -247,6 +250,37 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
     // Just a trick to hide a compiler warning about unused input parameter evt.
     (void) evt;
 
+    JOURNAL_BT(evt);
+
+    PROFILE_START(handler_cycles);
+
+    // interrupts queue their events in the scheduler and only raise one
+    // signal bit, handle every event queued since the last wakeup
+    if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_system_external_signal_id) {
+        sl_bt_msg_t queued_evt;
+
+        while (scheduler_next_event(&queued_evt)) {
+
+            PROFILE_START(event_cycles);
+
+            // software timer callbacks run here, in the main loop
+            if (external_signal_event_match(&queued_evt, EVENT_SW_TIMER)) {
+                sw_timer_dispatch();
+            }
+            else {
+                handle_ble_event(&queued_evt);
+            }
+
+            PROFILE_EVENT(PROFILE_SERVER_EVENT(queued_evt.data.evt_system_external_signal.extsignals), event_cycles);
+        }
+
+        // active objects that call the stack API run here too
+        ao_run_main();
+
+        PROFILE_HANDLER(PROFILE_BT_ON_EVENT, handler_cycles);
+        return;
+    }
+
     // Some events require responses from our application code,
     // and don’t necessarily advance our state machines.
     // For assignment 5 uncomment the next 2 function calls
@@ -254,7 +288,12 @@ void sl_bt_on_event(sl_bt_msg_t *evt)
 
     // sequence through states driven by events
     // put this code in scheduler.c/.h
+    PROFILE_START(sm_cycles);
     heart_sensor_state_machine(evt);
+    PROFILE_HANDLER(PROFILE_HEART_SM, sm_cycles);
+
+    PROFILE_EVENT(SL_BT_MSG_ID(evt->header), handler_cycles);
+    PROFILE_HANDLER(PROFILE_BT_ON_EVENT, handler_cycles);
 
    
 } // sl_bt_on_event()
@@ -52,6 +52,9 @@
 
 #define LETIMER_PERIOD_MS (5000)
 
+// NVIC priority of the application interrupts, higher numbers are less urgent
+#define APP_IRQ_PRIORITY (5)
+
 
 /**************************************************************************//**
  * Application Init.
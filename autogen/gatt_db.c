@@ -22,6 +22,12 @@ GATT_DATA(const uint16_t gattdb_uuidtable_16_map[]) =
   0x2a1e,
   0x2a21,
   0x2906,
+  0x2a37,
+  0x2a38,
+  0x2a39,
+  0x2a5e,
+  0x2a5f,
+  0x2a60,
   0x2a05,
   0x2b2a,
   0x2b29,
@@ -30,32 +36,38 @@ GATT_DATA(const uint16_t gattdb_uuidtable_16_map[]) =
 GATT_DATA(const uint8_t gattdb_uuidtable_128_map[]) =
 {
   0x89, 0x62, 0x13, 0x2d, 0x2a, 0x65, 0xec, 0x87, 0x3e, 0x43, 0xc8, 0x38, 0x02, 0x00, 0x00, 0x00, 
-  0xf0, 0xe7, 0x8d, 0xf1, 0x1c, 0x06, 0x00, 0x82, 0x20, 0x46, 0xb8, 0xce, 0x78, 0xfc, 0x41, 0x50, 
-  0xbf, 0x32, 0xf7, 0x38, 0x6d, 0x62, 0x58, 0xb8, 0x26, 0x41, 0x67, 0x1e, 0xd8, 0x2b, 0x9b, 0x83, 
+  0xb7, 0xe0, 0x21, 0x8d, 0x4c, 0x5f, 0x62, 0x9a, 0x8e, 0x4b, 0x1f, 0x7d, 0x2a, 0x5c, 0x0b, 0x3e, 
+  0x4c, 0x3c, 0x88, 0xb4, 0x47, 0x14, 0x15, 0x92, 0xe6, 0x44, 0x3d, 0x50, 0x12, 0x38, 0xbd, 0xf1, 
   0x63, 0x60, 0x32, 0xe0, 0x37, 0x5e, 0xa4, 0x88, 0x53, 0x4e, 0x6d, 0xfb, 0x64, 0x35, 0xbf, 0xf7, 
 };
-GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_44) = {
+GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_60) = {
   .len = 16,
   .data = { 0xf0, 0x19, 0x21, 0xb4, 0x47, 0x8f, 0xa4, 0xbf, 0xa1, 0x4f, 0x63, 0xfd, 0xee, 0xd6, 0x14, 0x1d, }
 };
-GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_42) = {
-  .properties = 0x22,
-  .max_len = 1,
-  .data = { 0x00, },
-};
-GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_40) = {
+GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_57) = {
   .len = 16,
-  .data = { 0x89, 0x7f, 0xc6, 0x67, 0x71, 0xbc, 0x6e, 0x98, 0x67, 0x4f, 0x40, 0x0d, 0xff, 0x62, 0x5b, 0x05, }
+  .data = { 0xae, 0x5a, 0xc9, 0x7d, 0x3e, 0x3d, 0xef, 0x87, 0x86, 0x42, 0x45, 0xd5, 0xee, 0x6b, 0x7e, 0x77, }
 };
-GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_38) = {
-  .properties = 0x22,
-  .max_len = 1,
-  .data = { 0x00, },
+GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_56) = {
+  .len = 2,
+  .data = { 0x00, 0x00, }
 };
-GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_36) = {
+GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_48) = {
+  .len = 2,
+  .data = { 0x22, 0x18, }
+};
+GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_44) = {
   .len = 16,
   .data = { 0xfd, 0x73, 0x62, 0x6b, 0x3c, 0x60, 0x1c, 0x97, 0x66, 0x49, 0x27, 0x23, 0x56, 0xce, 0x7d, 0x0a, }
 };
+GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_41) = {
+  .len = 1,
+  .data = { 0x03, }
+};
+GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_36) = {
+  .len = 2,
+  .data = { 0x0d, 0x18, }
+};
 GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t gattdb_attribute_field_34) = {
   .properties = 0x22,
   .max_len = 1,
@@ -142,13 +154,13 @@ GATT_DATA(const sli_bt_gattdb_value_t gattdb_attribute_field_0) = {
 
 GATT_DATA(const sli_bt_gattdb_attribute_t gattdb_attributes_map[]) = {
   { .handle = 0x01, .uuid = 0x0000, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_0 },
-  { .handle = 0x02, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x20, .char_uuid = 0x000d } },
-  { .handle = 0x03, .uuid = 0x000d, .permissions = 0x800, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_2 },
+  { .handle = 0x02, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x20, .char_uuid = 0x0013 } },
+  { .handle = 0x03, .uuid = 0x0013, .permissions = 0x800, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_2 },
   { .handle = 0x04, .uuid = 0x0008, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x02, .clientconfig_index = 0x00 } },
-  { .handle = 0x05, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x02, .char_uuid = 0x000e } },
-  { .handle = 0x06, .uuid = 0x000e, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_5 },
-  { .handle = 0x07, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x0a, .char_uuid = 0x000f } },
-  { .handle = 0x08, .uuid = 0x000f, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_7 },
+  { .handle = 0x05, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x02, .char_uuid = 0x0014 } },
+  { .handle = 0x06, .uuid = 0x0014, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_5 },
+  { .handle = 0x07, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x0a, .char_uuid = 0x0015 } },
+  { .handle = 0x08, .uuid = 0x0015, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_7 },
   { .handle = 0x09, .uuid = 0x0000, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_8 },
   { .handle = 0x0a, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x0a, .char_uuid = 0x0003 } },
   { .handle = 0x0b, .uuid = 0x0003, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_10 },
@@ -178,29 +190,45 @@ GATT_DATA(const sli_bt_gattdb_attribute_t gattdb_attributes_map[]) = {
   { .handle = 0x23, .uuid = 0x8000, .permissions = 0x4841, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_34 },
   { .handle = 0x24, .uuid = 0x0008, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x02, .clientconfig_index = 0x05 } },
   { .handle = 0x25, .uuid = 0x0000, .permissions = 0x8801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_36 },
-  { .handle = 0x26, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x22, .char_uuid = 0x8001 } },
-  { .handle = 0x27, .uuid = 0x8001, .permissions = 0x4841, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_38 },
-  { .handle = 0x28, .uuid = 0x0008, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x02, .clientconfig_index = 0x06 } },
-  { .handle = 0x29, .uuid = 0x0000, .permissions = 0x8801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_40 },
-  { .handle = 0x2a, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x22, .char_uuid = 0x8002 } },
-  { .handle = 0x2b, .uuid = 0x8002, .permissions = 0x4841, .caps = 0xffff, .state = 0x00, .datatype = 0x01, .dynamicdata = &gattdb_attribute_field_42 },
-  { .handle = 0x2c, .uuid = 0x0008, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x02, .clientconfig_index = 0x07 } },
+  { .handle = 0x26, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x10, .char_uuid = 0x000d } },
+  { .handle = 0x27, .uuid = 0x000d, .permissions = 0x4800, .caps = 0xffff, .state = 0x00, .datatype = 0x07, .dynamicdata = NULL },
+  { .handle = 0x28, .uuid = 0x0008, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x01, .clientconfig_index = 0x06 } },
+  { .handle = 0x29, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x02, .char_uuid = 0x000e } },
+  { .handle = 0x2a, .uuid = 0x000e, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_41 },
+  { .handle = 0x2b, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x08, .char_uuid = 0x000f } },
+  { .handle = 0x2c, .uuid = 0x000f, .permissions = 0x802, .caps = 0xffff, .state = 0x00, .datatype = 0x07, .dynamicdata = NULL },
   { .handle = 0x2d, .uuid = 0x0000, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_44 },
-  { .handle = 0x2e, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x08, .char_uuid = 0x8003 } },
-  { .handle = 0x2f, .uuid = 0x8003, .permissions = 0x802, .caps = 0xffff, .state = 0x00, .datatype = 0x07, .dynamicdata = NULL },
+  { .handle = 0x2e, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x10, .char_uuid = 0x8001 } },
+  { .handle = 0x2f, .uuid = 0x8001, .permissions = 0x4800, .caps = 0xffff, .state = 0x00, .datatype = 0x07, .dynamicdata = NULL },
+  { .handle = 0x30, .uuid = 0x0008, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x01, .clientconfig_index = 0x07 } },
+  { .handle = 0x31, .uuid = 0x0000, .permissions = 0x8801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_48 },
+  { .handle = 0x32, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x20, .char_uuid = 0x0010 } },
+  { .handle = 0x33, .uuid = 0x0010, .permissions = 0x4800, .caps = 0xffff, .state = 0x00, .datatype = 0x07, .dynamicdata = NULL },
+  { .handle = 0x34, .uuid = 0x0008, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x02, .clientconfig_index = 0x08 } },
+  { .handle = 0x35, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x10, .char_uuid = 0x0011 } },
+  { .handle = 0x36, .uuid = 0x0011, .permissions = 0x4800, .caps = 0xffff, .state = 0x00, .datatype = 0x07, .dynamicdata = NULL },
+  { .handle = 0x37, .uuid = 0x0008, .permissions = 0x803, .caps = 0xffff, .state = 0x00, .datatype = 0x03, .configdata = { .flags = 0x01, .clientconfig_index = 0x09 } },
+  { .handle = 0x38, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x02, .char_uuid = 0x0012 } },
+  { .handle = 0x39, .uuid = 0x0012, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_56 },
+  { .handle = 0x3a, .uuid = 0x0000, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_57 },
+  { .handle = 0x3b, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x02, .char_uuid = 0x8002 } },
+  { .handle = 0x3c, .uuid = 0x8002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x07, .dynamicdata = NULL },
+  { .handle = 0x3d, .uuid = 0x0000, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x00, .constdata = &gattdb_attribute_field_60 },
+  { .handle = 0x3e, .uuid = 0x0002, .permissions = 0x801, .caps = 0xffff, .state = 0x00, .datatype = 0x05, .characteristic = { .properties = 0x08, .char_uuid = 0x8003 } },
+  { .handle = 0x3f, .uuid = 0x8003, .permissions = 0x802, .caps = 0xffff, .state = 0x00, .datatype = 0x07, .dynamicdata = NULL },
 };
 
 GATT_HEADER(const sli_bt_gattdb_t gattdb) = {
   .attributes = gattdb_attributes_map,
-  .attribute_table_size = 47,
-  .attribute_num = 47,
+  .attribute_table_size = 63,
+  .attribute_num = 63,
   .uuid16 = gattdb_uuidtable_16_map,
-  .uuid16_table_size = 16,
-  .uuid16_num = 16,
+  .uuid16_table_size = 22,
+  .uuid16_num = 22,
   .uuid128 = gattdb_uuidtable_128_map,
   .uuid128_table_size = 4,
   .uuid128_num = 4,
-  .num_ccfg = 8,
+  .num_ccfg = 10,
   .caps_mask = 0xffff,
   .enabled_caps = 0xffff,
 };
@@ -22,8 +22,14 @@ extern const sli_bt_gattdb_t gattdb;
 #define gattdb_valid_range                    32
 #define gattdb_button_state                   35
 #define gattdb_heart_rate_measurement         39
-#define gattdb_blood_oxygen_measurement       43
-#define gattdb_ota_control                    47
+#define gattdb_body_sensor_location           42
+#define gattdb_heart_rate_control_point       44
+#define gattdb_heart_stream                   47
+#define gattdb_plx_spot_check_measurement     51
+#define gattdb_plx_continuous_measurement     54
+#define gattdb_plx_features                   57
+#define gattdb_profile_stats                  60
+#define gattdb_ota_control                    63
 
 
 #endif // __GATT_DB_H
@@ -0,0 +1,26 @@
+/*
+ * app_assert.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the application assert.
+ */
+
+#ifndef HOST_APP_ASSERT_H_
+#define HOST_APP_ASSERT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define app_assert(expr, ...) \
+    do { \
+        if (!(expr)) { \
+            fprintf(stderr, "Assertion '%s' failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+            abort(); \
+        } \
+    } while (0)
+
+#define app_assert_status(sc) app_assert((sc) == SL_STATUS_OK)
+
+#endif /* HOST_APP_ASSERT_H_ */
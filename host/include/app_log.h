@@ -0,0 +1,18 @@
+/*
+ * app_log.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the VCOM log, lines go to stdout unless the simulator
+ * was asked to keep quiet.
+ */
+
+#ifndef HOST_APP_LOG_H_
+#define HOST_APP_LOG_H_
+
+#include <stdio.h>
+
+void app_log(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif /* HOST_APP_LOG_H_ */
@@ -0,0 +1,20 @@
+/*
+ * dmd.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the dot matrix display driver.
+ */
+
+#ifndef HOST_DMD_H_
+#define HOST_DMD_H_
+
+#include "glib.h"
+
+#define DMD_OK 0x00000000
+
+EMSTATUS DMD_init(void* initConfig);
+EMSTATUS DMD_updateDisplay(void);
+
+#endif /* HOST_DMD_H_ */
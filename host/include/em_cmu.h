@@ -0,0 +1,46 @@
+/*
+ * em_cmu.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the clock management unit. Only the LFA clock and the
+ * LETIMER0 prescaler matter to the simulator, they set the LETIMER tick rate.
+ */
+
+#ifndef HOST_EM_CMU_H_
+#define HOST_EM_CMU_H_
+
+#include "em_device.h"
+
+typedef enum {
+    cmuClock_GPIO,
+    cmuClock_I2C0,
+    cmuClock_LFA,
+    cmuClock_LETIMER0,
+    cmuClock_HF
+} CMU_Clock_TypeDef;
+
+typedef enum {
+    cmuOsc_LFXO,
+    cmuOsc_LFRCO,
+    cmuOsc_ULFRCO,
+    cmuOsc_HFXO
+} CMU_Osc_TypeDef;
+
+typedef enum {
+    cmuSelect_Disabled,
+    cmuSelect_LFXO,
+    cmuSelect_LFRCO,
+    cmuSelect_ULFRCO
+} CMU_Select_TypeDef;
+
+typedef uint32_t CMU_ClkDiv_TypeDef;
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable);
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait);
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref);
+void CMU_ClockDivSet(CMU_Clock_TypeDef clock, CMU_ClkDiv_TypeDef div);
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock);
+
+#endif /* HOST_EM_CMU_H_ */
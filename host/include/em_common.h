@@ -0,0 +1,27 @@
+/*
+ * em_common.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the emlib / sl_common compiler helpers.
+ */
+
+#ifndef HOST_EM_COMMON_H_
+#define HOST_EM_COMMON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SL_WEAK __attribute__((weak))
+#define SL_ATTRIBUTE_PACKED __attribute__((packed))
+
+#define SL_MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define SL_MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+// count of trailing zeros, 32 for 0 like the target's RBIT + CLZ
+static inline uint32_t SL_CTZ(uint32_t value) {
+    return (value == 0U) ? 32U : (uint32_t) __builtin_ctz(value);
+}
+
+#endif /* HOST_EM_COMMON_H_ */
@@ -0,0 +1,29 @@
+/*
+ * em_core.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the emlib critical section API. PRIMASK is simulated,
+ * interrupts that became pending inside a critical section run when it is
+ * left, the same as on the target.
+ */
+
+#ifndef HOST_EM_CORE_H_
+#define HOST_EM_CORE_H_
+
+#include "em_device.h"
+
+typedef uint32_t CORE_irqState_t;
+
+// weak, src/irq_timing.c replaces them with IRQ_TIMING like it does on target
+CORE_irqState_t CORE_EnterCritical(void);
+void CORE_ExitCritical(CORE_irqState_t irqState);
+
+#define CORE_DECLARE_IRQ_STATE CORE_irqState_t irqState
+#define CORE_ENTER_CRITICAL() irqState = CORE_EnterCritical()
+#define CORE_EXIT_CRITICAL() CORE_ExitCritical(irqState)
+#define CORE_ENTER_ATOMIC() CORE_ENTER_CRITICAL()
+#define CORE_EXIT_ATOMIC() CORE_EXIT_CRITICAL()
+
+#endif /* HOST_EM_CORE_H_ */
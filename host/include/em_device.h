@@ -0,0 +1,119 @@
+/*
+ * em_device.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the EFR32BG13 device header and the CMSIS core functions
+ * the firmware uses. Interrupt numbers match the real device, the register
+ * blocks only have the fields the firmware touches. Everything is backed by
+ * the simulator in host/sim.
+ */
+
+#ifndef HOST_EM_DEVICE_H_
+#define HOST_EM_DEVICE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "em_common.h"
+
+#define __NVIC_PRIO_BITS 3U
+
+#define __INLINE static inline
+#define __STATIC_INLINE static inline
+
+typedef enum {
+    GPIO_EVEN_IRQn = 10,
+    I2C0_IRQn      = 17,
+    GPIO_ODD_IRQn  = 18,
+    LETIMER0_IRQn  = 27,
+    VDAC0_IRQn     = 41,
+    CSEN_IRQn      = 42
+} IRQn_Type;
+
+#define EXT_IRQ_COUNT 47
+
+// ---------------------------------------------------------------------
+// NVIC and core registers
+// ---------------------------------------------------------------------
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+
+uint32_t __get_PRIMASK(void);
+uint32_t __get_IPSR(void);
+void __disable_irq(void);
+void __enable_irq(void);
+
+// one exclusive monitor, cleared on exception entry and return like the core's
+uint32_t __LDREXW(volatile uint32_t* addr);
+uint32_t __STREXW(uint32_t value, volatile uint32_t* addr);
+void __CLREX(void);
+
+#define __DMB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __CLZ(x) ((uint8_t) (((x) == 0U) ? 32U : (uint32_t) __builtin_clz(x)))
+
+// core clock of the target, HFXO
+#define SIM_CORE_CLOCK_HZ 38400000UL
+
+uint32_t SystemCoreClockGet(void);
+
+typedef struct {
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+// every access refreshes CYCCNT, see sim_dwt() in sim_cpu.c
+DWT_Type* sim_dwt(void);
+extern CoreDebug_Type sim_core_debug;
+
+#define DWT (sim_dwt())
+#define CoreDebug (&sim_core_debug)
+
+// ---------------------------------------------------------------------
+// Peripheral register blocks, fields the firmware writes directly
+// ---------------------------------------------------------------------
+
+typedef struct {
+    volatile uint32_t SYNCBUSY;
+} LETIMER_TypeDef;
+
+typedef struct {
+    volatile uint32_t CMD;
+    volatile uint32_t ROUTEPEN;
+} I2C_TypeDef;
+
+extern LETIMER_TypeDef sim_letimer0;
+extern I2C_TypeDef sim_i2c0;
+
+#define LETIMER0 (&sim_letimer0)
+#define I2C0 (&sim_i2c0)
+
+#define LETIMER_IF_COMP0  (0x1UL << 0)
+#define LETIMER_IF_COMP1  (0x1UL << 1)
+#define LETIMER_IF_UF     (0x1UL << 2)
+#define LETIMER_IFS_COMP1 LETIMER_IF_COMP1
+#define LETIMER_IFC_COMP1 LETIMER_IF_COMP1
+#define LETIMER_IEN_COMP1 LETIMER_IF_COMP1
+#define LETIMER_IEN_UF    LETIMER_IF_UF
+
+#define I2C_CMD_ABORT       (0x1UL << 5)
+#define I2C_ROUTEPEN_SDAPEN (0x1UL << 0)
+#define I2C_ROUTEPEN_SCLPEN (0x1UL << 1)
+#define _I2C_IFC_MASK       0x0007FFCFUL
+
+#define _GPIO_IF_EXT_MASK 0xFFFFUL
+
+#endif /* HOST_EM_DEVICE_H_ */
@@ -0,0 +1,18 @@
+/*
+ * em_emu.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the energy management unit.
+ */
+
+#ifndef HOST_EM_EMU_H_
+#define HOST_EM_EMU_H_
+
+#include "em_device.h"
+
+// sleeps until an interrupt is pending, the virtual clock jumps to the next event
+void EMU_EnterEM1(void);
+
+#endif /* HOST_EM_EMU_H_ */
@@ -0,0 +1,56 @@
+/*
+ * em_gpio.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the GPIO driver. Output pins keep the level the firmware
+ * drives, input pins read the level set by the simulator (buttons, MFIO).
+ */
+
+#ifndef HOST_EM_GPIO_H_
+#define HOST_EM_GPIO_H_
+
+#include "em_device.h"
+
+#define GPIO_EXTINTNO_MAX 15
+#define GPIO_PORT_MAX 6
+#define GPIO_PIN_MAX 15
+
+typedef enum {
+    gpioPortA,
+    gpioPortB,
+    gpioPortC,
+    gpioPortD,
+    gpioPortE,
+    gpioPortF
+} GPIO_Port_TypeDef;
+
+typedef enum {
+    gpioModeDisabled,
+    gpioModeInput,
+    gpioModeInputPull,
+    gpioModeInputPullFilter,
+    gpioModePushPull,
+    gpioModeWiredAnd,
+    gpioModeWiredAndPullUp
+} GPIO_Mode_TypeDef;
+
+typedef enum {
+    gpioDriveStrengthWeakAlternateWeak,
+    gpioDriveStrengthWeakAlternateStrong,
+    gpioDriveStrengthStrongAlternateWeak,
+    gpioDriveStrengthStrongAlternateStrong
+} GPIO_DriveStrength_TypeDef;
+
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength);
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out);
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin, unsigned int intNo,
+                       bool risingEdge, bool fallingEdge, bool enable);
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin);
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin);
+uint32_t GPIO_IntGetEnabled(void);
+void GPIO_IntClear(uint32_t flags);
+
+#endif /* HOST_EM_GPIO_H_ */
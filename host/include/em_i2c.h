@@ -0,0 +1,58 @@
+/*
+ * em_i2c.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the I2C driver. Transfers go to the simulated devices
+ * attached with sim_i2c_attach() and take as long as they would on the bus.
+ */
+
+#ifndef HOST_EM_I2C_H_
+#define HOST_EM_I2C_H_
+
+#include "em_device.h"
+
+#define I2C_FREQ_STANDARD_MAX 92000
+#define I2C_FREQ_FAST_MAX 392157
+#define I2C_FREQ_FASTPLUS_MAX 987167
+
+#define I2C_FLAG_WRITE       0x0001
+#define I2C_FLAG_READ        0x0002
+#define I2C_FLAG_WRITE_READ  0x0004
+#define I2C_FLAG_WRITE_WRITE 0x0008
+#define I2C_FLAG_10BIT_ADDR  0x0010
+
+typedef enum {
+    i2cTransferInProgress = 1,
+    i2cTransferDone = 0,
+    i2cTransferNack = -1,
+    i2cTransferBusErr = -2,
+    i2cTransferArbLost = -3,
+    i2cTransferUsageFault = -4,
+    i2cTransferSwFault = -5
+} I2C_TransferReturn_TypeDef;
+
+typedef enum {
+    i2cClockHLRStandard,
+    i2cClockHLRAsymetric,
+    i2cClockHLRFast
+} I2C_ClockHLR_TypeDef;
+
+typedef struct {
+    uint16_t addr;
+    uint16_t flags;
+    struct {
+        uint8_t* data;
+        uint16_t len;
+    } buf[2];
+} I2C_TransferSeq_TypeDef;
+
+void I2C_BusFreqSet(I2C_TypeDef* i2c, uint32_t freqRef, uint32_t freqScl, I2C_ClockHLR_TypeDef i2cMode);
+void I2C_Enable(I2C_TypeDef* i2c, bool enable);
+void I2C_Reset(I2C_TypeDef* i2c);
+void I2C_IntClear(I2C_TypeDef* i2c, uint32_t flags);
+I2C_TransferReturn_TypeDef I2C_TransferInit(I2C_TypeDef* i2c, I2C_TransferSeq_TypeDef* seq);
+I2C_TransferReturn_TypeDef I2C_Transfer(I2C_TypeDef* i2c);
+
+#endif /* HOST_EM_I2C_H_ */
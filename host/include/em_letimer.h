@@ -0,0 +1,55 @@
+/*
+ * em_letimer.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the LETIMER driver. The counter is derived from the
+ * virtual clock, it counts down from COMP0 and raises UF and COMP1 like the
+ * peripheral, see sim_letimer.c.
+ */
+
+#ifndef HOST_EM_LETIMER_H_
+#define HOST_EM_LETIMER_H_
+
+#include "em_device.h"
+
+typedef enum {
+    letimerRepeatFree,
+    letimerRepeatOneshot,
+    letimerRepeatBuffered,
+    letimerRepeatDouble
+} LETIMER_RepeatMode_TypeDef;
+
+typedef enum {
+    letimerUFOANone,
+    letimerUFOAToggle,
+    letimerUFOAPulse,
+    letimerUFOAPwm
+} LETIMER_UFOA_TypeDef;
+
+typedef struct {
+    bool enable;
+    bool debugRun;
+    bool comp0Top;
+    bool bufTop;
+    uint8_t out0Pol;
+    uint8_t out1Pol;
+    LETIMER_UFOA_TypeDef ufoa0;
+    LETIMER_UFOA_TypeDef ufoa1;
+    LETIMER_RepeatMode_TypeDef repMode;
+    uint32_t topValue;
+} LETIMER_Init_TypeDef;
+
+void LETIMER_Init(LETIMER_TypeDef* letimer, const LETIMER_Init_TypeDef* init);
+void LETIMER_Enable(LETIMER_TypeDef* letimer, bool enable);
+void LETIMER_CompareSet(LETIMER_TypeDef* letimer, unsigned int comp, uint32_t value);
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef* letimer);
+uint32_t LETIMER_IntGet(LETIMER_TypeDef* letimer);
+uint32_t LETIMER_IntGetEnabled(LETIMER_TypeDef* letimer);
+void LETIMER_IntSet(LETIMER_TypeDef* letimer, uint32_t flags);
+void LETIMER_IntClear(LETIMER_TypeDef* letimer, uint32_t flags);
+void LETIMER_IntEnable(LETIMER_TypeDef* letimer, uint32_t flags);
+void LETIMER_IntDisable(LETIMER_TypeDef* letimer, uint32_t flags);
+
+#endif /* HOST_EM_LETIMER_H_ */
@@ -0,0 +1,56 @@
+/*
+ * glib.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the GLIB graphics library. Strings drawn on a line are
+ * kept as text per row, DMD_updateDisplay() makes them visible to the
+ * simulator, see sim_display.c.
+ */
+
+#ifndef HOST_GLIB_H_
+#define HOST_GLIB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t EMSTATUS;
+
+#define GLIB_OK 0x00000000
+#define GLIB_ERROR_INVALID_ARGUMENT 0x00000002
+
+typedef enum {
+    Black = 0x000000,
+    White = 0xFFFFFF
+} GLIB_Color_t;
+
+typedef struct {
+    const char* name;
+    uint8_t fontWidth;
+    uint8_t fontHeight;
+    uint8_t lineSpacing;
+    uint8_t charSpacing;
+} GLIB_Font_t;
+
+extern const GLIB_Font_t GLIB_FontNarrow6x8;
+
+typedef struct {
+    uint32_t foregroundColor;
+    uint32_t backgroundColor;
+    GLIB_Font_t font;
+} GLIB_Context_t;
+
+typedef enum {
+    GLIB_ALIGN_LEFT,
+    GLIB_ALIGN_CENTER,
+    GLIB_ALIGN_RIGHT
+} GLIB_Align_t;
+
+EMSTATUS GLIB_contextInit(GLIB_Context_t* pContext);
+EMSTATUS GLIB_clear(GLIB_Context_t* pContext);
+EMSTATUS GLIB_setFont(GLIB_Context_t* pContext, GLIB_Font_t* pFont);
+EMSTATUS GLIB_drawStringOnLine(GLIB_Context_t* pContext, const char* pString, uint8_t line,
+                               GLIB_Align_t align, int32_t xOffset, int32_t yOffset, bool opaque);
+
+#endif /* HOST_GLIB_H_ */
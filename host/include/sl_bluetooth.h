@@ -0,0 +1,25 @@
+/*
+ * sl_bluetooth.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for autogen/sl_bluetooth.h, the stack configuration headers
+ * it pulls in are target only. The component catalog comes along like it
+ * does through sl_bluetooth_config.h.
+ */
+
+#ifndef HOST_SL_BLUETOOTH_H_
+#define HOST_SL_BLUETOOTH_H_
+
+#include <stdbool.h>
+
+#include "sl_component_catalog.h"
+#include "sl_power_manager.h"
+#include "sl_bt_api.h"
+
+void sl_bt_init(void);
+void sl_bt_step(void);
+void sl_bt_on_event(sl_bt_msg_t* evt);
+
+#endif /* HOST_SL_BLUETOOTH_H_ */
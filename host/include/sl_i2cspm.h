@@ -0,0 +1,34 @@
+/*
+ * sl_i2cspm.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the I2C simple polled master.
+ */
+
+#ifndef HOST_SL_I2CSPM_H_
+#define HOST_SL_I2CSPM_H_
+
+#include "em_gpio.h"
+#include "em_i2c.h"
+
+typedef struct {
+    I2C_TypeDef* port;
+    GPIO_Port_TypeDef sclPort;
+    uint8_t sclPin;
+    GPIO_Port_TypeDef sdaPort;
+    uint8_t sdaPin;
+    uint8_t portLocationScl;
+    uint8_t portLocationSda;
+    uint32_t i2cRefFreq;
+    uint32_t i2cMaxFreq;
+    I2C_ClockHLR_TypeDef i2cClhr;
+} I2CSPM_Init_TypeDef;
+
+void I2CSPM_Init(I2CSPM_Init_TypeDef* init);
+
+// blocks until the transfer is finished, interrupts keep running meanwhile
+I2C_TransferReturn_TypeDef I2CSPM_Transfer(I2C_TypeDef* i2c, I2C_TransferSeq_TypeDef* seq);
+
+#endif /* HOST_SL_I2CSPM_H_ */
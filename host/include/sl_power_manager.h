@@ -0,0 +1,65 @@
+/*
+ * sl_power_manager.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the power manager. Sleeping advances the virtual clock
+ * to the next event that raises an interrupt, the simulator keeps the time
+ * spent in each energy mode.
+ */
+
+#ifndef HOST_SL_POWER_MANAGER_H_
+#define HOST_SL_POWER_MANAGER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM0 (1 << 0)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM0  (1 << 1)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM1 (1 << 2)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM1  (1 << 3)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM2 (1 << 4)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM2  (1 << 5)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM3 (1 << 6)
+#define SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM3  (1 << 7)
+
+typedef enum {
+    SL_POWER_MANAGER_EM0 = 0,
+    SL_POWER_MANAGER_EM1,
+    SL_POWER_MANAGER_EM2,
+    SL_POWER_MANAGER_EM3,
+    SL_POWER_MANAGER_EM4
+} sl_power_manager_em_t;
+
+typedef enum {
+    SL_POWER_MANAGER_IGNORE = (1UL << 0UL),
+    SL_POWER_MANAGER_SLEEP  = (1UL << 1UL),
+    SL_POWER_MANAGER_WAKEUP = (1UL << 2UL)
+} sl_power_manager_on_isr_exit_t;
+
+typedef uint32_t sl_power_manager_em_transition_event_t;
+
+typedef void (*sl_power_manager_em_transition_on_event_t)(sl_power_manager_em_t from, sl_power_manager_em_t to);
+
+typedef struct {
+    sl_power_manager_em_transition_event_t event_mask;
+    sl_power_manager_em_transition_on_event_t on_event;
+} sl_power_manager_em_transition_event_info_t;
+
+typedef struct sl_power_manager_em_transition_event_handle {
+    struct sl_power_manager_em_transition_event_handle* next;
+    const sl_power_manager_em_transition_event_info_t* info;
+} sl_power_manager_em_transition_event_handle_t;
+
+void sl_power_manager_add_em_requirement(sl_power_manager_em_t em);
+void sl_power_manager_remove_em_requirement(sl_power_manager_em_t em);
+void sl_power_manager_sleep(void);
+void sl_power_manager_subscribe_em_transition_event(sl_power_manager_em_transition_event_handle_t* handle,
+                                                    const sl_power_manager_em_transition_event_info_t* info);
+
+// implemented by the application, see app.c
+bool app_is_ok_to_sleep(void);
+sl_power_manager_on_isr_exit_t app_sleep_on_isr_exit(void);
+
+#endif /* HOST_SL_POWER_MANAGER_H_ */
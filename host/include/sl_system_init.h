@@ -0,0 +1,15 @@
+/*
+ * sl_system_init.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in, brings up the simulated device and queues the boot event.
+ */
+
+#ifndef HOST_SL_SYSTEM_INIT_H_
+#define HOST_SL_SYSTEM_INIT_H_
+
+void sl_system_init(void);
+
+#endif /* HOST_SL_SYSTEM_INIT_H_ */
@@ -0,0 +1,15 @@
+/*
+ * sl_system_process_action.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in, delivers the simulated stack's events to sl_bt_on_event().
+ */
+
+#ifndef HOST_SL_SYSTEM_PROCESS_ACTION_H_
+#define HOST_SL_SYSTEM_PROCESS_ACTION_H_
+
+void sl_system_process_action(void);
+
+#endif /* HOST_SL_SYSTEM_PROCESS_ACTION_H_ */
@@ -0,0 +1,17 @@
+/*
+ * sl_udelay.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host stand-in for the busy wait delay, advances the virtual clock.
+ */
+
+#ifndef HOST_SL_UDELAY_H_
+#define HOST_SL_UDELAY_H_
+
+#include <stdint.h>
+
+void sl_udelay_wait(unsigned us);
+
+#endif /* HOST_SL_UDELAY_H_ */
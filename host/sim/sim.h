@@ -0,0 +1,292 @@
+/*
+ * sim.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Host simulation of the EFR32BG13 board the firmware runs on.
+ *
+ * Everything shares one virtual clock in nanoseconds. Time only moves when
+ * the firmware sleeps, waits on the bus or spends a critical section, or
+ * when a harness advances it directly. Peripheral models and scripted
+ * actions are event sources on that clock; when one fires it can raise an
+ * interrupt, which runs the firmware's handler at its NVIC priority.
+ *
+ * The firmware's main() runs in a coroutine, sim_run_until() returns to the
+ * harness once the main loop sleeps past the requested time. Tests of a
+ * single module skip main() and call the module and sim_advance() directly.
+ */
+
+#ifndef HOST_SIM_H_
+#define HOST_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "em_device.h"
+#include "em_gpio.h"
+#include "em_i2c.h"
+#include "sl_power_manager.h"
+#include "sl_bt_api.h"
+
+// ---------------------------------------------------------------------
+// Virtual clock
+// ---------------------------------------------------------------------
+
+typedef uint64_t sim_time_t; // ns since power on
+
+#define SIM_US(us) ((sim_time_t) (us) * 1000ULL)
+#define SIM_MS(ms) ((sim_time_t) (ms) * 1000000ULL)
+#define SIM_S(s)   ((sim_time_t) (s) * 1000000000ULL)
+
+// cpu time charged for each critical section, lets polling loops make progress
+#define SIM_CRITICAL_NS 250
+
+sim_time_t sim_now(void);
+
+// runs every event source and interrupt due up to t
+void sim_advance_to(sim_time_t t);
+void sim_advance(sim_time_t dt);
+
+// one thing that happens at a point in virtual time, owned by its model
+typedef struct sim_source {
+    const char* name;
+    void (*fire)(struct sim_source* s);
+    void* context;
+    // private
+    sim_time_t when;
+    bool armed;
+    struct sim_source* next;
+} sim_source_t;
+
+void sim_source_arm(sim_source_t* s, sim_time_t when);
+void sim_source_cancel(sim_source_t* s);
+
+// scripted one-off action, the harness side of an event source
+typedef void (*sim_action_t)(void* context, uint32_t arg);
+void sim_at(sim_time_t t, sim_action_t action, void* context, uint32_t arg);
+
+// ---------------------------------------------------------------------
+// Running the firmware
+// ---------------------------------------------------------------------
+
+// runs the firmware's main() until its main loop sleeps past t
+void sim_run_until(sim_time_t t);
+void sim_run_for(sim_time_t dt);
+bool sim_firmware_started(void);
+
+// ---------------------------------------------------------------------
+// Cpu
+// ---------------------------------------------------------------------
+
+// re-evaluates the interrupt lines and runs whatever may preempt the current level
+void sim_irq_update(void);
+bool sim_in_isr(void);
+uint32_t sim_irq_count(IRQn_Type irq);
+
+// host time spent in a handler, nested handlers included
+uint64_t sim_irq_host_ns(IRQn_Type irq);
+
+// called between LDREX and STREX, just before the store, as "an interrupt"
+// that takes the exclusive monitor away; a test can post from here
+void sim_on_ldrex(void (*hook)(void));
+
+// ---------------------------------------------------------------------
+// Energy modes
+// ---------------------------------------------------------------------
+
+sim_time_t sim_em_time(sl_power_manager_em_t em);
+uint32_t sim_em_requirement(sl_power_manager_em_t em);
+uint32_t sim_wakeups(void);
+
+// times the core went to EM2 while an I2C transfer needed the peripheral clock
+uint32_t sim_em2_during_transfer(void);
+
+// ---------------------------------------------------------------------
+// GPIO
+// ---------------------------------------------------------------------
+
+// level driven onto a pin from outside the chip, SIM_GPIO_RELEASE to let it float
+#define SIM_GPIO_RELEASE (-1)
+void sim_gpio_drive(GPIO_Port_TypeDef port, unsigned int pin, int level);
+unsigned int sim_gpio_level(GPIO_Port_TypeDef port, unsigned int pin);
+GPIO_Mode_TypeDef sim_gpio_mode(GPIO_Port_TypeDef port, unsigned int pin);
+
+// called when the level of a pin changes
+typedef void (*sim_gpio_watch_t)(GPIO_Port_TypeDef port, unsigned int pin, unsigned int level);
+void sim_gpio_watch(GPIO_Port_TypeDef port, unsigned int pin, sim_gpio_watch_t watch);
+
+// push buttons on the main board, pressed pulls the pin low
+void sim_button(int button, bool pressed);
+
+// LEDs on the main board
+bool sim_led(int led);
+
+// ---------------------------------------------------------------------
+// I2C bus
+// ---------------------------------------------------------------------
+
+// a device on the bus, called when a transfer starts
+typedef struct sim_i2c_device {
+    const char* name;
+    uint16_t addr; // 8 bit address
+    I2C_TransferReturn_TypeDef (*write)(struct sim_i2c_device* d, const uint8_t* data, uint16_t len);
+    I2C_TransferReturn_TypeDef (*read)(struct sim_i2c_device* d, uint8_t* data, uint16_t len);
+    // private
+    struct sim_i2c_device* next;
+} sim_i2c_device_t;
+
+// a device at an address that is taken replaces the one there, a replay can stand in for a model
+void sim_i2c_attach(sim_i2c_device_t* d);
+
+// the next count transfers end with status instead of reaching the device
+void sim_i2c_fail_next(I2C_TransferReturn_TypeDef status, uint32_t count);
+
+typedef struct {
+    uint32_t transfers;
+    uint32_t bytes;
+    uint32_t nacks;
+    uint32_t errors; // injected bus errors and arbitration losses
+    uint32_t blocking; // transfers through I2CSPM_Transfer()
+    uint32_t freq; // bus speed now
+} sim_i2c_stats_t;
+
+const sim_i2c_stats_t* sim_i2c_stats(void);
+
+// ---------------------------------------------------------------------
+// MAX32664 sensor hub and MAX30101
+// ---------------------------------------------------------------------
+
+// what the algorithm reports, and what the raw PPG looks like
+typedef struct {
+    uint8_t finger_status; // 0 nothing, 1 object, 3 finger
+    uint16_t heart_rate; // bpm
+    uint16_t blood_oxygen; // %
+    uint8_t confidence; // %
+} sim_hub_reading_t;
+
+void sim_hub_set_reading(const sim_hub_reading_t* reading);
+void sim_hub_finger(uint16_t heart_rate, uint16_t blood_oxygen, uint8_t confidence);
+void sim_hub_no_finger(void);
+
+// the hub reports a sensor communication error in its status byte
+void sim_hub_comm_error(bool error);
+
+typedef struct {
+    bool running; // out of reset and booted
+    bool sensor_enabled;
+    bool algo_enabled;
+    uint8_t output_mode;
+    uint8_t fifo_threshold;
+    uint32_t resets;
+    uint32_t commands;
+    uint32_t fifo_reads;
+    uint32_t samples_read;
+    uint32_t samples_lost; // overwritten in a full fifo
+    uint32_t early_reads; // responses read before the command finished
+} sim_hub_stats_t;
+
+const sim_hub_stats_t* sim_hub_stats(void);
+
+// ---------------------------------------------------------------------
+// Si7021 temperature sensor
+// ---------------------------------------------------------------------
+
+void sim_si7021_set_temperature(int32_t millidegrees);
+uint32_t sim_si7021_conversions(void);
+
+// ---------------------------------------------------------------------
+// Bluetooth stack and the client on the other end of the link
+// ---------------------------------------------------------------------
+
+typedef struct {
+    uint16_t mtu; // asked for in the MTU exchange
+    bool phy_2m; // accepts the 2M PHY
+    bool confirm_indications; // otherwise indications time out
+    uint32_t confirm_delay_us; // indication to confirmation
+} sim_bt_client_t;
+
+void sim_bt_client_config(const sim_bt_client_t* client);
+
+// client actions, each turns into the events the stack would raise
+void sim_bt_connect(void);
+void sim_bt_disconnect(void);
+void sim_bt_bond(void); // bonding request, the passkey is confirmed by the client
+void sim_bt_subscribe(uint16_t characteristic, uint16_t flags); // CCCD write, gatt_disable/gatt_notification/gatt_indication
+void sim_bt_read(uint16_t characteristic, uint16_t offset);
+void sim_bt_write(uint16_t characteristic, const uint8_t* data, uint8_t len);
+
+// raises any event, for replaying a journal
+void sim_bt_inject(const sl_bt_msg_t* evt);
+
+// the stack raises no events of its own, boot and soft timers included, set before the first run
+void sim_bt_replay_mode(bool on);
+
+// per characteristic counters on the client side
+typedef struct {
+    uint32_t notifications;
+    uint32_t indications;
+    uint32_t confirmations;
+    uint32_t bytes;
+    uint8_t last_value[256];
+    uint16_t last_len;
+} sim_bt_char_stats_t;
+
+typedef struct {
+    bool advertising;
+    bool connected;
+    bool bonded;
+    uint16_t mtu;
+    uint8_t phy;
+    uint16_t interval; // 1.25 ms units
+    uint16_t latency;
+    uint32_t parameter_requests;
+    uint32_t events_delivered;
+    uint32_t notify_rejected; // notifications refused for a full buffer or a bad length
+    uint32_t indication_errors; // indications sent while one was in flight
+    uint32_t indication_timeouts;
+    uint8_t last_read[256]; // last user read response
+    uint16_t last_read_len;
+    uint8_t last_write_status;
+} sim_bt_stats_t;
+
+const sim_bt_stats_t* sim_bt_stats(void);
+const sim_bt_char_stats_t* sim_bt_char_stats(uint16_t characteristic);
+
+// value written with sl_bt_gatt_server_write_attribute_value()
+const uint8_t* sim_bt_attribute(uint16_t attribute, uint16_t* len);
+
+// host time sl_bt_on_event() took per event id, what the handlers cost on a workload
+typedef struct {
+    uint32_t id;
+    uint32_t count;
+    uint64_t host_ns;
+    uint64_t max_host_ns;
+} sim_bt_event_cost_t;
+
+const sim_bt_event_cost_t* sim_bt_event_costs(int* count);
+
+// ---------------------------------------------------------------------
+// Display and log
+// ---------------------------------------------------------------------
+
+// text on a row as of the last DMD_updateDisplay()
+const char* sim_display_row(int row);
+uint32_t sim_display_updates(void);
+
+// time DMD_updateDisplay() keeps the caller busy, 0 by default
+// the memory LCD takes about 16.8 ms for a frame, 128 rows of 18 bytes at 1.1 MHz
+void sim_display_update_time(sim_time_t ns);
+
+// every log line goes here, the default prints to stdout
+typedef void (*sim_log_sink_t)(const char* line);
+void sim_log_set_sink(sim_log_sink_t sink);
+void sim_log_quiet(bool quiet);
+
+// time app_log() keeps the caller busy per character, 0 by default
+// the VCOM USART takes 86.8 us, 10 bits at 115200 baud
+void sim_log_char_time(sim_time_t ns);
+uint32_t sim_log_errors(void);
+
+#endif /* HOST_SIM_H_ */
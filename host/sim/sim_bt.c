@@ -0,0 +1,772 @@
+/*
+ * sim_bt.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Bluetooth stack stand-in and the client on the other end of the link.
+ *
+ * The stack keeps a queue of events and hands one to sl_bt_on_event() per
+ * sl_system_process_action(), the main loop doesn't sleep while the queue
+ * holds any. External signals from interrupts are OR'ed into one queued
+ * external signal event until it is delivered, like the real stack does.
+ *
+ * The client acts on the harness's requests and answers the firmware's
+ * calls after a link-layer delay: it exchanges the MTU after connecting,
+ * accepts parameter and PHY updates, confirms the passkey during bonding
+ * and confirms indications unless told not to.
+ *
+ * In replay mode the stack raises nothing by itself, not even the boot
+ * event or soft timers; every event comes from sim_bt_inject() and the
+ * link state follows the events injected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim_internal.h"
+#include "sl_bluetooth.h"
+#include "sl_system_init.h"
+#include "sl_system_process_action.h"
+
+#define EVENT_QUEUE_DEPTH 64
+#define NUM_SOFT_TIMERS 8
+#define NUM_ATTRIBUTES 64
+
+#define CONNECTION_HANDLE 1
+
+// link layer round trips, a few connection events
+#define LINK_DELAY SIM_MS(30)
+#define MTU_EXCHANGE_DELAY SIM_MS(60)
+#define INDICATION_TIMEOUT SIM_S(30)
+
+// notifications the stack can hold before the link has sent them
+#define TX_BUFFERS 10
+// packets sent per connection event
+#define PACKETS_PER_EVENT 4
+
+#define SOFT_TIMER_HZ 32768
+
+#define REASON_REMOTE_USER_TERMINATED 0x1013
+#define ATT_OPCODE_READ_REQUEST 0x0a
+#define ATT_OPCODE_READ_BLOB_REQUEST 0x0c
+#define ATT_OPCODE_WRITE_REQUEST 0x12
+
+static sl_bt_msg_t queue[EVENT_QUEUE_DEPTH];
+static uint8_t queue_rptr = 0;
+static uint8_t queue_count = 0;
+
+// external signals raised since the queued external signal event
+static uint32_t pending_signals = 0;
+static bool signal_queued = false;
+
+static sim_bt_stats_t stats;
+static sim_bt_char_stats_t char_stats[NUM_ATTRIBUTES];
+static sim_bt_client_t client = {
+    .mtu = 247,
+    .phy_2m = true,
+    .confirm_indications = true,
+    .confirm_delay_us = 30000
+};
+
+static uint16_t server_max_mtu = 247;
+static bool replay = false;
+
+typedef struct {
+    uint16_t len;
+    uint8_t value[256];
+} attribute_t;
+
+static attribute_t attributes[NUM_ATTRIBUTES];
+
+// soft timers, one source per handle
+typedef struct {
+    sim_source_t source;
+    sim_time_t period;
+    uint8_t handle;
+} soft_timer_t;
+
+static soft_timer_t soft_timers[NUM_SOFT_TIMERS];
+
+// indication waiting for the client
+static bool indication_in_flight = false;
+static uint16_t indication_char = 0;
+static sim_source_t indication_source;
+
+// notifications the link hasn't sent yet
+static uint32_t tx_queued = 0;
+static sim_source_t tx_source;
+
+// host time spent in sl_bt_on_event() per event id
+#define NUM_COST_ENTRIES 32
+static sim_bt_event_cost_t costs[NUM_COST_ENTRIES];
+static int num_costs = 0;
+
+// ---------------------------------------------------------------------
+// Event queue
+// ---------------------------------------------------------------------
+
+// private helper, header of an event with its payload length
+static uint32_t make_header(uint32_t id, uint16_t len) {
+    return id | ((uint32_t) (len & 0xFF) << 8) | ((len >> 8) & 0x07);
+}
+
+static uint16_t event_length(const sl_bt_msg_t* evt) {
+    return SL_BT_MSG_LEN(evt->header);
+}
+
+static sl_bt_msg_t* queue_alloc(void) {
+    if (queue_count == EVENT_QUEUE_DEPTH) {
+        fprintf(stderr, "sim: bluetooth event queue full\n");
+        abort();
+    }
+    sl_bt_msg_t* evt = &queue[(queue_rptr + queue_count) % EVENT_QUEUE_DEPTH];
+    queue_count++;
+    memset(evt, 0, sizeof(*evt));
+    return evt;
+}
+
+static void queue_event(const sl_bt_msg_t* evt) {
+    sl_bt_msg_t* e = queue_alloc();
+    memcpy(e, evt, sizeof(e->header) + event_length(evt));
+}
+
+// event that the stack raises later
+typedef struct {
+    sim_source_t source;
+    sl_bt_msg_t evt;
+} delayed_event_t;
+
+static void delayed_event_fire(sim_source_t* s) {
+    delayed_event_t* d = (delayed_event_t*) s;
+
+    // the link went down meanwhile
+    if ((SL_BT_MSG_ID(d->evt.header) != sl_bt_evt_connection_opened_id) && !stats.connected &&
+        (SL_BT_MSG_ID(d->evt.header) != sl_bt_evt_system_boot_id)) {
+        free(d);
+        return;
+    }
+    queue_event(&d->evt);
+    free(d);
+}
+
+static void queue_event_at(sim_time_t t, const sl_bt_msg_t* evt) {
+    if (replay) {
+        return;
+    }
+    delayed_event_t* d = calloc(1, sizeof(*d));
+    if (d == 0) {
+        abort();
+    }
+    d->source.name = "bt event";
+    d->source.fire = delayed_event_fire;
+    memcpy(&d->evt, evt, sizeof(evt->header) + event_length(evt));
+    sim_source_arm(&d->source, t);
+}
+
+bool sim_bt_has_work(void) {
+    return queue_count > 0;
+}
+
+// private helper, the link state a replayed event implies
+static void follow_event(const sl_bt_msg_t* evt) {
+    switch (SL_BT_MSG_ID(evt->header)) {
+        case sl_bt_evt_connection_opened_id:
+            stats.connected = true;
+            stats.advertising = false;
+            stats.bonded = false;
+            stats.mtu = 23;
+            indication_in_flight = false;
+            tx_queued = 0;
+            break;
+        case sl_bt_evt_connection_closed_id:
+            stats.connected = false;
+            stats.bonded = false;
+            indication_in_flight = false;
+            tx_queued = 0;
+            sim_source_cancel(&tx_source);
+            break;
+        case sl_bt_evt_connection_parameters_id:
+            stats.interval = evt->data.evt_connection_parameters.interval;
+            stats.latency = evt->data.evt_connection_parameters.latency;
+            break;
+        case sl_bt_evt_connection_phy_status_id:
+            stats.phy = evt->data.evt_connection_phy_status.phy;
+            break;
+        case sl_bt_evt_gatt_mtu_exchanged_id:
+            stats.mtu = evt->data.evt_gatt_mtu_exchanged.mtu;
+            break;
+        case sl_bt_evt_sm_bonded_id:
+            stats.bonded = true;
+            break;
+        case sl_bt_evt_gatt_server_characteristic_status_id:
+            if (evt->data.evt_gatt_server_characteristic_status.status_flags == sl_bt_gatt_server_confirmation) {
+                char_stats[indication_char % NUM_ATTRIBUTES].confirmations++;
+                indication_in_flight = false;
+            }
+            break;
+        case sl_bt_evt_gatt_server_indication_timeout_id:
+            stats.indication_timeouts++;
+            indication_in_flight = false;
+            break;
+        default:
+            break;
+    }
+}
+
+void sim_bt_inject(const sl_bt_msg_t* evt) {
+    if (replay) {
+        follow_event(evt);
+    }
+    queue_event(evt);
+}
+
+void sim_bt_replay_mode(bool on) {
+    replay = on;
+}
+
+// private helper, adds up host time per event id
+static void record_cost(uint32_t id, uint64_t ns) {
+    int i;
+    for (i = 0; i < num_costs; i++) {
+        if (costs[i].id == id) {
+            break;
+        }
+    }
+    if (i == num_costs) {
+        if (num_costs == NUM_COST_ENTRIES) {
+            return;
+        }
+        costs[i].id = id;
+        num_costs++;
+    }
+    costs[i].count++;
+    costs[i].host_ns += ns;
+    if (ns > costs[i].max_host_ns) {
+        costs[i].max_host_ns = ns;
+    }
+}
+
+static uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+void sl_bt_step(void) {
+    sl_bt_msg_t evt;
+
+    if (queue_count == 0) {
+        return;
+    }
+    memcpy(&evt, &queue[queue_rptr], sizeof(evt));
+    queue_rptr = (queue_rptr + 1) % EVENT_QUEUE_DEPTH;
+    queue_count--;
+
+    // the signals raised until now go with this event, later ones queue another
+    if (SL_BT_MSG_ID(evt.header) == sl_bt_evt_system_external_signal_id) {
+        evt.data.evt_system_external_signal.extsignals = pending_signals;
+        pending_signals = 0;
+        signal_queued = false;
+    }
+
+    stats.events_delivered++;
+    uint64_t start = host_ns();
+    sl_bt_on_event(&evt);
+    record_cost(SL_BT_MSG_ID(evt.header), host_ns() - start);
+}
+
+const sim_bt_event_cost_t* sim_bt_event_costs(int* count) {
+    *count = num_costs;
+    return costs;
+}
+
+// ---------------------------------------------------------------------
+// System
+// ---------------------------------------------------------------------
+
+void sim_bt_boot(void) {
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_system_boot_id, sizeof(evt.data.evt_system_boot));
+    evt.data.evt_system_boot.major = 3;
+    evt.data.evt_system_boot.minor = 2;
+    evt.data.evt_system_boot.patch = 1;
+    queue_event(&evt);
+}
+
+void sl_bt_init(void) {
+}
+
+void sl_system_init(void) {
+    sl_bt_init();
+    if (!replay) {
+        sim_bt_boot();
+    }
+}
+
+void sl_system_process_action(void) {
+    sl_bt_step();
+}
+
+void sl_bt_external_signal(uint32_t signals) {
+    pending_signals |= signals;
+    if (!signal_queued) {
+        sl_bt_msg_t* evt = queue_alloc();
+        evt->header = make_header(sl_bt_evt_system_external_signal_id, sizeof(evt->data.evt_system_external_signal));
+        signal_queued = true;
+    }
+}
+
+sl_status_t sl_bt_system_get_identity_address(bd_addr* address, uint8_t* type) {
+    static const uint8_t addr[6] = { 0x5D, 0x2C, 0x1B, 0x57, 0x0B, 0x00 };
+    memcpy(address->addr, addr, sizeof(addr));
+    *type = 0;
+    return SL_STATUS_OK;
+}
+
+static void soft_timer_fire(sim_source_t* s) {
+    soft_timer_t* t = (soft_timer_t*) s;
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_system_soft_timer_id, sizeof(evt.data.evt_system_soft_timer));
+    evt.data.evt_system_soft_timer.handle = t->handle;
+    queue_event(&evt);
+    if (t->period != 0) {
+        sim_source_arm(s, s->when + t->period);
+    }
+}
+
+sl_status_t sl_bt_system_set_soft_timer(uint32_t time, uint8_t handle, uint8_t single_shot) {
+    soft_timer_t* t = &soft_timers[handle % NUM_SOFT_TIMERS];
+    t->source.name = "soft timer";
+    t->source.fire = soft_timer_fire;
+    t->handle = handle;
+    if ((time == 0) || replay) {
+        sim_source_cancel(&t->source);
+        return SL_STATUS_OK;
+    }
+    sim_time_t interval = ((sim_time_t) time * 1000000000ULL) / SOFT_TIMER_HZ;
+    t->period = single_shot ? 0 : interval;
+    sim_source_arm(&t->source, sim_now() + interval);
+    return SL_STATUS_OK;
+}
+
+// ---------------------------------------------------------------------
+// Advertising and connections
+// ---------------------------------------------------------------------
+
+sl_status_t sl_bt_advertiser_create_set(uint8_t* handle) {
+    *handle = 0;
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_advertiser_set_timing(uint8_t handle, uint32_t interval_min, uint32_t interval_max,
+                                        uint16_t duration, uint8_t maxevents) {
+    (void) handle;
+    (void) interval_min;
+    (void) interval_max;
+    (void) duration;
+    (void) maxevents;
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_advertiser_start(uint8_t handle, uint8_t discover, uint8_t connect) {
+    (void) handle;
+    (void) discover;
+    (void) connect;
+    if (stats.connected) {
+        return SL_STATUS_INVALID_STATE;
+    }
+    stats.advertising = true;
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_advertiser_stop(uint8_t handle) {
+    (void) handle;
+    stats.advertising = false;
+    return SL_STATUS_OK;
+}
+
+// private helper, the parameters event the stack raises after a connection update
+static void queue_parameters(sim_time_t t) {
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_connection_parameters_id, sizeof(evt.data.evt_connection_parameters));
+    evt.data.evt_connection_parameters.connection = CONNECTION_HANDLE;
+    evt.data.evt_connection_parameters.interval = stats.interval;
+    evt.data.evt_connection_parameters.latency = stats.latency;
+    evt.data.evt_connection_parameters.timeout = 500;
+    evt.data.evt_connection_parameters.security_mode = stats.bonded ? sl_bt_connection_mode1_level3 : sl_bt_connection_mode1_level1;
+    evt.data.evt_connection_parameters.txsize = 27;
+    queue_event_at(t, &evt);
+}
+
+sl_status_t sl_bt_connection_set_parameters(uint8_t connection, uint16_t min_interval, uint16_t max_interval,
+                                            uint16_t latency, uint16_t timeout, uint16_t min_ce_length,
+                                            uint16_t max_ce_length) {
+    (void) timeout;
+    (void) min_ce_length;
+    (void) max_ce_length;
+    if (!stats.connected || (connection != CONNECTION_HANDLE) || (min_interval > max_interval)) {
+        return SL_STATUS_INVALID_PARAMETER;
+    }
+    stats.parameter_requests++;
+    stats.interval = min_interval;
+    stats.latency = latency;
+    queue_parameters(sim_now() + LINK_DELAY);
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_connection_set_preferred_phy(uint8_t connection, uint8_t preferred_phy, uint8_t accepted_phy) {
+    (void) accepted_phy;
+    if (!stats.connected || (connection != CONNECTION_HANDLE)) {
+        return SL_STATUS_INVALID_PARAMETER;
+    }
+    stats.phy = (client.phy_2m && (preferred_phy & sl_bt_gap_2m_phy)) ? sl_bt_gap_2m_phy : sl_bt_gap_1m_phy;
+
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_connection_phy_status_id, sizeof(evt.data.evt_connection_phy_status));
+    evt.data.evt_connection_phy_status.connection = CONNECTION_HANDLE;
+    evt.data.evt_connection_phy_status.phy = stats.phy;
+    queue_event_at(sim_now() + LINK_DELAY, &evt);
+    return SL_STATUS_OK;
+}
+
+// ---------------------------------------------------------------------
+// GATT server
+// ---------------------------------------------------------------------
+
+sl_status_t sl_bt_gatt_server_set_max_mtu(uint16_t max_mtu, uint16_t* max_mtu_out) {
+    server_max_mtu = SL_MAX(23, SL_MIN(max_mtu, 250));
+    *max_mtu_out = server_max_mtu;
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_gatt_server_write_attribute_value(uint16_t attribute, uint16_t offset, size_t value_len,
+                                                    const uint8_t* value) {
+    if ((attribute >= NUM_ATTRIBUTES) || (offset + value_len > sizeof(attributes[0].value))) {
+        return SL_STATUS_INVALID_PARAMETER;
+    }
+    memcpy(&attributes[attribute].value[offset], value, value_len);
+    attributes[attribute].len = offset + value_len;
+    return SL_STATUS_OK;
+}
+
+static void tx_fire(sim_source_t* s) {
+    tx_queued = (tx_queued > PACKETS_PER_EVENT) ? (tx_queued - PACKETS_PER_EVENT) : 0;
+    if (tx_queued > 0) {
+        sim_source_arm(s, s->when + ((sim_time_t) stats.interval * 1250000ULL));
+    }
+}
+
+// private helper, what the client sees of a value
+static void client_receive(uint16_t characteristic, size_t len, const uint8_t* value) {
+    sim_bt_char_stats_t* c = &char_stats[characteristic % NUM_ATTRIBUTES];
+    c->bytes += len;
+    c->last_len = len;
+    memcpy(c->last_value, value, len);
+}
+
+sl_status_t sl_bt_gatt_server_send_notification(uint8_t connection, uint16_t characteristic, size_t value_len,
+                                                const uint8_t* value) {
+    if (!stats.connected || (connection != CONNECTION_HANDLE)) {
+        return SL_STATUS_INVALID_HANDLE;
+    }
+    if ((value_len > (size_t) (stats.mtu - 3)) || (tx_queued >= TX_BUFFERS)) {
+        stats.notify_rejected++;
+        return (tx_queued >= TX_BUFFERS) ? SL_STATUS_NO_MORE_RESOURCE : SL_STATUS_INVALID_PARAMETER;
+    }
+
+    tx_queued++;
+    if (!tx_source.armed) {
+        sim_source_arm(&tx_source, sim_now() + ((sim_time_t) stats.interval * 1250000ULL));
+    }
+
+    char_stats[characteristic % NUM_ATTRIBUTES].notifications++;
+    client_receive(characteristic, value_len, value);
+    return SL_STATUS_OK;
+}
+
+// the client confirms the indication, or it times out
+static void indication_fire(sim_source_t* s) {
+    (void) s;
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+
+    indication_in_flight = false;
+    if (client.confirm_indications) {
+        char_stats[indication_char % NUM_ATTRIBUTES].confirmations++;
+        evt.header = make_header(sl_bt_evt_gatt_server_characteristic_status_id,
+                                 sizeof(evt.data.evt_gatt_server_characteristic_status));
+        evt.data.evt_gatt_server_characteristic_status.connection = CONNECTION_HANDLE;
+        evt.data.evt_gatt_server_characteristic_status.characteristic = indication_char;
+        evt.data.evt_gatt_server_characteristic_status.status_flags = sl_bt_gatt_server_confirmation;
+    }
+    else {
+        stats.indication_timeouts++;
+        evt.header = make_header(sl_bt_evt_gatt_server_indication_timeout_id,
+                                 sizeof(evt.data.evt_gatt_server_indication_timeout));
+        evt.data.evt_gatt_server_indication_timeout.connection = CONNECTION_HANDLE;
+    }
+    queue_event(&evt);
+}
+
+sl_status_t sl_bt_gatt_server_send_indication(uint8_t connection, uint16_t characteristic, size_t value_len,
+                                              const uint8_t* value) {
+    if (!stats.connected || (connection != CONNECTION_HANDLE)) {
+        return SL_STATUS_INVALID_HANDLE;
+    }
+    if (indication_in_flight) {
+        stats.indication_errors++;
+        return SL_STATUS_INVALID_STATE;
+    }
+    if (value_len > (size_t) (stats.mtu - 3)) {
+        return SL_STATUS_INVALID_PARAMETER;
+    }
+
+    indication_in_flight = true;
+    indication_char = characteristic;
+    if (!replay) {
+        sim_source_arm(&indication_source,
+                       sim_now() + (client.confirm_indications ? SIM_US(client.confirm_delay_us) : INDICATION_TIMEOUT));
+    }
+
+    char_stats[characteristic % NUM_ATTRIBUTES].indications++;
+    client_receive(characteristic, value_len, value);
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_gatt_server_send_user_read_response(uint8_t connection, uint16_t characteristic,
+                                                      uint8_t att_errorcode, size_t value_len,
+                                                      const uint8_t* value, uint16_t* sent_len) {
+    (void) characteristic;
+    if (!stats.connected || (connection != CONNECTION_HANDLE)) {
+        return SL_STATUS_INVALID_HANDLE;
+    }
+    // a read response carries at most MTU - 1 bytes, the client reads on with blob requests
+    size_t len = (att_errorcode != 0) ? 0 : SL_MIN(value_len, (size_t) (stats.mtu - 1));
+    memcpy(stats.last_read, value, len);
+    stats.last_read_len = len;
+    *sent_len = len;
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_gatt_server_send_user_write_response(uint8_t connection, uint16_t characteristic,
+                                                       uint8_t att_errorcode) {
+    (void) characteristic;
+    if (!stats.connected || (connection != CONNECTION_HANDLE)) {
+        return SL_STATUS_INVALID_HANDLE;
+    }
+    stats.last_write_status = att_errorcode;
+    return SL_STATUS_OK;
+}
+
+// ---------------------------------------------------------------------
+// Security manager
+// ---------------------------------------------------------------------
+
+sl_status_t sl_bt_sm_configure(uint8_t flags, uint8_t io_capabilities) {
+    (void) flags;
+    (void) io_capabilities;
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_sm_delete_bondings(void) {
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_sm_bonding_confirm(uint8_t connection, uint8_t confirm) {
+    if (!stats.connected || (connection != CONNECTION_HANDLE)) {
+        return SL_STATUS_INVALID_HANDLE;
+    }
+
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    if (confirm) {
+        evt.header = make_header(sl_bt_evt_sm_confirm_passkey_id, sizeof(evt.data.evt_sm_confirm_passkey));
+        evt.data.evt_sm_confirm_passkey.connection = CONNECTION_HANDLE;
+        evt.data.evt_sm_confirm_passkey.passkey = 123456;
+    }
+    else {
+        evt.header = make_header(sl_bt_evt_sm_bonding_failed_id, sizeof(evt.data.evt_sm_bonding_failed));
+        evt.data.evt_sm_bonding_failed.connection = CONNECTION_HANDLE;
+        evt.data.evt_sm_bonding_failed.reason = SL_STATUS_BT_SMP_PAIRING_NOT_SUPPORTED;
+    }
+    queue_event_at(sim_now() + LINK_DELAY, &evt);
+    return SL_STATUS_OK;
+}
+
+sl_status_t sl_bt_sm_passkey_confirm(uint8_t connection, uint8_t confirm) {
+    if (!stats.connected || (connection != CONNECTION_HANDLE)) {
+        return SL_STATUS_INVALID_HANDLE;
+    }
+
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    if (confirm) {
+        stats.bonded = true;
+        evt.header = make_header(sl_bt_evt_sm_bonded_id, sizeof(evt.data.evt_sm_bonded));
+        evt.data.evt_sm_bonded.connection = CONNECTION_HANDLE;
+        evt.data.evt_sm_bonded.bonding = 1;
+        evt.data.evt_sm_bonded.security_mode = sl_bt_connection_mode1_level4;
+    }
+    else {
+        evt.header = make_header(sl_bt_evt_sm_bonding_failed_id, sizeof(evt.data.evt_sm_bonding_failed));
+        evt.data.evt_sm_bonding_failed.connection = CONNECTION_HANDLE;
+        evt.data.evt_sm_bonding_failed.reason = SL_STATUS_BT_SMP_PASSKEY_ENTRY_FAILED;
+    }
+    queue_event_at(sim_now() + LINK_DELAY, &evt);
+    return SL_STATUS_OK;
+}
+
+// ---------------------------------------------------------------------
+// Client
+// ---------------------------------------------------------------------
+
+void sim_bt_client_config(const sim_bt_client_t* c) {
+    client = *c;
+}
+
+void sim_bt_connect(void) {
+    if (stats.connected || !stats.advertising) {
+        return;
+    }
+    stats.connected = true;
+    stats.advertising = false;
+    stats.bonded = false;
+    stats.mtu = 23;
+    stats.phy = sl_bt_gap_1m_phy;
+    stats.interval = 24; // 30 ms
+    stats.latency = 0;
+    indication_in_flight = false;
+    tx_queued = 0;
+
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_connection_opened_id, sizeof(evt.data.evt_connection_opened));
+    evt.data.evt_connection_opened.address.addr[0] = 0xC1;
+    evt.data.evt_connection_opened.address_type = 1;
+    evt.data.evt_connection_opened.master = 0;
+    evt.data.evt_connection_opened.connection = CONNECTION_HANDLE;
+    evt.data.evt_connection_opened.bonding = 0xFF;
+    evt.data.evt_connection_opened.advertiser = 0;
+    queue_event(&evt);
+
+    queue_parameters(sim_now());
+
+    stats.mtu = SL_MIN(client.mtu, server_max_mtu);
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_gatt_mtu_exchanged_id, sizeof(evt.data.evt_gatt_mtu_exchanged));
+    evt.data.evt_gatt_mtu_exchanged.connection = CONNECTION_HANDLE;
+    evt.data.evt_gatt_mtu_exchanged.mtu = stats.mtu;
+    queue_event_at(sim_now() + MTU_EXCHANGE_DELAY, &evt);
+}
+
+void sim_bt_disconnect(void) {
+    if (!stats.connected) {
+        return;
+    }
+    stats.connected = false;
+    stats.bonded = false;
+    indication_in_flight = false;
+    tx_queued = 0;
+    sim_source_cancel(&indication_source);
+    sim_source_cancel(&tx_source);
+
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_connection_closed_id, sizeof(evt.data.evt_connection_closed));
+    evt.data.evt_connection_closed.reason = REASON_REMOTE_USER_TERMINATED;
+    evt.data.evt_connection_closed.connection = CONNECTION_HANDLE;
+    queue_event(&evt);
+}
+
+void sim_bt_bond(void) {
+    if (!stats.connected) {
+        return;
+    }
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_sm_confirm_bonding_id, sizeof(evt.data.evt_sm_confirm_bonding));
+    evt.data.evt_sm_confirm_bonding.connection = CONNECTION_HANDLE;
+    evt.data.evt_sm_confirm_bonding.bonding_handle = 0xFF;
+    queue_event(&evt);
+}
+
+void sim_bt_subscribe(uint16_t characteristic, uint16_t flags) {
+    if (!stats.connected) {
+        return;
+    }
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_gatt_server_characteristic_status_id,
+                             sizeof(evt.data.evt_gatt_server_characteristic_status));
+    evt.data.evt_gatt_server_characteristic_status.connection = CONNECTION_HANDLE;
+    evt.data.evt_gatt_server_characteristic_status.characteristic = characteristic;
+    evt.data.evt_gatt_server_characteristic_status.status_flags = sl_bt_gatt_server_client_config;
+    evt.data.evt_gatt_server_characteristic_status.client_config_flags = flags;
+    queue_event(&evt);
+}
+
+void sim_bt_read(uint16_t characteristic, uint16_t offset) {
+    if (!stats.connected) {
+        return;
+    }
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_gatt_server_user_read_request_id,
+                             sizeof(evt.data.evt_gatt_server_user_read_request));
+    evt.data.evt_gatt_server_user_read_request.connection = CONNECTION_HANDLE;
+    evt.data.evt_gatt_server_user_read_request.characteristic = characteristic;
+    evt.data.evt_gatt_server_user_read_request.att_opcode = (offset == 0) ? ATT_OPCODE_READ_REQUEST : ATT_OPCODE_READ_BLOB_REQUEST;
+    evt.data.evt_gatt_server_user_read_request.offset = offset;
+    queue_event(&evt);
+}
+
+void sim_bt_write(uint16_t characteristic, const uint8_t* data, uint8_t len) {
+    if (!stats.connected) {
+        return;
+    }
+    sl_bt_msg_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header = make_header(sl_bt_evt_gatt_server_user_write_request_id,
+                             sizeof(evt.data.evt_gatt_server_user_write_request) + len);
+    evt.data.evt_gatt_server_user_write_request.connection = CONNECTION_HANDLE;
+    evt.data.evt_gatt_server_user_write_request.characteristic = characteristic;
+    evt.data.evt_gatt_server_user_write_request.att_opcode = ATT_OPCODE_WRITE_REQUEST;
+    evt.data.evt_gatt_server_user_write_request.value.len = len;
+    memcpy(evt.data.evt_gatt_server_user_write_request.value.data, data, len);
+    queue_event(&evt);
+}
+
+__attribute__((constructor)) static void bt_register(void) {
+    indication_source.name = "indication";
+    indication_source.fire = indication_fire;
+    tx_source.name = "bt tx";
+    tx_source.fire = tx_fire;
+}
+
+// ---------------------------------------------------------------------
+// Statistics
+// ---------------------------------------------------------------------
+
+const sim_bt_stats_t* sim_bt_stats(void) {
+    return &stats;
+}
+
+const sim_bt_char_stats_t* sim_bt_char_stats(uint16_t characteristic) {
+    return &char_stats[characteristic % NUM_ATTRIBUTES];
+}
+
+const uint8_t* sim_bt_attribute(uint16_t attribute, uint16_t* len) {
+    if (attribute >= NUM_ATTRIBUTES) {
+        *len = 0;
+        return 0;
+    }
+    *len = attributes[attribute].len;
+    return attributes[attribute].value;
+}
@@ -0,0 +1,382 @@
+/*
+ * sim_cpu.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Virtual clock, event sources and the parts of the Cortex-M4 core the
+ * firmware depends on: NVIC priorities and pending bits, PRIMASK, IPSR,
+ * the exclusive monitor and the DWT cycle counter.
+ *
+ * An interrupt is pending if its software pending bit is set or its
+ * peripheral line is high. The highest priority pending interrupt runs as
+ * soon as it beats the current execution priority and PRIMASK is clear,
+ * handlers nest the same way they do on target. Interrupt handlers are
+ * called on the caller's stack, right where the firmware enabled
+ * interrupts, pended one or let time advance.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "sim_internal.h"
+#include "em_core.h"
+
+// execution priority of thread mode, lower than any interrupt
+#define THREAD_PRIORITY 0x100
+
+// cpu time charged for each DWT access, lets cycle counter polling loops make progress
+#define DWT_ACCESS_NS 25
+
+// firmware interrupt handlers, weak so a test can link only the modules it needs
+extern void LETIMER0_IRQHandler(void) __attribute__((weak));
+extern void I2C0_IRQHandler(void) __attribute__((weak));
+extern void GPIO_EVEN_IRQHandler(void) __attribute__((weak));
+extern void GPIO_ODD_IRQHandler(void) __attribute__((weak));
+extern void VDAC0_IRQHandler(void) __attribute__((weak));
+extern void CSEN_IRQHandler(void) __attribute__((weak));
+
+static void (*const vectors[EXT_IRQ_COUNT])(void) = {
+    [LETIMER0_IRQn]  = LETIMER0_IRQHandler,
+    [I2C0_IRQn]      = I2C0_IRQHandler,
+    [GPIO_EVEN_IRQn] = GPIO_EVEN_IRQHandler,
+    [GPIO_ODD_IRQn]  = GPIO_ODD_IRQHandler,
+    [VDAC0_IRQn]     = VDAC0_IRQHandler,
+    [CSEN_IRQn]      = CSEN_IRQHandler
+};
+
+static sim_time_t now_ns = 0;
+
+// armed sources, earliest first, sources due at the same time in arming order
+static sim_source_t* sources = 0;
+
+static uint32_t primask = 0;
+static uint32_t ipsr = 0;
+static uint32_t exec_priority = THREAD_PRIORITY;
+
+static bool nvic_enabled[EXT_IRQ_COUNT];
+static bool nvic_pending[EXT_IRQ_COUNT];
+static uint8_t nvic_priority[EXT_IRQ_COUNT];
+static sim_irq_line_t irq_lines[EXT_IRQ_COUNT];
+static uint32_t irq_counts[EXT_IRQ_COUNT];
+static uint64_t irq_host_ns[EXT_IRQ_COUNT];
+static uint64_t irq_entries = 0;
+
+// exclusive monitor, the address of the last LDREX until a STREX, CLREX or exception
+static volatile uint32_t* monitor = 0;
+static void (*ldrex_hook)(void) = 0;
+static bool in_ldrex_hook = false;
+
+static DWT_Type dwt;
+CoreDebug_Type sim_core_debug;
+
+// ---------------------------------------------------------------------
+// Virtual clock and event sources
+// ---------------------------------------------------------------------
+
+sim_time_t sim_now(void) {
+    return now_ns;
+}
+
+void sim_source_cancel(sim_source_t* s) {
+    if (!s->armed) {
+        return;
+    }
+    sim_source_t** p = &sources;
+    while (*p != s) {
+        p = &(*p)->next;
+    }
+    *p = s->next;
+    s->armed = false;
+}
+
+void sim_source_arm(sim_source_t* s, sim_time_t when) {
+    sim_source_cancel(s);
+    s->when = when;
+    s->armed = true;
+    sim_source_t** p = &sources;
+    while ((*p != 0) && ((*p)->when <= when)) {
+        p = &(*p)->next;
+    }
+    s->next = *p;
+    *p = s;
+}
+
+const sim_source_t* sim_next_source(void) {
+    return sources;
+}
+
+/*
+ * fires every source due up to t, in time order, interrupts they raise run
+ * as they become pending
+ * a handler can move time on by itself, the clock never goes backwards
+ */
+void sim_advance_to(sim_time_t t) {
+    while ((sources != 0) && (sources->when <= t)) {
+        sim_source_t* s = sources;
+        sources = s->next;
+        s->armed = false;
+        if (s->when > now_ns) {
+            now_ns = s->when;
+        }
+        s->fire(s);
+        sim_irq_update();
+    }
+    if (t > now_ns) {
+        now_ns = t;
+    }
+    sim_irq_update();
+}
+
+void sim_advance(sim_time_t dt) {
+    sim_advance_to(now_ns + dt);
+}
+
+// one-off harness actions
+typedef struct {
+    sim_source_t source;
+    sim_action_t action;
+    void* context;
+    uint32_t arg;
+} scripted_action_t;
+
+static void scripted_action_fire(sim_source_t* s) {
+    scripted_action_t* a = (scripted_action_t*) s;
+    a->action(a->context, a->arg);
+    free(a);
+}
+
+void sim_at(sim_time_t t, sim_action_t action, void* context, uint32_t arg) {
+    scripted_action_t* a = calloc(1, sizeof(*a));
+    if (a == 0) {
+        abort();
+    }
+    a->source.name = "action";
+    a->source.fire = scripted_action_fire;
+    a->action = action;
+    a->context = context;
+    a->arg = arg;
+    sim_source_arm(&a->source, (t < now_ns) ? now_ns : t);
+}
+
+// ---------------------------------------------------------------------
+// NVIC
+// ---------------------------------------------------------------------
+
+void sim_irq_line(IRQn_Type irq, sim_irq_line_t line) {
+    irq_lines[irq] = line;
+}
+
+// private helper, software pending bit or a high peripheral line
+static bool irq_pending(int irq) {
+    return nvic_pending[irq] || ((irq_lines[irq] != 0) && irq_lines[irq]());
+}
+
+// private helper, the enabled pending interrupt with the highest priority that beats the current level, -1 if none
+static int irq_next(void) {
+    int best = -1;
+    for (int irq = 0; irq < EXT_IRQ_COUNT; irq++) {
+        if (!nvic_enabled[irq] || (nvic_priority[irq] >= exec_priority) || !irq_pending(irq)) {
+            continue;
+        }
+        if ((best < 0) || (nvic_priority[irq] < nvic_priority[best])) {
+            best = irq;
+        }
+    }
+    return best;
+}
+
+// private helper, exception entry, the handler and exception return
+static void irq_run(int irq) {
+    uint32_t saved_priority = exec_priority;
+    uint32_t saved_ipsr = ipsr;
+
+    nvic_pending[irq] = false;
+    monitor = 0;
+    exec_priority = nvic_priority[irq];
+    ipsr = irq + 16;
+    irq_counts[irq]++;
+    irq_entries++;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (vectors[irq] != 0) {
+        vectors[irq]();
+    }
+    else {
+        fprintf(stderr, "sim: no handler for IRQ %d\n", irq);
+        abort();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    irq_host_ns[irq] += ((uint64_t) (end.tv_sec - start.tv_sec) * 1000000000ULL) + end.tv_nsec - start.tv_nsec;
+
+    monitor = 0;
+    exec_priority = saved_priority;
+    ipsr = saved_ipsr;
+}
+
+void sim_irq_update(void) {
+    while (primask == 0) {
+        int irq = irq_next();
+        if (irq < 0) {
+            return;
+        }
+        irq_run(irq);
+    }
+}
+
+bool sim_irq_wake_pending(void) {
+    return irq_next() >= 0;
+}
+
+bool sim_in_isr(void) {
+    return ipsr != 0;
+}
+
+uint32_t sim_irq_count(IRQn_Type irq) {
+    return irq_counts[irq];
+}
+
+uint64_t sim_irq_host_ns(IRQn_Type irq) {
+    return irq_host_ns[irq];
+}
+
+uint64_t sim_irq_entries(void) {
+    return irq_entries;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+    nvic_enabled[irq] = true;
+    sim_irq_update();
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+    nvic_enabled[irq] = false;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq) {
+    nvic_pending[irq] = true;
+    sim_irq_update();
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+    nvic_pending[irq] = false;
+}
+
+uint32_t NVIC_GetPendingIRQ(IRQn_Type irq) {
+    return irq_pending(irq) ? 1 : 0;
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+    nvic_priority[irq] = priority & ((1 << __NVIC_PRIO_BITS) - 1);
+    sim_irq_update();
+}
+
+// ---------------------------------------------------------------------
+// Core registers
+// ---------------------------------------------------------------------
+
+uint32_t __get_PRIMASK(void) {
+    return primask;
+}
+
+uint32_t __get_IPSR(void) {
+    return ipsr;
+}
+
+/*
+ * each critical section costs a little time, the interrupts that become due
+ * meanwhile run first, so a loop that polls state owned by an interrupt
+ * under a critical section moves forward like it does on target
+ */
+void __disable_irq(void) {
+    if (primask == 0) {
+        sim_advance(SIM_CRITICAL_NS);
+    }
+    primask = 1;
+}
+
+void __enable_irq(void) {
+    primask = 0;
+    sim_irq_update();
+}
+
+uint32_t sim_primask_swap(uint32_t value) {
+    uint32_t old = primask;
+    primask = value;
+    return old;
+}
+
+SL_WEAK CORE_irqState_t CORE_EnterCritical(void) {
+    CORE_irqState_t state = __get_PRIMASK();
+    __disable_irq();
+    return state;
+}
+
+SL_WEAK void CORE_ExitCritical(CORE_irqState_t irqState) {
+    if (irqState == 0) {
+        __enable_irq();
+    }
+}
+
+uint32_t __LDREXW(volatile uint32_t* addr) {
+    monitor = addr;
+    return *addr;
+}
+
+uint32_t __STREXW(uint32_t value, volatile uint32_t* addr) {
+    // a test stands in for an interrupt after the caller's checks, right before the store
+    if ((ldrex_hook != 0) && !in_ldrex_hook && (monitor == addr)) {
+        in_ldrex_hook = true;
+        uint32_t saved_ipsr = ipsr;
+        ipsr = 16;
+        ldrex_hook();
+        ipsr = saved_ipsr;
+        in_ldrex_hook = false;
+        monitor = 0;
+    }
+
+    if (monitor != addr) {
+        monitor = 0;
+        return 1;
+    }
+    *addr = value;
+    monitor = 0;
+    return 0;
+}
+
+void __CLREX(void) {
+    monitor = 0;
+}
+
+void sim_on_ldrex(void (*hook)(void)) {
+    ldrex_hook = hook;
+}
+
+// ---------------------------------------------------------------------
+// Clocks and the cycle counter
+// ---------------------------------------------------------------------
+
+uint32_t SystemCoreClockGet(void) {
+    return SIM_CORE_CLOCK_HZ;
+}
+
+/*
+ * the cycle counter follows the virtual clock, so profiles measure
+ * virtual time: bus waits, delays and the charged critical sections
+ */
+DWT_Type* sim_dwt(void) {
+    sim_advance(DWT_ACCESS_NS);
+    if (dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+        dwt.CYCCNT = (uint32_t) ((now_ns * (SIM_CORE_CLOCK_HZ / 100000)) / 10000);
+    }
+    return &dwt;
+}
+
+// busy waits from the sdk, they take virtual time
+void sl_udelay_wait(unsigned us) {
+    sim_advance(SIM_US(us));
+}
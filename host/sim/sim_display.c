@@ -0,0 +1,172 @@
+/*
+ * sim_display.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Memory LCD and VCOM log stand-ins.
+ *
+ * GLIB keeps the last string drawn on each line, DMD_updateDisplay() makes
+ * those rows what the harness reads back. The log collects app_log() output
+ * into lines and hands each to the sink. Both take no time unless a test
+ * sets how long the LCD frame or a UART character takes.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim_internal.h"
+#include "glib.h"
+#include "dmd.h"
+#include "app_log.h"
+
+#define DISPLAY_ROWS 13
+#define DISPLAY_COLUMNS 21
+#define LOG_LINE_LEN 256
+
+const GLIB_Font_t GLIB_FontNarrow6x8 = { "Narrow6x8", 6, 8, 0, 0 };
+
+static char drawn[DISPLAY_ROWS][DISPLAY_COLUMNS + 1];
+static char shown[DISPLAY_ROWS][DISPLAY_COLUMNS + 1];
+static uint32_t updates = 0;
+static sim_time_t update_ns = 0;
+
+static char log_line[LOG_LINE_LEN];
+static size_t log_len = 0;
+static bool log_quiet = false;
+static sim_time_t log_char_ns = 0;
+static uint32_t log_errors = 0;
+
+static void default_sink(const char* line) {
+    fputs(line, stdout);
+    fputc('\n', stdout);
+}
+
+static sim_log_sink_t log_sink = default_sink;
+
+// ---------------------------------------------------------------------
+// GLIB and DMD
+// ---------------------------------------------------------------------
+
+EMSTATUS DMD_init(void* initConfig) {
+    (void) initConfig;
+    memset(drawn, 0, sizeof(drawn));
+    memset(shown, 0, sizeof(shown));
+    return DMD_OK;
+}
+
+EMSTATUS DMD_updateDisplay(void) {
+    memcpy(shown, drawn, sizeof(shown));
+    updates++;
+    sim_advance(update_ns);
+    return DMD_OK;
+}
+
+EMSTATUS GLIB_contextInit(GLIB_Context_t* pContext) {
+    pContext->foregroundColor = Black;
+    pContext->backgroundColor = White;
+    pContext->font = GLIB_FontNarrow6x8;
+    return GLIB_OK;
+}
+
+EMSTATUS GLIB_clear(GLIB_Context_t* pContext) {
+    (void) pContext;
+    memset(drawn, 0, sizeof(drawn));
+    return GLIB_OK;
+}
+
+EMSTATUS GLIB_setFont(GLIB_Context_t* pContext, GLIB_Font_t* pFont) {
+    if (pFont == 0) {
+        return GLIB_ERROR_INVALID_ARGUMENT;
+    }
+    pContext->font = *pFont;
+    return GLIB_OK;
+}
+
+EMSTATUS GLIB_drawStringOnLine(GLIB_Context_t* pContext, const char* pString, uint8_t line,
+                               GLIB_Align_t align, int32_t xOffset, int32_t yOffset, bool opaque) {
+    (void) pContext;
+    (void) align;
+    (void) xOffset;
+    (void) yOffset;
+    (void) opaque;
+    if ((pString == 0) || (line >= DISPLAY_ROWS)) {
+        return GLIB_ERROR_INVALID_ARGUMENT;
+    }
+
+    // trailing blanks erase, they aren't part of the text
+    size_t len = strnlen(pString, DISPLAY_COLUMNS);
+    while ((len > 0) && (pString[len - 1] == ' ')) {
+        len--;
+    }
+    memcpy(drawn[line], pString, len);
+    drawn[line][len] = 0;
+    return GLIB_OK;
+}
+
+const char* sim_display_row(int row) {
+    if ((row < 0) || (row >= DISPLAY_ROWS)) {
+        return "";
+    }
+    return shown[row];
+}
+
+uint32_t sim_display_updates(void) {
+    return updates;
+}
+
+void sim_display_update_time(sim_time_t ns) {
+    update_ns = ns;
+}
+
+// ---------------------------------------------------------------------
+// Log
+// ---------------------------------------------------------------------
+
+// private helper, hands a finished line to the sink
+static void log_flush_line(void) {
+    log_line[log_len] = 0;
+    if (strstr(log_line, ":Error:") != 0) {
+        log_errors++;
+    }
+    if (!log_quiet) {
+        log_sink(log_line);
+    }
+    log_len = 0;
+}
+
+void app_log(const char* format, ...) {
+    char text[LOG_LINE_LEN];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    for (const char* c = text; *c != 0; c++) {
+        if (*c == '\n') {
+            log_flush_line();
+        }
+        else if (log_len < (LOG_LINE_LEN - 1)) {
+            log_line[log_len++] = *c;
+        }
+    }
+    sim_advance(log_char_ns * strlen(text));
+}
+
+void sim_log_set_sink(sim_log_sink_t sink) {
+    log_sink = (sink != 0) ? sink : default_sink;
+}
+
+void sim_log_quiet(bool quiet) {
+    log_quiet = quiet;
+}
+
+void sim_log_char_time(sim_time_t ns) {
+    log_char_ns = ns;
+}
+
+uint32_t sim_log_errors(void) {
+    return log_errors;
+}
@@ -0,0 +1,189 @@
+/*
+ * sim_gpio.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * GPIO pins and external interrupts.
+ *
+ * A push-pull pin is at the level the firmware drives. Any other pin is at
+ * the level driven onto it from outside, and otherwise at its pull, or high
+ * for the pull-ups on the board (buttons, I2C). Edges on a pin set the
+ * interrupt flag of the external interrupt it is routed to, even numbered
+ * flags raise GPIO_EVEN and odd ones GPIO_ODD.
+ */
+
+#include "sim_internal.h"
+#include "em_gpio.h"
+
+#define NUM_PORTS GPIO_PORT_MAX
+#define NUM_PINS (GPIO_PIN_MAX + 1)
+
+// main board
+#define BUTTON_PORT gpioPortF
+#define BUTTON0_PIN 6
+#define BUTTON1_PIN 7
+#define LED_PORT gpioPortF
+#define LED0_PIN 4
+#define LED1_PIN 5
+
+typedef struct {
+    GPIO_Mode_TypeDef mode;
+    unsigned int dout;
+    int drive; // level from outside, SIM_GPIO_RELEASE if none
+    unsigned int level;
+    sim_gpio_watch_t watch;
+} pin_t;
+
+static pin_t pins[NUM_PORTS][NUM_PINS];
+
+// external interrupts, numbered like the pins
+static GPIO_Port_TypeDef ext_port[GPIO_EXTINTNO_MAX + 1];
+static uint32_t ext_rising = 0;
+static uint32_t ext_falling = 0;
+static uint32_t gpio_if = 0;
+static uint32_t gpio_ien = 0;
+
+// private helper, electrical level of a pin
+static unsigned int pin_level(const pin_t* p) {
+    switch (p->mode) {
+        case gpioModePushPull:
+            return p->dout;
+        case gpioModeWiredAnd:
+        case gpioModeWiredAndPullUp:
+            if (p->dout == 0) {
+                return 0;
+            }
+            break;
+        default:
+            break;
+    }
+    if (p->drive != SIM_GPIO_RELEASE) {
+        return (unsigned int) p->drive;
+    }
+    if ((p->mode == gpioModeInputPull) || (p->mode == gpioModeInputPullFilter)) {
+        return p->dout;
+    }
+    return 1;
+}
+
+// private helper, sets the interrupt flags and tells the watcher after a change
+static void pin_update(GPIO_Port_TypeDef port, unsigned int pin) {
+    pin_t* p = &pins[port][pin];
+    unsigned int level = pin_level(p);
+    if (level == p->level) {
+        return;
+    }
+    p->level = level;
+
+    if (ext_port[pin] == port) {
+        uint32_t edges = level ? ext_rising : ext_falling;
+        gpio_if |= edges & (1 << pin);
+    }
+    if (p->watch != 0) {
+        p->watch(port, pin, level);
+    }
+    sim_irq_update();
+}
+
+static bool gpio_even_line(void) {
+    return (gpio_if & gpio_ien & 0x5555) != 0;
+}
+
+static bool gpio_odd_line(void) {
+    return (gpio_if & gpio_ien & 0xAAAA) != 0;
+}
+
+__attribute__((constructor)) static void gpio_register(void) {
+    for (int port = 0; port < NUM_PORTS; port++) {
+        for (int pin = 0; pin < NUM_PINS; pin++) {
+            pins[port][pin].mode = gpioModeDisabled;
+            pins[port][pin].drive = SIM_GPIO_RELEASE;
+            pins[port][pin].level = 1;
+        }
+    }
+    sim_irq_line(GPIO_EVEN_IRQn, gpio_even_line);
+    sim_irq_line(GPIO_ODD_IRQn, gpio_odd_line);
+}
+
+// ---------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------
+
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength) {
+    (void) port;
+    (void) strength;
+}
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out) {
+    pins[port][pin].mode = mode;
+    pins[port][pin].dout = out ? 1 : 0;
+    pin_update(port, pin);
+}
+
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin, unsigned int intNo,
+                       bool risingEdge, bool fallingEdge, bool enable) {
+    (void) pin;
+    uint32_t bit = 1 << intNo;
+    ext_port[intNo] = port;
+    ext_rising = risingEdge ? (ext_rising | bit) : (ext_rising & ~bit);
+    ext_falling = fallingEdge ? (ext_falling | bit) : (ext_falling & ~bit);
+    gpio_if &= ~bit;
+    gpio_ien = enable ? (gpio_ien | bit) : (gpio_ien & ~bit);
+}
+
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin) {
+    pins[port][pin].dout = 1;
+    pin_update(port, pin);
+}
+
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin) {
+    pins[port][pin].dout = 0;
+    pin_update(port, pin);
+}
+
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin) {
+    if (pins[port][pin].mode == gpioModeDisabled) {
+        return 0;
+    }
+    return pins[port][pin].level;
+}
+
+uint32_t GPIO_IntGetEnabled(void) {
+    return gpio_if & gpio_ien;
+}
+
+void GPIO_IntClear(uint32_t flags) {
+    gpio_if &= ~flags;
+}
+
+// ---------------------------------------------------------------------
+// Outside world
+// ---------------------------------------------------------------------
+
+void sim_gpio_drive(GPIO_Port_TypeDef port, unsigned int pin, int level) {
+    pins[port][pin].drive = (level == SIM_GPIO_RELEASE) ? SIM_GPIO_RELEASE : (level != 0);
+    pin_update(port, pin);
+}
+
+unsigned int sim_gpio_level(GPIO_Port_TypeDef port, unsigned int pin) {
+    return pins[port][pin].level;
+}
+
+GPIO_Mode_TypeDef sim_gpio_mode(GPIO_Port_TypeDef port, unsigned int pin) {
+    return pins[port][pin].mode;
+}
+
+void sim_gpio_watch(GPIO_Port_TypeDef port, unsigned int pin, sim_gpio_watch_t watch) {
+    pins[port][pin].watch = watch;
+}
+
+void sim_button(int button, bool pressed) {
+    unsigned int pin = (button == 0) ? BUTTON0_PIN : BUTTON1_PIN;
+    sim_gpio_drive(BUTTON_PORT, pin, pressed ? 0 : SIM_GPIO_RELEASE);
+}
+
+bool sim_led(int led) {
+    const pin_t* p = &pins[LED_PORT][(led == 0) ? LED0_PIN : LED1_PIN];
+    return (p->mode == gpioModePushPull) && (p->dout != 0);
+}
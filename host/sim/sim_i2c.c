@@ -0,0 +1,217 @@
+/*
+ * sim_i2c.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * I2C0, the polled master from the sdk and the devices on the bus.
+ *
+ * A transfer reaches the addressed device when it starts and finishes after
+ * the time its bytes take at the bus speed, 9 clocks each with the address.
+ * The peripheral raises one interrupt when the whole transfer is done
+ * rather than one per byte, I2C_Transfer() then returns the result.
+ * I2CSPM_Transfer() waits for the same transfer with the virtual clock.
+ */
+
+#include "sim_internal.h"
+#include "em_i2c.h"
+#include "sl_i2cspm.h"
+
+I2C_TypeDef sim_i2c0;
+
+static sim_i2c_device_t* devices = 0;
+
+static sim_i2c_stats_t stats = { .freq = I2C_FREQ_STANDARD_MAX };
+
+// transfer on the bus
+static bool active = false;
+static bool done = false; // completion interrupt flag
+static I2C_TransferReturn_TypeDef result = i2cTransferDone;
+static sim_source_t done_source;
+
+static I2C_TransferReturn_TypeDef fail_status = i2cTransferDone;
+static uint32_t fail_count = 0;
+
+// private helper, device at an address
+static sim_i2c_device_t* find_device(uint16_t addr) {
+    for (sim_i2c_device_t* d = devices; d != 0; d = d->next) {
+        if (d->addr == (addr & 0xFE)) {
+            return d;
+        }
+    }
+    return 0;
+}
+
+// private helper, a NACK stops the transfer at the address byte
+static I2C_TransferReturn_TypeDef device_transfer(I2C_TransferSeq_TypeDef* seq, uint32_t* bytes) {
+    sim_i2c_device_t* d = find_device(seq->addr);
+    I2C_TransferReturn_TypeDef status;
+
+    *bytes = 1;
+    if (fail_count > 0) {
+        fail_count--;
+        return fail_status;
+    }
+    if (d == 0) {
+        return i2cTransferNack;
+    }
+
+    if (seq->flags & I2C_FLAG_READ) {
+        status = d->read(d, seq->buf[0].data, seq->buf[0].len);
+        if (status == i2cTransferDone) {
+            *bytes += seq->buf[0].len;
+        }
+        return status;
+    }
+
+    status = d->write(d, seq->buf[0].data, seq->buf[0].len);
+    if (status != i2cTransferDone) {
+        return status;
+    }
+    *bytes += seq->buf[0].len;
+
+    if (seq->flags & I2C_FLAG_WRITE_READ) {
+        *bytes += 1;
+        status = d->read(d, seq->buf[1].data, seq->buf[1].len);
+        if (status == i2cTransferDone) {
+            *bytes += seq->buf[1].len;
+        }
+    }
+    else if (seq->flags & I2C_FLAG_WRITE_WRITE) {
+        status = d->write(d, seq->buf[1].data, seq->buf[1].len);
+        if (status == i2cTransferDone) {
+            *bytes += seq->buf[1].len;
+        }
+    }
+    return status;
+}
+
+// private helper, starts a transfer and returns the time it takes on the bus
+static sim_time_t transfer_start(I2C_TransferSeq_TypeDef* seq) {
+    uint32_t bytes;
+
+    result = device_transfer(seq, &bytes);
+    stats.transfers++;
+    stats.bytes += bytes;
+    if (result == i2cTransferNack) {
+        stats.nacks++;
+    }
+    else if (result != i2cTransferDone) {
+        stats.errors++;
+    }
+
+    active = true;
+    done = false;
+    return ((sim_time_t) bytes * 9 * 1000000000ULL) / stats.freq;
+}
+
+static void done_fire(sim_source_t* s) {
+    (void) s;
+    done = true;
+}
+
+static bool i2c_line(void) {
+    return done;
+}
+
+__attribute__((constructor)) static void i2c_register(void) {
+    done_source.name = "i2c";
+    done_source.fire = done_fire;
+    sim_irq_line(I2C0_IRQn, i2c_line);
+}
+
+bool sim_i2c_active(void) {
+    return active && !done;
+}
+
+// ---------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------
+
+void I2C_BusFreqSet(I2C_TypeDef* i2c, uint32_t freqRef, uint32_t freqScl, I2C_ClockHLR_TypeDef i2cMode) {
+    (void) i2c;
+    (void) freqRef;
+    (void) i2cMode;
+    stats.freq = freqScl;
+}
+
+void I2C_Enable(I2C_TypeDef* i2c, bool enable) {
+    (void) i2c;
+    (void) enable;
+}
+
+void I2C_Reset(I2C_TypeDef* i2c) {
+    (void) i2c;
+    sim_source_cancel(&done_source);
+    active = false;
+    done = false;
+}
+
+void I2C_IntClear(I2C_TypeDef* i2c, uint32_t flags) {
+    (void) i2c;
+    (void) flags;
+    done = false;
+}
+
+I2C_TransferReturn_TypeDef I2C_TransferInit(I2C_TypeDef* i2c, I2C_TransferSeq_TypeDef* seq) {
+    (void) i2c;
+    if (sim_i2c_active()) {
+        return i2cTransferUsageFault;
+    }
+    sim_source_arm(&done_source, sim_now() + transfer_start(seq));
+    return i2cTransferInProgress;
+}
+
+I2C_TransferReturn_TypeDef I2C_Transfer(I2C_TypeDef* i2c) {
+    (void) i2c;
+    if (!active) {
+        return i2cTransferUsageFault;
+    }
+    if (!done) {
+        return i2cTransferInProgress;
+    }
+    active = false;
+    done = false;
+    return result;
+}
+
+void I2CSPM_Init(I2CSPM_Init_TypeDef* init) {
+    stats.freq = init->i2cMaxFreq;
+    GPIO_PinModeSet(init->sclPort, init->sclPin, gpioModeWiredAndPullUp, 1);
+    GPIO_PinModeSet(init->sdaPort, init->sdaPin, gpioModeWiredAndPullUp, 1);
+}
+
+I2C_TransferReturn_TypeDef I2CSPM_Transfer(I2C_TypeDef* i2c, I2C_TransferSeq_TypeDef* seq) {
+    (void) i2c;
+    if (sim_i2c_active()) {
+        return i2cTransferUsageFault;
+    }
+    stats.blocking++;
+    sim_time_t end = sim_now() + transfer_start(seq);
+    sim_advance_to(end);
+    active = false;
+    done = false;
+    return result;
+}
+
+// ---------------------------------------------------------------------
+// Bus
+// ---------------------------------------------------------------------
+
+void sim_i2c_attach(sim_i2c_device_t* d) {
+    sim_i2c_device_t** p = &devices;
+    while ((*p != 0) && ((*p)->addr != d->addr)) {
+        p = &(*p)->next;
+    }
+    d->next = (*p != 0) ? (*p)->next : 0;
+    *p = d;
+}
+
+void sim_i2c_fail_next(I2C_TransferReturn_TypeDef status, uint32_t count) {
+    fail_status = status;
+    fail_count = count;
+}
+
+const sim_i2c_stats_t* sim_i2c_stats(void) {
+    return &stats;
+}
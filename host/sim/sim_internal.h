@@ -0,0 +1,56 @@
+/*
+ * sim_internal.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Interfaces between the simulator's models, not for harnesses.
+ */
+
+#ifndef HOST_SIM_INTERNAL_H_
+#define HOST_SIM_INTERNAL_H_
+
+#include "sim.h"
+
+// ---------------------------------------------------------------------
+// Cpu, sim_cpu.c
+// ---------------------------------------------------------------------
+
+// level of a peripheral interrupt line, sampled whenever interrupts are re-evaluated
+typedef bool (*sim_irq_line_t)(void);
+void sim_irq_line(IRQn_Type irq, sim_irq_line_t line);
+
+// an enabled interrupt is pending that would preempt the current level if PRIMASK allowed it, WFI wakes on this
+bool sim_irq_wake_pending(void);
+
+// interrupt handlers run so far, a sleep with PRIMASK clear ends after one
+uint64_t sim_irq_entries(void);
+
+// PRIMASK without charging time, for the sleep loop
+uint32_t sim_primask_swap(uint32_t primask);
+
+// the next armed event source, 0 if nothing is scheduled
+const sim_source_t* sim_next_source(void);
+
+// ---------------------------------------------------------------------
+// Firmware coroutine, sim_run.c
+// ---------------------------------------------------------------------
+
+bool sim_in_firmware(void);
+sim_time_t sim_run_end(void);
+
+// hands control back to the harness, returns when it calls sim_run_until() again
+void sim_yield(void);
+
+// ---------------------------------------------------------------------
+// Models
+// ---------------------------------------------------------------------
+
+// an I2C transfer is on the bus, the peripheral needs EM1
+bool sim_i2c_active(void);
+
+// the stack has events to deliver, the main loop must not sleep
+bool sim_bt_has_work(void);
+void sim_bt_boot(void);
+
+#endif /* HOST_SIM_INTERNAL_H_ */
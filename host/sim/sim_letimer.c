@@ -0,0 +1,228 @@
+/*
+ * sim_letimer.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * LETIMER0 and the low frequency clock tree feeding it.
+ *
+ * The counter is computed from the virtual clock rather than ticked. After
+ * LETIMER_Enable() CNT is 0, the first tick underflows and reloads COMP0,
+ * every later tick counts down by one. UF is raised on each reload and
+ * COMP1 whenever CNT equals COMP1, the same as the peripheral in free
+ * running mode with comp0Top.
+ */
+
+#include "sim_internal.h"
+#include "em_cmu.h"
+#include "em_letimer.h"
+
+#define LFXO_HZ 32768
+#define LFRCO_HZ 32768
+#define ULFRCO_HZ 1000
+
+LETIMER_TypeDef sim_letimer0;
+
+static CMU_Select_TypeDef lfa_select = cmuSelect_Disabled;
+static uint32_t letimer_div = 1;
+
+static bool enabled = false;
+static sim_time_t enable_time = 0; // virtual time of tick 0
+static uint32_t rate_hz = 0; // ticks per second
+static uint32_t comp[2];
+static uint32_t flags = 0;
+static uint32_t ien = 0;
+
+static sim_source_t tick_source;
+
+// ---------------------------------------------------------------------
+// CMU
+// ---------------------------------------------------------------------
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) {
+    (void) clock;
+    (void) enable;
+}
+
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait) {
+    (void) osc;
+    (void) enable;
+    (void) wait;
+}
+
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref) {
+    if (clock == cmuClock_LFA) {
+        lfa_select = ref;
+    }
+}
+
+void CMU_ClockDivSet(CMU_Clock_TypeDef clock, CMU_ClkDiv_TypeDef div) {
+    if ((clock == cmuClock_LETIMER0) && (div != 0)) {
+        letimer_div = div;
+    }
+}
+
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock) {
+    uint32_t lfa = 0;
+    switch (lfa_select) {
+        case cmuSelect_LFXO:
+            lfa = LFXO_HZ;
+            break;
+        case cmuSelect_LFRCO:
+            lfa = LFRCO_HZ;
+            break;
+        case cmuSelect_ULFRCO:
+            lfa = ULFRCO_HZ;
+            break;
+        default:
+            break;
+    }
+    switch (clock) {
+        case cmuClock_LFA:
+            return lfa;
+        case cmuClock_LETIMER0:
+            return lfa / letimer_div;
+        default:
+            return SIM_CORE_CLOCK_HZ;
+    }
+}
+
+// ---------------------------------------------------------------------
+// Counter
+// ---------------------------------------------------------------------
+
+// private helper, ticks since enable at virtual time t
+static uint64_t ticks_at(sim_time_t t) {
+    return (uint64_t) (((unsigned __int128) (t - enable_time) * rate_hz) / 1000000000ULL);
+}
+
+// private helper, virtual time of a tick, rounded up so ticks_at() of it is the tick
+static sim_time_t tick_time(uint64_t n) {
+    return enable_time + (sim_time_t) ((((unsigned __int128) n * 1000000000ULL) + rate_hz - 1) / rate_hz);
+}
+
+// private helper, CNT after n ticks
+static uint32_t count_at_tick(uint64_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    return comp[0] - (uint32_t) ((n - 1) % ((uint64_t) comp[0] + 1));
+}
+
+// private helper, first tick after n at a position in the period, position 0 is the reload
+static uint64_t next_tick_at(uint64_t n, uint64_t pos) {
+    uint64_t period = (uint64_t) comp[0] + 1;
+    return n + 1 + ((pos + period - (n % period)) % period);
+}
+
+// private helper, first tick after n that reloads or matches COMP1
+static uint64_t next_event_tick(uint64_t n) {
+    uint64_t next = next_tick_at(n, 0);
+    if (comp[1] <= comp[0]) {
+        // CNT == COMP1 at position COMP0 - COMP1
+        uint64_t match = next_tick_at(n, comp[0] - comp[1]);
+        if (match < next) {
+            next = match;
+        }
+    }
+    return next;
+}
+
+static void reload_source(void) {
+    if (!enabled || (rate_hz == 0)) {
+        sim_source_cancel(&tick_source);
+        return;
+    }
+    uint64_t n = ticks_at(sim_now());
+    sim_source_arm(&tick_source, tick_time(next_event_tick(n)));
+}
+
+static void tick_fire(sim_source_t* s) {
+    uint64_t n = ticks_at(s->when);
+    uint32_t cnt = count_at_tick(n);
+    if ((n > 0) && (((n - 1) % ((uint64_t) comp[0] + 1)) == 0)) {
+        flags |= LETIMER_IF_UF;
+    }
+    if (cnt == comp[1]) {
+        flags |= LETIMER_IF_COMP1;
+    }
+    reload_source();
+}
+
+static bool letimer_line(void) {
+    return (flags & ien) != 0;
+}
+
+__attribute__((constructor)) static void letimer_register(void) {
+    tick_source.name = "letimer";
+    tick_source.fire = tick_fire;
+    sim_irq_line(LETIMER0_IRQn, letimer_line);
+}
+
+// ---------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------
+
+void LETIMER_Init(LETIMER_TypeDef* letimer, const LETIMER_Init_TypeDef* init) {
+    (void) letimer;
+    comp[0] = init->topValue & 0xFFFF;
+    LETIMER_Enable(letimer, init->enable);
+}
+
+void LETIMER_Enable(LETIMER_TypeDef* letimer, bool enable) {
+    (void) letimer;
+    if (enable && !enabled) {
+        rate_hz = CMU_ClockFreqGet(cmuClock_LETIMER0);
+        enable_time = sim_now();
+    }
+    enabled = enable;
+    reload_source();
+}
+
+void LETIMER_CompareSet(LETIMER_TypeDef* letimer, unsigned int compNo, uint32_t value) {
+    (void) letimer;
+    if (compNo < 2) {
+        comp[compNo] = value & 0xFFFF;
+        reload_source();
+    }
+}
+
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef* letimer) {
+    (void) letimer;
+    if (!enabled) {
+        return 0;
+    }
+    return count_at_tick(ticks_at(sim_now()));
+}
+
+uint32_t LETIMER_IntGet(LETIMER_TypeDef* letimer) {
+    (void) letimer;
+    return flags;
+}
+
+uint32_t LETIMER_IntGetEnabled(LETIMER_TypeDef* letimer) {
+    (void) letimer;
+    return flags & ien;
+}
+
+void LETIMER_IntSet(LETIMER_TypeDef* letimer, uint32_t set) {
+    (void) letimer;
+    flags |= set;
+    sim_irq_update();
+}
+
+void LETIMER_IntClear(LETIMER_TypeDef* letimer, uint32_t clear) {
+    (void) letimer;
+    flags &= ~clear;
+}
+
+void LETIMER_IntEnable(LETIMER_TypeDef* letimer, uint32_t enable) {
+    (void) letimer;
+    ien |= enable;
+    sim_irq_update();
+}
+
+void LETIMER_IntDisable(LETIMER_TypeDef* letimer, uint32_t disable) {
+    (void) letimer;
+    ien &= ~disable;
+}
@@ -0,0 +1,395 @@
+/*
+ * sim_max32664.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * MAX32664 sensor hub with a MAX30101 behind it, enough of the host
+ * command protocol for the firmware's command table.
+ *
+ * The hub NACKs while RSTN is low and while it boots. A command is taken on
+ * the write, its response can be read once the command has had its
+ * execution time, an earlier read gets the try again status. With the
+ * sensor on, a sample goes into the output fifo every 10 ms and MFIO is
+ * pulled low while the fifo holds at least the threshold.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sim_internal.h"
+#include "em_gpio.h"
+
+#define HUB_ADDR 0xAA
+
+#define HUB_PORT gpioPortD
+#define MFIO_PIN 10
+#define RESET_PIN 11
+
+#define BOOT_TIME SIM_MS(50)
+#define SAMPLE_PERIOD SIM_MS(10)
+#define FIFO_DEPTH 255
+
+// command execution times, what the host has to wait before reading the response
+#define ENABLE_TIME SIM_MS(40)
+#define CONFIG_TIME SIM_MS(2)
+
+#define STATUS_SUCCESS 0x00
+#define STATUS_ILLEGAL_FAMILY 0x02
+#define STATUS_TRY_AGAIN 0xFE
+
+#define MODE_APPLICATION 0x00
+#define MODE_BOOTLOADER 0x08
+
+#define OUTPUT_RAW 0x01
+#define OUTPUT_ALGO 0x02
+#define OUTPUT_BOTH 0x03
+
+#define RAW_SAMPLE_SIZE 12
+#define ALGO_SAMPLE_SIZE 6
+#define MAX_SAMPLE_SIZE (RAW_SAMPLE_SIZE + ALGO_SAMPLE_SIZE)
+
+// PPG counts with a finger on the sensor, and without
+#define IR_DC 120000
+#define IR_AC 1500
+#define RED_DC 90000
+#define EMPTY_DC 8000
+
+static sim_hub_stats_t stats = { .fifo_threshold = 0x0F };
+
+static bool in_reset = false;
+static bool booted = false;
+static uint8_t device_mode = MODE_APPLICATION;
+static sim_time_t boot_done = 0;
+
+static sim_hub_reading_t reading = { .finger_status = 0 };
+static bool comm_error = false;
+static double ppg_phase = 0.0; // beat phase of the next sample, 0 to 1
+
+// response to the last command
+static uint8_t resp[4];
+static uint8_t resp_len = 0;
+static sim_time_t resp_ready = 0;
+static bool fifo_read_pending = false;
+
+// output fifo, samples laid out as the output mode was when they were taken
+static uint8_t fifo[FIFO_DEPTH][MAX_SAMPLE_SIZE];
+static uint8_t fifo_rptr = 0;
+static uint16_t fifo_count = 0;
+
+static sim_source_t sample_source;
+static sim_source_t boot_source;
+
+// private helper, MFIO is low while the fifo holds at least the threshold
+static void update_mfio(void) {
+    bool low = booted && (fifo_count > 0) && (fifo_count >= stats.fifo_threshold);
+    sim_gpio_drive(HUB_PORT, MFIO_PIN, low ? 0 : SIM_GPIO_RELEASE);
+}
+
+static uint8_t sample_size(void) {
+    switch (stats.output_mode) {
+        case OUTPUT_RAW:
+            return RAW_SAMPLE_SIZE;
+        case OUTPUT_BOTH:
+            return RAW_SAMPLE_SIZE + ALGO_SAMPLE_SIZE;
+        default:
+            return ALGO_SAMPLE_SIZE;
+    }
+}
+
+static void put_u24(uint8_t* p, uint32_t v) {
+    p[0] = (v >> 16) & 0x03;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = v & 0xFF;
+}
+
+static void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+/*
+ * private helper, one beat shaped PPG sample
+ * the red AC is sized so the ratio of ratios gives the scripted SpO2
+ * through SpO2 = 110 - 25 * R
+ */
+static void make_raw(uint8_t* p) {
+    uint32_t ir = EMPTY_DC;
+    uint32_t red = EMPTY_DC;
+
+    if (reading.finger_status == 3) {
+        double r = (110.0 - reading.blood_oxygen) / 25.0;
+        double pulse = sin(2.0 * M_PI * ppg_phase);
+        double ir_ac = IR_AC * pulse;
+        double red_ac = r * (IR_AC / (double) IR_DC) * RED_DC * pulse;
+        ir = (uint32_t) (IR_DC + ir_ac);
+        red = (uint32_t) (RED_DC + red_ac);
+
+        ppg_phase += reading.heart_rate / 60.0 / 100.0;
+        ppg_phase -= floor(ppg_phase);
+    }
+
+    memset(p, 0, RAW_SAMPLE_SIZE);
+    put_u24(&p[0], ir);
+    put_u24(&p[3], red);
+}
+
+static void make_algo(uint8_t* p) {
+    put_u16(&p[0], reading.heart_rate * 10);
+    p[2] = reading.confidence;
+    put_u16(&p[3], reading.blood_oxygen * 10);
+    p[5] = reading.finger_status;
+}
+
+static void sample_fire(sim_source_t* s) {
+    uint8_t* p;
+
+    if (fifo_count == FIFO_DEPTH) {
+        fifo_rptr = (fifo_rptr + 1) % FIFO_DEPTH;
+        fifo_count--;
+        stats.samples_lost++;
+    }
+    p = fifo[(fifo_rptr + fifo_count) % FIFO_DEPTH];
+    fifo_count++;
+
+    if (stats.output_mode == OUTPUT_RAW) {
+        make_raw(p);
+    }
+    else if (stats.output_mode == OUTPUT_BOTH) {
+        make_raw(p);
+        make_algo(p + RAW_SAMPLE_SIZE);
+    }
+    else {
+        make_algo(p);
+    }
+
+    sim_source_arm(s, s->when + SAMPLE_PERIOD);
+    update_mfio();
+}
+
+// private helper, the MAX30101 samples while it is on and something reads its output
+static void update_sampling(void) {
+    bool run = booted && stats.sensor_enabled && (stats.algo_enabled || (stats.output_mode == OUTPUT_RAW));
+    if (run && !sample_source.armed) {
+        sim_source_arm(&sample_source, sim_now() + SAMPLE_PERIOD);
+    }
+    else if (!run) {
+        sim_source_cancel(&sample_source);
+    }
+}
+
+static void hub_power_on_state(void) {
+    booted = false;
+    stats.running = false;
+    stats.sensor_enabled = false;
+    stats.algo_enabled = false;
+    stats.output_mode = 0;
+    stats.fifo_threshold = 0x0F;
+    fifo_rptr = 0;
+    fifo_count = 0;
+    resp_len = 0;
+    fifo_read_pending = false;
+    sim_source_cancel(&sample_source);
+    sim_source_cancel(&boot_source);
+}
+
+static void boot_fire(sim_source_t* s) {
+    (void) s;
+    booted = true;
+    stats.running = true;
+    update_mfio();
+}
+
+// RSTN low resets the hub, MFIO high when it rises selects the application
+static void reset_watch(GPIO_Port_TypeDef port, unsigned int pin, unsigned int level) {
+    (void) port;
+    (void) pin;
+    if (level == 0) {
+        in_reset = true;
+        stats.resets++;
+        hub_power_on_state();
+        sim_gpio_drive(HUB_PORT, MFIO_PIN, SIM_GPIO_RELEASE);
+        return;
+    }
+    if (!in_reset) {
+        return;
+    }
+    in_reset = false;
+    device_mode = sim_gpio_level(HUB_PORT, MFIO_PIN) ? MODE_APPLICATION : MODE_BOOTLOADER;
+    boot_done = sim_now() + BOOT_TIME;
+    sim_source_arm(&boot_source, boot_done);
+}
+
+// private helper, sets the response of a command and when it can be read
+static void respond(uint8_t status, const uint8_t* data, uint8_t len, sim_time_t exec_time) {
+    resp[0] = status;
+    if (len > 0) {
+        memcpy(&resp[1], data, len);
+    }
+    resp_len = 1 + len;
+    resp_ready = sim_now() + exec_time;
+}
+
+static I2C_TransferReturn_TypeDef hub_write(sim_i2c_device_t* d, const uint8_t* cmd, uint16_t len) {
+    (void) d;
+    uint8_t data[3] = { 0 };
+
+    if (in_reset || !booted) {
+        return i2cTransferNack;
+    }
+    if (len < 2) {
+        respond(STATUS_ILLEGAL_FAMILY, 0, 0, 0);
+        return i2cTransferDone;
+    }
+
+    stats.commands++;
+    fifo_read_pending = false;
+
+    uint16_t family = (cmd[0] << 8) | cmd[1];
+    uint8_t arg = (len > 2) ? cmd[2] : 0;
+
+    switch (family) {
+        case 0x0000: // read status
+            data[0] = comm_error ? 1 : 0;
+            respond(STATUS_SUCCESS, data, 1, 0);
+            break;
+        case 0x0200: // read device mode
+            data[0] = device_mode;
+            respond(STATUS_SUCCESS, data, 1, CONFIG_TIME);
+            break;
+        case 0xFF03: // read version
+            data[0] = 10;
+            data[1] = 1;
+            data[2] = 0;
+            respond(STATUS_SUCCESS, data, 3, CONFIG_TIME);
+            break;
+        case 0x1000: // set output mode
+            stats.output_mode = arg;
+            fifo_rptr = 0;
+            fifo_count = 0;
+            respond(STATUS_SUCCESS, 0, 0, CONFIG_TIME);
+            break;
+        case 0x1001: // set fifo threshold
+            stats.fifo_threshold = arg;
+            respond(STATUS_SUCCESS, 0, 0, CONFIG_TIME);
+            break;
+        case 0x1100: // read output mode
+            data[0] = stats.output_mode;
+            respond(STATUS_SUCCESS, data, 1, CONFIG_TIME);
+            break;
+        case 0x1200: // samples in the output fifo
+            data[0] = (fifo_count > 0xFF) ? 0xFF : fifo_count;
+            respond(STATUS_SUCCESS, data, 1, 0);
+            break;
+        case 0x1201: // read the output fifo
+            fifo_read_pending = true;
+            respond(STATUS_SUCCESS, 0, 0, 0);
+            break;
+        case 0x4403: // MAX30101 enable
+            stats.sensor_enabled = (arg != 0);
+            respond(STATUS_SUCCESS, 0, 0, ENABLE_TIME);
+            break;
+        case 0x5100: // read algorithm configuration
+            data[0] = 4;
+            respond(STATUS_SUCCESS, data, 1, CONFIG_TIME);
+            break;
+        case 0x5200: // AGC enable
+            respond(STATUS_SUCCESS, 0, 0, ENABLE_TIME);
+            break;
+        case 0x5202: // MaximFast enable
+            stats.algo_enabled = (arg != 0);
+            respond(STATUS_SUCCESS, 0, 0, ENABLE_TIME);
+            break;
+        default:
+            respond(STATUS_ILLEGAL_FAMILY, 0, 0, 0);
+            break;
+    }
+
+    update_sampling();
+    update_mfio();
+    return i2cTransferDone;
+}
+
+static I2C_TransferReturn_TypeDef hub_read(sim_i2c_device_t* d, uint8_t* data, uint16_t len) {
+    (void) d;
+
+    if (in_reset || !booted) {
+        return i2cTransferNack;
+    }
+
+    memset(data, 0, len);
+    if (len == 0) {
+        return i2cTransferDone;
+    }
+    if (sim_now() < resp_ready) {
+        stats.early_reads++;
+        data[0] = STATUS_TRY_AGAIN;
+        return i2cTransferDone;
+    }
+
+    if (!fifo_read_pending) {
+        memcpy(data, resp, (len < resp_len) ? len : resp_len);
+        return i2cTransferDone;
+    }
+
+    // status byte, then as many whole samples as were asked for
+    uint8_t size = sample_size();
+    uint16_t n = (len - 1) / size;
+    data[0] = STATUS_SUCCESS;
+    for (uint16_t i = 0; (i < n) && (fifo_count > 0); i++) {
+        memcpy(&data[1 + (i * size)], fifo[fifo_rptr], size);
+        fifo_rptr = (fifo_rptr + 1) % FIFO_DEPTH;
+        fifo_count--;
+        stats.samples_read++;
+    }
+    stats.fifo_reads++;
+    fifo_read_pending = false;
+    update_mfio();
+    return i2cTransferDone;
+}
+
+static sim_i2c_device_t hub_device = {
+    .name = "max32664",
+    .addr = HUB_ADDR,
+    .write = hub_write,
+    .read = hub_read
+};
+
+__attribute__((constructor)) static void hub_register(void) {
+    sample_source.name = "max30101";
+    sample_source.fire = sample_fire;
+    boot_source.name = "max32664 boot";
+    boot_source.fire = boot_fire;
+    sim_i2c_attach(&hub_device);
+    sim_gpio_watch(HUB_PORT, RESET_PIN, reset_watch);
+
+    // powered with RSTN pulled up, running the application
+    booted = true;
+    stats.running = true;
+}
+
+// ---------------------------------------------------------------------
+// Scripting
+// ---------------------------------------------------------------------
+
+void sim_hub_set_reading(const sim_hub_reading_t* r) {
+    reading = *r;
+}
+
+void sim_hub_finger(uint16_t heart_rate, uint16_t blood_oxygen, uint8_t confidence) {
+    sim_hub_reading_t r = { 3, heart_rate, blood_oxygen, confidence };
+    sim_hub_set_reading(&r);
+}
+
+void sim_hub_no_finger(void) {
+    sim_hub_reading_t r = { 0, 0, 0, 0 };
+    sim_hub_set_reading(&r);
+}
+
+void sim_hub_comm_error(bool error) {
+    comm_error = error;
+}
+
+const sim_hub_stats_t* sim_hub_stats(void) {
+    return &stats;
+}
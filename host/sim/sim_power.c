@@ -0,0 +1,167 @@
+/*
+ * sim_power.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Power manager and EMU.
+ *
+ * Sleeping jumps the virtual clock from event to event until an interrupt
+ * that can run is pending or the stack has an event to deliver, and books
+ * the time to the energy mode the requirements allow. When the next event
+ * lies past the end of the current run the firmware is parked there until
+ * the harness runs it again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim_internal.h"
+#include "em_emu.h"
+
+#define NUM_EMS (SL_POWER_MANAGER_EM4 + 1)
+
+static uint32_t requirements[NUM_EMS];
+static sim_time_t em_time[NUM_EMS];
+static uint32_t wakeups = 0;
+static uint32_t em2_during_transfer = 0;
+
+static sl_power_manager_em_transition_event_handle_t* subscribers = 0;
+
+// private helper, the deepest mode the requirements allow
+static sl_power_manager_em_t sleep_mode(void) {
+    if (requirements[SL_POWER_MANAGER_EM1] > 0) {
+        return SL_POWER_MANAGER_EM1;
+    }
+    if (requirements[SL_POWER_MANAGER_EM2] > 0) {
+        return SL_POWER_MANAGER_EM2;
+    }
+    return SL_POWER_MANAGER_EM3;
+}
+
+// private helper, tells every subscriber that leaves from or enters to
+static void notify(sl_power_manager_em_t from, sl_power_manager_em_t to) {
+    uint32_t events = (1U << ((from * 2) + 1)) | (1U << (to * 2));
+    for (sl_power_manager_em_transition_event_handle_t* h = subscribers; h != 0; h = h->next) {
+        if (h->info->event_mask & events) {
+            h->info->on_event(from, to);
+        }
+    }
+}
+
+/*
+ * private helper, WFI: moves time to each next event until an interrupt
+ * could run or, for the main loop, the stack has work
+ *
+ * returns: false if there was nothing to wait for
+ */
+static bool wait_for_interrupt(bool wake_on_stack) {
+    uint64_t entries = sim_irq_entries();
+
+    while (!sim_irq_wake_pending() && (sim_irq_entries() == entries) &&
+           !(wake_on_stack && sim_bt_has_work())) {
+        const sim_source_t* next = sim_next_source();
+        if (sim_in_firmware() && ((next == 0) || (next->when > sim_run_end()))) {
+            sim_yield();
+            continue;
+        }
+        if (next == 0) {
+            return false;
+        }
+        sim_advance_to(next->when);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// Power manager
+// ---------------------------------------------------------------------
+
+void sl_power_manager_add_em_requirement(sl_power_manager_em_t em) {
+    requirements[em]++;
+}
+
+void sl_power_manager_remove_em_requirement(sl_power_manager_em_t em) {
+    if (requirements[em] == 0) {
+        fprintf(stderr, "sim: EM%d requirement removed more often than added\n", (int) em);
+        abort();
+    }
+    requirements[em]--;
+}
+
+void sl_power_manager_subscribe_em_transition_event(sl_power_manager_em_transition_event_handle_t* handle,
+                                                    const sl_power_manager_em_transition_event_info_t* info) {
+    handle->info = info;
+    handle->next = subscribers;
+    subscribers = handle;
+}
+
+void sl_power_manager_sleep(void) {
+    uint32_t primask = sim_primask_swap(1);
+
+    if (sim_irq_wake_pending() || sim_bt_has_work()) {
+        sim_primask_swap(primask);
+        sim_irq_update();
+        return;
+    }
+
+    // with EM0 the main loop spins, which takes the same time as waiting
+    sl_power_manager_em_t em = app_is_ok_to_sleep() ? sleep_mode() : SL_POWER_MANAGER_EM0;
+    sim_time_t start = sim_now();
+
+    if (em != SL_POWER_MANAGER_EM0) {
+        if ((em >= SL_POWER_MANAGER_EM2) && sim_i2c_active()) {
+            em2_during_transfer++;
+        }
+        notify(SL_POWER_MANAGER_EM0, em);
+    }
+
+    if (!wait_for_interrupt(true)) {
+        fprintf(stderr, "sim: main loop sleeps with nothing left to wake it\n");
+        abort();
+    }
+
+    em_time[em] += sim_now() - start;
+    if (em != SL_POWER_MANAGER_EM0) {
+        wakeups++;
+        notify(em, SL_POWER_MANAGER_EM0);
+    }
+
+    sim_primask_swap(primask);
+    sim_irq_update();
+}
+
+// ---------------------------------------------------------------------
+// EMU
+// ---------------------------------------------------------------------
+
+// WFI, also from a critical section or an interrupt handler
+void EMU_EnterEM1(void) {
+    sim_time_t start = sim_now();
+    if (!wait_for_interrupt(false)) {
+        fprintf(stderr, "sim: EM1 wait with nothing left to wake it\n");
+        abort();
+    }
+    em_time[SL_POWER_MANAGER_EM1] += sim_now() - start;
+    wakeups++;
+}
+
+// ---------------------------------------------------------------------
+// Statistics
+// ---------------------------------------------------------------------
+
+sim_time_t sim_em_time(sl_power_manager_em_t em) {
+    return em_time[em];
+}
+
+uint32_t sim_em_requirement(sl_power_manager_em_t em) {
+    return requirements[em];
+}
+
+uint32_t sim_wakeups(void) {
+    return wakeups;
+}
+
+uint32_t sim_em2_during_transfer(void) {
+    return em2_during_transfer;
+}
@@ -0,0 +1,89 @@
+/*
+ * sim_run.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Runs the firmware's main() as a coroutine of the harness. main() never
+ * returns, so it gets its own stack and hands control back whenever its
+ * main loop would sleep past the end of the current run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#include "sim_internal.h"
+
+#define FIRMWARE_STACK_SIZE (1024 * 1024)
+
+// main.c is built with -Dmain=firmware_main
+extern int firmware_main(void);
+
+static ucontext_t harness_context;
+static ucontext_t firmware_context;
+static void* firmware_stack = 0;
+static bool started = false;
+static bool in_firmware = false;
+static sim_time_t run_end = 0;
+
+static void firmware_entry(void) {
+    firmware_main();
+    fprintf(stderr, "sim: firmware main() returned\n");
+    abort();
+}
+
+void sim_run_until(sim_time_t t) {
+    if (in_firmware) {
+        fprintf(stderr, "sim: sim_run_until() called from the firmware\n");
+        abort();
+    }
+    run_end = t;
+
+    if (!started) {
+        firmware_stack = malloc(FIRMWARE_STACK_SIZE);
+        if ((firmware_stack == 0) || (getcontext(&firmware_context) != 0)) {
+            abort();
+        }
+        firmware_context.uc_stack.ss_sp = firmware_stack;
+        firmware_context.uc_stack.ss_size = FIRMWARE_STACK_SIZE;
+        firmware_context.uc_link = 0;
+        makecontext(&firmware_context, firmware_entry, 0);
+        started = true;
+    }
+
+    in_firmware = true;
+    swapcontext(&harness_context, &firmware_context);
+    in_firmware = false;
+
+    // nothing happens before the next event, which is past the end of the run
+    if (sim_now() < t) {
+        sim_advance_to(t);
+    }
+}
+
+void sim_run_for(sim_time_t dt) {
+    sim_run_until(sim_now() + dt);
+}
+
+bool sim_firmware_started(void) {
+    return started;
+}
+
+bool sim_in_firmware(void) {
+    return in_firmware;
+}
+
+sim_time_t sim_run_end(void) {
+    return run_end;
+}
+
+// interrupts raised by the harness meanwhile wait for the firmware to resume
+void sim_yield(void) {
+    uint32_t primask = sim_primask_swap(1);
+    in_firmware = false;
+    swapcontext(&firmware_context, &harness_context);
+    in_firmware = true;
+    sim_primask_swap(primask);
+    sim_irq_update();
+}
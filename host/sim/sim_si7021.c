@@ -0,0 +1,87 @@
+/*
+ * sim_si7021.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Si7021 temperature sensor, no hold master mode measurements only. The
+ * sensor NACKs a read until its conversion is done, and everything while
+ * SENSOR_ENABLE is low.
+ */
+
+#include "sim_internal.h"
+#include "em_gpio.h"
+
+#define SI7021_ADDR 0x80
+#define MEASURE_TEMP_NO_HOLD 0xF3
+#define CONVERSION_TIME SIM_US(7000)
+
+#define SENSOR_ENABLE_PORT gpioPortD
+#define SENSOR_ENABLE_PIN 15
+
+static int32_t temperature = 22500; // mC
+static bool converting = false;
+static sim_time_t conversion_done = 0;
+static uint16_t result = 0;
+static uint32_t conversions = 0;
+
+static bool powered(void) {
+    return sim_gpio_level(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN) != 0;
+}
+
+// datasheet: temp C = 175.72 * code / 65536 - 46.85, the two lowest bits are status
+static uint16_t temperature_code(int32_t mc) {
+    int64_t code = (((int64_t) mc + 46850) * 65536) / 175720;
+    if (code < 0) {
+        code = 0;
+    }
+    if (code > 0xFFFF) {
+        code = 0xFFFF;
+    }
+    return (uint16_t) code & 0xFFFC;
+}
+
+static I2C_TransferReturn_TypeDef si7021_write(sim_i2c_device_t* d, const uint8_t* data, uint16_t len) {
+    (void) d;
+    if (!powered()) {
+        return i2cTransferNack;
+    }
+    if ((len == 1) && (data[0] == MEASURE_TEMP_NO_HOLD)) {
+        converting = true;
+        conversion_done = sim_now() + CONVERSION_TIME;
+        result = temperature_code(temperature);
+        conversions++;
+    }
+    return i2cTransferDone;
+}
+
+static I2C_TransferReturn_TypeDef si7021_read(sim_i2c_device_t* d, uint8_t* data, uint16_t len) {
+    (void) d;
+    if (!powered() || !converting || (sim_now() < conversion_done)) {
+        return i2cTransferNack;
+    }
+    converting = false;
+    for (uint16_t i = 0; i < len; i++) {
+        data[i] = (i == 0) ? (result >> 8) : (i == 1) ? (result & 0xFF) : 0;
+    }
+    return i2cTransferDone;
+}
+
+static sim_i2c_device_t si7021_device = {
+    .name = "si7021",
+    .addr = SI7021_ADDR,
+    .write = si7021_write,
+    .read = si7021_read
+};
+
+__attribute__((constructor)) static void si7021_register(void) {
+    sim_i2c_attach(&si7021_device);
+}
+
+void sim_si7021_set_temperature(int32_t millidegrees) {
+    temperature = millidegrees;
+}
+
+uint32_t sim_si7021_conversions(void) {
+    return conversions;
+}
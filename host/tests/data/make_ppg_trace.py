@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+#
+# make_ppg_trace.py
+#
+#  Created on: Oct 16, 2026
+#      Author: bjornnelson
+#
+# Writes ppg_trace.txt next to this file, see the comment at its top.
+# Seeded, running it again gives the same trace.
+
+import math
+import os
+import random
+
+FS = 100  # Hz
+SECONDS = 120
+
+DC_IR = 104000.0
+DC_RED = 83000.0
+PERFUSION = 0.012  # AC / DC of the IR pulse
+NOISE = 25  # counts, standard deviation
+
+MOTION_START = 70  # s
+MOTION_SECONDS = 2
+
+HEADER = """\
+# PPG trace for test_ppg_estimator.c, written by make_ppg_trace.py
+#
+# Not a capture from the board, there is none in the tree yet. Made to have
+# what one has: heart rate 62 -> 96 -> 74 bpm with respiratory sinus
+# arrhythmia, SpO2 97 -> 93 -> 95 %, respiratory amplitude modulation, a
+# dicrotic notch that varies beat to beat, baseline wander, sensor noise, and
+# the finger pressed harder for 2 s at 70 s. A capture in the same format
+# can take its place.
+#
+# <ir> <red>                   MAX30101 counts, 100 Hz
+# ref <sample> <bpm> <spo2>    reference before that sample: 60 / mean beat
+#                              interval of the beats in the 8 s before it,
+#                              and the SpO2 the trace was made with
+# artifact <first> <last>      samples with motion on them"""
+
+
+def heart_rate(t):
+    if t < 30:
+        bpm = 62
+    elif t < 50:
+        bpm = 62 + (t - 30) * (96 - 62) / 20
+    elif t < 80:
+        bpm = 96
+    elif t < 95:
+        bpm = 96 - (t - 80) * (96 - 74) / 15
+    else:
+        bpm = 74
+    # respiratory sinus arrhythmia, breathing at 15 per minute
+    return bpm + 3 * math.sin(2 * math.pi * 0.25 * t)
+
+
+def spo2(t):
+    if t < 40:
+        return 97
+    if t < 60:
+        return 97 - (t - 40) * 4 / 20
+    if t < 100:
+        return 93
+    return 95
+
+
+def pulse_shape(x, notch):
+    """one beat, 0 to 1: systolic upstroke, runoff and a dicrotic notch"""
+    y = 0.5 - 0.5 * math.cos(math.pi * x / 0.14) if x < 0.14 else math.exp(-(x - 0.14) * 4.2)
+    return y + notch * math.exp(-((x - 0.45) / 0.05) ** 2)
+
+
+def main():
+    random.seed(20261016)
+    phase = 0.0
+    notch = 0.18
+    drift = 0.0
+    beats = []
+    samples = []
+
+    for n in range(SECONDS * FS):
+        t = n / FS
+        phase += heart_rate(t) / 60 / FS
+        if phase >= 1:
+            phase -= 1
+            beats.append(n)
+            notch = min(0.3, max(0.08, notch + random.uniform(-0.03, 0.03)))
+
+        r = (110 - spo2(t)) / 25
+        perfusion = PERFUSION * (1 + 0.08 * math.sin(2 * math.pi * 0.25 * t + 1.0))
+        drift = 0.999 * drift + random.gauss(0, 12)
+        wander = 600 * math.sin(2 * math.pi * 0.05 * t) + drift
+
+        # blood absorbs light, the counts dip with each beat
+        y = pulse_shape(phase, notch)
+        ir = DC_IR + wander - DC_IR * perfusion * y
+        red = DC_RED + wander * DC_RED / DC_IR - DC_RED * perfusion * r * y
+
+        if MOTION_START <= t < MOTION_START + MOTION_SECONDS:
+            m = 2500 * math.sin(math.pi * (t - MOTION_START) / MOTION_SECONDS) * (1 + 0.3 * math.sin(2 * math.pi * 3 * t))
+            ir += m
+            red += m * 0.8
+
+        ir += random.gauss(0, NOISE)
+        red += random.gauss(0, NOISE)
+        samples.append((int(round(ir)) & 0x3FFFF, int(round(red)) & 0x3FFFF))
+
+    lines = [HEADER, "artifact %d %d" % (MOTION_START * FS, (MOTION_START + MOTION_SECONDS) * FS - 1)]
+    for n, (ir, red) in enumerate(samples):
+        recent = [b for b in beats if n - 8 * FS <= b < n]
+        if (n % FS == 0) and (len(recent) >= 2):
+            interval = (recent[-1] - recent[0]) / (len(recent) - 1) / FS
+            lines.append("ref %d %.1f %d" % (n, 60 / interval, round(spo2(n / FS))))
+        lines.append("%d %d" % (ir, red))
+
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "ppg_trace.txt")
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,47 @@
+/*
+ * test.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Checks for the host tests. A failed check is reported and counted, the
+ * test goes on; TEST_EXIT() makes the exit status fail if any did.
+ */
+
+#ifndef HOST_TESTS_TEST_H_
+#define HOST_TESTS_TEST_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        long long check_a_ = (long long) (a); \
+        long long check_b_ = (long long) (b); \
+        if (check_a_ != check_b_) { \
+            fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", \
+                    __FILE__, __LINE__, #a, #b, check_a_, check_b_); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define RUN_TEST(fn) \
+    do { \
+        int before_ = test_failures; \
+        fn(); \
+        printf("%-40s %s\n", #fn, (test_failures == before_) ? "ok" : "FAILED"); \
+    } while (0)
+
+#define TEST_EXIT() return (test_failures == 0) ? 0 : 1
+
+#endif /* HOST_TESTS_TEST_H_ */
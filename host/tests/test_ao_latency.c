@@ -0,0 +1,111 @@
+/*
+ * test_ao_latency.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * The whole firmware taking a reading while displayPrintf() keeps the
+ * display object redrawing back to back, each redraw as long as the memory
+ * LCD takes. The sensor object is a level above the display, its events
+ * start within the posting interrupt's return instead of waiting for a
+ * redraw. Prints the worst case latency of both objects from
+ * print_ao_stats().
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "sim.h"
+#include "src/active_object.h"
+#include "src/lcd.h"
+
+// memory LCD frame, 128 rows of 18 bytes at 1.1 MHz
+#define DISPLAY_UPDATE_NS SIM_US(16800)
+
+// a row written this often, several times per redraw
+#define FLOOD_PERIOD_NS SIM_MS(2)
+
+// a reading that waited for a redraw would see most of one
+#define MAX_SENSOR_LATENCY_US 1000
+
+typedef struct {
+    uint32_t events;
+    uint32_t max_latency_us;
+    uint32_t max_run_us;
+} ao_line_t;
+
+static ao_line_t sensor;
+static ao_line_t display;
+static char heart_rate_row[32];
+
+// private helper, fills in one object's numbers from its print_ao_stats() line
+static void parse_ao_line(const char* line, const char* name, ao_line_t* out) {
+    const char* p = strstr(line, name);
+    if ((p == 0) || (strstr(p, " level ") == 0) || (strstr(p, "run max ") == 0)) {
+        return;
+    }
+    out->events = (uint32_t) strtoul(strstr(p, ": ") + 2, 0, 10);
+    out->max_latency_us = (uint32_t) strtoul(strstr(p, " max ") + strlen(" max "), 0, 10);
+    out->max_run_us = (uint32_t) strtoul(strstr(p, "run max ") + strlen("run max "), 0, 10);
+}
+
+static void capture_line(const char* line) {
+    parse_ao_line(line, "sensor ", &sensor);
+    parse_ao_line(line, "display ", &display);
+}
+
+static sim_time_t flood_end = 0;
+static uint32_t flood_writes = 0;
+
+// rewrites a row no one else uses until the flood ends
+static void flood(void* context, uint32_t arg) {
+    (void) context;
+    displayPrintf(DISPLAY_ROW_11, "flood %u", (unsigned int) arg);
+    flood_writes++;
+    if (sim_now() + FLOOD_PERIOD_NS < flood_end) {
+        sim_at(sim_now() + FLOOD_PERIOD_NS, flood, 0, arg + 1);
+    }
+}
+
+static void test_sensor_latency_under_redraws(void) {
+    // up and waiting for a finger, the boot redraws are done
+    sim_run_until(SIM_S(2));
+
+    sim_display_update_time(DISPLAY_UPDATE_NS);
+    uint32_t updates = sim_display_updates();
+    flood_end = sim_now() + SIM_S(20);
+    sim_at(sim_now(), flood, 0, 0);
+
+    sim_hub_finger(72, 98, 99);
+    sim_run_until(flood_end);
+    strncpy(heart_rate_row, sim_display_row(DISPLAY_ROW_8), sizeof(heart_rate_row) - 1);
+    updates = sim_display_updates() - updates;
+
+    print_ao_stats();
+
+    // the display was busy for most of the run and a reading came through it
+    CHECK(updates * DISPLAY_UPDATE_NS * 10 >= SIM_S(20) * 9);
+    CHECK(strstr(heart_rate_row, "72") != 0);
+    CHECK(display.max_run_us * 1000 >= DISPLAY_UPDATE_NS);
+    CHECK(sensor.events > 0);
+
+    // no sensor event waited for a redraw to finish
+    CHECK(sensor.max_latency_us < MAX_SENSOR_LATENCY_US);
+
+    // not a check, prints the worst case wait at each level
+    fprintf(stderr, "    %u rows written, %u redraws of %u us\n", (unsigned int) flood_writes,
+            (unsigned int) updates, (unsigned int) (DISPLAY_UPDATE_NS / 1000));
+    fprintf(stderr, "    sensor:  %5u events, latency max %5u us\n", (unsigned int) sensor.events,
+            (unsigned int) sensor.max_latency_us);
+    fprintf(stderr, "    display: %5u events, latency max %5u us, run max %5u us\n",
+            (unsigned int) display.events, (unsigned int) display.max_latency_us, (unsigned int) display.max_run_us);
+}
+
+int main(void) {
+    sim_log_set_sink(capture_line);
+
+    RUN_TEST(test_sensor_latency_under_redraws);
+
+    TEST_EXIT();
+}
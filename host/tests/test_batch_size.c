@@ -0,0 +1,80 @@
+/*
+ * test_batch_size.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * The whole firmware measuring a finger for one simulated minute, built once
+ * per HEART_SENSOR_BATCH_SIZE. Prints the I2C bytes from print_i2c_stats()
+ * and the wakeups the minute took, the numbers to compare between batch
+ * sizes 1, 5 and 25, and checks every sample still arrives with one fifo
+ * read per batch.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "sim.h"
+#include "src/heart_sensor.h"
+#include "src/i2c.h"
+
+// the hub's sample rate
+#define SAMPLES_PER_MINUTE 6000
+
+static char i2c_line[256];
+
+// keeps the last print_i2c_stats() line
+static void capture_line(const char* line) {
+    if (strstr(line, "I2C transactions: ") != 0) {
+        strncpy(i2c_line, line, sizeof(i2c_line) - 1);
+    }
+}
+
+// private helper, I2C bytes the engine counted so far
+static uint32_t engine_bytes(void) {
+    i2c_line[0] = 0;
+    print_i2c_stats();
+    const char* bytes = strstr(i2c_line, "bytes: ");
+    CHECK(bytes != 0);
+    return (bytes != 0) ? (uint32_t) strtoul(bytes + strlen("bytes: "), 0, 10) : 0;
+}
+
+static void test_one_minute(void) {
+    // a finger from the start, the hub is up well before the minute starts
+    sim_hub_finger(72, 98, 99);
+    sim_run_until(SIM_S(10));
+
+    uint32_t bytes = engine_bytes();
+    uint32_t wakeups = sim_wakeups();
+    uint32_t fifo_reads = sim_hub_stats()->fifo_reads;
+    uint32_t samples = sim_hub_stats()->samples_read;
+    uint32_t lost = sim_hub_stats()->samples_lost;
+
+    sim_run_until(SIM_S(70));
+
+    bytes = engine_bytes() - bytes;
+    wakeups = sim_wakeups() - wakeups;
+    fifo_reads = sim_hub_stats()->fifo_reads - fifo_reads;
+    samples = sim_hub_stats()->samples_read - samples;
+
+    // nothing overflows, and a drain takes the whole batch
+    CHECK_EQ(sim_hub_stats()->samples_lost, lost);
+    CHECK(samples + HEART_SENSOR_BATCH_SIZE >= SAMPLES_PER_MINUTE);
+    CHECK(samples <= SAMPLES_PER_MINUTE + HEART_SENSOR_BATCH_SIZE);
+    CHECK(fifo_reads * HEART_SENSOR_BATCH_SIZE <= samples + HEART_SENSOR_BATCH_SIZE);
+    CHECK(fifo_reads * HEART_SENSOR_BATCH_SIZE * 11 >= samples * 10);
+    CHECK(wakeups >= fifo_reads);
+
+    fprintf(stderr, "    batch %2u: %6u I2C bytes, %5u wakeups, %4u fifo reads per minute\n",
+            (unsigned int) HEART_SENSOR_BATCH_SIZE, (unsigned int) bytes, (unsigned int) wakeups,
+            (unsigned int) fifo_reads);
+}
+
+int main(void) {
+    sim_log_set_sink(capture_line);
+
+    RUN_TEST(test_one_minute);
+
+    TEST_EXIT();
+}
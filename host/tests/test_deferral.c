@@ -0,0 +1,295 @@
+/*
+ * test_deferral.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Work handed from interrupts to the main loop: work items run in priority
+ * order between the events, log lines from interrupt context wait for the
+ * main loop, and, built with IRQ_TIMING, the I2C handler and the critical
+ * sections stay short while the bus fails and is recovered. Built with
+ * SCHEDULER_DEFER_INLINE as well, the work runs in the handlers the way it
+ * did before it was deferred, and the same numbers print for comparison.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "sim.h"
+#include "src/scheduler.h"
+#include "src/event_queue.h"
+#include "src/irq_timing.h"
+#include "src/i2c.h"
+#include "src/irq.h"
+#include "src/oscillators.h"
+#include "src/timers.h"
+
+#define INCLUDE_LOG_DEBUG 1
+#include "src/log.h"
+
+// what ran, in order: work items as 'a' + arg, events as 'A' + event
+static char trace[64];
+static uint32_t trace_len = 0;
+
+static void trace_work(uint32_t arg) {
+    trace[trace_len++] = 'a' + arg;
+    trace[trace_len] = 0;
+}
+
+// private helper, what the main loop does with the stack's external signal
+static bool next_event(void) {
+    sl_bt_msg_t evt;
+
+    if (!scheduler_next_event(&evt)) {
+        return false;
+    }
+    trace[trace_len++] = 'A' + evt.data.evt_system_external_signal.extsignals;
+    trace[trace_len] = 0;
+    return true;
+}
+
+static void drain(void) {
+    while (next_event());
+}
+
+// log lines the main loop printed, in order
+#define MAX_LINES 64
+#define LINE_LEN 128
+static char lines[MAX_LINES][LINE_LEN];
+static uint32_t num_lines = 0;
+
+static void capture_line(const char* line) {
+    if (num_lines < MAX_LINES) {
+        strncpy(lines[num_lines], line, LINE_LEN - 1);
+        lines[num_lines][LINE_LEN - 1] = 0;
+    }
+    num_lines++;
+}
+
+// private helper, first captured line containing text, or 0
+static const char* find_line(const char* text) {
+    for (uint32_t i = 0; (i < num_lines) && (i < MAX_LINES); i++) {
+        if (strstr(lines[i], text) != 0) {
+            return lines[i];
+        }
+    }
+    return 0;
+}
+
+static void start(void) {
+    drain();
+    trace_len = 0;
+    trace[0] = 0;
+    num_lines = 0;
+}
+
+static void post_from_interrupt(void* context, uint32_t arg) {
+    (void) context;
+    (void) arg;
+    scheduler_defer(EVENT_PRIORITY_LOW, trace_work, 0);
+    scheduler_set_event_PB0_pressed();
+    scheduler_defer(EVENT_PRIORITY_HIGH, trace_work, 1);
+    scheduler_defer(EVENT_PRIORITY_NORMAL, trace_work, 2);
+    scheduler_set_event_PB0_released();
+    scheduler_defer(EVENT_PRIORITY_HIGH, trace_work, 3);
+}
+
+static void test_work_in_priority_order(void) {
+    start();
+
+    sim_at(sim_now() + SIM_US(100), post_from_interrupt, 0, 0);
+    sim_advance(SIM_MS(1));
+
+    // nothing runs until the main loop asks for the next event
+    CHECK_EQ(trace_len, 0);
+
+    // high first, normal in the order posted with the events, low last,
+    // each event only after the work queued ahead of it, EVENT_PB0 is 'E'
+    CHECK(next_event());
+    CHECK(strcmp(trace, "bdE") == 0);
+    CHECK(next_event());
+    CHECK(strcmp(trace, "bdEcE") == 0);
+    CHECK(!next_event());
+    CHECK(strcmp(trace, "bdEcEa") == 0);
+    if (strcmp(trace, "bdEcEa") != 0) {
+        fprintf(stderr, "    ran %s\n", trace);
+    }
+}
+
+// a device that logs each write, the engine's later steps reach it from the I2C handler
+static uint32_t device_writes = 0;
+
+static I2C_TransferReturn_TypeDef logging_write(sim_i2c_device_t* d, const uint8_t* data, uint16_t len) {
+    (void) d;
+    (void) data;
+    (void) len;
+    device_writes++;
+    LOG_INFO("device write %u", (unsigned int) device_writes);
+    return i2cTransferDone;
+}
+
+static sim_i2c_device_t logging_device = { .name = "logging si7021", .addr = 0x80, .write = logging_write };
+
+// private helper, three writes in one transaction, the first from here and the others from the handler
+static void logging_transaction(void) {
+    uint8_t cmd[1] = { 0xE3 };
+
+    device_writes = 0;
+    for (uint32_t i = 0; i < 3; i++) {
+        i2c_queue_write(I2C_DEV_SI7021, cmd, sizeof(cmd));
+    }
+    i2c_start_transaction(I2C_DEV_SI7021);
+    for (uint32_t i = 0; (i < 1000) && i2c_transaction_busy(I2C_DEV_SI7021); i++) {
+        sim_advance(SIM_US(50));
+    }
+    CHECK(!i2c_transaction_busy(I2C_DEV_SI7021));
+    CHECK_EQ(device_writes, 3);
+}
+
+// private helper, index of the first captured line containing text, or MAX_LINES
+static uint32_t line_index(const char* text) {
+    const char* line = find_line(text);
+    return (line != 0) ? (uint32_t) ((line - lines[0]) / LINE_LEN) : MAX_LINES;
+}
+
+static void test_interrupt_logs_wait_for_main_loop(void) {
+    start();
+
+    // the handler only formats its lines, the low priority flush prints them
+    logging_transaction();
+    CHECK(find_line("device write 1") != 0);
+    CHECK(find_line("device write 2") == 0);
+    drain();
+    CHECK(line_index("device write 2") < line_index("device write 3"));
+    CHECK(line_index("device write 3") < MAX_LINES);
+
+    // a main loop line prints the waiting ones first
+    start();
+    logging_transaction();
+    CHECK(find_line("device write 3") == 0);
+    LOG_INFO("main loop line");
+    CHECK(line_index("device write 3") < line_index("main loop line"));
+    CHECK(line_index("main loop line") < MAX_LINES);
+
+    // and the flush still queued has nothing left to print
+    num_lines = 0;
+    drain();
+    CHECK(find_line("device write") == 0);
+}
+
+// private helper, a number a print function logs after text
+static uint32_t logged_number(void (*print)(), const char* text) {
+    num_lines = 0;
+    print();
+    const char* line = find_line(text);
+    CHECK(line != 0);
+    if (line == 0) {
+        return UINT32_MAX;
+    }
+    return (uint32_t) strtoul(strstr(line, text) + strlen(text), 0, 10);
+}
+
+// the VCOM USART, 10 bits per character at 115200 baud
+#define UART_CHAR_NS 86806
+
+// private helper, transfers that fail with bus errors, each needs a recovery and logs its status
+// log lines take as long as on the VCOM from here on
+static void failing_transactions(void) {
+    uint8_t cmd[2] = { 0x00, 0x00 };
+    uint8_t resp[2];
+
+    start();
+    sim_log_char_time(UART_CHAR_NS);
+    uint32_t errors = sim_i2c_stats()->errors;
+
+    for (uint32_t i = 0; i < 4; i++) {
+        i2c_queue_write(I2C_DEV_MAX32664, cmd, sizeof(cmd));
+        i2c_queue_delay(I2C_DEV_MAX32664, 60);
+        i2c_queue_read(I2C_DEV_MAX32664, resp, sizeof(resp));
+        sim_i2c_fail_next(i2cTransferBusErr, 2);
+        i2c_start_transaction(I2C_DEV_MAX32664);
+        while (i2c_transaction_busy(I2C_DEV_MAX32664)) {
+            sim_advance(SIM_US(50));
+            drain();
+        }
+        CHECK_EQ(i2c_transaction_status(I2C_DEV_MAX32664), i2cTransferDone);
+    }
+    CHECK_EQ(sim_i2c_stats()->errors - errors, 8);
+    drain();
+    CHECK(logged_number(print_i2c_stats, "bus recoveries: ") >= 8);
+}
+
+typedef struct {
+    uint32_t i2c;
+    uint32_t letimer;
+    uint32_t critical;
+} irq_times_t;
+
+// private helper, the worst cases print_irq_timing() logs
+static irq_times_t irq_times(const char* build) {
+    irq_times_t t;
+    uint32_t cycles_per_us = SystemCoreClockGet() / 1000000;
+
+    t.i2c = logged_number(print_irq_timing, "I2C0 handler max: ");
+    t.letimer = logged_number(print_irq_timing, "LETIMER0 handler max: ");
+    t.critical = logged_number(print_irq_timing, "Critical section max: ");
+
+    // not a check, prints the numbers to compare with the other build
+    fprintf(stderr, "    %-8s I2C0 %7u cycles (%5u us), LETIMER0 %4u cycles, critical section %4u cycles\n",
+            build, (unsigned int) t.i2c, (unsigned int) (t.i2c / cycles_per_us), (unsigned int) t.letimer,
+            (unsigned int) t.critical);
+    return t;
+}
+
+#ifndef SCHEDULER_DEFER_INLINE
+static void test_irq_timing_bounded(void) {
+    failing_transactions();
+
+    // a recovery is 15 us of clocking at least, a log line over the UART milliseconds,
+    // neither may be in a handler or with interrupts off
+    uint32_t cycles_per_us = SystemCoreClockGet() / 1000000;
+    irq_times_t t = irq_times("deferred");
+    CHECK(t.i2c > 0);
+    CHECK(t.i2c < 5 * cycles_per_us);
+    CHECK(t.letimer > 0);
+    CHECK(t.letimer < 5 * cycles_per_us);
+    CHECK(t.critical > 0);
+    CHECK(t.critical < 5 * cycles_per_us);
+}
+#else
+// the same transfers with the recovery and the status logs run in the I2C handler
+static void test_irq_timing_inline(void) {
+    failing_transactions();
+
+    // at least one status line went out over the UART from the handler
+    uint32_t cycles_per_us = SystemCoreClockGet() / 1000000;
+    irq_times_t t = irq_times("inline");
+    CHECK(t.i2c > 20 * (UART_CHAR_NS / 1000) * cycles_per_us);
+    CHECK(t.critical < 5 * cycles_per_us);
+}
+#endif
+
+int main(void) {
+    sim_log_set_sink(capture_line);
+    init_oscillators();
+    init_timer();
+    init_i2c();
+    init_event_queue();
+    NVIC_EnableIRQ(LETIMER0_IRQn);
+    sim_advance(SIM_MS(10));
+
+    sim_i2c_attach(&logging_device);
+
+#ifndef SCHEDULER_DEFER_INLINE
+    RUN_TEST(test_work_in_priority_order);
+    RUN_TEST(test_interrupt_logs_wait_for_main_loop);
+#ifdef IRQ_TIMING
+    RUN_TEST(test_irq_timing_bounded);
+#endif
+#else
+    RUN_TEST(test_irq_timing_inline);
+#endif
+
+    TEST_EXIT();
+}
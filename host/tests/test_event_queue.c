@@ -0,0 +1,172 @@
+/*
+ * test_event_queue.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Event queue: order, priorities, a full ring, and posts from an interrupt
+ * that lands inside another producer's claim.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sim.h"
+#include "src/event_queue.h"
+
+static event_ring_t ring;
+static uint32_t hook_posts = 0;
+
+static void test_fifo_order(void) {
+    app_event_t e;
+
+    event_ring_init(&ring);
+    for (uint32_t i = 0; i < 5; i++) {
+        CHECK(!event_ring_post(&ring, i, 100 + i, 1000 * i, 0));
+    }
+    for (uint32_t i = 0; i < 5; i++) {
+        CHECK(!event_ring_read(&ring, &e));
+        CHECK_EQ(e.event, i);
+        CHECK_EQ(e.payload, 100 + i);
+        CHECK_EQ(e.timestamp, 1000 * i);
+        CHECK(e.work == 0);
+    }
+    CHECK(event_ring_read(&ring, &e));
+}
+
+static void test_priorities(void) {
+    app_event_t e;
+
+    init_event_queue();
+    CHECK(!event_queue_post(EVENT_PRIORITY_LOW, 1, 0, 0, 0));
+    CHECK(!event_queue_post(EVENT_PRIORITY_NORMAL, 2, 0, 0, 0));
+    CHECK(!event_queue_post(EVENT_PRIORITY_HIGH, 3, 0, 0, 0));
+    CHECK(!event_queue_post(EVENT_PRIORITY_NORMAL, 4, 0, 0, 0));
+
+    static const uint8_t order[] = { 3, 2, 4, 1 };
+    for (uint32_t i = 0; i < sizeof(order); i++) {
+        CHECK(!event_queue_read(&e));
+        CHECK_EQ(e.event, order[i]);
+    }
+    CHECK(event_queue_read(&e));
+}
+
+static void test_full_ring_drops(void) {
+    app_event_t e;
+
+    init_event_queue();
+    for (uint32_t i = 0; i < EVENT_QUEUE_DEPTH; i++) {
+        CHECK(!event_queue_post(EVENT_PRIORITY_NORMAL, i, 0, 0, 0));
+    }
+    CHECK(event_queue_post(EVENT_PRIORITY_NORMAL, 99, 0, 0, 0));
+    CHECK_EQ(event_queue_dropped(), 1);
+
+    // the other levels are separate rings
+    CHECK(!event_queue_post(EVENT_PRIORITY_HIGH, 50, 0, 0, 0));
+
+    CHECK(!event_queue_read(&e));
+    CHECK_EQ(e.event, 50);
+    CHECK(!event_queue_read(&e));
+    CHECK_EQ(e.event, 0);
+
+    // the slot read is free again, the dropped event never shows up
+    CHECK(!event_queue_post(EVENT_PRIORITY_NORMAL, 16, 0, 0, 0));
+    for (uint32_t i = 1; i <= EVENT_QUEUE_DEPTH; i++) {
+        CHECK(!event_queue_read(&e));
+        CHECK_EQ(e.event, i);
+    }
+    CHECK(event_queue_read(&e));
+    CHECK_EQ(event_queue_dropped(), 1);
+}
+
+static void test_many_laps(void) {
+    app_event_t e;
+    uint32_t next_read = 0;
+    uint32_t next_post = 0;
+
+    event_ring_init(&ring);
+
+    // the ring is never more than three quarters full, slots are reused a few hundred times
+    for (uint32_t round = 0; round < 1000; round++) {
+        while (next_post - next_read < (EVENT_QUEUE_DEPTH * 3) / 4) {
+            CHECK(!event_ring_post(&ring, next_post & 0xFF, next_post, 0, 0));
+            next_post++;
+        }
+        for (uint32_t i = 0; i < (round % 7) + 1; i++) {
+            CHECK(!event_ring_read(&ring, &e));
+            CHECK_EQ(e.payload, next_read);
+            next_read++;
+        }
+    }
+}
+
+// "an interrupt" right before a producer's STREX, once
+static void post_from_interrupt(void) {
+    CHECK(sim_in_isr());
+    sim_on_ldrex(0);
+    hook_posts++;
+    CHECK(!event_ring_post(&ring, 200, hook_posts, 0, 0));
+}
+
+static void test_post_preempted_during_claim(void) {
+    app_event_t e;
+
+    event_ring_init(&ring);
+    hook_posts = 0;
+
+    sim_on_ldrex(post_from_interrupt);
+    CHECK(!event_ring_post(&ring, 1, 0, 0, 0));
+    sim_on_ldrex(post_from_interrupt);
+    CHECK(!event_ring_post(&ring, 2, 0, 0, 0));
+
+    // each interrupted claim lost its STREX and took the next slot
+    static const uint8_t order[] = { 200, 1, 200, 2 };
+    for (uint32_t i = 0; i < sizeof(order); i++) {
+        CHECK(!event_ring_read(&ring, &e));
+        CHECK_EQ(e.event, order[i]);
+    }
+    CHECK(event_ring_read(&ring, &e));
+    CHECK_EQ(hook_posts, 2);
+}
+
+static void work(uint32_t arg) {
+    (void) arg;
+}
+
+static void test_reader_waits_for_publish(void) {
+    app_event_t e;
+
+    event_ring_init(&ring);
+
+    // a producer claimed position 0 and was preempted before filling it in
+    ring.write_pos = 1;
+    CHECK(!event_ring_post(&ring, 7, 70, 0, work));
+
+    // position 1 is complete but must not be read ahead of position 0
+    CHECK(event_ring_read(&ring, &e));
+
+    // the first producer resumes and publishes
+    ring.slots[0].entry.event = 6;
+    ring.slots[0].entry.payload = 60;
+    ring.slots[0].entry.work = 0;
+    ring.slots[0].seq = 1;
+
+    CHECK(!event_ring_read(&ring, &e));
+    CHECK_EQ(e.event, 6);
+    CHECK(!event_ring_read(&ring, &e));
+    CHECK_EQ(e.event, 7);
+    CHECK_EQ(e.payload, 70);
+    CHECK(e.work == work);
+    CHECK(event_ring_read(&ring, &e));
+}
+
+int main(void) {
+    RUN_TEST(test_fifo_order);
+    RUN_TEST(test_priorities);
+    RUN_TEST(test_full_ring_drops);
+    RUN_TEST(test_many_laps);
+    RUN_TEST(test_post_preempted_during_claim);
+    RUN_TEST(test_reader_waits_for_publish);
+
+    TEST_EXIT();
+}
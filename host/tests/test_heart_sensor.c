@@ -0,0 +1,482 @@
+/*
+ * test_heart_sensor.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Sensor hub fifo reads: the count and drain transactions, decoding a batch
+ * of samples into the sample ring, and what a read does when the hub or the
+ * bus reports a problem. A scripted hub stands in for the model so every
+ * byte of the fifo is known.
+ *
+ * Built a second time with PPG_STREAMING_MODE, where each sample carries the
+ * MAX30101 LED counts ahead of the algorithm data and the counts go to
+ * ppg_estimator.c and the PPG ring.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "test.h"
+#include "sim.h"
+#include "src/heart_sensor.h"
+#include "src/ppg_estimator.h"
+#include "src/sensor_hub.h"
+#include "src/i2c.h"
+#include "src/irq.h"
+#include "src/oscillators.h"
+#include "src/timers.h"
+
+// bytes per sample as the hub sends them in this build
+#ifdef PPG_STREAMING_MODE
+#define LED_BYTES 12
+#else
+#define LED_BYTES 0
+#endif
+#define SAMPLE_SIZE (LED_BYTES + 6)
+
+// a finger on the sensor, in 18-bit counts
+#define DC_IR  100000
+#define DC_RED 80000
+
+// tries the transaction engine gives a step, I2C_MAX_RETRIES + 1
+#define ENGINE_ATTEMPTS 3
+
+// more than the drain takes at once
+#define HUB_FIFO_DEPTH 64
+
+// one MaximFast sample, in the units the hub uses
+typedef struct {
+    uint16_t heart_rate_x10;
+    uint8_t confidence;
+    uint16_t blood_oxygen_x10;
+    uint8_t finger_status;
+    uint32_t ir; // LED counts, streaming mode only
+    uint32_t red;
+} hub_sample_t;
+
+// a hub that answers the read commands from what the test put in its fifo
+static struct {
+    sim_i2c_device_t device;
+    uint8_t cmd[2];
+    uint8_t status; // read status response
+    uint8_t comm_error; // sensor communication error flag
+    uint8_t count_status;
+    uint8_t fifo_status;
+    hub_sample_t fifo[HUB_FIFO_DEPTH];
+    uint32_t fifo_count;
+    uint32_t fifo_reads;
+    uint16_t last_fifo_read_len;
+} hub;
+
+static I2C_TransferReturn_TypeDef hub_write(sim_i2c_device_t* d, const uint8_t* data, uint16_t len) {
+    (void) d;
+    CHECK(len >= 2);
+    memcpy(hub.cmd, data, 2);
+    return i2cTransferDone;
+}
+
+// private helper, one 3 byte big endian LED count, the unused upper bits set
+static uint8_t* put_count(uint8_t* raw, uint32_t count) {
+    count |= 0xFC0000;
+    raw[0] = count >> 16;
+    raw[1] = (count >> 8) & 0xFF;
+    raw[2] = count & 0xFF;
+    return raw + 3;
+}
+
+// private helper, writes one sample the way the hub lays it out
+static void put_sample(uint8_t* raw, const hub_sample_t* s) {
+#ifdef PPG_STREAMING_MODE
+    // LED1 is IR, LED2 red, LED3 and LED4 aren't fitted and read as noise
+    raw = put_count(raw, s->ir);
+    raw = put_count(raw, s->red);
+    raw = put_count(raw, 0x2AAAA);
+    raw = put_count(raw, 0x15555);
+#else
+    (void) put_count;
+#endif
+    raw[0] = s->heart_rate_x10 >> 8;
+    raw[1] = s->heart_rate_x10 & 0xFF;
+    raw[2] = s->confidence;
+    raw[3] = s->blood_oxygen_x10 >> 8;
+    raw[4] = s->blood_oxygen_x10 & 0xFF;
+    raw[5] = s->finger_status;
+}
+
+static I2C_TransferReturn_TypeDef hub_read(sim_i2c_device_t* d, uint8_t* data, uint16_t len) {
+    (void) d;
+    memset(data, 0, len);
+
+    if ((hub.cmd[0] == 0x00) && (hub.cmd[1] == 0x00)) {
+        data[0] = hub.status;
+        data[1] = hub.comm_error;
+    }
+    else if ((hub.cmd[0] == 0x12) && (hub.cmd[1] == 0x00)) {
+        data[0] = hub.count_status;
+        data[1] = (hub.fifo_count > 255) ? 255 : hub.fifo_count;
+    }
+    else if ((hub.cmd[0] == 0x12) && (hub.cmd[1] == 0x01)) {
+        uint32_t n = (len - 1) / SAMPLE_SIZE;
+
+        hub.fifo_reads++;
+        hub.last_fifo_read_len = len;
+        data[0] = hub.fifo_status;
+
+        // oldest first, the rest move up
+        if (n > hub.fifo_count) {
+            n = hub.fifo_count;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            put_sample(&data[1 + (i * SAMPLE_SIZE)], &hub.fifo[i]);
+        }
+        memmove(hub.fifo, &hub.fifo[n], (hub.fifo_count - n) * sizeof(hub.fifo[0]));
+        hub.fifo_count -= n;
+    }
+    return i2cTransferDone;
+}
+
+// private helper, fills the hub fifo with samples that count up from base
+static void fill_fifo(uint32_t count, uint16_t base) {
+    for (uint32_t i = 0; i < count; i++) {
+        hub_sample_t* s = &hub.fifo[hub.fifo_count++];
+        s->heart_rate_x10 = (base + i) * 10 + 7; // the tenths are cut off
+        s->confidence = 90 + (i % 10);
+        s->blood_oxygen_x10 = 950 + i;
+        s->finger_status = FINGER_DETECTED;
+        s->ir = DC_IR;
+        s->red = DC_RED;
+    }
+}
+
+// private helper, runs a whole reading the way the sensor object does, one step per EVENT_I2C_DONE
+static heart_read_status_t run_read(uint32_t* transactions) {
+    heart_read_status_t status;
+    uint32_t n = 0;
+
+    read_heart_sensor();
+    do {
+        while (i2c_transaction_busy(I2C_DEV_MAX32664)) {
+            sim_advance(SIM_US(50));
+        }
+        n++;
+        status = finish_heart_sensor_read();
+    } while (status == HEART_READ_BUSY);
+
+    if (transactions != 0) {
+        *transactions = n;
+    }
+    return status;
+}
+
+static void drain_ring(void) {
+    heart_sensor_data s;
+    ppg_sample p;
+    while (!read_heart_sample(&s));
+    while (!read_ppg_sample(&p));
+}
+
+// private helper, empties the hub and the sample ring, the hub stays on the bus
+static void reset_hub(void) {
+    sim_i2c_device_t device = hub.device;
+
+    memset(&hub, 0, sizeof(hub));
+    hub.device = device;
+    drain_ring();
+}
+
+static void test_batch_decoded_in_order(void) {
+    heart_sensor_data s;
+    uint32_t transactions;
+
+    reset_hub();
+    fill_fifo(5, 60);
+
+    CHECK_EQ(run_read(&transactions), HEART_READ_NEW_DATA);
+    uint64_t now = letimerMicroseconds();
+
+    // one count, one drain of exactly the samples waiting
+    CHECK_EQ(transactions, 2);
+    CHECK_EQ(hub.fifo_reads, 1);
+    CHECK_EQ(hub.last_fifo_read_len, 1 + (5 * SAMPLE_SIZE));
+    CHECK_EQ(hub.fifo_count, 0);
+
+    CHECK_EQ(heart_samples_available(), 5);
+    for (uint32_t i = 0; i < 5; i++) {
+        CHECK(!read_heart_sample(&s));
+        CHECK_EQ(s.heart_rate, 60 + i);
+        CHECK_EQ(s.confidence, 90 + i);
+        CHECK_EQ(s.blood_oxygen, 95);
+        CHECK_EQ(s.finger_status, FINGER_DETECTED);
+
+        // the newest was taken about now, the others a sample period apart before it
+        uint64_t taken = now - ((4 - i) * (1000000 / 100));
+        CHECK(s.timestamp <= taken);
+        CHECK(s.timestamp + 1000 >= taken);
+    }
+    CHECK(read_heart_sample(&s));
+
+    // the newest sample is the current reading
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 64);
+    CHECK_EQ(get_heart_data_ptr()->confidence, 94);
+}
+
+static void test_drain_limited_to_buffer(void) {
+    reset_hub();
+    fill_fifo(HEART_FIFO_MAX_SAMPLES + 8, 100);
+
+    CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+    CHECK_EQ(hub.last_fifo_read_len, 1 + (HEART_FIFO_MAX_SAMPLES * SAMPLE_SIZE));
+    CHECK_EQ(hub.fifo_count, 8);
+    CHECK_EQ(heart_samples_available(), HEART_FIFO_MAX_SAMPLES);
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 100 + HEART_FIFO_MAX_SAMPLES - 1);
+
+    // the rest comes with the next reading
+    drain_ring();
+    CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+    CHECK_EQ(heart_samples_available(), 8);
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 100 + HEART_FIFO_MAX_SAMPLES + 7);
+}
+
+static void test_empty_fifo_keeps_reading(void) {
+    uint32_t transactions;
+
+    reset_hub();
+    fill_fifo(1, 70);
+    CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+    drain_ring();
+
+    // no drain at all, the last reading stays
+    CHECK_EQ(run_read(&transactions), HEART_READ_NO_DATA);
+    CHECK_EQ(transactions, 1);
+    CHECK_EQ(hub.fifo_reads, 1);
+    CHECK_EQ(heart_samples_available(), 0);
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 70);
+}
+
+static void test_ring_keeps_newest(void) {
+    heart_sensor_data s;
+
+    reset_hub();
+    uint32_t dropped = heart_samples_dropped();
+
+    // two batches before anything reads the ring
+    fill_fifo(25, 40);
+    CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+    fill_fifo(25, 65);
+    CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+
+    CHECK_EQ(heart_samples_available(), SAMPLE_RING_DEPTH);
+    CHECK_EQ(heart_samples_dropped() - dropped, 50 - SAMPLE_RING_DEPTH);
+    for (uint32_t i = 0; i < SAMPLE_RING_DEPTH; i++) {
+        CHECK(!read_heart_sample(&s));
+        CHECK_EQ(s.heart_rate, 40 + (50 - SAMPLE_RING_DEPTH) + i);
+    }
+    CHECK(read_heart_sample(&s));
+}
+
+static void test_hub_errors(void) {
+    reset_hub();
+    fill_fifo(3, 80);
+    CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+    drain_ring();
+
+    // the count failed, nothing is drained and the reading stays
+    fill_fifo(3, 90);
+    hub.count_status = 0x01;
+    CHECK_EQ(run_read(0), HEART_READ_NO_DATA);
+    CHECK_EQ(hub.fifo_reads, 1);
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 82);
+
+    // the drain failed, the samples are gone but not parsed
+    hub.count_status = 0;
+    hub.fifo_status = 0x01;
+    CHECK_EQ(run_read(0), HEART_READ_NO_DATA);
+    CHECK_EQ(heart_samples_available(), 0);
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 82);
+
+    // the hub lost the sensor, the reading is cleared
+    hub.fifo_status = 0;
+    fill_fifo(3, 90);
+    hub.comm_error = 1;
+    CHECK_EQ(run_read(0), HEART_READ_FAILED);
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 0);
+    CHECK_EQ(get_heart_data_ptr()->finger_status, NOTHING_DETECTED);
+    CHECK_EQ(heart_samples_available(), 0);
+}
+
+static void test_bus_failures(void) {
+    uint32_t transactions;
+
+    reset_hub();
+
+    // the engine retries a NACKed step twice before the transaction fails,
+    // the read then starts over from the count once
+    fill_fifo(4, 50);
+    sim_i2c_fail_next(i2cTransferNack, ENGINE_ATTEMPTS);
+    CHECK_EQ(run_read(&transactions), HEART_READ_NEW_DATA);
+    CHECK_EQ(transactions, 3);
+    CHECK_EQ(heart_samples_available(), 4);
+    drain_ring();
+
+    // a second failed transaction is one too many
+    fill_fifo(4, 50);
+    sim_i2c_fail_next(i2cTransferNack, 2 * ENGINE_ATTEMPTS);
+    CHECK_EQ(run_read(0), HEART_READ_FAILED);
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 0);
+    CHECK_EQ(heart_samples_available(), 0);
+}
+
+#ifdef PPG_STREAMING_MODE
+
+// private helper, hub reads of a 70 bpm pulse with SpO2 95 (R = 0.6), dc_ir 0 for no finger
+static void stream_pulse(double seconds, uint32_t dc_ir) {
+    static double phase = 0;
+    uint32_t batches = (uint32_t) (seconds * PPG_SAMPLE_RATE_HZ / HEART_SENSOR_BATCH_SIZE);
+
+    for (uint32_t b = 0; b < batches; b++) {
+        fill_fifo(HEART_SENSOR_BATCH_SIZE, 70);
+        for (uint32_t i = 0; i < HEART_SENSOR_BATCH_SIZE; i++) {
+            hub_sample_t* s = &hub.fifo[i];
+
+            // a fast upstroke then an exponential runoff, blood absorbs light so the counts dip
+            double y = (phase < 0.15) ? phase / 0.15 : exp(-(phase - 0.15) * 5);
+            s->ir = dc_ir ? (uint32_t) (dc_ir - (1000 * y)) : 500;
+            s->red = dc_ir ? (uint32_t) (DC_RED - (0.6 * 800 * y)) : 400;
+
+            phase += 70.0 / 60 / PPG_SAMPLE_RATE_HZ;
+            if (phase >= 1) {
+                phase -= 1;
+            }
+        }
+        CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+        drain_ring();
+    }
+}
+
+static void test_stream_feeds_estimator(void) {
+    heart_sensor_data est;
+    uint16_t rr;
+
+    reset_hub();
+    ppg_estimator_reset();
+    while (!ppg_estimator_read_rr(&rr));
+
+    // the estimator sees the LED counts, IR and red the right way round, and the
+    // algorithm data behind them is still what the ring gets
+    stream_pulse(15, DC_IR);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.finger_status, FINGER_DETECTED);
+    CHECK(fabs(est.heart_rate - 70) <= 2);
+    CHECK(fabs(est.blood_oxygen - 95) <= 2);
+    CHECK(!ppg_estimator_read_rr(&rr));
+    CHECK(fabs(rr - (60.0 / 70 * 1024)) <= 11);
+    CHECK_EQ(get_heart_data_ptr()->heart_rate, 70 + HEART_SENSOR_BATCH_SIZE - 1);
+}
+
+static void test_stream_masks_unused_bits(void) {
+    heart_sensor_data est;
+
+    // a few hundred counts is no finger, the set upper bits must not make it one
+    reset_hub();
+    ppg_estimator_reset();
+    stream_pulse(10, 0);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.finger_status, NOTHING_DETECTED);
+    CHECK_EQ(est.heart_rate, 0);
+}
+
+static void test_stream_fills_ppg_ring(void) {
+    ppg_sample p;
+
+    reset_hub();
+    CHECK_EQ(ppg_samples_available(), 0);
+
+    // the waveform for the rest of the firmware, oldest first, upper bits masked
+    fill_fifo(10, 60);
+    for (uint32_t i = 0; i < 10; i++) {
+        hub.fifo[i].ir = DC_IR + i;
+        hub.fifo[i].red = DC_RED - i;
+    }
+    CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+    CHECK_EQ(ppg_samples_available(), 10);
+    for (uint32_t i = 0; i < 10; i++) {
+        CHECK(!read_ppg_sample(&p));
+        CHECK_EQ(p.ir, DC_IR + i);
+        CHECK_EQ(p.red, DC_RED - i);
+    }
+    CHECK(read_ppg_sample(&p));
+
+    // a reader that fell behind gets the newest PPG_RING_DEPTH samples
+    uint32_t total = 0;
+    while (total < PPG_RING_DEPTH + 40) {
+        fill_fifo(HEART_SENSOR_BATCH_SIZE, 60);
+        for (uint32_t i = 0; i < HEART_SENSOR_BATCH_SIZE; i++) {
+            hub.fifo[i].ir = total++;
+        }
+        CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+    }
+    CHECK_EQ(ppg_samples_available(), PPG_RING_DEPTH);
+    for (uint32_t i = 0; i < PPG_RING_DEPTH; i++) {
+        CHECK(!read_ppg_sample(&p));
+        CHECK_EQ(p.ir, total - PPG_RING_DEPTH + i);
+    }
+    CHECK(read_ppg_sample(&p));
+    drain_ring();
+}
+
+// not a check, prints how fast a full drain is decoded on the host
+static void test_decode_throughput(void) {
+    const uint32_t rounds = 20000;
+
+    reset_hub();
+    fill_fifo(HEART_FIFO_MAX_SAMPLES, 60);
+    CHECK_EQ(run_read(0), HEART_READ_NEW_DATA);
+
+    // the drained bytes stay in the buffer, decode them again and again
+    clock_t start = clock();
+    for (uint32_t i = 0; i < rounds; i++) {
+        process_raw_heart_data();
+    }
+    double us = (double) (clock() - start) * 1000000 / CLOCKS_PER_SEC;
+    drain_ring();
+
+    double bytes = (double) rounds * HEART_FIFO_MAX_SAMPLES * SAMPLE_SIZE;
+    if (us > 0) {
+        fprintf(stderr, "    decode: %.1f bytes/us, %.2f us per %u sample drain\n",
+                bytes / us, us / rounds, HEART_FIFO_MAX_SAMPLES);
+    }
+}
+
+#endif
+
+int main(void) {
+    sim_log_quiet(true);
+    init_oscillators();
+    init_timer();
+    init_i2c();
+    NVIC_EnableIRQ(LETIMER0_IRQn);
+    sim_advance(SIM_MS(10));
+
+    hub.device.name = "scripted max32664";
+    hub.device.addr = 0xAA;
+    hub.device.write = hub_write;
+    hub.device.read = hub_read;
+    sim_i2c_attach(&hub.device);
+
+    RUN_TEST(test_batch_decoded_in_order);
+    RUN_TEST(test_drain_limited_to_buffer);
+    RUN_TEST(test_empty_fifo_keeps_reading);
+    RUN_TEST(test_ring_keeps_newest);
+    RUN_TEST(test_hub_errors);
+    RUN_TEST(test_bus_failures);
+#ifdef PPG_STREAMING_MODE
+    RUN_TEST(test_stream_feeds_estimator);
+    RUN_TEST(test_stream_masks_unused_bits);
+    RUN_TEST(test_stream_fills_ppg_ring);
+    RUN_TEST(test_decode_throughput);
+#endif
+
+    TEST_EXIT();
+}
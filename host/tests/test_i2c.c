@@ -0,0 +1,475 @@
+/*
+ * test_i2c.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Non-blocking I2C transaction engine: step order and delays, the EM1
+ * requirement, two devices sharing the bus, retries, bus recovery from the
+ * main loop, falling back to slower speeds, and blocking transfers that
+ * have to wait for the engine. Also prints the EM0 time of one heart sensor
+ * reading on the engine and with blocking transfers.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sim.h"
+#include "src/i2c.h"
+#include "src/event_queue.h"
+#include "src/heart_sensor.h"
+#include "src/sensor_hub.h"
+#include "src/irq.h"
+#include "src/oscillators.h"
+#include "src/timers.h"
+
+#include "em_core.h"
+#include "em_emu.h"
+#include "sl_udelay.h"
+
+#define MAX_ACCESSES 64
+
+// one transfer as a device saw it
+typedef struct {
+    uint16_t addr;
+    bool read;
+    uint16_t len;
+    sim_time_t when;
+    uint32_t em1; // EM1 requirements held during the transfer
+} access_t;
+
+static access_t accesses[MAX_ACCESSES];
+static uint32_t num_accesses = 0;
+
+// called from inside the next transfer, stands in for an interrupt that comes during it
+static void (*during_next_transfer)(void) = 0;
+
+static I2C_TransferReturn_TypeDef record(sim_i2c_device_t* d, bool read, uint16_t len) {
+    if (during_next_transfer != 0) {
+        void (*action)(void) = during_next_transfer;
+        during_next_transfer = 0;
+        action();
+    }
+    if (num_accesses < MAX_ACCESSES) {
+        access_t* a = &accesses[num_accesses];
+        a->addr = d->addr;
+        a->read = read;
+        a->len = len;
+        a->when = sim_now();
+        a->em1 = sim_em_requirement(SL_POWER_MANAGER_EM1);
+    }
+    num_accesses++;
+    return i2cTransferDone;
+}
+
+static I2C_TransferReturn_TypeDef dev_write(sim_i2c_device_t* d, const uint8_t* data, uint16_t len) {
+    (void) data;
+    return record(d, false, len);
+}
+
+// reads return the address followed by a count, so buffers show which device filled them
+static I2C_TransferReturn_TypeDef dev_read(sim_i2c_device_t* d, uint8_t* data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        data[i] = (i == 0) ? d->addr : i;
+    }
+    return record(d, true, len);
+}
+
+static sim_i2c_device_t hub = { .name = "test hub", .addr = 0xAA, .write = dev_write, .read = dev_read };
+static sim_i2c_device_t si7021 = { .name = "test si7021", .addr = 0x80, .write = dev_write, .read = dev_read };
+
+static uint8_t cmd[2] = { 0x12, 0x34 };
+static uint8_t resp[8];
+static uint8_t resp2[8];
+
+// private helper, runs the work items interrupts deferred, what the main loop would do
+static uint32_t run_deferred(void) {
+    app_event_t e;
+    uint32_t n = 0;
+
+    while (!event_queue_read(&e)) {
+        if (e.work != 0) {
+            e.work(e.payload);
+            n++;
+        }
+    }
+    return n;
+}
+
+// private helper, lets the engine run until a device's transaction is done
+static void wait_done(i2c_dev_t dev) {
+    for (uint32_t i = 0; (i < 100000) && i2c_transaction_busy(dev); i++) {
+        sim_advance(SIM_US(10));
+        run_deferred();
+    }
+    CHECK(!i2c_transaction_busy(dev));
+}
+
+static void start(void) {
+    wait_done(I2C_DEV_MAX32664);
+    wait_done(I2C_DEV_SI7021);
+    run_deferred();
+    num_accesses = 0;
+    memset(resp, 0, sizeof(resp));
+    memset(resp2, 0, sizeof(resp2));
+}
+
+// private helper, one write-delay-read command on a device
+static void queue_command(i2c_dev_t dev, uint32_t delay_us, uint8_t* buf) {
+    i2c_queue_write(dev, cmd, sizeof(cmd));
+    i2c_queue_delay(dev, delay_us);
+    i2c_queue_read(dev, buf, 4);
+}
+
+static void test_steps_in_order(void) {
+    start();
+
+    queue_command(I2C_DEV_MAX32664, 2000, resp);
+    i2c_queue_write(I2C_DEV_MAX32664, cmd, 1);
+    sim_time_t t0 = sim_now();
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    CHECK(i2c_transaction_busy(I2C_DEV_MAX32664));
+    CHECK(i2c_bus_busy());
+
+    wait_done(I2C_DEV_MAX32664);
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_MAX32664), i2cTransferDone);
+    CHECK(!i2c_bus_busy());
+
+    CHECK_EQ(num_accesses, 3);
+    CHECK(!accesses[0].read);
+    CHECK_EQ(accesses[0].len, 2);
+    CHECK(accesses[1].read);
+    CHECK_EQ(accesses[1].len, 4);
+    CHECK(!accesses[2].read);
+    CHECK_EQ(accesses[2].len, 1);
+    CHECK(accesses[0].when - t0 < SIM_US(500));
+
+    // the delay is a minimum, late by no more than a LETIMER tick or two
+    sim_time_t gap = accesses[1].when - accesses[0].when;
+    CHECK(gap >= SIM_US(2000));
+    CHECK(gap <= SIM_US(2000) + SIM_US(3 * 1000000 / clock_freq_hz) + SIM_US(200));
+
+    CHECK_EQ(resp[0], 0xAA);
+    CHECK_EQ(resp[3], 3);
+}
+
+static void test_em1_only_for_transfers(void) {
+    start();
+
+    uint32_t em2_before = sim_em2_during_transfer();
+    queue_command(I2C_DEV_MAX32664, 5000, resp);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+
+    // transfers keep the peripheral clock, the delay between them doesn't
+    sim_advance(SIM_US(2500));
+    CHECK_EQ(num_accesses, 1);
+    CHECK_EQ(sim_em_requirement(SL_POWER_MANAGER_EM1), 0);
+
+    wait_done(I2C_DEV_MAX32664);
+    CHECK_EQ(num_accesses, 2);
+    CHECK_EQ(accesses[0].em1, 1);
+    CHECK_EQ(accesses[1].em1, 1);
+    CHECK_EQ(sim_em_requirement(SL_POWER_MANAGER_EM1), 0);
+    CHECK_EQ(sim_em2_during_transfer(), em2_before);
+}
+
+static void test_devices_share_the_bus(void) {
+    start();
+
+    queue_command(I2C_DEV_MAX32664, 3000, resp);
+    queue_command(I2C_DEV_SI7021, 1000, resp2);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    i2c_start_transaction(I2C_DEV_SI7021);
+
+    // the second waits for the bus, the delays of the first included
+    CHECK(i2c_transaction_busy(I2C_DEV_SI7021));
+    wait_done(I2C_DEV_SI7021);
+    CHECK(!i2c_transaction_busy(I2C_DEV_MAX32664));
+
+    CHECK_EQ(num_accesses, 4);
+    CHECK_EQ(accesses[0].addr, 0xAA);
+    CHECK_EQ(accesses[1].addr, 0xAA);
+    CHECK_EQ(accesses[2].addr, 0x80);
+    CHECK_EQ(accesses[3].addr, 0x80);
+    CHECK_EQ(resp[0], 0xAA);
+    CHECK_EQ(resp2[0], 0x80);
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_SI7021), i2cTransferDone);
+}
+
+static void test_nack_retried(void) {
+    start();
+
+    // two retries are enough
+    queue_command(I2C_DEV_MAX32664, 100, resp);
+    sim_i2c_fail_next(i2cTransferNack, 2);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    wait_done(I2C_DEV_MAX32664);
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_MAX32664), i2cTransferDone);
+    CHECK_EQ(num_accesses, 2);
+    CHECK_EQ(resp[0], 0xAA);
+
+    // a third failure ends the transaction, the steps after it don't run
+    num_accesses = 0;
+    memset(resp, 0, sizeof(resp));
+    queue_command(I2C_DEV_MAX32664, 100, resp);
+    sim_i2c_fail_next(i2cTransferNack, 3);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    wait_done(I2C_DEV_MAX32664);
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_MAX32664), i2cTransferNack);
+    CHECK_EQ(num_accesses, 0);
+    CHECK_EQ(resp[0], 0);
+    CHECK(!i2c_bus_busy());
+
+    // and the next transaction starts clean
+    queue_command(I2C_DEV_MAX32664, 100, resp);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    wait_done(I2C_DEV_MAX32664);
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_MAX32664), i2cTransferDone);
+}
+
+static void test_bus_error_recovered_from_main_loop(void) {
+    start();
+
+    queue_command(I2C_DEV_SI7021, 100, resp2);
+    sim_i2c_fail_next(i2cTransferBusErr, 1);
+    i2c_start_transaction(I2C_DEV_SI7021);
+
+    // the interrupt only hands the recovery over, nothing else happens until the main loop runs it
+    sim_advance(SIM_MS(5));
+    CHECK(i2c_transaction_busy(I2C_DEV_SI7021));
+    CHECK(i2c_bus_busy());
+    CHECK_EQ(num_accesses, 0);
+
+    CHECK(run_deferred() >= 1);
+    wait_done(I2C_DEV_SI7021);
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_SI7021), i2cTransferDone);
+    CHECK_EQ(num_accesses, 2);
+    CHECK_EQ(sim_i2c_stats()->freq, I2C_FREQ_FAST_MAX);
+}
+
+static void test_slower_after_errors(void) {
+    start();
+
+    // three bus errors in a row, the transaction fails and the bus drops to standard mode
+    queue_command(I2C_DEV_MAX32664, 100, resp);
+    sim_i2c_fail_next(i2cTransferBusErr, 3);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    wait_done(I2C_DEV_MAX32664);
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_MAX32664), i2cTransferBusErr);
+    CHECK_EQ(sim_i2c_stats()->freq, I2C_FREQ_STANDARD_MAX);
+
+    // NACKs say nothing about the wiring
+    queue_command(I2C_DEV_MAX32664, 100, resp);
+    sim_i2c_fail_next(i2cTransferNack, 3);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    wait_done(I2C_DEV_MAX32664);
+    CHECK_EQ(sim_i2c_stats()->freq, I2C_FREQ_STANDARD_MAX);
+
+    // a long clean run tries the faster speed again
+    uint32_t transfers = 0;
+    while ((sim_i2c_stats()->freq != I2C_FREQ_FAST_MAX) && (transfers < 2000)) {
+        i2c_queue_write(I2C_DEV_MAX32664, cmd, 1);
+        i2c_start_transaction(I2C_DEV_MAX32664);
+        wait_done(I2C_DEV_MAX32664);
+        transfers++;
+    }
+    CHECK_EQ(sim_i2c_stats()->freq, I2C_FREQ_FAST_MAX);
+    CHECK(transfers >= 990);
+    CHECK(transfers <= 1000);
+}
+
+// private helper, starts a temperature command from "an interrupt"
+static void start_si7021(void) {
+    queue_command(I2C_DEV_SI7021, 100, resp2);
+    i2c_start_transaction(I2C_DEV_SI7021);
+}
+
+static void start_si7021_at(void* context, uint32_t arg) {
+    (void) context;
+    (void) arg;
+    start_si7021();
+}
+
+static void test_blocking_waits_for_engine(void) {
+    start();
+
+    // a command running and another waiting for the bus behind it
+    queue_command(I2C_DEV_MAX32664, 3000, resp);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    sim_at(sim_now() + SIM_MS(1), start_si7021_at, 0, 0);
+
+    // the blocking write goes after both, asleep while it waits
+    uint32_t blocking = sim_i2c_stats()->blocking;
+    sim_time_t t0 = sim_now();
+    sim_time_t em1 = sim_em_time(SL_POWER_MANAGER_EM1);
+    CHECK_EQ(i2c_write(cmd, 2), i2cTransferDone);
+    CHECK_EQ(sim_i2c_stats()->blocking, blocking + 1);
+    CHECK(sim_em_time(SL_POWER_MANAGER_EM1) - em1 >= SIM_US(3000));
+    CHECK(sim_now() - t0 - (sim_em_time(SL_POWER_MANAGER_EM1) - em1) < SIM_US(500));
+    CHECK(!i2c_transaction_busy(I2C_DEV_MAX32664));
+    CHECK(!i2c_transaction_busy(I2C_DEV_SI7021));
+
+    CHECK_EQ(num_accesses, 5);
+    CHECK_EQ(accesses[0].addr, 0xAA);
+    CHECK_EQ(accesses[1].addr, 0xAA);
+    CHECK_EQ(accesses[2].addr, 0x80);
+    CHECK_EQ(accesses[3].addr, 0x80);
+    CHECK_EQ(accesses[4].addr, 0xAA);
+    CHECK(!accesses[4].read);
+    CHECK_EQ(resp2[0], 0x80);
+}
+
+static void test_blocking_runs_pending_recovery(void) {
+    start();
+
+    // the recovery waits for the main loop, which is the one blocked here
+    queue_command(I2C_DEV_SI7021, 100, resp2);
+    sim_i2c_fail_next(i2cTransferBusErr, 1);
+    i2c_start_transaction(I2C_DEV_SI7021);
+    sim_advance(SIM_MS(1));
+    CHECK(i2c_bus_busy());
+
+    CHECK_EQ(i2c_write(cmd, 2), i2cTransferDone);
+    CHECK(!i2c_transaction_busy(I2C_DEV_SI7021));
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_SI7021), i2cTransferDone);
+    CHECK_EQ(num_accesses, 3);
+    CHECK_EQ(accesses[2].addr, 0xAA);
+    run_deferred();
+}
+
+static void test_started_during_blocking_transfer(void) {
+    start();
+
+    // it waits for the blocking transfer to give the bus back, then runs on its own
+    during_next_transfer = start_si7021;
+    CHECK_EQ(i2c_write(cmd, 2), i2cTransferDone);
+    CHECK(i2c_transaction_busy(I2C_DEV_SI7021));
+
+    wait_done(I2C_DEV_SI7021);
+    CHECK_EQ(i2c_transaction_status(I2C_DEV_SI7021), i2cTransferDone);
+    CHECK_EQ(num_accesses, 3);
+    CHECK_EQ(accesses[0].addr, 0xAA);
+    CHECK_EQ(accesses[1].addr, 0x80);
+    CHECK_EQ(accesses[2].addr, 0x80);
+    CHECK_EQ(resp2[0], 0x80);
+}
+
+// a drained batch of MaximFast samples, 6 bytes each after the status byte
+#define FIFO_READ_LEN (1 + (HEART_SENSOR_BATCH_SIZE * 6))
+
+// time asleep in any mode, the rest of the time the core is in EM0
+static sim_time_t asleep(void) {
+    return sim_em_time(SL_POWER_MANAGER_EM1) + sim_em_time(SL_POWER_MANAGER_EM2)
+           + sim_em_time(SL_POWER_MANAGER_EM3);
+}
+
+// private helper, sleeps until a device's transaction is done, waking for each interrupt
+static void sleep_until_done(i2c_dev_t dev) {
+    CORE_DECLARE_IRQ_STATE;
+
+    for (uint32_t i = 0; (i < 1000) && i2c_transaction_busy(dev); i++) {
+        CORE_ENTER_CRITICAL();
+        if (i2c_transaction_busy(dev)) {
+            EMU_EnterEM1();
+        }
+        CORE_EXIT_CRITICAL();
+        run_deferred();
+    }
+    CHECK(!i2c_transaction_busy(dev));
+}
+
+// the reading heart_sensor.c does after MFIO: status and fifo count, then the fifo
+static void engine_reading(void) {
+    static uint8_t status[2];
+    static uint8_t count[2];
+    static uint8_t fifo[FIFO_READ_LEN];
+
+    hub_queue_command(HUB_CMD_READ_STATUS, status, 0);
+    hub_queue_command(HUB_CMD_NUM_SAMPLES, count, 0);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    sleep_until_done(I2C_DEV_MAX32664);
+
+    hub_queue_command(HUB_CMD_READ_FIFO, fifo, sizeof(fifo));
+    i2c_start_transaction(I2C_DEV_MAX32664);
+    sleep_until_done(I2C_DEV_MAX32664);
+}
+
+// private helper, one hub command the way the polled driver did it
+static void blocking_command(hub_cmd_id_t id, uint8_t* resp, uint8_t resp_len) {
+    const hub_cmd_desc_t* desc = hub_get_cmd(id);
+
+    CHECK_EQ(i2c_write((uint8_t*) desc->cmd, desc->cmd_len), i2cTransferDone);
+    sl_udelay_wait(desc->delay_us);
+    CHECK_EQ(i2c_read_addr(resp, resp_len), i2cTransferDone);
+}
+
+// the same reading with blocking transfers and a spinning command delay
+static void blocking_reading(void) {
+    static uint8_t status[2];
+    static uint8_t count[2];
+    static uint8_t fifo[FIFO_READ_LEN];
+
+    blocking_command(HUB_CMD_READ_STATUS, status, sizeof(status));
+    blocking_command(HUB_CMD_NUM_SAMPLES, count, sizeof(count));
+    blocking_command(HUB_CMD_READ_FIFO, fifo, sizeof(fifo));
+}
+
+// private helper, runs a reading and returns its EM0 time, the whole time through took
+static sim_time_t em0_time(void (*reading)(void), sim_time_t* took) {
+    sim_time_t start = sim_now();
+    sim_time_t asleep_start = asleep();
+
+    reading();
+
+    *took = sim_now() - start;
+    return *took - (asleep() - asleep_start);
+}
+
+static void test_em0_per_reading(void) {
+    sim_time_t engine_took;
+    sim_time_t blocking_took;
+
+    start();
+    uint32_t bytes = sim_i2c_stats()->bytes;
+    sim_time_t engine = em0_time(engine_reading, &engine_took);
+    CHECK_EQ(num_accesses, 6);
+    bytes = sim_i2c_stats()->bytes - bytes;
+
+    start();
+    sim_time_t blocking = em0_time(blocking_reading, &blocking_took);
+    CHECK_EQ(num_accesses, 6);
+
+    // the blocking reading is awake for all of it, the engine only to set up each step
+    CHECK(blocking == blocking_took);
+    CHECK(engine * 10 < blocking);
+
+    // not a check, prints the EM0 time of one reading
+    fprintf(stderr, "    reading of %u bytes, EM0 time: engine %.1f us of %.1f us, blocking %.1f us of %.1f us\n",
+            (unsigned int) bytes, engine / 1e3, engine_took / 1e3, blocking / 1e3, blocking_took / 1e3);
+}
+
+int main(void) {
+    sim_log_quiet(true);
+    init_oscillators();
+    init_timer();
+    init_event_queue();
+    init_i2c();
+    NVIC_EnableIRQ(LETIMER0_IRQn);
+    sim_advance(SIM_MS(10));
+
+    sim_i2c_attach(&hub);
+    sim_i2c_attach(&si7021);
+
+    RUN_TEST(test_steps_in_order);
+    RUN_TEST(test_em1_only_for_transfers);
+    RUN_TEST(test_devices_share_the_bus);
+    RUN_TEST(test_nack_retried);
+    RUN_TEST(test_bus_error_recovered_from_main_loop);
+    RUN_TEST(test_slower_after_errors);
+    RUN_TEST(test_blocking_waits_for_engine);
+    RUN_TEST(test_blocking_runs_pending_recovery);
+    RUN_TEST(test_started_during_blocking_transfer);
+    RUN_TEST(test_em0_per_reading);
+
+    TEST_EXIT();
+}
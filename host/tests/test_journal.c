@@ -0,0 +1,186 @@
+/*
+ * test_journal.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Journal records written through the ring and read back with the decoder,
+ * the same path heart_replay takes.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "sim.h"
+#include "src/journal.h"
+#include "src/irq.h"
+#include "src/oscillators.h"
+#include "src/timers.h"
+
+static uint8_t copy[JOURNAL_SIZE];
+
+// private helper, copies the journal out and decodes every record
+static uint32_t read_all(journal_record_t* out, uint32_t max, size_t* len) {
+    journal_reader_t r;
+    uint32_t n = 0;
+
+    *len = journal_copy(copy, sizeof(copy));
+    journal_reader_init(&r, copy, *len);
+    while ((n < max) && journal_next(&r, &out[n])) {
+        n++;
+    }
+    return n;
+}
+
+static uint32_t app_payload(const journal_record_t* rec) {
+    const uint8_t* p = rec->payload;
+    return p[2] | (p[3] << 8) | (p[4] << 16) | ((uint32_t) p[5] << 24);
+}
+
+// fills the ring so earlier tests leave nothing behind, every record is an app event
+static void fill_with_app_events(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        journal_app_event(JOURNAL_TARGET_MAIN, 1, i);
+    }
+}
+
+static void test_round_trip(void) {
+    static const uint8_t bytes[3] = { 0x11, 0x22, 0x33 };
+    journal_record_t rec[JOURNAL_SIZE / JOURNAL_HEADER_SIZE];
+    sl_bt_msg_t evt;
+    size_t len;
+
+    fill_with_app_events(JOURNAL_SIZE / 12);
+
+    uint32_t t0 = (uint32_t) letimerMicroseconds();
+    journal_app_event(3, 7, 0x12345678);
+    sim_advance(SIM_MS(1));
+    journal_i2c_read(1, bytes, sizeof(bytes));
+    sim_advance(SIM_MS(1));
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header = sl_bt_evt_system_soft_timer_id | (sizeof(evt.data.evt_system_soft_timer) << 8);
+    evt.data.evt_system_soft_timer.handle = 2;
+    JOURNAL_BT(&evt);
+
+    uint32_t n = read_all(rec, sizeof(rec) / sizeof(rec[0]), &len);
+    CHECK(n >= 3);
+    journal_record_t* app = &rec[n - 3];
+    journal_record_t* i2c = &rec[n - 2];
+    journal_record_t* bt = &rec[n - 1];
+
+    CHECK_EQ(app->type, JOURNAL_APP_EVENT);
+    CHECK_EQ(app->len, 6);
+    CHECK_EQ(app->payload[0], 3);
+    CHECK_EQ(app->payload[1], 7);
+    CHECK_EQ(app_payload(app), 0x12345678);
+
+    CHECK_EQ(i2c->type, JOURNAL_I2C_READ);
+    CHECK_EQ(i2c->len, 4);
+    CHECK_EQ(i2c->payload[0], 1);
+    CHECK(memcmp(&i2c->payload[1], bytes, sizeof(bytes)) == 0);
+
+    CHECK_EQ(bt->type, JOURNAL_BT_EVENT);
+    CHECK_EQ(bt->len, 4 + sizeof(evt.data.evt_system_soft_timer));
+    CHECK_EQ(bt->payload[0] | (bt->payload[1] << 8) | (bt->payload[2] << 16) | ((uint32_t) bt->payload[3] << 24),
+             evt.header);
+    CHECK_EQ(bt->payload[4], 2);
+
+    // microseconds since startup, to the resolution of a LETIMER tick
+    uint32_t tick_us = 1000000 / clock_freq_hz + 1;
+    CHECK(app->timestamp - t0 <= tick_us);
+    CHECK(i2c->timestamp - app->timestamp >= 1000 - tick_us);
+    CHECK(i2c->timestamp - app->timestamp <= 1000 + tick_us);
+    CHECK(bt->timestamp - i2c->timestamp >= 1000 - tick_us);
+}
+
+static void test_payload_cut_at_max(void) {
+    uint8_t bytes[300];
+    journal_record_t rec[JOURNAL_SIZE / JOURNAL_HEADER_SIZE];
+    size_t len;
+
+    for (int i = 0; i < (int) sizeof(bytes); i++) {
+        bytes[i] = i;
+    }
+    journal_i2c_read(0, bytes, sizeof(bytes));
+
+    uint32_t n = read_all(rec, sizeof(rec) / sizeof(rec[0]), &len);
+    CHECK(n >= 1);
+    CHECK_EQ(rec[n - 1].type, JOURNAL_I2C_READ);
+    CHECK_EQ(rec[n - 1].len, JOURNAL_MAX_PAYLOAD);
+    CHECK_EQ(rec[n - 1].payload[0], 0);
+    CHECK(memcmp(&rec[n - 1].payload[1], bytes, JOURNAL_MAX_PAYLOAD - 1) == 0);
+}
+
+static void test_ring_drops_oldest(void) {
+    journal_record_t rec[JOURNAL_SIZE / JOURNAL_HEADER_SIZE];
+    size_t len;
+
+    // twelve bytes each, several times the ring
+    fill_with_app_events(4 * JOURNAL_SIZE / 12);
+
+    uint32_t n = read_all(rec, sizeof(rec) / sizeof(rec[0]), &len);
+    CHECK_EQ(n, JOURNAL_SIZE / 12);
+    CHECK_EQ(len, n * 12);
+    CHECK_EQ(app_payload(&rec[n - 1]), (4 * JOURNAL_SIZE / 12) - 1);
+    for (uint32_t i = 1; i < n; i++) {
+        CHECK_EQ(app_payload(&rec[i]), app_payload(&rec[i - 1]) + 1);
+    }
+}
+
+static void test_copy_keeps_whole_records(void) {
+    uint8_t small[100];
+    journal_reader_t r;
+    journal_record_t rec;
+    uint32_t n = 0;
+
+    fill_with_app_events(JOURNAL_SIZE / 12);
+
+    size_t len = journal_copy(small, sizeof(small));
+    CHECK_EQ(len, 96);
+
+    journal_reader_init(&r, small, len);
+    while (journal_next(&r, &rec)) {
+        n++;
+    }
+    CHECK_EQ(n, 8);
+    CHECK_EQ(r.pos, len);
+}
+
+static void test_reader_stops_at_cut_record(void) {
+    static const uint8_t records[] = {
+        JOURNAL_APP_EVENT, 6, 0x10, 0, 0, 0, 0xFF, 4, 1, 0, 0, 0,
+        JOURNAL_I2C_READ, 3, 0x20, 0, 0, 0, 1, 0xAB
+    };
+    journal_reader_t r;
+    journal_record_t rec;
+
+    journal_reader_init(&r, records, sizeof(records));
+    CHECK(journal_next(&r, &rec));
+    CHECK_EQ(rec.type, JOURNAL_APP_EVENT);
+    CHECK_EQ(rec.timestamp, 0x10);
+    CHECK_EQ(app_payload(&rec), 1);
+
+    // the second record says three bytes of payload, two are there
+    CHECK(!journal_next(&r, &rec));
+    CHECK_EQ(r.pos, 12);
+
+    // a header cut short
+    journal_reader_init(&r, records, 4);
+    CHECK(!journal_next(&r, &rec));
+}
+
+int main(void) {
+    sim_log_quiet(true);
+    init_oscillators();
+    init_timer();
+    sim_advance(SIM_MS(10));
+
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_payload_cut_at_max);
+    RUN_TEST(test_ring_drops_oldest);
+    RUN_TEST(test_copy_keeps_whole_records);
+    RUN_TEST(test_reader_stops_at_cut_record);
+
+    TEST_EXIT();
+}
@@ -0,0 +1,138 @@
+/*
+ * test_letimer_time.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * The 64-bit time base in irq.c: exact tick counts on both sides of each
+ * LETIMER reload, reloads that happen while interrupts are masked, and
+ * running long enough to pass 32-bit microseconds and 32-bit ticks.
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "src/irq.h"
+#include "src/oscillators.h"
+#include "src/timers.h"
+
+// virtual time of LETIMER tick 0, set by init_timer()
+static sim_time_t enable_time;
+
+// private helper, ticks since tick 0 at t
+static uint64_t ticks_at(sim_time_t t) {
+    return (uint64_t) (((unsigned __int128) (t - enable_time) * clock_freq_hz) / 1000000000ULL);
+}
+
+// private helper, virtual time of a tick, rounded up so ticks_at() of it is the tick
+static sim_time_t tick_time(uint64_t n) {
+    return enable_time + (sim_time_t) ((((unsigned __int128) n * 1000000000ULL) + clock_freq_hz - 1) / clock_freq_hz);
+}
+
+// private helper, time of the k-th reload, the first tick reloads and so does every period after it
+static sim_time_t reload_time(uint64_t k) {
+    return tick_time(1 + (k * ((uint64_t) timer_max_ticks + 1)));
+}
+
+// private helper, what letimerTicks() should say now, the count starts a period in
+static uint64_t expected_ticks(void) {
+    return ticks_at(sim_now()) + timer_max_ticks;
+}
+
+static void test_starts_one_period_in(void) {
+    CHECK_EQ(letimerTicks(), timer_max_ticks);
+    CHECK_EQ(letimerTicks(), expected_ticks());
+}
+
+static void test_exact_around_reloads(void) {
+    uint64_t last = letimerTicks();
+    uint64_t last_us = letimerMicroseconds();
+
+    // a few ticks either side of each reload, in steps that land on every part of a tick
+    for (uint64_t k = 1; k <= 20; k++) {
+        sim_time_t reload = reload_time(k);
+
+        for (sim_time_t t = reload - SIM_US(500); t <= reload + SIM_US(500); t += 37) {
+            if (t < sim_now()) {
+                continue;
+            }
+            sim_advance_to(t);
+
+            uint64_t ticks = letimerTicks();
+            CHECK_EQ(ticks, expected_ticks());
+            CHECK(ticks >= last);
+            last = ticks;
+
+            uint64_t us = letimerMicroseconds();
+            CHECK(us >= last_us);
+            last_us = us;
+        }
+    }
+}
+
+static void test_reload_with_interrupts_masked(void) {
+    for (uint64_t k = 30; k <= 40; k++) {
+        sim_time_t reload = reload_time(k);
+
+        // a caller inside a critical section or a higher priority handler
+        sim_advance_to(reload - SIM_US(200) - (k * 29));
+        __disable_irq();
+        uint32_t underflow_irqs = sim_irq_count(LETIMER0_IRQn);
+        uint64_t before = letimerTicks();
+        CHECK_EQ(before, expected_ticks());
+
+        sim_advance_to(reload + SIM_US(50) + (k * 29));
+
+        // the underflow is pending and not counted yet
+        CHECK_EQ(sim_irq_count(LETIMER0_IRQn), underflow_irqs);
+        uint64_t masked = letimerTicks();
+        CHECK_EQ(masked, expected_ticks());
+        CHECK(masked > before);
+
+        // and counted once when the handler gets to run
+        __enable_irq();
+        CHECK_EQ(sim_irq_count(LETIMER0_IRQn), underflow_irqs + 1);
+        CHECK_EQ(letimerTicks(), expected_ticks());
+        CHECK(letimerTicks() >= masked);
+    }
+}
+
+static void test_past_32_bits(void) {
+    // 2^32 us is 72 minutes, 2^32 ticks at 8192 Hz is a little over 6 days
+    sim_advance(SIM_S(7 * 24 * 3600));
+
+    uint64_t ticks = letimerTicks();
+    CHECK_EQ(ticks, expected_ticks());
+    CHECK(ticks > UINT32_MAX);
+
+    // to the resolution of a tick, from the Q12 microseconds per tick
+    uint64_t expected_us = (ticks * 1000000) / clock_freq_hz;
+    uint64_t us = letimerMicroseconds();
+    CHECK(us > UINT32_MAX);
+    CHECK(us + 2 >= expected_us);
+    CHECK(us <= expected_us + 2);
+    CHECK_EQ(letimerMilliseconds(), (uint32_t) (us / 1000));
+
+    // and still exact around a reload that far out
+    uint64_t k = (ticks_at(sim_now()) / ((uint64_t) timer_max_ticks + 1)) + 1;
+    sim_time_t reload = reload_time(k);
+    for (sim_time_t t = reload - SIM_US(300); t <= reload + SIM_US(300); t += 53) {
+        sim_advance_to(t);
+        CHECK_EQ(letimerTicks(), expected_ticks());
+    }
+}
+
+int main(void) {
+    sim_log_quiet(true);
+    init_oscillators();
+
+    enable_time = sim_now();
+    init_timer();
+    NVIC_EnableIRQ(LETIMER0_IRQn);
+
+    RUN_TEST(test_starts_one_period_in);
+    RUN_TEST(test_exact_around_reloads);
+    RUN_TEST(test_reload_with_interrupts_masked);
+    RUN_TEST(test_past_32_bits);
+
+    TEST_EXIT();
+}
@@ -0,0 +1,450 @@
+/*
+ * test_ppg_estimator.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * PPG estimator on synthetic red / IR counts: heart rate over the range the
+ * hub reports, SpO2 from the ratio of ratios, RR intervals, confidence, and
+ * what happens when the finger comes off or the pulse goes away.
+ *
+ * A replay of the trace in tests/data/ppg_trace.txt checks the estimate
+ * against the trace's reference heart rate and SpO2 and prints the time the
+ * estimator takes per sample.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "test.h"
+#include "src/ppg_estimator.h"
+
+// time stamp counter for the cycles per sample, where the host has one
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define host_cycles() __rdtsc()
+#else
+#define host_cycles() 0
+#endif
+
+// a finger on the sensor, counts the MAX30101 gives at the hub's LED currents
+#define DC_IR  100000
+#define DC_RED 80000
+
+// IR pulse amplitude, 1% perfusion
+#define AC_IR 1000
+
+typedef struct {
+    double bpm;
+    double r; // ratio of ratios, SpO2 = 110 - 25 * R
+    uint32_t dc_ir; // 0 for DC_IR, red scales with it
+    uint32_t noise; // peak to peak counts on both channels
+    bool dicrotic; // second, smaller peak after each beat
+} ppg_signal_t;
+
+static double phase = 0;
+static uint32_t noise_state = 1;
+
+// one beat, 0 to 1: a fast systolic upstroke then an exponential runoff
+static double pulse_shape(double x, bool dicrotic) {
+    double notch = dicrotic ? 0.25 * exp(-pow((x - 0.5) / 0.05, 2)) : 0;
+
+    if (x < 0.15) {
+        return x / 0.15;
+    }
+    return exp(-(x - 0.15) * 5) + notch;
+}
+
+static int32_t noise(uint32_t peak_to_peak) {
+    if (peak_to_peak == 0) {
+        return 0;
+    }
+    noise_state = noise_state * 1103515245 + 12345;
+    return (int32_t) ((noise_state >> 16) % peak_to_peak) - (int32_t) (peak_to_peak / 2);
+}
+
+// private helper, feeds seconds of signal and keeps the phase across calls
+static void feed(const ppg_signal_t* s, double seconds) {
+    double dc_ir = s->dc_ir ? s->dc_ir : DC_IR;
+    double dc_red = s->dc_ir ? (s->dc_ir * DC_RED) / DC_IR : DC_RED;
+    double ac_red = s->r * AC_IR * dc_red / dc_ir;
+    uint32_t n = (uint32_t) (seconds * PPG_SAMPLE_RATE_HZ);
+
+    for (uint32_t i = 0; i < n; i++) {
+        double y = pulse_shape(phase, s->dicrotic);
+
+        // blood absorbs light, the counts dip with each beat
+        uint32_t ir = (uint32_t) (dc_ir - (AC_IR * y) + noise(s->noise));
+        uint32_t red = (uint32_t) (dc_red - (ac_red * y) + noise(s->noise));
+        ppg_estimator_add_sample(red, ir);
+
+        phase += s->bpm / 60.0 / PPG_SAMPLE_RATE_HZ;
+        if (phase >= 1) {
+            phase -= 1;
+        }
+    }
+}
+
+static void drain_rr(void) {
+    uint16_t rr;
+    while (!ppg_estimator_read_rr(&rr));
+}
+
+static void start(void) {
+    ppg_estimator_reset();
+    drain_rr();
+    phase = 0;
+    noise_state = 1;
+}
+
+static void test_no_finger(void) {
+    heart_sensor_data est;
+    ppg_signal_t s = { .bpm = 70, .r = 0.5, .dc_ir = 2000 };
+
+    start();
+    feed(&s, 10);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.finger_status, NOTHING_DETECTED);
+    CHECK_EQ(est.heart_rate, 0);
+    CHECK_EQ(est.confidence, 0);
+}
+
+static void test_heart_rate_range(void) {
+    static const double rates[] = { 40, 60, 75, 100, 140, 180 };
+    heart_sensor_data est;
+
+    for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        ppg_signal_t s = { .bpm = rates[i], .r = 0.5 };
+
+        start();
+        feed(&s, 15);
+        ppg_estimator_get(&est);
+
+        // intervals are whole samples, 10 ms
+        double tolerance = 1 + rates[i] * rates[i] / (60.0 * PPG_SAMPLE_RATE_HZ);
+        CHECK_EQ(est.finger_status, FINGER_DETECTED);
+        CHECK(fabs(est.heart_rate - rates[i]) <= tolerance);
+        CHECK_EQ(est.confidence, 100);
+        if (fabs(est.heart_rate - rates[i]) > tolerance) {
+            fprintf(stderr, "    %.0f bpm estimated as %u\n", rates[i], est.heart_rate);
+        }
+    }
+}
+
+static void test_spo2_from_ratio(void) {
+    static const double ratios[] = { 0.5, 0.7, 1.0 };
+    heart_sensor_data est;
+
+    for (uint32_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++) {
+        ppg_signal_t s = { .bpm = 72, .r = ratios[i] };
+
+        start();
+        feed(&s, 20);
+        ppg_estimator_get(&est);
+
+        double expected = 110 - 25 * ratios[i];
+        CHECK(fabs(est.blood_oxygen - expected) <= 2);
+        if (fabs(est.blood_oxygen - expected) > 2) {
+            fprintf(stderr, "    R %.1f estimated as %u%%\n", ratios[i], est.blood_oxygen);
+        }
+    }
+}
+
+static void test_rr_intervals(void) {
+    ppg_signal_t s = { .bpm = 75, .r = 0.5 };
+    uint16_t rr;
+    uint32_t count = 0;
+
+    start();
+
+    // short enough that the ring doesn't fill, about a dozen beats
+    feed(&s, 10);
+    while (!ppg_estimator_read_rr(&rr)) {
+        // 0.8 s is 819 / 1024 s, give or take a sample
+        CHECK(rr >= 819 - 11);
+        CHECK(rr <= 819 + 11);
+        count++;
+    }
+
+    // the first beat only starts the first interval
+    CHECK(count >= 9);
+    CHECK(count <= 12);
+    CHECK(ppg_estimator_read_rr(&rr));
+}
+
+static void test_rr_ring_full_keeps_oldest(void) {
+    ppg_signal_t s = { .bpm = 120, .r = 0.5 };
+    uint16_t rr;
+    uint32_t count = 0;
+
+    start();
+    feed(&s, 30);
+    while (!ppg_estimator_read_rr(&rr)) {
+        count++;
+    }
+    CHECK_EQ(count, RR_RING_DEPTH - 1);
+}
+
+static void test_irregular_beat_lowers_confidence(void) {
+    ppg_signal_t s = { .bpm = 70, .r = 0.5 };
+    heart_sensor_data est;
+
+    start();
+    feed(&s, 10);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.confidence, 100);
+
+    // holds start in diastole, whole beats in between keep them there
+    // one beat 15% late is within the variation a resting pulse has
+    s.bpm = 0;
+    feed(&s, 0.15 * 60 / 70);
+    s.bpm = 70;
+    feed(&s, 2 * 60 / 70);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.confidence, 100);
+
+    // one beat 40% late, the signal holds in between
+    s.bpm = 0;
+    feed(&s, 0.4 * 60 / 70);
+    s.bpm = 70;
+    feed(&s, 2 * 60 / 70);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.confidence, 0);
+
+    // and back up once the rhythm is regular again
+    feed(&s, 10);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.confidence, 100);
+    CHECK(fabs(est.heart_rate - 70) <= 2);
+}
+
+static void test_noise(void) {
+    ppg_signal_t s = { .bpm = 65, .r = 0.6, .noise = 100 };
+    heart_sensor_data est;
+
+    start();
+    feed(&s, 20);
+    ppg_estimator_get(&est);
+    CHECK(fabs(est.heart_rate - 65) <= 3);
+    CHECK(fabs(est.blood_oxygen - 95) <= 3);
+}
+
+static void test_dicrotic_notch_is_no_beat(void) {
+    ppg_signal_t s = { .bpm = 50, .r = 0.5, .dicrotic = true };
+    heart_sensor_data est;
+
+    // slow enough that the second peak is outside the 200 bpm limit, only the threshold stops it
+    start();
+    feed(&s, 20);
+    ppg_estimator_get(&est);
+    CHECK(fabs(est.heart_rate - 50) <= 2);
+    CHECK_EQ(est.confidence, 100);
+}
+
+static void test_finger_removed(void) {
+    ppg_signal_t s = { .bpm = 80, .r = 0.5 };
+    heart_sensor_data est;
+
+    start();
+    feed(&s, 10);
+    ppg_estimator_get(&est);
+    CHECK(est.heart_rate != 0);
+
+    // the DC tracker takes a few seconds to fall below the threshold
+    s.dc_ir = 500;
+    feed(&s, 5);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.finger_status, NOTHING_DETECTED);
+    CHECK_EQ(est.heart_rate, 0);
+    CHECK_EQ(est.confidence, 0);
+
+    // and back on, the DC tracker climbs back over about 12 s before beats count again
+    s.dc_ir = 0;
+    feed(&s, 20);
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.finger_status, FINGER_DETECTED);
+    CHECK(fabs(est.heart_rate - 80) <= 2);
+}
+
+static void test_pulse_lost(void) {
+    ppg_signal_t s = { .bpm = 80, .r = 0.5 };
+    heart_sensor_data est;
+
+    start();
+    feed(&s, 10);
+
+    // a finger with no pulse on it, the old rate must not stick
+    for (uint32_t i = 0; i < 5 * PPG_SAMPLE_RATE_HZ; i++) {
+        ppg_estimator_add_sample(DC_RED, DC_IR);
+    }
+    ppg_estimator_get(&est);
+    CHECK_EQ(est.finger_status, FINGER_DETECTED);
+    CHECK_EQ(est.heart_rate, 0);
+    CHECK_EQ(est.confidence, 0);
+}
+
+// a trace to replay, the samples and the reference values along it
+#define MAX_TRACE_SAMPLES 20000
+#define MAX_TRACE_REFS 400
+
+static struct {
+    uint32_t ir[MAX_TRACE_SAMPLES];
+    uint32_t red[MAX_TRACE_SAMPLES];
+    uint32_t num_samples;
+    struct {
+        uint32_t sample; // checked before this sample goes in
+        double heart_rate;
+        double blood_oxygen;
+    } refs[MAX_TRACE_REFS];
+    uint32_t num_refs;
+    uint32_t artifact_first; // motion, 0 and 0 for none
+    uint32_t artifact_last;
+} trace;
+
+// private helper, reads a trace file, see the comment at the top of tests/data/ppg_trace.txt
+static bool load_trace(const char* path) {
+    char line[128];
+    FILE* f = fopen(path, "r");
+
+    if (f == 0) {
+        perror(path);
+        return false;
+    }
+    memset(&trace, 0, sizeof(trace));
+    while (fgets(line, sizeof(line), f) != 0) {
+        unsigned int a;
+        unsigned int b;
+        double hr;
+        double spo2;
+
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "artifact %u %u", &a, &b) == 2) {
+            trace.artifact_first = a;
+            trace.artifact_last = b;
+        }
+        else if (sscanf(line, "ref %u %lf %lf", &a, &hr, &spo2) == 3) {
+            if (trace.num_refs < MAX_TRACE_REFS) {
+                trace.refs[trace.num_refs].sample = a;
+                trace.refs[trace.num_refs].heart_rate = hr;
+                trace.refs[trace.num_refs].blood_oxygen = spo2;
+                trace.num_refs++;
+            }
+        }
+        else if ((sscanf(line, "%u %u", &a, &b) == 2) && (trace.num_samples < MAX_TRACE_SAMPLES)) {
+            trace.ir[trace.num_samples] = a;
+            trace.red[trace.num_samples] = b;
+            trace.num_samples++;
+        }
+    }
+    fclose(f);
+    return (trace.num_samples > 0) && (trace.num_refs > 0);
+}
+
+// private helper, host time now in ns
+static uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void test_replay_trace(void) {
+    heart_sensor_data est;
+    const uint32_t settle = 10 * PPG_SAMPLE_RATE_HZ;
+    double hr_error_sum = 0;
+    double hr_error_max = 0;
+    double spo2_error_sum = 0;
+    double spo2_error_max = 0;
+    uint32_t references = 0;
+    uint32_t published = 0;
+    uint32_t off_beat = 0;
+    uint32_t r = 0;
+
+    CHECK(load_trace(TEST_DATA_DIR "/ppg_trace.txt"));
+    if (trace.num_samples == 0) {
+        return;
+    }
+
+    // the estimate at each reference point once the filters and the beat average settle,
+    // scored when its confidence is high enough for the firmware to publish it
+    start();
+    for (uint32_t i = 0; i < trace.num_samples; i++) {
+        for (; (r < trace.num_refs) && (trace.refs[r].sample == i); r++) {
+            if (i < settle) {
+                continue;
+            }
+            references++;
+            ppg_estimator_get(&est);
+
+            // a beat missed or counted twice shows as 10 bpm or more, the motion and
+            // the 10 s the beat average needs to recover from it aside
+            if ((i < trace.artifact_first) || (i > trace.artifact_last + settle)) {
+                off_beat += (fabs(est.heart_rate - trace.refs[r].heart_rate) > 10) ? 1 : 0;
+            }
+            if (est.confidence <= CONFIDENCE_THRESHOLD) {
+                continue;
+            }
+            double hr_error = fabs(est.heart_rate - trace.refs[r].heart_rate);
+            double spo2_error = fabs(est.blood_oxygen - trace.refs[r].blood_oxygen);
+            hr_error_sum += hr_error;
+            spo2_error_sum += spo2_error;
+            hr_error_max = (hr_error > hr_error_max) ? hr_error : hr_error_max;
+            spo2_error_max = (spo2_error > spo2_error_max) ? spo2_error : spo2_error_max;
+            published++;
+        }
+        ppg_estimator_add_sample(trace.red[i], trace.ir[i]);
+    }
+
+    // most of the trace gives a reading, the motion and the fastest changes may not
+    CHECK(published * 2 >= references);
+
+    // an occasional missed beat, not one every few seconds
+    CHECK(off_beat <= 2);
+    if (published == 0) {
+        return;
+    }
+    double hr_error_mean = hr_error_sum / published;
+    double spo2_error_mean = spo2_error_sum / published;
+    CHECK(hr_error_mean <= 3);
+    CHECK(hr_error_max <= 8);
+    CHECK(spo2_error_mean <= 2);
+    CHECK(spo2_error_max <= 4);
+    fprintf(stderr, "    %u of %u references published: HR error mean %.1f max %.1f bpm, "
+            "SpO2 error mean %.1f max %.1f %%\n", (unsigned int) published, (unsigned int) references,
+            hr_error_mean, hr_error_max, spo2_error_mean, spo2_error_max);
+
+    // the whole trace again for the time per sample, nothing else in the loop
+    const uint32_t rounds = 20;
+    uint64_t t0 = host_ns();
+    uint64_t c0 = host_cycles();
+    for (uint32_t k = 0; k < rounds; k++) {
+        ppg_estimator_reset();
+        for (uint32_t i = 0; i < trace.num_samples; i++) {
+            ppg_estimator_add_sample(trace.red[i], trace.ir[i]);
+        }
+    }
+    double per_sample = (double) rounds * trace.num_samples;
+    fprintf(stderr, "    %.1f ns, %.0f host cycles per sample\n",
+            (host_ns() - t0) / per_sample, (host_cycles() - c0) / per_sample);
+    drain_rr();
+}
+
+int main(void) {
+    RUN_TEST(test_no_finger);
+    RUN_TEST(test_heart_rate_range);
+    RUN_TEST(test_spo2_from_ratio);
+    RUN_TEST(test_rr_intervals);
+    RUN_TEST(test_rr_ring_full_keeps_oldest);
+    RUN_TEST(test_irregular_beat_lowers_confidence);
+    RUN_TEST(test_noise);
+    RUN_TEST(test_dicrotic_notch_is_no_beat);
+    RUN_TEST(test_finger_removed);
+    RUN_TEST(test_pulse_lost);
+    RUN_TEST(test_replay_trace);
+
+    TEST_EXIT();
+}
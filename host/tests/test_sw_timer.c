@@ -0,0 +1,435 @@
+/*
+ * test_sw_timer.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Software timers: deadlines, heap order with starts and stops in the
+ * middle, periodic phase, deadlines past the LETIMER period, and the main
+ * loop dispatch list. A benchmark prints the host time of a start, a stop
+ * and an expiry with 1 to 64 timers running.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "test.h"
+#include "sim.h"
+#include "src/sw_timer.h"
+#include "src/event_queue.h"
+#include "src/scheduler.h"
+#include "src/irq.h"
+#include "src/oscillators.h"
+#include "src/timers.h"
+
+#include "em_core.h"
+
+#define TIMERS 16
+
+static sw_timer_t timers[TIMERS];
+static uint32_t fired[4 * TIMERS];
+static uint64_t fired_us[4 * TIMERS];
+static uint32_t fire_count = 0;
+
+// one LETIMER tick, what deadlines are rounded up to
+static uint32_t tick_us;
+
+static void expired(void* context) {
+    uint32_t i = (uint32_t) (uintptr_t) context;
+
+    if (fire_count < sizeof(fired) / sizeof(fired[0])) {
+        fired[fire_count] = i;
+        fired_us[fire_count] = letimerMicroseconds();
+    }
+    fire_count++;
+}
+
+// private helper, stops whatever an earlier test left running and clears the record
+static void reset_timers(uint8_t flags) {
+    app_event_t e;
+
+    for (uint32_t i = 0; i < TIMERS; i++) {
+        sw_timer_stop(&timers[i]);
+        sw_timer_dispatch();
+        timers[i].callback = expired;
+        timers[i].context = (void*) (uintptr_t) i;
+        timers[i].flags = flags;
+    }
+    while (!event_queue_read(&e));
+    fire_count = 0;
+}
+
+static void test_one_shot_deadline(void) {
+    reset_timers(SW_TIMER_FROM_ISR);
+
+    uint64_t start = letimerMicroseconds();
+    CHECK(!sw_timer_start(&timers[0], 25000, 0));
+    CHECK(sw_timer_running(&timers[0]));
+
+    sim_advance(SIM_US(24000));
+    CHECK_EQ(fire_count, 0);
+
+    sim_advance(SIM_US(2000));
+    CHECK_EQ(fire_count, 1);
+    CHECK(fired_us[0] - start >= 25000);
+    CHECK(fired_us[0] - start <= 25000 + 3 * tick_us);
+    CHECK(!sw_timer_running(&timers[0]));
+
+    // one-shot, nothing more
+    sim_advance(SIM_MS(100));
+    CHECK_EQ(fire_count, 1);
+}
+
+static void test_heap_order(void) {
+    // each delay once, in an order that exercises both sift directions
+    static const uint32_t delay_ms[TIMERS] = { 90, 10, 150, 40, 20, 130, 70, 160, 30, 110, 50, 140, 80, 60, 120, 100 };
+
+    reset_timers(SW_TIMER_FROM_ISR);
+
+    for (uint32_t i = 0; i < TIMERS; i++) {
+        CHECK(!sw_timer_start(&timers[i], delay_ms[i] * 1000, 0));
+    }
+
+    sim_advance(SIM_MS(200));
+    CHECK_EQ(fire_count, TIMERS);
+    for (uint32_t i = 1; i < TIMERS; i++) {
+        CHECK(delay_ms[fired[i]] > delay_ms[fired[i - 1]]);
+        CHECK(fired_us[i] > fired_us[i - 1]);
+    }
+}
+
+static void test_stop_and_restart_in_heap(void) {
+    reset_timers(SW_TIMER_FROM_ISR);
+
+    for (uint32_t i = 0; i < TIMERS; i++) {
+        CHECK(!sw_timer_start(&timers[i], (i + 1) * 10000, 0));
+    }
+
+    // the root, a leaf and a few in between
+    sw_timer_stop(&timers[0]);
+    sw_timer_stop(&timers[TIMERS - 1]);
+    sw_timer_stop(&timers[5]);
+    sw_timer_stop(&timers[6]);
+    CHECK(!sw_timer_running(&timers[5]));
+
+    // stopping a stopped timer is harmless
+    sw_timer_stop(&timers[5]);
+
+    // moved from the middle to the front, and from the front to the back
+    CHECK(!sw_timer_start(&timers[9], 5000, 0));
+    CHECK(!sw_timer_start(&timers[1], 300000, 0));
+
+    sim_advance(SIM_MS(400));
+
+    static const uint8_t order[] = { 9, 2, 3, 4, 7, 8, 10, 11, 12, 13, 14, 1 };
+    CHECK_EQ(fire_count, sizeof(order));
+    for (uint32_t i = 0; i < sizeof(order) && i < fire_count; i++) {
+        CHECK_EQ(fired[i], order[i]);
+    }
+}
+
+// xorshift, the same sequence every run
+static uint32_t rand_state = 2463534242u;
+
+static uint32_t next_rand(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static void test_random_starts_and_stops(void) {
+    static uint32_t delay[TIMERS]; // half milliseconds, a few LETIMER ticks
+    static bool running[TIMERS];
+
+    for (uint32_t round = 0; round < 200; round++) {
+        reset_timers(SW_TIMER_FROM_ISR);
+
+        // starts, restarts and stops anywhere in the heap, all from the same time,
+        // op is below 64 so every delay is different and deadline order is delay order
+        for (uint32_t op = 0; op < 3 * TIMERS; op++) {
+            uint32_t i = next_rand() % TIMERS;
+
+            if ((next_rand() % 3) == 0) {
+                sw_timer_stop(&timers[i]);
+                running[i] = false;
+                continue;
+            }
+
+            delay[i] = ((1 + (next_rand() % 16)) * 64) + op;
+            running[i] = true;
+            CHECK(!sw_timer_start(&timers[i], delay[i] * 500, 0));
+        }
+
+        uint32_t expected = 0;
+        for (uint32_t i = 0; i < TIMERS; i++) {
+            expected += running[i];
+        }
+
+        sim_advance(SIM_MS(600));
+        CHECK_EQ(fire_count, expected);
+        for (uint32_t i = 1; i < fire_count && i < expected; i++) {
+            CHECK(delay[fired[i]] > delay[fired[i - 1]]);
+        }
+        for (uint32_t i = 0; i < fire_count && i < expected; i++) {
+            CHECK(running[fired[i]]);
+            running[fired[i]] = false;
+        }
+    }
+}
+
+static void test_periodic_keeps_phase(void) {
+    reset_timers(SW_TIMER_FROM_ISR);
+
+    uint64_t start = letimerMicroseconds();
+    CHECK(!sw_timer_start(&timers[0], 50000, 100000));
+
+    sim_advance(SIM_MS(1020));
+    CHECK_EQ(fire_count, 10);
+    for (uint32_t i = 0; i < 10 && i < fire_count; i++) {
+        // no drift, each expiry is the first deadline plus whole periods, each rounded up to a tick
+        uint64_t due = start + 50000 + (i * 100000);
+        CHECK(fired_us[i] >= due);
+        CHECK(fired_us[i] <= due + ((3 + i) * tick_us));
+    }
+    CHECK(sw_timer_running(&timers[0]));
+
+    sw_timer_stop(&timers[0]);
+    sim_advance(SIM_MS(500));
+    CHECK_EQ(fire_count, 10);
+}
+
+static void test_periodic_late_interrupt_keeps_phase(void) {
+    reset_timers(SW_TIMER_FROM_ISR);
+
+    uint64_t start = letimerMicroseconds();
+    CHECK(!sw_timer_start(&timers[0], 50000, 100000));
+    sim_advance(SIM_MS(60));
+    CHECK_EQ(fire_count, 1);
+
+    // the second expiry is taken 30 ms late
+    NVIC_DisableIRQ(LETIMER0_IRQn);
+    sim_advance(SIM_MS(120));
+    NVIC_EnableIRQ(LETIMER0_IRQn);
+    CHECK_EQ(fire_count, 2);
+
+    // the third is still on the original phase
+    sim_advance(SIM_MS(80));
+    CHECK_EQ(fire_count, 3);
+    CHECK(fired_us[2] - start >= 250000);
+    CHECK(fired_us[2] - start <= 250000 + 5 * tick_us);
+
+    // more than a whole period late starts a new phase instead of firing back to back
+    NVIC_DisableIRQ(LETIMER0_IRQn);
+    sim_advance(SIM_MS(230));
+    uint64_t late = letimerMicroseconds();
+    NVIC_EnableIRQ(LETIMER0_IRQn);
+    CHECK_EQ(fire_count, 4);
+    sim_advance(SIM_MS(90));
+    CHECK_EQ(fire_count, 4);
+    sim_advance(SIM_MS(20));
+    CHECK_EQ(fire_count, 5);
+    CHECK(fired_us[4] - late >= 100000);
+    CHECK(fired_us[4] - late <= 100000 + 3 * tick_us);
+
+    sw_timer_stop(&timers[0]);
+}
+
+static void test_deadline_past_letimer_period(void) {
+    reset_timers(SW_TIMER_FROM_ISR);
+
+    // longer than a LETIMER period, COMP1 can only be set after an underflow or two
+    uint32_t period_us = (uint32_t) (((uint64_t) timer_max_ticks + 1) * 1000000 / clock_freq_hz);
+    uint32_t delay_us = (2 * period_us) + 123000;
+
+    uint64_t start = letimerMicroseconds();
+    CHECK(!sw_timer_start(&timers[0], delay_us, 0));
+    CHECK(!sw_timer_start(&timers[1], 1000, 0));
+
+    sim_advance(SIM_US(delay_us - 2000));
+    CHECK_EQ(fire_count, 1);
+    CHECK_EQ(fired[0], 1);
+
+    sim_advance(SIM_US(4000));
+    CHECK_EQ(fire_count, 2);
+    CHECK_EQ(fired[1], 0);
+    CHECK(fired_us[1] - start >= delay_us);
+    CHECK(fired_us[1] - start <= delay_us + 3 * tick_us);
+}
+
+static void test_main_loop_dispatch(void) {
+    app_event_t e;
+
+    reset_timers(0);
+
+    CHECK(!sw_timer_start(&timers[0], 10000, 0));
+    CHECK(!sw_timer_start(&timers[1], 20000, 0));
+    CHECK(!sw_timer_start(&timers[2], 30000, 0));
+    sim_advance(SIM_MS(40));
+
+    // expired but waiting for the main loop, which was told once per expiry
+    CHECK_EQ(fire_count, 0);
+    CHECK(sw_timer_running(&timers[0]));
+    uint32_t posts = 0;
+    while (!event_queue_read(&e)) {
+        CHECK_EQ(e.event, EVENT_SW_TIMER);
+        posts++;
+    }
+    CHECK(posts >= 1);
+
+    // a stopped timer drops its expiry, a restarted one waits for its new deadline
+    sw_timer_stop(&timers[1]);
+    CHECK(!sw_timer_start(&timers[2], 50000, 0));
+
+    sw_timer_dispatch();
+    CHECK_EQ(fire_count, 1);
+    CHECK_EQ(fired[0], 0);
+    CHECK(!sw_timer_running(&timers[0]));
+
+    sim_advance(SIM_MS(60));
+    sw_timer_dispatch();
+    CHECK_EQ(fire_count, 2);
+    CHECK_EQ(fired[1], 2);
+
+    // nothing left on the list
+    sw_timer_dispatch();
+    CHECK_EQ(fire_count, 2);
+}
+
+static void test_periodic_dispatch_runs_once_per_drain(void) {
+    reset_timers(0);
+
+    // expires twice before the main loop gets to it, linked only once
+    CHECK(!sw_timer_start(&timers[0], 10000, 10000));
+    sim_advance(SIM_MS(25));
+    sw_timer_dispatch();
+    CHECK_EQ(fire_count, 1);
+
+    sim_advance(SIM_MS(10));
+    sw_timer_dispatch();
+    CHECK_EQ(fire_count, 2);
+
+    sw_timer_stop(&timers[0]);
+}
+
+static void test_too_many_timers(void) {
+    static sw_timer_t many[SW_TIMER_MAX + 1];
+
+    reset_timers(SW_TIMER_FROM_ISR);
+
+    for (uint32_t i = 0; i < SW_TIMER_MAX; i++) {
+        many[i].callback = expired;
+        many[i].context = (void*) (uintptr_t) 0;
+        many[i].flags = SW_TIMER_FROM_ISR;
+        CHECK(!sw_timer_start(&many[i], 1000000 + (i * 1000), 0));
+    }
+    many[SW_TIMER_MAX].callback = expired;
+    CHECK(sw_timer_start(&many[SW_TIMER_MAX], 1000, 0));
+    CHECK(!sw_timer_running(&many[SW_TIMER_MAX]));
+    CHECK_EQ(sim_log_errors(), 1);
+
+    // restarting one that is already running needs no new slot
+    CHECK(!sw_timer_start(&many[0], 2000, 0));
+
+    for (uint32_t i = 0; i < SW_TIMER_MAX; i++) {
+        sw_timer_stop(&many[i]);
+    }
+    sim_advance(SIM_MS(1200));
+    CHECK_EQ(fire_count, 0);
+}
+
+// private helper, host time now in ns
+static uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+// not a check apart from the expiries, prints what start, stop and expiry cost with n timers running
+static void test_benchmark_1_to_64_timers(void) {
+    static sw_timer_t bench[SW_TIMER_MAX];
+    const uint32_t rounds = 2000;
+
+    reset_timers(SW_TIMER_FROM_ISR);
+
+    // what every operation pays for its critical section on the host, for reference
+    uint64_t t0 = host_ns();
+    for (uint32_t i = 0; i < rounds * 16; i++) {
+        CORE_DECLARE_IRQ_STATE;
+        CORE_ENTER_CRITICAL();
+        CORE_EXIT_CRITICAL();
+    }
+    fprintf(stderr, "    critical section alone %.0f ns\n", (double) (host_ns() - t0) / (rounds * 16));
+
+    for (uint32_t n = 1; n <= SW_TIMER_MAX; n *= 2) {
+        uint64_t start_ns = 0;
+        uint64_t stop_ns = 0;
+        uint64_t expiry_ns = 0;
+
+        for (uint32_t i = 0; i < n; i++) {
+            bench[i].callback = expired;
+            bench[i].context = (void*) (uintptr_t) 0;
+            bench[i].flags = SW_TIMER_FROM_ISR;
+        }
+        fire_count = 0;
+
+        for (uint32_t r = 0; r < rounds; r++) {
+            // n deadlines a second out in a scrambled order, 37 is odd so i * 37 % n visits every timer
+            t0 = host_ns();
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t k = (i * 37) % n;
+                sw_timer_start(&bench[k], 1000000 + (((k * 13) + r) % 64) * 1000, 0);
+            }
+            start_ns += host_ns() - t0;
+
+            // one of them falls due with the others still running, the handler is held off
+            // so only the expiry is timed
+            uint32_t due = r % n;
+            __disable_irq();
+            sw_timer_start(&bench[due], 0, 0);
+            sim_advance(SIM_US(250));
+            t0 = host_ns();
+            sw_timer_irq();
+            expiry_ns += host_ns() - t0;
+            __enable_irq();
+
+            // all n running again, then stopped in the scrambled order
+            sw_timer_start(&bench[due], 1000000, 0);
+            t0 = host_ns();
+            for (uint32_t i = 0; i < n; i++) {
+                sw_timer_stop(&bench[(i * 37) % n]);
+            }
+            stop_ns += host_ns() - t0;
+        }
+
+        CHECK_EQ(fire_count, rounds);
+        fprintf(stderr, "    %2u timers: start %.0f ns, stop %.0f ns, expiry %.0f ns\n", (unsigned int) n,
+                (double) start_ns / (rounds * n), (double) stop_ns / (rounds * n), (double) expiry_ns / rounds);
+    }
+}
+
+int main(void) {
+    sim_log_quiet(true);
+    init_oscillators();
+    init_timer();
+    init_event_queue();
+    NVIC_EnableIRQ(LETIMER0_IRQn);
+    sim_advance(SIM_MS(10));
+
+    tick_us = 1000000 / clock_freq_hz + 1;
+
+    RUN_TEST(test_one_shot_deadline);
+    RUN_TEST(test_heap_order);
+    RUN_TEST(test_stop_and_restart_in_heap);
+    RUN_TEST(test_random_starts_and_stops);
+    RUN_TEST(test_periodic_keeps_phase);
+    RUN_TEST(test_periodic_late_interrupt_keeps_phase);
+    RUN_TEST(test_deadline_past_letimer_period);
+    RUN_TEST(test_main_loop_dispatch);
+    RUN_TEST(test_periodic_dispatch_runs_once_per_drain);
+    RUN_TEST(test_too_many_timers);
+    RUN_TEST(test_benchmark_1_to_64_timers);
+
+    TEST_EXIT();
+}
@@ -0,0 +1,124 @@
+/*
+ * test_timer_delay.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * timer_delay_us(): short delays spin on the cycle counter to the
+ * microsecond, longer ones sleep in EM1 until their software timer fires,
+ * whatever else interrupts them on the way.
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "src/irq.h"
+#include "src/oscillators.h"
+#include "src/sw_timer.h"
+#include "src/timers.h"
+
+// one LETIMER tick in ns
+#define TICK_NS (1000000000ULL / clock_freq_hz)
+
+// time asleep in any mode
+static sim_time_t slept(void) {
+    return sim_em_time(SL_POWER_MANAGER_EM1) + sim_em_time(SL_POWER_MANAGER_EM2)
+           + sim_em_time(SL_POWER_MANAGER_EM3);
+}
+
+// private helper, runs one delay and says how long it took and how much of it was asleep
+static sim_time_t run_delay(uint32_t us, sim_time_t* asleep) {
+    sim_time_t start = sim_now();
+    sim_time_t sleep_start = slept();
+
+    timer_delay_us(us);
+
+    if (asleep != 0) {
+        *asleep = slept() - sleep_start;
+    }
+    return sim_now() - start;
+}
+
+static void test_short_delays_spin(void) {
+    static const uint32_t delays[] = { 1, 10, 60, 200, 999 };
+    sim_time_t asleep;
+
+    // the old polled wait rounded these down to whole milliseconds, 60 us was no wait at all
+    for (uint32_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        sim_time_t took = run_delay(delays[i], &asleep);
+        CHECK(took >= SIM_US(delays[i]));
+        CHECK(took <= SIM_US(delays[i]) + 200);
+        CHECK_EQ(asleep, 0);
+    }
+
+    sim_time_t took = run_delay(0, &asleep);
+    CHECK(took <= 200);
+}
+
+static void test_long_delays_sleep(void) {
+    static const uint32_t delays[] = { 1000, 1234, 6000, 45000, 250000 };
+    sim_time_t asleep;
+    uint32_t wakeups;
+
+    // to the next tick at most, and asleep for all but the wakeup
+    for (uint32_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        wakeups = sim_wakeups();
+        sim_time_t took = run_delay(delays[i], &asleep);
+        CHECK(took >= SIM_US(delays[i]));
+        CHECK(took <= SIM_US(delays[i]) + (2 * TICK_NS));
+        CHECK(asleep + SIM_US(20) >= took);
+        CHECK_EQ(sim_wakeups() - wakeups, 1);
+    }
+}
+
+static void test_longer_than_letimer_period(void) {
+    // past two underflows, the software timer keeps the 64-bit deadline
+    sim_time_t took = run_delay(12000000, 0);
+    CHECK(took >= SIM_S(12));
+    CHECK(took <= SIM_S(12) + (2 * TICK_NS));
+}
+
+static uint32_t other_fired = 0;
+
+static void other_expired(void* context) {
+    (void) context;
+    other_fired++;
+}
+
+static void interrupt_action(void* context, uint32_t arg) {
+    (void) context;
+    (void) arg;
+    NVIC_SetPendingIRQ(GPIO_EVEN_IRQn);
+}
+
+static void test_other_interrupts_keep_sleeping(void) {
+    static sw_timer_t other = { .callback = other_expired, .flags = SW_TIMER_FROM_ISR };
+    uint32_t wakeups = sim_wakeups();
+
+    // a software timer expiring first and an unrelated interrupt in between
+    sw_timer_start(&other, 2000, 0);
+    sim_at(sim_now() + SIM_MS(5), interrupt_action, 0, 0);
+    NVIC_EnableIRQ(GPIO_EVEN_IRQn);
+
+    sim_time_t took = run_delay(8000, 0);
+    NVIC_DisableIRQ(GPIO_EVEN_IRQn);
+
+    CHECK_EQ(other_fired, 1);
+    CHECK(took >= SIM_US(8000));
+    CHECK(took <= SIM_US(8000) + (2 * TICK_NS));
+    CHECK(sim_wakeups() - wakeups >= 3);
+}
+
+int main(void) {
+    sim_log_quiet(true);
+    init_oscillators();
+    init_timer();
+    NVIC_EnableIRQ(LETIMER0_IRQn);
+    sim_advance(SIM_MS(10));
+
+    RUN_TEST(test_short_delays_spin);
+    RUN_TEST(test_long_delays_sleep);
+    RUN_TEST(test_longer_than_letimer_period);
+    RUN_TEST(test_other_interrupts_keep_sleeping);
+
+    TEST_EXIT();
+}
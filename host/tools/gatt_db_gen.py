@@ -0,0 +1,403 @@
+#!/usr/bin/env python3
+#
+# gatt_db_gen.py
+#
+#  Created on: Oct 16, 2026
+#      Author: bjornnelson
+#
+# Writes autogen/gatt_db.c and autogen/gatt_db.h from the GATT configuration,
+# in the layout the Simplicity Studio GATT configurator produces, so the
+# database can be regenerated without the IDE. Only the features the
+# project's .btconf files use are supported; anything else is an error
+# instead of a guess.
+#
+#     gatt_db_gen.py [--check] OUT_DIR gatt_configuration.btconf [contributed.xml ...]
+#
+# Contributed files (ota_dfu.xml) are appended after the project's services,
+# like the ota_dfu component does. --check compares instead of writing and
+# fails if the files in OUT_DIR are out of date.
+
+import sys
+import uuid as uuidlib
+import xml.etree.ElementTree as ET
+
+# characteristic properties, as in the characteristic declaration
+PROP_READ = 0x02
+PROP_WRITE_NO_RESPONSE = 0x04
+PROP_WRITE = 0x08
+PROP_NOTIFY = 0x10
+PROP_INDICATE = 0x20
+
+PROP_BITS = {
+    "read": PROP_READ,
+    "write_no_response": PROP_WRITE_NO_RESPONSE,
+    "write": PROP_WRITE,
+    "notify": PROP_NOTIFY,
+    "indicate": PROP_INDICATE,
+}
+
+# attribute permissions
+PERM_READ = 0x0001
+PERM_WRITE = 0x0002
+PERM_READ_BONDED = 0x0040
+PERM_DISCOVERABLE = 0x0800
+PERM_NOTIFY_BONDED = 0x4000
+PERM_ADVERTISE = 0x8000
+
+# how an attribute keeps its value
+DATATYPE_CONST = 0x00
+DATATYPE_DYNAMIC = 0x01
+DATATYPE_CONFIG = 0x03
+DATATYPE_CHARACTERISTIC = 0x05
+DATATYPE_USER = 0x07
+
+UUID_PRIMARY_SERVICE = 0x2800
+UUID_SECONDARY_SERVICE = 0x2801
+UUID_CHARACTERISTIC = 0x2803
+UUID_CCCD = 0x2902
+
+
+class GattError(Exception):
+    pass
+
+
+def parse_uuid(text):
+    """16-bit uuid as an int, 128-bit as its 16 bytes little endian"""
+    if len(text) == 4:
+        return int(text, 16)
+    return uuidlib.UUID(text).bytes[::-1]
+
+
+def uuid_bytes(u):
+    return u.to_bytes(2, "little") if isinstance(u, int) else u
+
+
+class Attribute:
+    def __init__(self, uuid, permissions, datatype):
+        self.handle = 0
+        self.uuid = uuid
+        self.uuid_index = 0  # into the uuid16 table, or 0x8000 and into the uuid128 table
+        self.permissions = permissions
+        self.datatype = datatype
+        self.value = b""  # const and dynamic data
+        self.properties = 0  # characteristic declaration and dynamic data
+        self.max_len = 0
+        self.char_value = None  # characteristic declaration, its value attribute
+        self.char_uuid = 0
+        self.flags = 0  # client configuration
+        self.config_index = 0
+        self.name = None  # define in gatt_db.h
+
+
+def properties_of(element):
+    """properties and security permissions of a characteristic or descriptor"""
+    props = 0
+    perms = 0
+    node = element.find("properties")
+    if node is None:
+        return props, perms
+
+    # either <properties read="true"> or <properties><read .../></properties>
+    for name, bit in PROP_BITS.items():
+        if node.get(name) == "true":
+            props |= bit
+    for child in node:
+        if child.tag not in PROP_BITS:
+            raise GattError("unsupported property %s" % child.tag)
+        props |= PROP_BITS[child.tag]
+        if child.get("authenticated") == "true" or child.get("encrypted") == "true":
+            raise GattError("%s: authenticated and encrypted properties are not supported" % element.get("name"))
+        if child.get("bonded") == "true":
+            if child.tag == "read":
+                perms |= PERM_READ_BONDED
+            elif child.tag in ("notify", "indicate"):
+                perms |= PERM_NOTIFY_BONDED
+            else:
+                raise GattError("%s: bonded %s is not supported" % (element.get("name"), child.tag))
+    return props, perms
+
+
+def value_of(element):
+    """type, bytes and length of a <value>"""
+    node = element.find("value")
+    if node is None:
+        return "hex", b"", 0
+    kind = node.get("type", "hex")
+    length = int(node.get("length", "0"))
+    text = (node.text or "").strip()
+
+    if kind == "user":
+        return kind, b"", length
+    if node.get("variable_length") == "true":
+        raise GattError("%s: variable length values are only supported for type user" % element.get("name"))
+    if kind == "hex":
+        data = bytes.fromhex(text)
+    elif kind == "utf-8":
+        data = text.encode("utf-8")
+    else:
+        raise GattError("%s: unsupported value type %s" % (element.get("name"), kind))
+    if len(data) > length:
+        raise GattError("%s: value longer than its length" % element.get("name"))
+    return kind, data + bytes(length - len(data)), length
+
+
+def value_attribute(element, uuid, props, perms, characteristic):
+    kind, data, length = value_of(element)
+
+    perms |= PERM_DISCOVERABLE
+    if props & PROP_READ:
+        perms |= PERM_READ
+    if props & (PROP_WRITE | PROP_WRITE_NO_RESPONSE):
+        perms |= PERM_WRITE
+
+    if kind == "user":
+        attr = Attribute(uuid, perms, DATATYPE_USER)
+    elif element.get("const") == "true":
+        if props & (PROP_WRITE | PROP_WRITE_NO_RESPONSE):
+            raise GattError("%s: const values can't be written" % element.get("name"))
+        attr = Attribute(uuid, perms, DATATYPE_CONST)
+        attr.value = data
+    else:
+        attr = Attribute(uuid, perms, DATATYPE_DYNAMIC)
+        attr.value = data
+        attr.max_len = length
+        attr.properties = props if characteristic else (props & (PROP_READ | PROP_WRITE))
+    return attr
+
+
+class Database:
+    def __init__(self):
+        self.attributes = []
+        self.uuid16 = [UUID_PRIMARY_SERVICE, UUID_SECONDARY_SERVICE, UUID_CHARACTERISTIC]
+        self.uuid128 = []
+        self.num_ccfg = 0
+
+    def uuid_index(self, u):
+        if isinstance(u, int):
+            if u not in self.uuid16:
+                self.uuid16.append(u)
+            return self.uuid16.index(u)
+        if u not in self.uuid128:
+            self.uuid128.append(u)
+        return 0x8000 | self.uuid128.index(u)
+
+    def service(self, element):
+        if element.get("type", "primary") != "primary":
+            raise GattError("%s: only primary services are supported" % element.get("name"))
+        perms = PERM_DISCOVERABLE | PERM_READ
+        if element.get("advertise") == "true":
+            perms |= PERM_ADVERTISE
+        attrs = [Attribute(UUID_PRIMARY_SERVICE, perms, DATATYPE_CONST)]
+        attrs[0].value = uuid_bytes(parse_uuid(element.get("uuid")))
+
+        for char in element.findall("characteristic"):
+            attrs += self.characteristic(char)
+        return attrs
+
+    def characteristic(self, element):
+        props, perms = properties_of(element)
+        uuid = parse_uuid(element.get("uuid"))
+
+        decl = Attribute(UUID_CHARACTERISTIC, PERM_DISCOVERABLE | PERM_READ, DATATYPE_CHARACTERISTIC)
+        decl.properties = props
+        value = value_attribute(element, uuid, props, perms, True)
+        value.name = element.get("id")
+        decl.char_value = value
+        attrs = [decl, value]
+
+        # the client configuration comes right after the value, declared or not
+        if props & (PROP_NOTIFY | PROP_INDICATE):
+            config = Attribute(UUID_CCCD, PERM_DISCOVERABLE | PERM_READ | PERM_WRITE, DATATYPE_CONFIG)
+            config.flags = (0x01 if props & PROP_NOTIFY else 0) | (0x02 if props & PROP_INDICATE else 0)
+            attrs.append(config)
+
+        for desc in element.findall("descriptor"):
+            desc_uuid = parse_uuid(desc.get("uuid"))
+            if desc_uuid == UUID_CCCD:
+                continue
+            desc_props, desc_perms = properties_of(desc)
+            attr = value_attribute(desc, desc_uuid, desc_props, desc_perms, False)
+            attr.name = desc.get("id")
+            attrs.append(attr)
+        return attrs
+
+    def generic_attribute_service(self, caching):
+        """the GATT service the configurator adds in front of everything else"""
+        gatt = ET.fromstring(
+            '<service uuid="1801" type="primary">'
+            '<characteristic id="service_changed_char" uuid="2A05">'
+            '<value length="4" type="hex"/><properties><indicate/></properties></characteristic>'
+            + ('<characteristic id="database_hash" uuid="2B2A">'
+               '<value length="16" type="hex"/><properties><read/></properties></characteristic>'
+               '<characteristic id="client_support_features" uuid="2B29">'
+               '<value length="1" type="hex"/><properties><read/><write/></properties></characteristic>'
+               if caching else "")
+            + '</service>')
+        return self.service(gatt)
+
+    def build(self, root, contributed):
+        services = []
+        for tree in [root] + contributed:
+            for element in tree.findall("service"):
+                services.append(self.service(element))
+
+        if root.get("generic_attribute_service") == "true":
+            services.insert(0, self.generic_attribute_service(root.get("gatt_caching") == "true"))
+
+        # the uuid tables fill in the order the attributes are defined, the GATT service last
+        order = services[1:] + services[:1] if root.get("generic_attribute_service") == "true" else services
+        for attrs in order:
+            for attr in attrs:
+                attr.uuid_index = self.uuid_index(attr.uuid)
+        for attrs in order:
+            for attr in attrs:
+                if attr.datatype == DATATYPE_CHARACTERISTIC:
+                    attr.char_uuid = attr.char_value.uuid_index
+
+        for attrs in services:
+            self.attributes += attrs
+        for i, attr in enumerate(self.attributes):
+            attr.handle = i + 1
+            if attr.datatype == DATATYPE_CONFIG:
+                attr.config_index = self.num_ccfg
+                self.num_ccfg += 1
+
+
+def data_list(data):
+    return "".join("0x%02x, " % b for b in data)
+
+
+def write_source(db, prefix):
+    name = prefix.rstrip("_")
+    out = []
+    out.append("/********************************************************************\n"
+               " * Autogenerated file, do not edit.\n"
+               " *******************************************************************/\n"
+               "\n"
+               "#include <stdint.h>\n"
+               "#include \"sli_bt_gattdb_def.h\"\n"
+               "\n"
+               "#define GATT_HEADER(F) F\n"
+               "#define GATT_DATA(F) F\n")
+
+    out.append("GATT_DATA(const uint16_t %suuidtable_16_map[]) =\n{\n" % prefix)
+    out += ["  0x%04x,\n" % u for u in db.uuid16]
+    out.append("};\n\n")
+
+    out.append("GATT_DATA(const uint8_t %suuidtable_128_map[]) =\n{\n" % prefix)
+    out += ["  %s\n" % data_list(u) for u in db.uuid128]
+    out.append("};\n")
+
+    for attr in reversed(db.attributes):
+        field = "%sattribute_field_%d" % (prefix, attr.handle - 1)
+        if attr.datatype == DATATYPE_CONST:
+            out.append("GATT_DATA(const sli_bt_gattdb_value_t %s) = {\n"
+                       "  .len = %d,\n"
+                       "  .data = { %s}\n"
+                       "};\n" % (field, len(attr.value), data_list(attr.value)))
+        elif attr.datatype == DATATYPE_DYNAMIC:
+            out.append("GATT_DATA(sli_bt_gattdb_attribute_chrvalue_t %s) = {\n"
+                       "  .properties = 0x%02x,\n"
+                       "  .max_len = %d,\n"
+                       "  .data = { %s},\n"
+                       "};\n" % (field, attr.properties, attr.max_len, data_list(attr.value)))
+
+    out.append("\nGATT_DATA(const sli_bt_gattdb_attribute_t %sattributes_map[]) = {\n" % prefix)
+    for attr in db.attributes:
+        common = ("  { .handle = 0x%02x, .uuid = 0x%04x, .permissions = 0x%x, .caps = 0xffff, .state = 0x00, .datatype = 0x%02x, "
+                  % (attr.handle, attr.uuid_index, attr.permissions, attr.datatype))
+        if attr.datatype == DATATYPE_CONST:
+            data = ".constdata = &%sattribute_field_%d" % (prefix, attr.handle - 1)
+        elif attr.datatype == DATATYPE_DYNAMIC:
+            data = ".dynamicdata = &%sattribute_field_%d" % (prefix, attr.handle - 1)
+        elif attr.datatype == DATATYPE_USER:
+            data = ".dynamicdata = NULL"
+        elif attr.datatype == DATATYPE_CONFIG:
+            data = ".configdata = { .flags = 0x%02x, .clientconfig_index = 0x%02x }" % (attr.flags, attr.config_index)
+        else:
+            data = ".characteristic = { .properties = 0x%02x, .char_uuid = 0x%04x }" % (attr.properties, attr.char_uuid)
+        out.append(common + data + " },\n")
+    out.append("};\n\n")
+
+    out.append("GATT_HEADER(const sli_bt_gattdb_t %s) = {\n"
+               "  .attributes = %sattributes_map,\n"
+               "  .attribute_table_size = %d,\n"
+               "  .attribute_num = %d,\n"
+               "  .uuid16 = %suuidtable_16_map,\n"
+               "  .uuid16_table_size = %d,\n"
+               "  .uuid16_num = %d,\n"
+               "  .uuid128 = %suuidtable_128_map,\n"
+               "  .uuid128_table_size = %d,\n"
+               "  .uuid128_num = %d,\n"
+               "  .num_ccfg = %d,\n"
+               "  .caps_mask = 0xffff,\n"
+               "  .enabled_caps = 0xffff,\n"
+               "};\n"
+               "const sli_bt_gattdb_t *static_gattdb = &%s;\n"
+               % (name, prefix, len(db.attributes), len(db.attributes), prefix, len(db.uuid16), len(db.uuid16),
+                  prefix, len(db.uuid128), len(db.uuid128), db.num_ccfg, name))
+    return "".join(out)
+
+
+def write_header(db, prefix):
+    name = prefix.rstrip("_")
+    out = []
+    out.append("/********************************************************************\n"
+               " * Autogenerated file, do not edit.\n"
+               " *******************************************************************/\n"
+               "\n"
+               "#ifndef __GATT_DB_H\n"
+               "#define __GATT_DB_H\n"
+               "\n"
+               "#include \"sli_bt_gattdb_def.h\"\n"
+               "\n"
+               "extern const sli_bt_gattdb_t %s;\n"
+               "\n" % name)
+    for attr in db.attributes:
+        if attr.name:
+            out.append("#define %-37s %d\n" % (prefix + attr.name, attr.handle))
+    out.append("\n\n#endif // __GATT_DB_H\n")
+    return "".join(out)
+
+
+def main(argv):
+    check = "--check" in argv
+    args = [a for a in argv if a != "--check"]
+    if len(args) < 2:
+        print("usage: gatt_db_gen.py [--check] OUT_DIR gatt_configuration.btconf [contributed.xml ...]", file=sys.stderr)
+        return 2
+
+    out_dir = args[0]
+    root = ET.parse(args[1]).getroot()
+    contributed = [ET.parse(path).getroot() for path in args[2:]]
+    prefix = root.get("prefix", "gattdb_")
+
+    db = Database()
+    try:
+        db.build(root, contributed)
+    except GattError as e:
+        print("gatt_db_gen: %s" % e, file=sys.stderr)
+        return 1
+
+    files = {
+        root.get("out", "gatt_db.c"): write_source(db, prefix),
+        root.get("header", "gatt_db.h"): write_header(db, prefix),
+    }
+
+    stale = False
+    for name, text in files.items():
+        path = "%s/%s" % (out_dir, name)
+        if check:
+            with open(path, newline="") as f:
+                if f.read() != text:
+                    print("gatt_db_gen: %s is out of date with %s, run host/tools/gatt_db_gen.py" % (path, args[1]),
+                          file=sys.stderr)
+                    stale = True
+        else:
+            with open(path, "w", newline="") as f:
+                f.write(text)
+    return 1 if stale else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
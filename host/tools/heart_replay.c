@@ -0,0 +1,458 @@
+/*
+ * heart_replay.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Feeds a journal recorded by the firmware (src/journal.h) back through
+ * sl_bt_on_event() and the heart sensor workflow in the simulator, as fast
+ * as the host runs it, and checks the firmware handles the same
+ * application events in the same order.
+ *
+ *   heart_replay [-v] journal
+ *
+ * The journal is either the binary records, as heart_sim_record --journal
+ * writes them or as read back from flash, or a VCOM capture holding the
+ * "J <offset> <hex>" lines of journal_dump(). It has to start with the
+ * boot event, so the ring must have held everything since boot.
+ *
+ * What the journal holds is turned back into the inputs that caused it:
+ *   - bluetooth events other than external signals are raised by the
+ *     stack at the time they were delivered, the stack raises none itself
+ *   - every I2C read returns the bytes recorded for that device, in order
+ *   - EVENT_DATA_READY pulses MFIO low, EVENT_PB0/EVENT_PB1 press and
+ *     release the buttons
+ * Timers, the I2C engine and the active objects run as they do in the
+ * simulator, the application events they produce are what is compared.
+ *
+ * At the end it prints how much faster than real time the replay ran and
+ * the host time each bluetooth event and interrupt handler took, the cost
+ * of the handlers on the recorded workload.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+#include "src/journal.h"
+#include "src/irq.h"
+#include "src/i2c.h"
+#include "src/gpio.h"
+#include "src/scheduler.h"
+
+// a replayed MFIO assertion, the firmware reads the fifo well after it ends
+#define MFIO_PULSE SIM_US(500)
+
+// a replayed PB1 press, only the press is in the journal
+#define PB1_PRESS SIM_MS(50)
+
+// time left for the last recorded events to be handled again
+#define RUN_MARGIN SIM_MS(100)
+
+typedef struct {
+    journal_record_t record;
+    uint64_t timestamp; // us, unwrapped
+} replay_record_t;
+
+// recorded reads of one device, served in order
+typedef struct {
+    sim_i2c_device_t device;
+    const replay_record_t** reads;
+    uint32_t count;
+    uint32_t next;
+    uint32_t short_reads; // fewer bytes recorded than read
+    uint32_t exhausted; // reads after the last recorded one
+} replay_device_t;
+
+static uint8_t* journal = 0;
+static size_t journal_len = 0;
+static replay_record_t* records = 0;
+static uint32_t num_records = 0;
+static replay_device_t devices[NUM_I2C_DEVICES];
+static int64_t offset_us = 0;
+static bool verbose = false;
+
+// ---------------------------------------------------------------------
+// Loading
+// ---------------------------------------------------------------------
+
+// private helper, appends bytes to the journal buffer
+static void journal_append(const uint8_t* data, size_t len) {
+    journal = realloc(journal, journal_len + len);
+    if (journal == 0) {
+        abort();
+    }
+    memcpy(&journal[journal_len], data, len);
+    journal_len += len;
+}
+
+// private helper, reads "J <offset> <hex>" lines from a journal_dump() capture
+static bool load_dump(FILE* f) {
+    char line[1024];
+    bool found = false;
+
+    while (fgets(line, sizeof(line), f) != 0) {
+        char* p = strstr(line, "J ");
+        unsigned int offset;
+        char hex[512];
+
+        if ((p == 0) || (sscanf(p, "J %x %511s", &offset, hex) != 2) || (offset != journal_len)) {
+            continue;
+        }
+        for (size_t i = 0; (hex[i] != 0) && (hex[i + 1] != 0); i += 2) {
+            char byte[3] = { hex[i], hex[i + 1], 0 };
+            uint8_t b = (uint8_t) strtoul(byte, 0, 16);
+            journal_append(&b, 1);
+        }
+        found = true;
+    }
+    return found;
+}
+
+static bool load_journal(const char* path) {
+    FILE* f = fopen(path, "rb");
+    uint8_t buffer[4096];
+    size_t n;
+
+    if (f == 0) {
+        perror(path);
+        return false;
+    }
+
+    if (load_dump(f)) {
+        fclose(f);
+        return true;
+    }
+
+    rewind(f);
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        journal_append(buffer, n);
+    }
+    fclose(f);
+    return journal_len > 0;
+}
+
+// private helper, decodes every record and unwraps the 32 bit timestamps
+static void decode_journal(void) {
+    journal_reader_t r;
+    journal_record_t record;
+    uint32_t last = 0;
+    uint64_t wraps = 0;
+
+    journal_reader_init(&r, journal, journal_len);
+    while (journal_next(&r, &record)) {
+        records = realloc(records, (num_records + 1) * sizeof(records[0]));
+        if (records == 0) {
+            abort();
+        }
+        if ((num_records > 0) && (record.timestamp < last)) {
+            wraps += 1ULL << 32;
+        }
+        last = record.timestamp;
+        records[num_records].record = record;
+        records[num_records].timestamp = wraps + record.timestamp;
+        num_records++;
+    }
+
+    if (r.pos != journal_len) {
+        fprintf(stderr, "heart_replay: %zu bytes after the last whole record ignored\n", journal_len - r.pos);
+    }
+}
+
+// private helper, the event id of a bluetooth record
+static uint32_t record_bt_id(const replay_record_t* rec) {
+    const uint8_t* p = rec->record.payload;
+    return SL_BT_MSG_ID(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+// ---------------------------------------------------------------------
+// Inputs
+// ---------------------------------------------------------------------
+
+// private helper, firmware time of a record to virtual time
+static sim_time_t record_time(const replay_record_t* rec) {
+    int64_t us = (int64_t) rec->timestamp - offset_us;
+    return (us < 0) ? 0 : SIM_US(us);
+}
+
+// scripted action, the stack raises a recorded event
+static void inject_bt_event(void* context, uint32_t arg) {
+    (void) arg;
+    const replay_record_t* rec = context;
+    const uint8_t* p = rec->record.payload;
+    sl_bt_msg_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+    memcpy(&evt.data, &p[4], rec->record.len - 4);
+    sim_bt_inject(&evt);
+}
+
+static void drive_mfio(void* context, uint32_t low) {
+    (void) context;
+    sim_gpio_drive(MAX30101_PORT, MAX30101_MFIO_PIN, low ? 0 : SIM_GPIO_RELEASE);
+}
+
+static void press_button(void* context, uint32_t pressed) {
+    sim_button((int) (intptr_t) context, pressed != 0);
+}
+
+static I2C_TransferReturn_TypeDef replay_write(sim_i2c_device_t* d, const uint8_t* data, uint16_t len) {
+    (void) d;
+    (void) data;
+    (void) len;
+    return i2cTransferDone;
+}
+
+static I2C_TransferReturn_TypeDef replay_read(sim_i2c_device_t* d, uint8_t* data, uint16_t len) {
+    replay_device_t* dev = (replay_device_t*) d;
+
+    if (dev->next == dev->count) {
+        dev->exhausted++;
+        return i2cTransferNack;
+    }
+
+    const journal_record_t* rec = &dev->reads[dev->next++]->record;
+    uint16_t recorded = rec->len - 1;
+    if (recorded < len) {
+        dev->short_reads++;
+    }
+    memset(data, 0, len);
+    memcpy(data, &rec->payload[1], (recorded < len) ? recorded : len);
+    return i2cTransferDone;
+}
+
+// private helper, replaces the sensor models with the recorded reads
+static void attach_devices(void) {
+    static const struct { const char* name; uint16_t addr; } bus[NUM_I2C_DEVICES] = {
+        [I2C_DEV_MAX32664] = { "MAX32664 replay", 0xAA },
+        [I2C_DEV_SI7021]   = { "Si7021 replay", 0x80 }
+    };
+
+    for (uint32_t i = 0; i < num_records; i++) {
+        const journal_record_t* rec = &records[i].record;
+        if ((rec->type != JOURNAL_I2C_READ) || (rec->len < 1) || (rec->payload[0] >= NUM_I2C_DEVICES)) {
+            continue;
+        }
+        replay_device_t* dev = &devices[rec->payload[0]];
+        dev->reads = realloc(dev->reads, (dev->count + 1) * sizeof(dev->reads[0]));
+        if (dev->reads == 0) {
+            abort();
+        }
+        dev->reads[dev->count++] = &records[i];
+    }
+
+    for (int i = 0; i < NUM_I2C_DEVICES; i++) {
+        devices[i].device.name = bus[i].name;
+        devices[i].device.addr = bus[i].addr;
+        devices[i].device.write = replay_write;
+        devices[i].device.read = replay_read;
+        sim_i2c_attach(&devices[i].device);
+    }
+}
+
+// private helper, schedules everything the journal says came from outside the firmware
+static void schedule_inputs(void) {
+    for (uint32_t i = 0; i < num_records; i++) {
+        const replay_record_t* rec = &records[i];
+        const uint8_t* p = rec->record.payload;
+        sim_time_t t = record_time(rec);
+
+        if (rec->record.type == JOURNAL_BT_EVENT) {
+            if ((rec->record.len >= 4) && (record_bt_id(rec) != sl_bt_evt_system_external_signal_id)) {
+                sim_at(t, inject_bt_event, (void*) rec, 0);
+            }
+        }
+        else if ((rec->record.type == JOURNAL_APP_EVENT) && (rec->record.len == 6)) {
+            uint32_t payload = p[2] | (p[3] << 8) | (p[4] << 16) | ((uint32_t) p[5] << 24);
+
+            if ((p[0] != JOURNAL_TARGET_MAIN) && (p[1] == EVENT_DATA_READY)) {
+                sim_at(t, drive_mfio, 0, true);
+                sim_at(t + MFIO_PULSE, drive_mfio, 0, false);
+            }
+            else if ((p[0] == JOURNAL_TARGET_MAIN) && (p[1] == EVENT_PB0)) {
+                sim_at(t, press_button, (void*) 0, payload);
+            }
+            else if ((p[0] == JOURNAL_TARGET_MAIN) && (p[1] == EVENT_PB1)) {
+                sim_at(t, press_button, (void*) 1, true);
+                sim_at(t + PB1_PRESS, press_button, (void*) 1, false);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------
+// Comparing and reporting
+// ---------------------------------------------------------------------
+
+// private helper, the application events of a journal
+static uint32_t app_events(const uint8_t* data, size_t len, journal_record_t* out, uint32_t max) {
+    journal_reader_t r;
+    journal_record_t rec;
+    uint32_t n = 0;
+
+    journal_reader_init(&r, data, len);
+    while (journal_next(&r, &rec) && (n < max)) {
+        if (rec.type == JOURNAL_APP_EVENT) {
+            out[n++] = rec;
+        }
+    }
+    return n;
+}
+
+static void print_app_event(const char* what, const journal_record_t* rec) {
+    const uint8_t* p = rec->payload;
+    printf("  %s: %10" PRIu32 " us  target 0x%02x  event %2u  payload %" PRIu32 "\n", what, rec->timestamp, p[0], p[1],
+           (uint32_t) (p[2] | (p[3] << 8) | (p[4] << 16) | ((uint32_t) p[5] << 24)));
+}
+
+// returns: number of recorded events the replay did not reproduce in order
+static uint32_t compare(void) {
+    static uint8_t replayed[JOURNAL_SIZE];
+    size_t replayed_len = journal_copy(replayed, sizeof(replayed));
+
+    journal_record_t* want = calloc(num_records + 1, sizeof(*want));
+    journal_record_t* got = calloc((replayed_len / JOURNAL_HEADER_SIZE) + 1, sizeof(*got));
+    if ((want == 0) || (got == 0)) {
+        abort();
+    }
+    uint32_t num_want = app_events(journal, journal_len, want, num_records);
+    uint32_t num_got = app_events(replayed, replayed_len, got, (replayed_len / JOURNAL_HEADER_SIZE) + 1);
+
+    uint32_t i = 0;
+    while ((i < num_want) && (i < num_got) && (memcmp(want[i].payload, got[i].payload, 6) == 0)) {
+        i++;
+    }
+
+    printf("app events: %" PRIu32 " recorded, %" PRIu32 " replayed, %" PRIu32 " match in order\n", num_want, num_got, i);
+    if (i < num_want) {
+        printf("first difference at event %" PRIu32 "\n", i);
+        print_app_event("recorded", &want[i]);
+        if (i < num_got) {
+            print_app_event("replayed", &got[i]);
+        }
+    }
+
+    free(want);
+    free(got);
+    return num_want - i;
+}
+
+static const char* bt_event_name(uint32_t id) {
+    switch (id) {
+        case sl_bt_evt_system_boot_id: return "system_boot";
+        case sl_bt_evt_system_external_signal_id: return "external_signal";
+        case sl_bt_evt_system_soft_timer_id: return "soft_timer";
+        case sl_bt_evt_connection_opened_id: return "connection_opened";
+        case sl_bt_evt_connection_parameters_id: return "connection_parameters";
+        case sl_bt_evt_connection_phy_status_id: return "connection_phy_status";
+        case sl_bt_evt_connection_closed_id: return "connection_closed";
+        case sl_bt_evt_gatt_mtu_exchanged_id: return "gatt_mtu_exchanged";
+        case sl_bt_evt_gatt_server_characteristic_status_id: return "characteristic_status";
+        case sl_bt_evt_gatt_server_user_read_request_id: return "user_read_request";
+        case sl_bt_evt_gatt_server_user_write_request_id: return "user_write_request";
+        case sl_bt_evt_gatt_server_indication_timeout_id: return "indication_timeout";
+        case sl_bt_evt_sm_confirm_bonding_id: return "sm_confirm_bonding";
+        case sl_bt_evt_sm_confirm_passkey_id: return "sm_confirm_passkey";
+        case sl_bt_evt_sm_bonded_id: return "sm_bonded";
+        case sl_bt_evt_sm_bonding_failed_id: return "sm_bonding_failed";
+        default: return "other";
+    }
+}
+
+static void print_costs(sim_time_t simulated, uint64_t host_ns) {
+    static const struct { IRQn_Type irq; const char* name; } handlers[] = {
+        { LETIMER0_IRQn, "LETIMER0" },
+        { GPIO_EVEN_IRQn, "GPIO_EVEN" },
+        { GPIO_ODD_IRQn, "GPIO_ODD" },
+        { I2C0_IRQn, "I2C0" },
+        { CSEN_IRQn, "CSEN (sensor object)" },
+        { VDAC0_IRQn, "VDAC0 (display object)" }
+    };
+    int count;
+    const sim_bt_event_cost_t* costs = sim_bt_event_costs(&count);
+
+    printf("replayed %.3f s of firmware time in %.1f ms, %.0fx real time\n",
+           simulated / 1e9, host_ns / 1e6, (host_ns > 0) ? ((double) simulated / host_ns) : 0.0);
+
+    printf("\nsl_bt_on_event()          count    mean ns     max ns\n");
+    for (int i = 0; i < count; i++) {
+        printf("  %-22s %8" PRIu32 " %10.0f %10" PRIu64 "\n", bt_event_name(costs[i].id), costs[i].count,
+               (double) costs[i].host_ns / costs[i].count, costs[i].max_host_ns);
+    }
+
+    printf("\ninterrupt handler         count    mean ns\n");
+    for (size_t i = 0; i < sizeof(handlers) / sizeof(handlers[0]); i++) {
+        uint32_t n = sim_irq_count(handlers[i].irq);
+        printf("  %-22s %8" PRIu32 " %10.0f\n", handlers[i].name, n,
+               (n > 0) ? ((double) sim_irq_host_ns(handlers[i].irq) / n) : 0.0);
+    }
+}
+
+static uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+    const char* path = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+    if (path == 0) {
+        fprintf(stderr, "usage: heart_replay [-v] journal\n");
+        return 2;
+    }
+
+    if (!load_journal(path)) {
+        fprintf(stderr, "heart_replay: no journal in %s\n", path);
+        return 2;
+    }
+    decode_journal();
+
+    uint32_t first_bt = 0;
+    while ((first_bt < num_records) && (records[first_bt].record.type != JOURNAL_BT_EVENT)) {
+        first_bt++;
+    }
+    if ((first_bt == num_records) || (records[first_bt].record.len < 4) ||
+        (record_bt_id(&records[first_bt]) != sl_bt_evt_system_boot_id)) {
+        fprintf(stderr, "heart_replay: the journal doesn't start at boot, records were dropped from the ring\n");
+        return 2;
+    }
+
+    sim_log_quiet(!verbose);
+    sim_bt_replay_mode(true);
+    attach_devices();
+
+    uint64_t start = host_ns();
+
+    // app_init() has run and the main loop waits for the boot event, the firmware clock can be read now
+    sim_run_until(0);
+    offset_us = (int64_t) letimerMicroseconds() - (int64_t) (sim_now() / 1000);
+
+    schedule_inputs();
+    sim_run_until(record_time(&records[num_records - 1]) + RUN_MARGIN);
+
+    uint64_t elapsed = host_ns() - start;
+
+    printf("journal: %zu bytes, %" PRIu32 " records\n", journal_len, num_records);
+    for (int i = 0; i < NUM_I2C_DEVICES; i++) {
+        printf("%s: %" PRIu32 " of %" PRIu32 " reads served, %" PRIu32 " short, %" PRIu32 " past the end\n",
+               devices[i].device.name, devices[i].next, devices[i].count, devices[i].short_reads, devices[i].exhausted);
+    }
+    uint32_t missed = compare();
+    printf("\n");
+    print_costs(sim_now(), elapsed);
+
+    return (missed > 0) ? 1 : 0;
+}
@@ -0,0 +1,380 @@
+/*
+ * heart_sim.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Runs the firmware in the simulator against a scenario and prints what the
+ * client saw, the energy modes and the bus traffic.
+ *
+ *   heart_sim [--journal file] [scenario]
+ *
+ * A scenario is one command per line, the time in ms it happens at first:
+ *
+ *   1000  connect
+ *   1500  bond                       client asks to bond, PB0 confirms the passkey
+ *   1700  button 0 1                 PB0 pressed, "button 0 0" releases it
+ *   2000  subscribe 39 notify        CCCD write, none/notify/indicate
+ *   2000  read 60                    user read, an offset may follow
+ *   2000  write 44 01                user write, hex bytes
+ *   3000  finger 72 98 99            heart rate, SpO2, confidence
+ *   30000 nofinger
+ *   3000  temp 23500                 Si7021 temperature in m°C
+ *   0     mtu 100                    client MTU, before connecting
+ *   0     noconfirm                  client stops confirming indications
+ *   60000 disconnect
+ *   60000 end                        length of the run
+ *
+ * Checks run at the end and make the exit status fail:
+ *
+ *   expect notify 39 >= 10           notify/indicate <char>, bonded, connected,
+ *   expect errors == 0               errors, lost, display <row> (text match)
+ *
+ * Without a scenario a built-in one connects, bonds, subscribes to every
+ * characteristic and measures a finger for a minute.
+ *
+ * --journal writes the firmware's journal at the end, a workload for
+ * heart_replay. Use heart_sim_record, its ring holds a whole run.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "gatt_db.h"
+#include "src/journal.h"
+
+#define MAX_EXPECTS 32
+#define LINE_LEN 256
+
+typedef struct {
+    char line[LINE_LEN];
+} command_t;
+
+typedef struct {
+    char metric[32];
+    int arg;
+    char op[3];
+    long value;
+    char text[LINE_LEN];
+} expect_t;
+
+static const char* default_scenario[] = {
+    "1000  connect",
+    "1500  bond",
+    "1700  button 0 1",
+    "1800  button 0 0",
+    "2000  subscribe 21 indicate",
+    "2000  subscribe 35 indicate",
+    "2000  subscribe 39 notify",
+    "2000  subscribe 51 indicate",
+    "2000  subscribe 54 notify",
+    "3000  finger 72 98 99",
+    "3000  temp 23500",
+    "40000 read 60",
+    "45000 nofinger",
+    "55000 finger 65 97 99",
+    "70000 end",
+    "expect bonded == 1",
+    "expect connected == 1",
+    "expect notify 39 >= 10",
+    "expect notify 54 >= 10",
+    "expect indicate 21 >= 1",
+    "expect errors == 0",
+    "expect display 8 Heart Rate: 65 BPM",
+    0
+};
+
+static sim_time_t end_time = SIM_S(60);
+static expect_t expects[MAX_EXPECTS];
+static int num_expects = 0;
+
+// private helper, hex string to bytes
+static uint8_t parse_hex(const char* hex, uint8_t* out, uint8_t max) {
+    uint8_t len = 0;
+    while ((hex[0] != 0) && (hex[1] != 0) && (len < max)) {
+        char byte[3] = { hex[0], hex[1], 0 };
+        out[len++] = (uint8_t) strtoul(byte, 0, 16);
+        hex += 2;
+    }
+    return len;
+}
+
+// scripted action, runs one scenario command
+static void run_command(void* context, uint32_t arg) {
+    (void) arg;
+    command_t* c = context;
+    char cmd[32] = "";
+    char text[LINE_LEN] = "";
+    int a = 0;
+    int b = 0;
+    int d = 0;
+
+    sscanf(c->line, "%31s", cmd);
+
+    if (strcmp(cmd, "connect") == 0) {
+        sim_bt_connect();
+    }
+    else if (strcmp(cmd, "disconnect") == 0) {
+        sim_bt_disconnect();
+    }
+    else if (strcmp(cmd, "bond") == 0) {
+        sim_bt_bond();
+    }
+    else if (sscanf(c->line, "button %d %d", &a, &b) == 2) {
+        sim_button(a, b != 0);
+    }
+    else if (sscanf(c->line, "subscribe %d %31s", &a, text) == 2) {
+        uint16_t flags = (strcmp(text, "notify") == 0) ? sl_bt_gatt_notification :
+                         (strcmp(text, "indicate") == 0) ? sl_bt_gatt_indication : sl_bt_gatt_disable;
+        sim_bt_subscribe(a, flags);
+    }
+    else if (sscanf(c->line, "read %d %d", &a, &b) >= 1) {
+        sim_bt_read(a, (sscanf(c->line, "read %d %d", &a, &b) == 2) ? b : 0);
+    }
+    else if (sscanf(c->line, "write %d %255s", &a, text) == 2) {
+        uint8_t data[128];
+        sim_bt_write(a, data, parse_hex(text, data, sizeof(data)));
+    }
+    else if (sscanf(c->line, "finger %d %d %d", &a, &b, &d) == 3) {
+        sim_hub_finger(a, b, d);
+    }
+    else if (strcmp(cmd, "nofinger") == 0) {
+        sim_hub_no_finger();
+    }
+    else if (sscanf(c->line, "temp %d", &a) == 1) {
+        sim_si7021_set_temperature(a);
+    }
+    else {
+        fprintf(stderr, "heart_sim: unknown command '%s'\n", c->line);
+        exit(2);
+    }
+    free(c);
+}
+
+// private helper, client settings apply before the run
+static bool client_setting(const char* line, sim_bt_client_t* client) {
+    int mtu;
+    if (sscanf(line, "mtu %d", &mtu) == 1) {
+        client->mtu = mtu;
+        return true;
+    }
+    if (strcmp(line, "noconfirm") == 0) {
+        client->confirm_indications = false;
+        return true;
+    }
+    return false;
+}
+
+// private helper, one scenario line
+static void parse_line(const char* line, sim_bt_client_t* client) {
+    unsigned long ms;
+    int consumed = 0;
+
+    while ((*line == ' ') || (*line == '\t')) {
+        line++;
+    }
+    if ((*line == 0) || (*line == '#') || (*line == '\n')) {
+        return;
+    }
+
+    if (strncmp(line, "expect ", 7) == 0) {
+        expect_t* e = &expects[num_expects];
+        if (num_expects == MAX_EXPECTS) {
+            fprintf(stderr, "heart_sim: too many expectations\n");
+            exit(2);
+        }
+        memset(e, 0, sizeof(*e));
+        if ((sscanf(line, "expect display %d %255[^\n]", &e->arg, e->text) == 2)) {
+            strcpy(e->metric, "display");
+        }
+        else if ((sscanf(line, "expect %31s %d %2s %ld", e->metric, &e->arg, e->op, &e->value) != 4) &&
+                 (sscanf(line, "expect %31s %2s %ld", e->metric, e->op, &e->value) != 3)) {
+            fprintf(stderr, "heart_sim: bad expectation '%s'\n", line);
+            exit(2);
+        }
+        num_expects++;
+        return;
+    }
+
+    if (sscanf(line, "%lu %n", &ms, &consumed) != 1) {
+        fprintf(stderr, "heart_sim: bad line '%s'\n", line);
+        exit(2);
+    }
+    line += consumed;
+
+    command_t* c = calloc(1, sizeof(*c));
+    if (c == 0) {
+        abort();
+    }
+    strncpy(c->line, line, sizeof(c->line) - 1);
+    c->line[strcspn(c->line, "\r\n")] = 0;
+
+    if (strcmp(c->line, "end") == 0) {
+        end_time = SIM_MS(ms);
+        free(c);
+    }
+    else if (client_setting(c->line, client)) {
+        free(c);
+    }
+    else {
+        sim_at(SIM_MS(ms), run_command, c, 0);
+    }
+}
+
+// private helper, the value an expectation compares
+static long metric(const expect_t* e) {
+    if (strcmp(e->metric, "notify") == 0) {
+        return sim_bt_char_stats(e->arg)->notifications;
+    }
+    if (strcmp(e->metric, "indicate") == 0) {
+        return sim_bt_char_stats(e->arg)->indications;
+    }
+    if (strcmp(e->metric, "bonded") == 0) {
+        return sim_bt_stats()->bonded;
+    }
+    if (strcmp(e->metric, "connected") == 0) {
+        return sim_bt_stats()->connected;
+    }
+    if (strcmp(e->metric, "errors") == 0) {
+        return sim_log_errors();
+    }
+    if (strcmp(e->metric, "lost") == 0) {
+        return sim_hub_stats()->samples_lost;
+    }
+    fprintf(stderr, "heart_sim: unknown metric '%s'\n", e->metric);
+    exit(2);
+}
+
+static bool check(const expect_t* e) {
+    if (strcmp(e->metric, "display") == 0) {
+        return strcmp(sim_display_row(e->arg), e->text) == 0;
+    }
+    long v = metric(e);
+    if (strcmp(e->op, "==") == 0) return v == e->value;
+    if (strcmp(e->op, "!=") == 0) return v != e->value;
+    if (strcmp(e->op, ">=") == 0) return v >= e->value;
+    if (strcmp(e->op, "<=") == 0) return v <= e->value;
+    if (strcmp(e->op, ">") == 0)  return v > e->value;
+    if (strcmp(e->op, "<") == 0)  return v < e->value;
+    fprintf(stderr, "heart_sim: bad operator '%s'\n", e->op);
+    exit(2);
+}
+
+static void print_summary(void) {
+    const sim_bt_stats_t* bt = sim_bt_stats();
+    const sim_i2c_stats_t* i2c = sim_i2c_stats();
+    const sim_hub_stats_t* hub = sim_hub_stats();
+    static const uint16_t chars[] = {
+        gattdb_temperature_measurement, gattdb_button_state, gattdb_heart_rate_measurement,
+        gattdb_heart_stream, gattdb_plx_spot_check_measurement, gattdb_plx_continuous_measurement
+    };
+
+    printf("\n--- %.3f s simulated\n", sim_now() / 1e9);
+    printf("energy   EM0 %.3f s  EM1 %.3f s  EM2 %.3f s  EM3 %.3f s  wakeups %" PRIu32 "\n",
+           sim_em_time(SL_POWER_MANAGER_EM0) / 1e9, sim_em_time(SL_POWER_MANAGER_EM1) / 1e9,
+           sim_em_time(SL_POWER_MANAGER_EM2) / 1e9, sim_em_time(SL_POWER_MANAGER_EM3) / 1e9, sim_wakeups());
+    printf("i2c      transfers %" PRIu32 "  bytes %" PRIu32 "  nacks %" PRIu32 "  blocking %" PRIu32
+           "  em2 during transfer %" PRIu32 "\n",
+           i2c->transfers, i2c->bytes, i2c->nacks, i2c->blocking, sim_em2_during_transfer());
+    printf("hub      commands %" PRIu32 "  fifo reads %" PRIu32 "  samples %" PRIu32 "  lost %" PRIu32
+           "  early reads %" PRIu32 "\n",
+           hub->commands, hub->fifo_reads, hub->samples_read, hub->samples_lost, hub->early_reads);
+    printf("ble      connected %d  bonded %d  mtu %u  interval %u  latency %u  events %" PRIu32
+           "  rejected %" PRIu32 "  indication errors %" PRIu32 "\n",
+           bt->connected, bt->bonded, bt->mtu, bt->interval, bt->latency, bt->events_delivered,
+           bt->notify_rejected, bt->indication_errors);
+    for (size_t i = 0; i < sizeof(chars) / sizeof(chars[0]); i++) {
+        const sim_bt_char_stats_t* c = sim_bt_char_stats(chars[i]);
+        printf("char %2u  notifications %" PRIu32 "  indications %" PRIu32 "  confirmed %" PRIu32
+               "  bytes %" PRIu32 "\n",
+               chars[i], c->notifications, c->indications, c->confirmations, c->bytes);
+    }
+    printf("display\n");
+    for (int row = 0; row < 13; row++) {
+        printf("  %2d |%s\n", row, sim_display_row(row));
+    }
+}
+
+// private helper, the records of a whole run oldest first, false if the ring dropped some
+static bool write_journal(const char* path) {
+    static uint8_t records[JOURNAL_SIZE];
+    size_t len = journal_copy(records, sizeof(records));
+    journal_reader_t r;
+    journal_record_t first;
+
+    journal_reader_init(&r, records, len);
+    if (!journal_next(&r, &first) || (first.type != JOURNAL_BT_EVENT) ||
+        (SL_BT_MSG_ID(first.payload[0] | (first.payload[1] << 8) | (first.payload[2] << 16) |
+                      ((uint32_t) first.payload[3] << 24)) != sl_bt_evt_system_boot_id)) {
+        fprintf(stderr, "heart_sim: the journal ring lost the start of the run\n");
+        return false;
+    }
+
+    FILE* f = fopen(path, "wb");
+    if ((f == 0) || (fwrite(records, 1, len, f) != len)) {
+        perror(path);
+        return false;
+    }
+    fclose(f);
+    printf("journal  %zu bytes written to %s\n", len, path);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    sim_bt_client_t client = { .mtu = 247, .phy_2m = true, .confirm_indications = true, .confirm_delay_us = 30000 };
+    char line[LINE_LEN];
+    const char* scenario = 0;
+    const char* journal_path = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--journal") == 0) && (i + 1 < argc)) {
+            journal_path = argv[++i];
+        }
+        else {
+            scenario = argv[i];
+        }
+    }
+
+    if (scenario != 0) {
+        FILE* f = fopen(scenario, "r");
+        if (f == 0) {
+            perror(scenario);
+            return 2;
+        }
+        while (fgets(line, sizeof(line), f) != 0) {
+            parse_line(line, &client);
+        }
+        fclose(f);
+    }
+    else {
+        for (int i = 0; default_scenario[i] != 0; i++) {
+            parse_line(default_scenario[i], &client);
+        }
+    }
+
+    sim_bt_client_config(&client);
+    sim_run_until(end_time);
+    print_summary();
+
+    if ((journal_path != 0) && !write_journal(journal_path)) {
+        return 2;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < num_expects; i++) {
+        if (!check(&expects[i])) {
+            const expect_t* e = &expects[i];
+            if (strcmp(e->metric, "display") == 0) {
+                printf("FAIL display %d is \"%s\", expected \"%s\"\n", e->arg, sim_display_row(e->arg), e->text);
+            }
+            else {
+                printf("FAIL %s %d: %ld, expected %s %ld\n", e->metric, e->arg, metric(e), e->op, e->value);
+            }
+            failed++;
+        }
+    }
+    return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+/*
+ * active_object.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#include "active_object.h"
+#include "irq.h"
+#include "app.h"
+#include "journal.h"
+#include "scheduler.h"
+
+#include "em_device.h"
+#include "em_core.h"
+#include "sl_bluetooth.h"
+
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+// ---------------------------------------------------------------------
+// Active objects
+//
+// Each object owns a queue and a handler that runs one event to
+// completion. Objects are scheduled by level instead of by the main loop:
+// every level above AO_PRIORITY_MAIN is an otherwise unused NVIC vector
+// set pending by ao_post(), so the NVIC does the preemption and all
+// levels share one stack. A sensor event posted while a display redraw
+// is running starts as soon as the posting interrupt returns and the
+// redraw continues afterwards.
+//
+// PendSV is not used for this, the bluetooth stack runs its link layer
+// from PendSV_Handler in bare-metal builds (autogen/sl_bluetooth.c).
+//
+// Levels run below the application interrupts, which only post, and the
+// stack API isn't reentrant, so objects that call sl_bt_*() live at
+// AO_PRIORITY_MAIN and run from the main loop on an external signal.
+// ---------------------------------------------------------------------
+
+// external signal bit used to wake the stack for main loop objects, scheduler.c uses 0x01
+#define AO_SIGNAL 0x02
+
+// vector behind each level, the peripherals themselves stay disabled
+static const IRQn_Type level_irqs[NUM_AO_PRIORITIES] = {
+    [AO_PRIORITY_MAIN] = 0, // not an interrupt
+    [AO_PRIORITY_LOW]  = VDAC0_IRQn,
+    [AO_PRIORITY_HIGH] = CSEN_IRQn
+};
+
+// NVIC priority of each level, higher numbers are less urgent
+static const uint8_t level_nvic_priorities[NUM_AO_PRIORITIES] = {
+    [AO_PRIORITY_MAIN] = 0, // not an interrupt
+    [AO_PRIORITY_LOW]  = APP_IRQ_PRIORITY + 2,
+    [AO_PRIORITY_HIGH] = APP_IRQ_PRIORITY + 1
+};
+
+// objects at each level
+static active_object_t* levels[NUM_AO_PRIORITIES];
+
+// level running now, AO_PRIORITY_MAIN when no object is
+static volatile ao_priority_t running_level = AO_PRIORITY_MAIN;
+
+// times a level started while a lower one was part way through an event
+static volatile uint32_t preemptions = 0;
+
+/*
+ * Registers an object and enables its level, must happen before anything posts to it
+ *
+ * ao = object to start
+ */
+void ao_start(active_object_t* ao) {
+
+    event_ring_init(&ao->queue);
+    ao->handled = 0;
+    ao->dropped = 0;
+    ao->total_latency_us = 0;
+    ao->max_latency_us = 0;
+    ao->max_run_us = 0;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    ao->next = levels[ao->priority];
+    levels[ao->priority] = ao;
+    CORE_EXIT_CRITICAL();
+
+    if (ao->priority != AO_PRIORITY_MAIN) {
+        IRQn_Type irq = level_irqs[ao->priority];
+        NVIC_SetPriority(irq, level_nvic_priorities[ao->priority]);
+        NVIC_ClearPendingIRQ(irq);
+        NVIC_EnableIRQ(irq);
+    }
+}
+
+// deferred from ao_post(), the poster may be an interrupt
+static void report_queue_full(uint32_t level) {
+    LOG_ERROR("Active object queue full at level %u, see print_ao_stats()", (unsigned int) level);
+}
+
+/*
+ * Queues an event and schedules the object, safe to call from any interrupt or object
+ *
+ * ao = object to post to
+ * event = object specific event
+ * payload = event specific value
+ *
+ * returns: false if successful or true if the object's queue is full
+ */
+bool ao_post(active_object_t* ao, uint8_t event, uint32_t payload) {
+
+    if (event_ring_post(&ao->queue, event, payload, letimerMicroseconds(), 0)) {
+        // only report the first loss, the count keeps going
+        if (__atomic_fetch_add(&ao->dropped, 1, __ATOMIC_RELAXED) == 0) {
+            scheduler_defer(EVENT_PRIORITY_LOW, report_queue_full, ao->priority);
+        }
+        return true;
+    }
+
+    if (ao->priority == AO_PRIORITY_MAIN) {
+        sl_bt_external_signal(AO_SIGNAL);
+    }
+    else {
+        NVIC_SetPendingIRQ(level_irqs[ao->priority]);
+    }
+
+    return false;
+}
+
+// private helper, runs one event and updates the object's statistics
+static void run_event(active_object_t* ao, const app_event_t* e) {
+
+    uint64_t start = letimerMicroseconds();
+    uint32_t latency = start - e->timestamp;
+
+    JOURNAL_APP_EVENT(ao->priority, e->event, e->payload);
+
+    PROFILE_START(cycles);
+    ao->handler(ao, e);
+    PROFILE_HANDLER(ao->profile, cycles);
+
+    uint32_t run = letimerMicroseconds() - start;
+
+    ao->handled++;
+    ao->total_latency_us += latency;
+    if (latency > ao->max_latency_us) {
+        ao->max_latency_us = latency;
+    }
+    if (run > ao->max_run_us) {
+        ao->max_run_us = run;
+    }
+}
+
+/*
+ * private helper, runs the objects of one level until their queues are empty
+ * an event posted after the last check pends the level again, so nothing is left behind
+ *
+ * level = level to run
+ */
+static void run_level(ao_priority_t level) {
+
+    ao_priority_t preempted = running_level;
+    if (preempted != AO_PRIORITY_MAIN) {
+        preemptions++;
+    }
+    running_level = level;
+
+    app_event_t e;
+    bool busy = true;
+
+    while (busy) {
+        busy = false;
+
+        for (active_object_t* ao = levels[level]; ao != 0; ao = ao->next) {
+            if (!event_ring_read(&ao->queue, &e)) {
+                run_event(ao, &e);
+                busy = true;
+            }
+        }
+    }
+
+    running_level = preempted;
+}
+
+// runs the main loop objects
+void ao_run_main() {
+    run_level(AO_PRIORITY_MAIN);
+}
+
+void VDAC0_IRQHandler() {
+    run_level(AO_PRIORITY_LOW);
+}
+
+void CSEN_IRQHandler() {
+    run_level(AO_PRIORITY_HIGH);
+}
+
+// print how long events waited and ran for each object, for measuring preemption
+void print_ao_stats() {
+
+    LOG_INFO("Active objects: %u preemptions", (unsigned int) preemptions);
+
+    for (int level=NUM_AO_PRIORITIES-1; level>=0; level--) {
+        for (active_object_t* ao = levels[level]; ao != 0; ao = ao->next) {
+
+            uint32_t avg = (ao->handled > 0) ? (ao->total_latency_us / ao->handled) : 0;
+
+            LOG_INFO("  %-8s level %d: %u events, %u dropped, latency avg %u us max %u us, run max %u us",
+                     ao->name, level, (unsigned int) ao->handled, (unsigned int) ao->dropped, (unsigned int) avg,
+                     (unsigned int) ao->max_latency_us, (unsigned int) ao->max_run_us);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * active_object.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_ACTIVE_OBJECT_H_
+#define SRC_ACTIVE_OBJECT_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "event_queue.h"
+#include "profiler.h"
+
+// scheduling levels, a posted event preempts anything running at a lower level
+typedef enum {
+    AO_PRIORITY_MAIN, // main loop with the bluetooth stack, the only level that may call sl_bt_*()
+    AO_PRIORITY_LOW, // slow work, display redraws
+    AO_PRIORITY_HIGH, // sensor workflow
+    NUM_AO_PRIORITIES
+} ao_priority_t;
+
+struct active_object;
+
+// runs one event to completion, the event values are private to each object
+typedef void (*ao_handler_t)(struct active_object* ao, const app_event_t* e);
+
+/*
+ * one active object, owned by its module and usually static
+ * only name, priority, handler and profile are set by the owner, e.g.
+ *     static active_object_t ao = { .name = "display", .priority = AO_PRIORITY_LOW, .handler = redraw, .profile = PROFILE_AO_DISPLAY };
+ */
+typedef struct active_object {
+    const char* name;
+    ao_priority_t priority;
+    ao_handler_t handler;
+    profile_handler_t profile; // histogram for the handler's run times
+
+    // private
+    event_ring_t queue;
+    struct active_object* next; // objects at the same level
+    uint32_t handled; // events run
+    volatile uint32_t dropped; // posts lost to a full queue
+    uint64_t total_latency_us; // post to start of the handler
+    uint32_t max_latency_us;
+    uint32_t max_run_us; // longest handler, including time spent preempted
+} active_object_t;
+
+void ao_start(active_object_t* ao);
+bool ao_post(active_object_t* ao, uint8_t event, uint32_t payload);
+
+// called from the main loop on the external signal
+void ao_run_main();
+
+void print_ao_stats();
+
+#endif /* SRC_ACTIVE_OBJECT_H_ */
@@ -12,134 +12,136 @@
 #include "ble_device_type.h"
 #include "scheduler.h"
 #include "math.h"
+#include "string.h"
 #include "gpio.h"
+#include "irq.h"
+#include "active_object.h"
+#include "profiler.h"
+#include "heart_sensor.h"
+#include "ppg_estimator.h"
+#include "sw_timer.h"
 
 // enable logging for errors
 #define INCLUDE_LOG_DEBUG 1
 #include "log.h"
 
 
-// CIRCULAR BUFFER CODE
+// OUTBOUND INDICATIONS
 
-#define QUEUE_DEPTH      (16)
+// queued indications older than this are logged when they are finally sent
+#define PUBLISH_STALE_US   (1000000)
 
-typedef struct {
-    uint16_t charHandle; // Char handle from gatt_db.h
-    size_t bufferLength; // Length of buffer in bytes to send
-
-    // Need space for HTM (5 bytes) and button_state (2 bytes) indications, buffer[0] holds the flag byte
-    uint8_t buffer[5]; // The actual data buffer for the indication.
-
-} queue_struct_t;
-
-// Declare memory for the queue/buffer/fifo, and the write and read pointers
-queue_struct_t   my_queue[QUEUE_DEPTH]; // the queue
-uint32_t         wptr = 0;              // write pointer
-uint32_t         rptr = 0;              // read pointer
-int num_queue_entries = 0; // how many elements are in the buffer
-
-
-// ---------------------------------------------------------------------
-// Private function used only by this .c file.
-// compute next ptr value
-// Isolation of functionality: This defines "how" a pointer advances.
-// ---------------------------------------------------------------------
-static uint32_t nextPtr(uint32_t ptr) {
-
-  if (ptr + 1 == QUEUE_DEPTH) {
-      return 0; // wrap back to beginning of queue
-  }
-  else {
-      return ptr + 1; // advance by 1
-  }
-
-}
+// longest indication value, HTM is a flag byte and a 32-bit FLOAT, PLX spot check a flag byte and 2 SFLOATs
+#define PUBLISH_MAX_LENGTH (5)
 
+// characteristics that are indicated, each keeps only its latest value while another indication is in flight
+typedef enum {
+    INDICATE_BUTTON_STATE,
+    INDICATE_SPOT_CHECK,
+    INDICATE_TEMPERATURE,
+    NUM_INDICATED_CHARS
+} indicated_char_t;
 
-// status check for enqueuing
-bool queue_full() {
-    if (num_queue_entries == QUEUE_DEPTH)
-        return true;
-    else
-        return false;
-}
+typedef struct {
+    uint16_t charHandle; // Char handle from gatt_db.h
+    const char* name;
+} publish_desc_t;
 
+static const publish_desc_t indicated_chars[NUM_INDICATED_CHARS] = {
+    [INDICATE_BUTTON_STATE] = { gattdb_button_state,               "button" },
+    [INDICATE_SPOT_CHECK]   = { gattdb_plx_spot_check_measurement, "spot check" },
+    [INDICATE_TEMPERATURE]  = { gattdb_temperature_measurement,    "temp" }
+};
 
-// status check for dequeuing
-bool queue_empty() {
-    if (num_queue_entries == 0)
-        return true;
-    else
-        return false;
-}
+typedef struct {
+    bool pending; // a value is waiting for the indication in flight to be confirmed
+    uint8_t bufferLength; // Length of buffer in bytes to send
+    uint8_t buffer[PUBLISH_MAX_LENGTH]; // buffer[0] holds the flag byte
+    uint64_t timestamp; // us since startup when the pending value was queued
 
+    uint32_t sent; // indications sent
+    uint32_t coalesced; // pending values replaced by a newer reading before they were sent
+    uint32_t dropped; // pending values thrown away by a disconnect, an unsubscribe or a failed send
+} publish_slot_t;
 
-// ---------------------------------------------------------------------
-// Public function
-// This function writes an entry to the queue.
-// Returns false if successful or true if writing to a full fifo.
-// ---------------------------------------------------------------------
-bool write_queue(uint16_t charHandle, size_t bufferLength, uint8_t* buffer) {
+static publish_slot_t publish_slots[NUM_INDICATED_CHARS];
 
-  // nothing enqueued, fifo full
-  if (queue_full()) {
-      return true;
-  }
+// slot sent last, the search for the next pending value starts after it so no characteristic starves
+static indicated_char_t publish_last = NUM_INDICATED_CHARS - 1;
 
-  // element enqueued
-  my_queue[wptr].charHandle = charHandle;
-  my_queue[wptr].bufferLength = bufferLength;
 
-  for (int i=0; i<5; i++) {
-      my_queue[wptr].buffer[i] = buffer[i];
-  }
+// STREAMING NOTIFICATIONS
 
-  wptr = nextPtr(wptr);
-  num_queue_entries++;
+// largest ATT MTU offered, the stack's GATT client asks the peer for it after connecting
+#define STREAM_MAX_MTU     (247)
+#define ATT_DEFAULT_MTU    (23)
+#define ATT_NOTIFY_HEADER  (3) // opcode and handle
 
-  return false;
+/*
+ * Heart Stream notification, little endian:
+ *     u16 sequence, u32 ms since startup of the first sample, then per sample
+ *     u16 ms after the first sample, u16 heart rate, u8 SpO2, u8 confidence, u8 finger status
+ * the sequence counts every batch, gaps are batches the stack had no room for
+ */
+#define STREAM_HEADER_SIZE (6)
+#define STREAM_SAMPLE_SIZE (7)
+#define STREAM_MAX_SAMPLES ((STREAM_MAX_MTU - ATT_NOTIFY_HEADER - STREAM_HEADER_SIZE) / STREAM_SAMPLE_SIZE)
 
-}
+// a partial batch is sent once it has waited this long
+#define STREAM_MAX_AGE_US  (1000000)
 
+typedef struct {
+    uint8_t buffer[STREAM_HEADER_SIZE + (STREAM_MAX_SAMPLES * STREAM_SAMPLE_SIZE)];
+    uint8_t num_samples;
+    uint32_t first_ms; // ms since startup of the first sample
+    uint16_t sequence; // of the batch being filled
 
-// ---------------------------------------------------------------------
-// Public function
-// This function reads an entry from the queue.
-// Returns false if successful or true if reading from an empty fifo.
-// ---------------------------------------------------------------------
-bool read_queue(uint16_t* charHandle, size_t* bufferLength, uint8_t* buffer) {
+    uint32_t sent; // notifications sent
+    uint32_t samples_sent;
+    uint32_t dropped; // notifications the stack refused
+} stream_batch_t;
 
-  // nothing dequeued, fifo empty
-  if (queue_empty()) {
-      return true;
-  }
+static stream_batch_t stream;
 
-  // element dequeued
-  *charHandle = my_queue[rptr].charHandle;
-  *bufferLength = my_queue[rptr].bufferLength;
+static void stream_age_expired(void* context);
 
-  for (int i=0; i<5; i++) {
-      buffer[i] = my_queue[rptr].buffer[i];
-  }
+// runs from the main loop, the stack API isn't reentrant
+static sw_timer_t stream_age_timer = { .callback = stream_age_expired };
 
-  rptr = nextPtr(rptr);
-  num_queue_entries--;
 
-  return false;
+// HEART RATE AND PULSE OXIMETER SERVICES
 
-}
+// Heart Rate Measurement and PLX Continuous Measurement are sent at most this often,
+// the RR intervals of the beats in between go out together
+#define MEASUREMENT_INTERVAL_US (1000000)
 
+// Heart Rate Measurement flags
+#define HRM_FLAG_HR_UINT16          0x01
+#define HRM_FLAG_CONTACT_DETECTED   0x02
+#define HRM_FLAG_CONTACT_SUPPORTED  0x04
+#define HRM_FLAG_ENERGY_EXPENDED    0x08
+#define HRM_FLAG_RR_INTERVALS       0x10
 
-// END OF CIRCULAR BUFFER CODE
+// the spec asks for energy expended in at least every 10th measurement
+#define HRM_ENERGY_EVERY 10
 
+// Heart Rate Control Point
+#define HRCP_RESET_ENERGY_EXPENDED  0x01
+#define ATT_HRCP_NOT_SUPPORTED      0x80
 
-// 2nd soft timer setup
-#define QUEUE_HANDLE 3
+/*
+ * energy expended estimated from heart rate alone (Keytel et al. 2005), in J/min
+ *     630.9 * HR - 55096.9 + 198.8 * weight kg + 201.7 * age years
+ * for an assumed 70 kg, 30 year old wearer, both sides scaled by 10
+ */
+#define EE_WEIGHT_KG        70
+#define EE_AGE_YEARS        30
+#define EE_RATE_PER_BPM_X10 6309
+#define EE_RATE_OFFSET_X10  (-550969 + (1988 * EE_WEIGHT_KG) + (2017 * EE_AGE_YEARS))
 
-// 3268 = 0.1 sec = 100 ms
-// 1635 = 50 ms
-// 327 = 0.01 sec = 10 ms
-#define QUEUE_TIMER_INTERVAL 1635
+static uint64_t energy_mj = 0; // since startup or the last control point reset
+static uint64_t last_measurement_us = 0; // 0 = none sent yet
+static uint32_t measurements_sent = 0;
 
 sl_status_t status; // return variable for various api calls
 
@@ -171,6 +173,187 @@ ble_data_struct_t* get_ble_data_ptr() {
             (a1.addr[5] == a2.addr[5]));
 }*/
 
+/*
+ * private helper, sends the next pending value when no indication is in flight
+ * runs when a value is queued and when the client confirms the last indication,
+ * so nothing waits on a poll and nothing wakes up while all slots are empty
+ */
+static void publish_next() {
+
+    if (ble_data.indicationInFlight || !ble_data.connectionOpen || !ble_data.bonded) {
+        return;
+    }
+
+    for (int i=1; i<=NUM_INDICATED_CHARS; i++) {
+        indicated_char_t c = (publish_last + i) % NUM_INDICATED_CHARS;
+        publish_slot_t* slot = &publish_slots[c];
+
+        if (!slot->pending) {
+            continue;
+        }
+
+        slot->pending = false;
+        publish_last = c;
+
+        uint64_t queued_us = letimerMicroseconds() - slot->timestamp;
+        if (queued_us > PUBLISH_STALE_US) {
+            LOG_WARN("Indication for %s was queued for %u ms", indicated_chars[c].name, (unsigned int) (queued_us / 1000));
+        }
+
+        status = sl_bt_gatt_server_send_indication(
+                ble_data.serverConnectionHandle,
+                indicated_chars[c].charHandle, // characteristic from gatt_db.h
+                slot->bufferLength, // value length
+                slot->buffer // value
+                );
+
+        if (status != SL_STATUS_OK) {
+            LOG_ERROR("%s sl_bt_gatt_server_send_indication", indicated_chars[c].name);
+            slot->dropped++;
+            continue;
+        }
+
+        slot->sent++;
+        conn_policy_sent(slot->bufferLength);
+        ble_data.indicationInFlight = true;
+        return;
+    }
+}
+
+/*
+ * private helper, queues a value for indication, replacing any older value still pending
+ *
+ * c = characteristic to indicate
+ * buffer = value, starting with the flag byte
+ * bufferLength = num bytes, at most PUBLISH_MAX_LENGTH
+ */
+static void publish_value(indicated_char_t c, const uint8_t* buffer, uint8_t bufferLength) {
+
+    publish_slot_t* slot = &publish_slots[c];
+
+    if (slot->pending) {
+        slot->coalesced++;
+    }
+
+    memcpy(slot->buffer, buffer, bufferLength);
+    slot->bufferLength = bufferLength;
+    slot->timestamp = letimerMicroseconds();
+    slot->pending = true;
+
+    publish_next();
+}
+
+// private helper, throws away a pending value the client can no longer receive
+static void publish_discard(indicated_char_t c) {
+
+    if (publish_slots[c].pending) {
+        publish_slots[c].pending = false;
+        publish_slots[c].dropped++;
+    }
+}
+
+// private helper, samples that fit in one notification at the current MTU
+static uint8_t stream_capacity() {
+
+    uint16_t capacity = (ble_data.mtu - ATT_NOTIFY_HEADER - STREAM_HEADER_SIZE) / STREAM_SAMPLE_SIZE;
+
+    return (capacity < STREAM_MAX_SAMPLES) ? capacity : STREAM_MAX_SAMPLES;
+}
+
+// private helper, sends the samples batched so far as one notification
+static void stream_flush() {
+
+    sw_timer_stop(&stream_age_timer);
+
+    if (stream.num_samples == 0) {
+        return;
+    }
+
+    uint8_t* p = stream.buffer;
+    UINT16_TO_BITSTREAM(p, stream.sequence);
+    UINT32_TO_BITSTREAM(p, stream.first_ms);
+
+    status = sl_bt_gatt_server_send_notification(
+            ble_data.serverConnectionHandle,
+            gattdb_heart_stream, // characteristic from gatt_db.h
+            STREAM_HEADER_SIZE + (stream.num_samples * STREAM_SAMPLE_SIZE), // value length
+            stream.buffer // value
+            );
+
+    if (status != SL_STATUS_OK) {
+        LOG_ERROR("STREAM sl_bt_gatt_server_send_notification");
+        stream.dropped++;
+
+        // out of buffers, the link is too slow for the stream
+        conn_policy_burst();
+    }
+    else {
+        stream.sent++;
+        stream.samples_sent += stream.num_samples;
+        conn_policy_sent(STREAM_HEADER_SIZE + (stream.num_samples * STREAM_SAMPLE_SIZE));
+    }
+
+    stream.sequence++;
+    stream.num_samples = 0;
+}
+
+// private helper, the age limit passed before the batch filled up
+static void stream_age_expired(void* context) {
+    (void) context;
+
+    stream_flush();
+}
+
+/*
+ * private helper, adds a sample to the batch and sends the batch once no more fit
+ *
+ * sample = sample to add
+ */
+static void stream_add(const heart_sensor_data* sample) {
+
+    uint32_t sample_ms = sample->timestamp / 1000;
+
+    if (stream.num_samples == 0) {
+        stream.first_ms = sample_ms;
+        sw_timer_start(&stream_age_timer, STREAM_MAX_AGE_US, 0);
+    }
+
+    uint8_t* p = &stream.buffer[STREAM_HEADER_SIZE + (stream.num_samples * STREAM_SAMPLE_SIZE)];
+    UINT16_TO_BITSTREAM(p, sample_ms - stream.first_ms);
+    UINT16_TO_BITSTREAM(p, sample->heart_rate);
+    UINT8_TO_BITSTREAM(p, sample->blood_oxygen);
+    UINT8_TO_BITSTREAM(p, sample->confidence);
+    UINT8_TO_BITSTREAM(p, sample->finger_status);
+
+    stream.num_samples++;
+
+    if (stream.num_samples >= stream_capacity()) {
+        stream_flush();
+    }
+}
+
+// private helper, throws away a partial batch the client can no longer receive
+static void stream_discard() {
+    sw_timer_stop(&stream_age_timer);
+    stream.num_samples = 0;
+}
+
+// print what happened to the values queued for each indicated characteristic
+void print_ble_stats() {
+
+    LOG_INFO("Indications:");
+
+    for (int c=0; c<NUM_INDICATED_CHARS; c++) {
+        LOG_INFO("  %-10s %u sent, %u coalesced, %u dropped", indicated_chars[c].name,
+                 (unsigned int) publish_slots[c].sent, (unsigned int) publish_slots[c].coalesced,
+                 (unsigned int) publish_slots[c].dropped);
+    }
+
+    LOG_INFO("  %-10s %u sent, %u samples, %u dropped, MTU %d", "stream",
+             (unsigned int) stream.sent, (unsigned int) stream.samples_sent,
+             (unsigned int) stream.dropped, ble_data.mtu);
+}
+
 // called by external signal to send push button indications to client
 void ble_transmit_button_state() {
 
@@ -182,127 +365,288 @@ void ble_transmit_button_state() {
     // connection open AND button_state indications are enabled AND bonded
     if (ble_data.connectionOpen && ble_data.pbIndicationsEnabled && ble_data.bonded) {
 
-        // no indication in flight, send right away
-        if (!(ble_data.indicationInFlight)) {
-            status = sl_bt_gatt_server_send_indication(
-                    ble_data.serverConnectionHandle,
-                    gattdb_button_state, // characteristic from gatt_db.h
-                    2, // value length
-                    pb_buffer // value
-                    );
+        // sent right away unless another indication is in flight
+        publish_value(INDICATE_BUTTON_STATE, pb_buffer, 2);
+    }
+}
 
+// called by the publisher with a confident reading, sends it as a PLX spot check
+void ble_transmit_heart_data() {
 
-            if (status != SL_STATUS_OK) {
-                LOG_ERROR("PB sl_bt_gatt_server_send_indication");
-            }
-            else {
-                ble_data.indicationInFlight = true;
-            }
-        }
-        else { // put into circular buffer, send later
-            CORE_DECLARE_IRQ_STATE;
-            CORE_ENTER_CRITICAL();
-            write_queue(gattdb_button_state, 2, pb_buffer);
-            CORE_EXIT_CRITICAL();
-        }
+    uint8_t plx_buffer[5];
+    uint8_t* p = plx_buffer;
+
+    UINT8_TO_BITSTREAM(p, 0); // flags byte, no time stamp, status or pulse amplitude index
+    UINT16_TO_BITSTREAM(p, UINT16_TO_SFLOAT(ble_data.blood_oxygen, 0));
+    UINT16_TO_BITSTREAM(p, UINT16_TO_SFLOAT(ble_data.heart_rate, 0));
+
+    if (ble_data.connectionOpen && ble_data.spotCheckIndicationsEnabled && ble_data.bonded) {
+
+        // sent right away unless another indication is in flight
+        publish_value(INDICATE_SPOT_CHECK, plx_buffer, 5);
     }
 }
 
-// called in state machine to send heart rate and blood oxygen data to client
-void ble_transmit_heart_data() {
+// called in state machine to send the Si7021 temperature to client
+void ble_transmit_temperature() {
+
+    uint8_t htm_buffer[5];
+    uint8_t* p = htm_buffer;
 
-    uint8_t data1 = ble_data.heart_rate;
-    uint8_t data2 = ble_data.blood_oxygen;
+    // IEEE-11073 32-bit FLOAT, millidegrees with an exponent of -3
+    uint32_t htm_temperature_flt = UINT32_TO_FLOAT(ble_data.tempMeasurement, -3);
 
-    //LOG_INFO("GATT WRITE: %d  %d", data1, data2);
+    UINT8_TO_BITSTREAM(p, 0); // flags byte, celsius, no time stamp or type
+    UINT32_TO_BITSTREAM(p, htm_temperature_flt);
 
     // write value to GATT database
     status = sl_bt_gatt_server_write_attribute_value(
-            gattdb_heart_rate_measurement, // characteristic from gatt_db.h
+            gattdb_temperature_measurement, // characteristic from gatt_db.h
             0, // offset
-            1, // length
-            &data1 // pointer to value
+            5, // length
+            htm_buffer // pointer to value
             );
 
     if (status != SL_STATUS_OK) {
-        LOG_ERROR("HEART RATE sl_bt_gatt_server_write_attribute_value");
+        LOG_ERROR("TEMPERATURE sl_bt_gatt_server_write_attribute_value");
     }
 
-    // write value to GATT database
-    status = sl_bt_gatt_server_write_attribute_value(
-            gattdb_blood_oxygen_measurement, // characteristic from gatt_db.h
-            0, // offset
-            1, // length
-            &data2 // pointer to value
+    if (ble_data.connectionOpen && ble_data.tempIndicationsEnabled && ble_data.bonded) {
+
+        // sent right away unless another indication is in flight
+        publish_value(INDICATE_TEMPERATURE, htm_buffer, 5);
+    }
+}
+
+/*
+ * private helper, sends a Heart Rate Measurement with the RR intervals since the last one
+ * 16-bit heart rate, sensor contact, energy expended in every HRM_ENERGY_EVERY'th,
+ * then as many RR intervals as fit, the rest wait for the next measurement
+ *
+ * heart_rate = beats per minute
+ * contact = finger on the sensor
+ */
+static void send_heart_rate_measurement(uint16_t heart_rate, bool contact) {
+
+    uint8_t hrm_buffer[STREAM_MAX_MTU - ATT_NOTIFY_HEADER];
+    uint8_t* end = &hrm_buffer[ble_data.mtu - ATT_NOTIFY_HEADER];
+    uint8_t* p = &hrm_buffer[1]; // flags byte goes in last
+
+    uint8_t flags = HRM_FLAG_HR_UINT16 | HRM_FLAG_CONTACT_SUPPORTED;
+    if (contact) {
+        flags |= HRM_FLAG_CONTACT_DETECTED;
+    }
+
+    UINT16_TO_BITSTREAM(p, heart_rate);
+
+    if ((measurements_sent % HRM_ENERGY_EVERY) == 0) {
+        uint64_t kj = energy_mj / 1000000;
+        flags |= HRM_FLAG_ENERGY_EXPENDED;
+        UINT16_TO_BITSTREAM(p, (kj > 0xFFFF) ? 0xFFFF : kj);
+    }
+
+    uint16_t rr;
+    while (((p + 2) <= end) && !ppg_estimator_read_rr(&rr)) {
+        flags |= HRM_FLAG_RR_INTERVALS;
+        UINT16_TO_BITSTREAM(p, rr);
+    }
+
+    hrm_buffer[0] = flags;
+
+    status = sl_bt_gatt_server_send_notification(
+            ble_data.serverConnectionHandle,
+            gattdb_heart_rate_measurement, // characteristic from gatt_db.h
+            p - hrm_buffer, // value length
+            hrm_buffer // value
             );
 
     if (status != SL_STATUS_OK) {
-        LOG_ERROR("BLOOD OXYGEN sl_bt_gatt_server_write_attribute_value");
+        LOG_ERROR("HEART RATE sl_bt_gatt_server_send_notification");
+    }
+    else {
+        conn_policy_sent(p - hrm_buffer);
     }
 
-    uint8_t data_buffer[2];
-    data_buffer[0] = 0; // flags byte
-    data_buffer[1] = ble_data.heart_rate;
+    measurements_sent++;
+}
 
-    if (ble_data.connectionOpen && ble_data.heartRateIndicationsEnabled && ble_data.bonded) {
+/*
+ * private helper, sends a PLX Continuous Measurement, SpO2 and pulse rate as SFLOATs
+ *
+ * sample = newest sample
+ * contact = finger on the sensor, otherwise both values are NaN
+ */
+static void send_plx_continuous(const heart_sensor_data* sample, bool contact) {
 
-        // no indication in flight, send right away
-        if (!(ble_data.indicationInFlight)) {
-            status = sl_bt_gatt_server_send_indication(
-                    ble_data.serverConnectionHandle,
-                    gattdb_heart_rate_measurement, // characteristic from gatt_db.h
-                    2, // value length
-                    data_buffer // value
-                    );
+    uint8_t plx_buffer[5];
+    uint8_t* p = plx_buffer;
 
+    UINT8_TO_BITSTREAM(p, 0); // flags byte, no fast, slow, status or pulse amplitude index fields
+    UINT16_TO_BITSTREAM(p, contact ? UINT16_TO_SFLOAT(sample->blood_oxygen, 0) : SFLOAT_NAN);
+    UINT16_TO_BITSTREAM(p, contact ? UINT16_TO_SFLOAT(sample->heart_rate, 0) : SFLOAT_NAN);
 
-            if (status != SL_STATUS_OK) {
-                LOG_ERROR("HEART RATE sl_bt_gatt_server_send_indication");
-            }
-            else {
-                ble_data.indicationInFlight = true;
-            }
-        }
-        else { // put into circular buffer, send later
-            //LOG_INFO("HR CIRC QUEUE");
-            CORE_DECLARE_IRQ_STATE;
-            CORE_ENTER_CRITICAL();
-            write_queue(gattdb_heart_rate_measurement, 2, data_buffer);
-            CORE_EXIT_CRITICAL();
-        }
+    status = sl_bt_gatt_server_send_notification(
+            ble_data.serverConnectionHandle,
+            gattdb_plx_continuous_measurement, // characteristic from gatt_db.h
+            5, // value length
+            plx_buffer // value
+            );
+
+    if (status != SL_STATUS_OK) {
+        LOG_ERROR("PLX sl_bt_gatt_server_send_notification");
+    }
+    else {
+        conn_policy_sent(sizeof(plx_buffer));
     }
+}
 
-    data_buffer[0] = 0; // flags byte
-    data_buffer[1] = ble_data.blood_oxygen;
+/*
+ * private helper, the periodic measurements of the Heart Rate and Pulse Oximeter services
+ * energy expended keeps counting while nobody is subscribed, RR intervals are only kept for a subscriber
+ *
+ * sample = newest sample
+ */
+static void send_measurements(const heart_sensor_data* sample) {
 
-    if (ble_data.connectionOpen && ble_data.bloodOxygenIndicationsEnabled && ble_data.bonded) {
+    uint64_t now = letimerMicroseconds();
 
-        // no indication in flight, send right away
-        if (!(ble_data.indicationInFlight)) {
-            status = sl_bt_gatt_server_send_indication(
-                    ble_data.serverConnectionHandle,
-                    gattdb_blood_oxygen_measurement, // characteristic from gatt_db.h
-                    2, // value length
-                    data_buffer // value
-                    );
+    if ((last_measurement_us != 0) && ((now - last_measurement_us) < MEASUREMENT_INTERVAL_US)) {
+        return;
+    }
 
+    bool contact = (sample->finger_status == FINGER_DETECTED);
 
-            if (status != SL_STATUS_OK) {
-                LOG_ERROR("BLOOD OXYGEN sl_bt_gatt_server_send_indication");
-            }
-            else {
-                ble_data.indicationInFlight = true;
-            }
+    if (contact && (last_measurement_us != 0)) {
+        int32_t rate_x10 = (EE_RATE_PER_BPM_X10 * sample->heart_rate) + EE_RATE_OFFSET_X10;
+
+        // J/min * ms / 60 = mJ
+        if (rate_x10 > 0) {
+            energy_mj += ((uint64_t) rate_x10 * ((now - last_measurement_us) / 1000)) / 600;
         }
-        else { // put into circular buffer, send later
-            //LOG_INFO("BLOOD OX CIRC QUEUE");
-            CORE_DECLARE_IRQ_STATE;
-            CORE_ENTER_CRITICAL();
-            write_queue(gattdb_blood_oxygen_measurement, 2, data_buffer);
-            CORE_EXIT_CRITICAL();
+    }
+
+    last_measurement_us = now;
+
+    bool connected = ble_data.connectionOpen && ble_data.bonded;
+
+    if (connected && ble_data.heartRateNotificationsEnabled) {
+        send_heart_rate_measurement(sample->heart_rate, contact);
+    }
+    else {
+        uint16_t rr;
+        while (!ppg_estimator_read_rr(&rr));
+    }
+
+    if (connected && ble_data.plxContinuousNotificationsEnabled) {
+        send_plx_continuous(sample, contact);
+    }
+}
+
+// private helper, batches new heart sensor samples into stream notifications
+// the ring is drained either way so it only holds samples newer than the last reading
+static void stream_samples() {
+
+    heart_sensor_data sample;
+    bool streaming = ble_data.connectionOpen && ble_data.streamNotificationsEnabled && ble_data.bonded;
+    bool have_sample = false;
+    uint8_t num_samples = 0;
+
+    while (!read_heart_sample(&sample)) {
+        have_sample = true;
+        num_samples++;
+
+        if (streaming) {
+            stream_add(&sample);
         }
     }
 
+    // more than one notification per hub read, a backlog builds at a slow interval
+    if (streaming && (num_samples > stream_capacity())) {
+        conn_policy_burst();
+    }
+
+    // the newest sample is the current heart rate and SpO2
+    if (have_sample) {
+        send_measurements(&sample);
+    }
+}
+
+// events of the publisher active object
+typedef enum {
+    PUBLISH_HEART_DATA, // payload = heart rate | blood oxygen << 16 | confidence << 24
+    PUBLISH_TEMPERATURE, // payload = millidegrees C
+    PUBLISH_SAMPLES, // drain the heart sensor sample ring
+    PUBLISH_ACTIVITY // payload = conn_activity_t
+} publisher_events_t;
+
+/*
+ * publisher active object handler, runs in the main loop because the stack API isn't reentrant
+ * the readings come in the payload so the sensor side never writes ble_data
+ *
+ * ao = publisher
+ * e = event to handle
+ */
+static void publisher_handler(active_object_t* ao, const app_event_t* e) {
+    (void) ao;
+
+    switch (e->event) {
+
+        case PUBLISH_HEART_DATA:
+            ble_data.heart_rate = e->payload & 0xFFFF;
+            ble_data.blood_oxygen = (e->payload >> 16) & 0xFF;
+            ble_data.confidence = e->payload >> 24;
+            ble_transmit_heart_data();
+            break;
+
+        case PUBLISH_TEMPERATURE:
+            ble_data.tempMeasurement = (int32_t) e->payload;
+            ble_transmit_temperature();
+            break;
+
+        case PUBLISH_SAMPLES:
+            stream_samples();
+            break;
+
+        case PUBLISH_ACTIVITY:
+            conn_policy_set_activity(e->payload);
+            break;
+    }
+}
+
+static active_object_t publisher_ao = { .name = "ble", .priority = AO_PRIORITY_MAIN, .handler = publisher_handler, .profile = PROFILE_AO_BLE };
+
+/*
+ * queue a heart reading for the GATT database and indications, safe from any active object
+ *
+ * heart_rate = beats per minute
+ * blood_oxygen = SpO2 in %
+ * confidence = hub confidence in %
+ */
+void ble_publish_heart_data(uint16_t heart_rate, uint8_t blood_oxygen, uint8_t confidence) {
+    ao_post(&publisher_ao, PUBLISH_HEART_DATA, heart_rate | ((uint32_t) blood_oxygen << 16) | ((uint32_t) confidence << 24));
+}
+
+/*
+ * queue a temperature for the GATT database and indications, safe from any active object
+ *
+ * temperature = millidegrees C
+ */
+void ble_publish_temperature(int32_t temperature) {
+    ao_post(&publisher_ao, PUBLISH_TEMPERATURE, (uint32_t) temperature);
+}
+
+// queue the samples from the last hub read for the stream, safe from any active object
+void ble_publish_samples() {
+    ao_post(&publisher_ao, PUBLISH_SAMPLES, 0);
+}
+
+/*
+ * tell the connection policy what the sensor workflow is doing, safe from any active object
+ *
+ * activity = new activity
+ */
+void ble_publish_activity(conn_activity_t activity) {
+    ao_post(&publisher_ao, PUBLISH_ACTIVITY, activity);
 }
 
 // COMMON SERVER + CLIENT EVENTS BELOW
@@ -322,6 +666,17 @@ void ble_boot_event() {
     ble_data.pb0Pressed = false;
     ble_data.passkeyConfirm = false;
 
+    // readings are published through this once the sensor workflow starts
+    ao_start(&publisher_ao);
+
+    // stream batches fill the largest notification the peer accepts
+    uint16_t max_mtu;
+    status = sl_bt_gatt_server_set_max_mtu(STREAM_MAX_MTU, &max_mtu);
+
+    if (status != SL_STATUS_OK) {
+        LOG_ERROR("sl_bt_gatt_server_set_max_mtu");
+    }
+
     // initialize the security manager
     uint8_t flags = 0x0F; // Bonding requires MITM protection, Encryption requires bonding, Secure connections only, Bonding requests need to be confirmed
     status = sl_bt_sm_configure(flags, sm_io_capability_displayyesno);
@@ -364,6 +719,9 @@ void ble_boot_event() {
     if (status != SL_STATUS_OK) {
         LOG_ERROR("sl_bt_advertiser_start");
     }
+    else {
+        LOG_INFO("Boot trace: advertising at %d ms", letimerMilliseconds());
+    }
 
     // enable the LCD
     displayInit(); // starts a 1 second soft timer
@@ -394,6 +752,7 @@ void ble_connection_opened_event(sl_bt_msg_t* evt) {
     ble_data.connectionOpen = true;
     ble_data.indicationInFlight = false;
     ble_data.serverConnectionHandle = evt->data.evt_connection_opened.connection;
+    ble_data.mtu = ATT_DEFAULT_MTU; // until the exchange completes
 
     // Stop advertising
     status = sl_bt_advertiser_stop(ble_data.advertisingSetHandle);
@@ -402,39 +761,11 @@ void ble_connection_opened_event(sl_bt_msg_t* evt) {
         LOG_ERROR("sl_bt_advertiser_stop");
     }
 
-    uint16_t min_interval = 60; // Value = Time in ms / 1.25 ms = 75 / 1.25 = 60
-    uint16_t max_interval = 60; // same math
-    uint16_t latency = 3; // how many connection intervals the slave can skip - off air for up to 300 ms
-
-    // value greater than (1 + slave latency) * (connection_interval * 2) = (1 + 3) * (75 * 2) = 4 * 150 = 600 ms
-    // Value = Time / 10 ms = 600 / 10 = 60 -> use 80
-    uint16_t timeout = 80;
-
-    uint16_t min_ce_length = 0; // default
-    uint16_t max_ce_length = 0xffff; // no limitation
-
-    // Send a request with a set of parameters to the master
-    status = sl_bt_connection_set_parameters(ble_data.serverConnectionHandle,
-                                             min_interval,
-                                             max_interval,
-                                             latency,
-                                             timeout,
-                                             min_ce_length,
-                                             max_ce_length);
-
-    if (status != SL_STATUS_OK) {
-        LOG_ERROR("sl_bt_connection_set_parameters");
-    }
+    // parameters follow the sensor workflow from here on
+    conn_policy_opened(ble_data.serverConnectionHandle);
 
     displayPrintf(DISPLAY_ROW_CONNECTION, "Connected");
 
-    // start a 2nd soft timer for circular queue checks
-    status = sl_bt_system_set_soft_timer(QUEUE_TIMER_INTERVAL, QUEUE_HANDLE, false);
-
-    if (status != SL_STATUS_OK) {
-        LOG_ERROR("sl_bt_system_set_soft_timer 2");
-    }
-
 }
 
 // This event indicates that a connection was closed
@@ -451,6 +782,13 @@ void ble_connection_closed_event() {
     ble_data.connectionOpen = false;
     ble_data.bonded = false;
 
+    conn_policy_closed();
+
+    for (int c=0; c<NUM_INDICATED_CHARS; c++) {
+        publish_discard(c);
+    }
+    stream_discard();
+
     // Tells the device to start sending advertising packets
     status = sl_bt_advertiser_start(ble_data.advertisingSetHandle, sl_bt_advertiser_general_discoverable, sl_bt_advertiser_connectable_scannable);
 
@@ -466,27 +804,42 @@ void ble_connection_closed_event() {
 
 }
 
-// Informational: triggered whenever the connection parameters are changed and at any time a connection is established
+// triggered whenever the connection parameters are changed and at any time a connection is established
 void ble_connection_parameters_event(sl_bt_msg_t* evt) {
 
-    // Just a trick to hide a compiler warning about unused input parameter evt.
-    (void) evt;
+    conn_policy_parameters(&evt->data.evt_connection_parameters);
+
+}
 
-    //LOG_INFO("CONNECTION PARAMETERS CHANGED");
+// the PHY update procedure finished, 2M unless the central can't do it
+void ble_connection_phy_status_event(sl_bt_msg_t* evt) {
 
-    // log interval, latency, and timeout values from **client**
-    /*LOG_INFO("interval = %d, latency = %d, timeout = %d",
-             evt->data.evt_connection_parameters.interval,
-             evt->data.evt_connection_parameters.latency,
-             evt->data.evt_connection_parameters.timeout);*/
+    conn_policy_phy(&evt->data.evt_connection_phy_status);
 
 }
 
+/*
+ * the ATT MTU exchange finished, stream batches grow to fill the new size
+ *
+ * evt = event that occurred
+ */
+void ble_gatt_mtu_exchanged_event(sl_bt_msg_t* evt) {
+
+    ble_data.mtu = evt->data.evt_gatt_mtu_exchanged.mtu;
+
+    LOG_INFO("ATT MTU %d, %d samples per stream notification", ble_data.mtu, stream_capacity());
+}
+
 // handles external events
 void ble_external_signal_event(sl_bt_msg_t* evt) {
 
     //LOG_INFO("EXTERNAL SIGNAL EVENT");
 
+    // button level when the interrupt happened, a press and release can be queued together
+    if (evt->data.evt_system_external_signal.extsignals == EVENT_PB0) {
+        ble_data.pb0Pressed = scheduler_event_payload();
+    }
+
     // handle pairing process
     if ((evt->data.evt_system_external_signal.extsignals == EVENT_PB0) && (ble_data.passkeyConfirm == true) && ble_data.pb0Pressed) {
 
@@ -539,46 +892,6 @@ void ble_system_soft_timer_event(sl_bt_msg_t* evt) {
         displayUpdate(); // prevent charge buildup on LCD
     }
 
-    uint16_t charHandle;
-    size_t bufferLength;
-    uint8_t buffer[5];
-    buffer[0] = 0; // set flags
-
-    // every 50 ms
-    if (evt->data.evt_system_soft_timer.handle == QUEUE_HANDLE) {
-        // LOG_INFO("Soft Timer 2");
-
-        /*
-         * check the queue for pending indications
-         *
-         * if: there are queued indications AND no indication in flight
-         * then: remove 1 indication from the tail of queue, send indication, set indication in flight
-         */
-
-         if ((num_queue_entries > 0) && !(ble_data.indicationInFlight)) {
-             CORE_DECLARE_IRQ_STATE;
-             CORE_ENTER_CRITICAL();
-             read_queue (&charHandle, &bufferLength, buffer);
-             CORE_EXIT_CRITICAL();
-
-             status = sl_bt_gatt_server_send_indication(
-                     ble_data.serverConnectionHandle,
-                     charHandle, // characteristic from gatt_db.h
-                     bufferLength, // value length
-                     buffer // value
-                     );
-
-             if (status != SL_STATUS_OK) {
-                 LOG_ERROR("QUEUE sl_bt_gatt_server_send_indication");
-             }
-             else {
-                 ble_data.indicationInFlight = true;
-             }
-
-         }
-
-    }
-
 }
 
 /*
@@ -634,6 +947,7 @@ void ble_server_characteristic_status_event(sl_bt_msg_t* evt) {
         if (status_flags == gatt_server_client_config) {
             if (client_config_flags == gatt_disable) {
                 ble_data.pbIndicationsEnabled = false;
+                publish_discard(INDICATE_BUTTON_STATE);
             }
 
             if (client_config_flags == gatt_indication) {
@@ -646,17 +960,16 @@ void ble_server_characteristic_status_event(sl_bt_msg_t* evt) {
         }
     }
 
-    // heart rate indication handling
-    if (characteristic == gattdb_heart_rate_measurement) {
+    // temperature indication handling
+    if (characteristic == gattdb_temperature_measurement) {
         if (status_flags == gatt_server_client_config) {
             if (client_config_flags == gatt_disable) {
-                ble_data.heartRateIndicationsEnabled = false;
-                gpioLed1SetOff();
+                ble_data.tempIndicationsEnabled = false;
+                publish_discard(INDICATE_TEMPERATURE);
             }
 
             if (client_config_flags == gatt_indication) {
-                gpioLed1SetOn();
-                ble_data.heartRateIndicationsEnabled = true;
+                ble_data.tempIndicationsEnabled = true;
             }
         }
 
@@ -665,17 +978,31 @@ void ble_server_characteristic_status_event(sl_bt_msg_t* evt) {
         }
     }
 
-    // blood oxygen indication handling
-    if (characteristic == gattdb_blood_oxygen_measurement) {
+    // heart rate measurement notification handling
+    if (characteristic == gattdb_heart_rate_measurement) {
+        if (status_flags == gatt_server_client_config) {
+            if (client_config_flags == gatt_disable) {
+                ble_data.heartRateNotificationsEnabled = false;
+                gpioLed1SetOff();
+            }
+
+            if (client_config_flags == gatt_notification) {
+                gpioLed1SetOn();
+                ble_data.heartRateNotificationsEnabled = true;
+            }
+        }
+    }
+
+    // PLX spot check indication handling
+    if (characteristic == gattdb_plx_spot_check_measurement) {
         if (status_flags == gatt_server_client_config) {
             if (client_config_flags == gatt_disable) {
-                ble_data.bloodOxygenIndicationsEnabled = false;
-                //gpioLed0SetOff();
+                ble_data.spotCheckIndicationsEnabled = false;
+                publish_discard(INDICATE_SPOT_CHECK);
             }
 
             if (client_config_flags == gatt_indication) {
-                //gpioLed0SetOn();
-                ble_data.bloodOxygenIndicationsEnabled = true;
+                ble_data.spotCheckIndicationsEnabled = true;
             }
         }
 
@@ -684,6 +1011,38 @@ void ble_server_characteristic_status_event(sl_bt_msg_t* evt) {
         }
     }
 
+    // PLX continuous measurement notification handling
+    if (characteristic == gattdb_plx_continuous_measurement) {
+        if (status_flags == gatt_server_client_config) {
+            if (client_config_flags == gatt_disable) {
+                ble_data.plxContinuousNotificationsEnabled = false;
+            }
+
+            if (client_config_flags == gatt_notification) {
+                ble_data.plxContinuousNotificationsEnabled = true;
+            }
+        }
+    }
+
+    // heart stream notification handling
+    if (characteristic == gattdb_heart_stream) {
+        if (status_flags == gatt_server_client_config) {
+            if (client_config_flags == gatt_disable) {
+                ble_data.streamNotificationsEnabled = false;
+                stream_discard();
+            }
+
+            if (client_config_flags == gatt_notification) {
+                ble_data.streamNotificationsEnabled = true;
+            }
+        }
+    }
+
+    // the client is ready for the next indication
+    if (status_flags == gatt_server_confirmation) {
+        publish_next();
+    }
+
 }
 
 // Possible event from never receiving confirmation for previously transmitted indication
@@ -693,6 +1052,81 @@ void ble_server_indication_timeout_event() {
     ble_data.indicationInFlight = false;
 }
 
+// ATT error for a read past the end of the value
+#define ATT_INVALID_OFFSET 0x07
+
+/*
+ * serves reads of user characteristics, the profiler statistics are built when read
+ * a long read arrives as several requests, the snapshot is taken on the first so the pieces match
+ *
+ * evt = user read request event
+ */
+void ble_server_user_read_request_event(sl_bt_msg_t* evt) {
+
+    static uint8_t profile_buffer[PROFILE_SNAPSHOT_SIZE];
+    static size_t profile_length = 0;
+
+    uint8_t connection = evt->data.evt_gatt_server_user_read_request.connection;
+    uint16_t characteristic = evt->data.evt_gatt_server_user_read_request.characteristic;
+    uint16_t offset = evt->data.evt_gatt_server_user_read_request.offset;
+
+    if (characteristic != gattdb_profile_stats) {
+        return;
+    }
+
+    if (offset == 0) {
+        profile_length = profile_snapshot(profile_buffer, sizeof(profile_buffer));
+    }
+
+    uint8_t att_error = 0;
+    size_t length = 0;
+
+    if (offset > profile_length) {
+        att_error = ATT_INVALID_OFFSET;
+    }
+    else {
+        length = profile_length - offset;
+    }
+
+    uint16_t sent_length;
+    status = sl_bt_gatt_server_send_user_read_response(connection, characteristic, att_error, length, &profile_buffer[offset], &sent_length);
+
+    if (status != SL_STATUS_OK) {
+        LOG_ERROR("sl_bt_gatt_server_send_user_read_response");
+    }
+}
+
+/*
+ * serves writes of user characteristics, the Heart Rate Control Point resets energy expended
+ *
+ * evt = user write request event
+ */
+void ble_server_user_write_request_event(sl_bt_msg_t* evt) {
+
+    uint8_t connection = evt->data.evt_gatt_server_user_write_request.connection;
+    uint16_t characteristic = evt->data.evt_gatt_server_user_write_request.characteristic;
+    uint8array* value = &evt->data.evt_gatt_server_user_write_request.value;
+
+    if (characteristic != gattdb_heart_rate_control_point) {
+        return;
+    }
+
+    uint8_t att_error = 0;
+
+    if ((value->len == 1) && (value->data[0] == HRCP_RESET_ENERGY_EXPENDED)) {
+        energy_mj = 0;
+    }
+    else {
+        att_error = ATT_HRCP_NOT_SUPPORTED;
+    }
+
+    status = sl_bt_gatt_server_send_user_write_response(connection, characteristic, att_error);
+
+    if (status != SL_STATUS_OK) {
+        LOG_ERROR("sl_bt_gatt_server_send_user_write_response");
+    }
+}
+
 // accepts the bonding request
 void ble_server_sm_confirm_bonding_event() {
     status = sl_bt_sm_bonding_confirm(ble_data.serverConnectionHandle, 1);
@@ -728,6 +1162,14 @@ void handle_ble_event(sl_bt_msg_t* evt) {
             ble_connection_parameters_event(evt);
             break;
 
+        case sl_bt_evt_connection_phy_status_id:
+            ble_connection_phy_status_event(evt);
+            break;
+
+        case sl_bt_evt_gatt_mtu_exchanged_id:
+            ble_gatt_mtu_exchanged_event(evt);
+            break;
+
         case sl_bt_evt_system_external_signal_id:
             ble_external_signal_event(evt);
             break;
@@ -761,6 +1203,14 @@ void handle_ble_event(sl_bt_msg_t* evt) {
             ble_server_sm_confirm_bonding_event();
             break;
 
+        case sl_bt_evt_gatt_server_user_read_request_id:
+            ble_server_user_read_request_event(evt);
+            break;
+
+        case sl_bt_evt_gatt_server_user_write_request_id:
+            ble_server_user_write_request_event(evt);
+            break;
+
         // events just for clients
 
     }
@@ -12,13 +12,20 @@
 #include "stdbool.h"
 #include "sl_bgapi.h"
 #include "sl_bt_api.h"
+#include "conn_policy.h"
 
 #define UINT8_TO_BITSTREAM(p, n) { *(p)++ = (uint8_t)(n); }
 
+#define UINT16_TO_BITSTREAM(p, n) { *(p)++ = (uint8_t)(n); *(p)++ = (uint8_t)((n) >> 8); }
+
 #define UINT32_TO_BITSTREAM(p, n) { *(p)++ = (uint8_t)(n); *(p)++ = (uint8_t)((n) >> 8); \
                                     *(p)++ = (uint8_t)((n) >> 16); *(p)++ = (uint8_t)((n) >> 24); }
 
-#define UINT32_TO_FLOAT(m, e) (((uint32_t)(m) & 0x00FFFFFFU) | (uint32_t)((int32_t)(e) << 24))
+#define UINT32_TO_FLOAT(m, e) (((uint32_t)(m) & 0x00FFFFFFU) | (((uint32_t)(e) & 0xFFU) << 24))
+
+// IEEE-11073 16-bit SFLOAT, 12-bit mantissa and 4-bit exponent
+#define UINT16_TO_SFLOAT(m, e) ((uint16_t)(((uint16_t)(m) & 0x0FFFU) | (((uint16_t)(e) & 0x0FU) << 12)))
+#define SFLOAT_NAN 0x07FF
 
 // BLE Data Structure, save all of our private BT data in here.
 // Modern C (circa 2021 does it this way)
@@ -34,8 +41,12 @@ typedef struct {
     bool connectionOpen;
     bool indicationInFlight;
     bool pbIndicationsEnabled;
-    bool heartRateIndicationsEnabled;
-    bool bloodOxygenIndicationsEnabled;
+    bool heartRateNotificationsEnabled;
+    bool spotCheckIndicationsEnabled;
+    bool plxContinuousNotificationsEnabled;
+    bool tempIndicationsEnabled;
+    bool streamNotificationsEnabled;
+    uint16_t mtu; // ATT MTU of the connection
 
     uint16_t heart_rate;
     uint16_t blood_oxygen;
@@ -78,12 +89,28 @@ ble_data_struct_t* get_ble_data_ptr();
 
 void ble_transmit_button_state();
 void ble_transmit_heart_data();
+void ble_transmit_temperature();
+
+// queue readings for the main loop, safe from any active object
+void ble_publish_heart_data(uint16_t heart_rate, uint8_t blood_oxygen, uint8_t confidence);
+void ble_publish_temperature(int32_t temperature);
+
+// stream the samples waiting in the heart sensor sample ring, safe from any active object
+void ble_publish_samples();
+
+// connection parameters follow the sensor workflow, safe from any active object
+void ble_publish_activity(conn_activity_t activity);
+
+// indication counters per characteristic, for debugging
+void print_ble_stats();
 
 // common server + client events
 void ble_boot_event();
 void ble_connection_opened_event(sl_bt_msg_t* evt);
 void ble_connection_closed_event();
 void ble_connection_parameters_event(sl_bt_msg_t* evt);
+void ble_connection_phy_status_event(sl_bt_msg_t* evt);
+void ble_gatt_mtu_exchanged_event(sl_bt_msg_t* evt);
 void ble_external_signal_event(sl_bt_msg_t* evt);
 void ble_system_soft_timer_event();
 void ble_sm_confirm_passkey_id(sl_bt_msg_t* evt);
@@ -94,6 +121,8 @@ void ble_sm_bonding_failed_id();
 void ble_server_characteristic_status_event(sl_bt_msg_t* evt);
 void ble_server_indication_timeout_event();
 void ble_server_sm_confirm_bonding_event();
+void ble_server_user_read_request_event(sl_bt_msg_t* evt);
+void ble_server_user_write_request_event(sl_bt_msg_t* evt);
 
 // event responder
 void handle_ble_event(sl_bt_msg_t* event);
@@ -0,0 +1,382 @@
+/*
+ * conn_policy.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Connection parameters that follow what the device is doing.
+ * While it waits for a finger a long interval with high latency keeps the
+ * radio mostly off, while it measures a short interval keeps readings and
+ * stream batches flowing, and when more is queued than one connection event
+ * carries the fastest profile drains it, held for a few seconds after the
+ * last backlog. The central has the final say, the parameters it picks come
+ * back in sl_bt_evt_connection_parameters and are logged with the radio
+ * time they cost. Requests are spaced at least CONN_UPDATE_MIN_GAP_US
+ * apart, a change that comes sooner is applied when the gap is over.
+ *
+ * Every connection asks for the 2M PHY and keeps accepting 1M, a central
+ * that can't do 2M leaves the link on 1M. The data length is negotiated
+ * by the stack up to the largest PDU its buffers allow. Bytes sent, time
+ * and estimated air time are kept per PHY.
+ */
+
+#include "conn_policy.h"
+#include "irq.h"
+#include "sw_timer.h"
+
+// enable logging for errors
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+// shortest time between two update requests, each one costs the central a procedure
+#define CONN_UPDATE_MIN_GAP_US (2000000)
+
+// fast interval kept this long after the last backlog
+#define CONN_BURST_HOLD_US     (3000000)
+
+// rough radio on time of a connection event with nothing to send, ramp up included,
+// only used to compare parameter sets in the log
+#define CONN_EVENT_RADIO_US    (500)
+
+// interval in 1.25 ms units, timeout in 10 ms units
+// timeout > (1 + latency) * max interval * 2
+typedef enum {
+    CONN_PROFILE_IDLE,
+    CONN_PROFILE_MEASURING,
+    CONN_PROFILE_BURST,
+    NUM_CONN_PROFILES
+} conn_profile_t;
+
+typedef struct {
+    const char* name;
+    uint16_t min_interval;
+    uint16_t max_interval;
+    uint16_t latency; // connection events the peripheral may skip when it has nothing to send
+    uint16_t timeout;
+} conn_params_t;
+
+// PHYs asked for and accepted from the central, sl_bt_gap_phy_coding_t bits
+#define CONN_PHY_PREFERRED (sl_bt_gap_phy_coding_2m_uncoded)
+#define CONN_PHY_ACCEPTED  (sl_bt_gap_phy_coding_1m_uncoded | sl_bt_gap_phy_coding_2m_uncoded)
+
+// per packet on air, besides the payload: access address, LL header, MIC and CRC (the preamble is per PHY)
+#define LL_PDU_OVERHEAD    (4 + 2 + 4 + 3)
+#define LL_EMPTY_PDU       (4 + 2 + 3)
+#define LL_IFS_US          (150)
+#define L2CAP_ATT_HEADER   (4 + 3) // L2CAP length and channel, ATT opcode and handle
+
+typedef enum {
+    CONN_PHY_1M,
+    CONN_PHY_2M,
+    NUM_CONN_PHYS
+} conn_phy_t;
+
+typedef struct {
+    const char* name;
+    uint8_t preamble; // bytes
+    uint8_t us_per_byte;
+} phy_desc_t;
+
+static const phy_desc_t phys[NUM_CONN_PHYS] = {
+    [CONN_PHY_1M] = { "1M", 1, 8 },
+    [CONN_PHY_2M] = { "2M", 2, 4 }
+};
+
+typedef struct {
+    uint64_t time_us; // connected on this PHY
+    uint32_t packets; // notifications and indications
+    uint32_t bytes; // values sent
+    uint64_t air_us; // estimated radio on time of those packets
+} phy_stats_t;
+
+static const conn_params_t profiles[NUM_CONN_PROFILES] = {
+    //                         name         min   max   latency  timeout
+    [CONN_PROFILE_IDLE]      = { "idle",      320,  400,  4,       600 }, // 400-500 ms, wakes every 2.5 s when quiet, 6 s timeout
+    [CONN_PROFILE_MEASURING] = { "measuring", 24,   36,   4,       200 }, // 30-45 ms, 2 s timeout
+    [CONN_PROFILE_BURST]     = { "burst",     6,    12,   0,       200 }  // 7.5-15 ms, 2 s timeout
+};
+
+static bool connection_open = false;
+static uint8_t connection;
+static conn_activity_t activity = CONN_ACTIVITY_IDLE;
+static bool burst = false;
+
+static conn_profile_t requested = NUM_CONN_PROFILES; // last profile asked for, none yet
+static uint64_t last_request_us = 0;
+
+// parameters in effect, 0 until the first sl_bt_evt_connection_parameters
+static uint16_t interval = 0;
+static uint16_t latency = 0;
+static uint16_t timeout = 0;
+
+// every connection starts on 1M
+static conn_phy_t phy = CONN_PHY_1M;
+static uint64_t phy_since_us = 0;
+static phy_stats_t phy_stats[NUM_CONN_PHYS];
+
+static uint32_t requests = 0;
+static uint32_t deferred = 0; // changes held back by the request gap
+static uint32_t failed = 0;
+
+static void update_due(void* context);
+static void burst_over(void* context);
+
+// both run from the main loop, the stack API isn't reentrant
+static sw_timer_t update_timer = { .callback = update_due };
+static sw_timer_t burst_timer = { .callback = burst_over };
+
+// private helper, profile for the current activity
+static conn_profile_t wanted_profile() {
+
+    if (burst) {
+        return CONN_PROFILE_BURST;
+    }
+
+    return (activity == CONN_ACTIVITY_MEASURING) ? CONN_PROFILE_MEASURING : CONN_PROFILE_IDLE;
+}
+
+// private helper, asks the central for the wanted profile unless it was the last request
+static void apply() {
+
+    if (!connection_open) {
+        return;
+    }
+
+    conn_profile_t p = wanted_profile();
+
+    if (p == requested) {
+        sw_timer_stop(&update_timer);
+        return;
+    }
+
+    uint64_t now = letimerMicroseconds();
+
+    if ((requested < NUM_CONN_PROFILES) && (now - last_request_us < CONN_UPDATE_MIN_GAP_US)) {
+        if (!sw_timer_running(&update_timer)) {
+            sw_timer_start(&update_timer, CONN_UPDATE_MIN_GAP_US - (now - last_request_us), 0);
+            deferred++;
+        }
+        return;
+    }
+
+    sl_status_t status = sl_bt_connection_set_parameters(connection,
+                                                         profiles[p].min_interval,
+                                                         profiles[p].max_interval,
+                                                         profiles[p].latency,
+                                                         profiles[p].timeout,
+                                                         0, // min_ce_length, default
+                                                         0xffff); // max_ce_length, no limitation
+
+    if (status != SL_STATUS_OK) {
+        LOG_ERROR("sl_bt_connection_set_parameters");
+        failed++;
+        return;
+    }
+
+    requested = p;
+    last_request_us = now;
+    requests++;
+
+    LOG_INFO("Connection: asking for %s parameters", profiles[p].name);
+}
+
+// private helper, the request gap is over
+static void update_due(void* context) {
+    (void) context;
+
+    apply();
+}
+
+// private helper, no backlog for CONN_BURST_HOLD_US
+static void burst_over(void* context) {
+    (void) context;
+
+    burst = false;
+    apply();
+}
+
+/*
+ * private helper, share of the time the radio is on in 0.01 %
+ *
+ * i = connection interval in 1.25 ms units
+ * skipped = connection events skipped after each one attended
+ *
+ * returns: estimate from CONN_EVENT_RADIO_US
+ */
+static uint32_t radio_basis_points(uint16_t i, uint16_t skipped) {
+
+    if (i == 0) {
+        return 0;
+    }
+
+    return ((uint32_t) CONN_EVENT_RADIO_US * 10000) / ((uint32_t) i * 1250 * (1 + skipped));
+}
+
+// private helper, adds the time since the last PHY change to the PHY in use
+static void account_phy_time() {
+
+    uint64_t now = letimerMicroseconds();
+
+    phy_stats[phy].time_us += now - phy_since_us;
+    phy_since_us = now;
+}
+
+// a connection was opened, ask for the parameters of the current activity and the 2M PHY
+void conn_policy_opened(uint8_t handle) {
+
+    connection_open = true;
+    connection = handle;
+    requested = NUM_CONN_PROFILES;
+    interval = 0;
+    latency = 0;
+    timeout = 0;
+
+    phy = CONN_PHY_1M;
+    phy_since_us = letimerMicroseconds();
+
+    apply();
+
+    // the PHY update runs in the background, sl_bt_evt_connection_phy_status reports the result
+    sl_status_t status = sl_bt_connection_set_preferred_phy(connection, CONN_PHY_PREFERRED, CONN_PHY_ACCEPTED);
+
+    if (status != SL_STATUS_OK) {
+        LOG_WARN("2M PHY not available (0x%04x), staying on 1M", (unsigned int) status);
+    }
+}
+
+void conn_policy_closed() {
+
+    if (connection_open) {
+        account_phy_time();
+    }
+
+    connection_open = false;
+    burst = false;
+
+    sw_timer_stop(&update_timer);
+    sw_timer_stop(&burst_timer);
+}
+
+/*
+ * the central set new parameters, log what they cost against the ones before
+ * the radio is on every interval while there is data to send, every (1 + latency) intervals while quiet
+ *
+ * params = event data
+ */
+void conn_policy_parameters(sl_bt_evt_connection_parameters_t* params) {
+
+    uint32_t busy = radio_basis_points(params->interval, 0);
+    uint32_t quiet = radio_basis_points(params->interval, params->latency);
+    uint32_t was_busy = radio_basis_points(interval, 0);
+    uint32_t was_quiet = radio_basis_points(interval, latency);
+
+    LOG_INFO("Connection: interval %u.%02u ms, latency %u, timeout %u ms, radio ~%u.%02u%% busy, %u.%02u%% quiet (was %u.%02u%%, %u.%02u%%)",
+             (unsigned int) (params->interval * 125 / 100), (unsigned int) (params->interval * 125 % 100),
+             params->latency, params->timeout * 10,
+             (unsigned int) (busy / 100), (unsigned int) (busy % 100),
+             (unsigned int) (quiet / 100), (unsigned int) (quiet % 100),
+             (unsigned int) (was_busy / 100), (unsigned int) (was_busy % 100),
+             (unsigned int) (was_quiet / 100), (unsigned int) (was_quiet % 100));
+
+    interval = params->interval;
+    latency = params->latency;
+    timeout = params->timeout;
+
+    // the same profile isn't asked for again, only a change of activity or burst moves on
+    if ((requested < NUM_CONN_PROFILES) &&
+        ((interval < profiles[requested].min_interval) || (interval > profiles[requested].max_interval))) {
+        LOG_INFO("Connection: interval is outside the %s parameters asked for", profiles[requested].name);
+    }
+}
+
+/*
+ * the PHY update finished, a central without 2M leaves it on 1M
+ *
+ * event = event data
+ */
+void conn_policy_phy(sl_bt_evt_connection_phy_status_t* event) {
+
+    account_phy_time();
+
+    if (event->phy == sl_bt_gap_phy_coding_2m_uncoded) {
+        phy = CONN_PHY_2M;
+    }
+    else {
+        if (event->phy != sl_bt_gap_phy_coding_1m_uncoded) {
+            LOG_WARN("Connection: unexpected PHY 0x%02x, counted as 1M", event->phy);
+        }
+        phy = CONN_PHY_1M;
+    }
+
+    LOG_INFO("Connection: on the %s PHY", phys[phy].name);
+}
+
+/*
+ * a notification or indication was handed to the stack, counts it against the PHY in use
+ * air time assumes one LL packet per ATT PDU, true once the stack has raised the data length,
+ * plus the empty packet back from the central
+ *
+ * len = value length
+ */
+void conn_policy_sent(uint16_t len) {
+
+    const phy_desc_t* d = &phys[phy];
+    uint32_t data_bytes = d->preamble + LL_PDU_OVERHEAD + L2CAP_ATT_HEADER + len;
+    uint32_t ack_bytes = d->preamble + LL_EMPTY_PDU;
+
+    phy_stats[phy].packets++;
+    phy_stats[phy].bytes += len;
+    phy_stats[phy].air_us += ((data_bytes + ack_bytes) * d->us_per_byte) + (2 * LL_IFS_US);
+}
+
+/*
+ * the sensor workflow changed what it is doing
+ *
+ * a = new activity
+ */
+void conn_policy_set_activity(conn_activity_t a) {
+
+    activity = a;
+
+    apply();
+}
+
+// more is queued than the link carries, use the burst parameters for a while
+void conn_policy_burst() {
+
+    sw_timer_start(&burst_timer, CONN_BURST_HOLD_US, 0);
+
+    if (!burst) {
+        burst = true;
+        apply();
+    }
+}
+
+// log the parameters in effect and how often they were asked for
+void print_conn_policy() {
+
+    conn_profile_t p = wanted_profile();
+
+    LOG_INFO("Connection policy: %s parameters wanted, %s requested, %u requests, %u deferred, %u failed",
+             profiles[p].name, (requested < NUM_CONN_PROFILES) ? profiles[requested].name : "none",
+             (unsigned int) requests, (unsigned int) deferred, (unsigned int) failed);
+
+    LOG_INFO("  interval %u.%02u ms, latency %u, timeout %u ms, %s PHY",
+             (unsigned int) (interval * 125 / 100), (unsigned int) (interval * 125 % 100), latency, timeout * 10,
+             phys[phy].name);
+
+    if (connection_open) {
+        account_phy_time();
+    }
+
+    for (int i=0; i<NUM_CONN_PHYS; i++) {
+        phy_stats_t* st = &phy_stats[i];
+        uint32_t bytes_per_s = (st->time_us > 0) ? ((uint64_t) st->bytes * 1000000 / st->time_us) : 0;
+        uint32_t ns_per_byte = (st->bytes > 0) ? (st->air_us * 1000 / st->bytes) : 0;
+
+        LOG_INFO("  %s: %u s, %u packets, %u bytes, %u bytes/s, air %u ms, %u ns per byte",
+                 phys[i].name, (unsigned int) (st->time_us / 1000000), (unsigned int) st->packets,
+                 (unsigned int) st->bytes, (unsigned int) bytes_per_s,
+                 (unsigned int) (st->air_us / 1000), (unsigned int) ns_per_byte);
+    }
+}
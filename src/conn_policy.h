@@ -0,0 +1,39 @@
+/*
+ * conn_policy.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_CONN_POLICY_H_
+#define SRC_CONN_POLICY_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#include "sl_bt_api.h"
+
+// what the device is doing, picks the connection parameters to ask the central for
+typedef enum {
+    CONN_ACTIVITY_IDLE, // no finger, nothing new to send for a while
+    CONN_ACTIVITY_MEASURING, // finger present, readings and stream batches every hub read
+    NUM_CONN_ACTIVITIES
+} conn_activity_t;
+
+// main loop only, the policy calls sl_bt_connection_set_parameters()
+void conn_policy_opened(uint8_t handle);
+void conn_policy_closed();
+void conn_policy_parameters(sl_bt_evt_connection_parameters_t* params);
+void conn_policy_phy(sl_bt_evt_connection_phy_status_t* event);
+
+// a value was handed to the stack, for the per PHY throughput and air time
+void conn_policy_sent(uint16_t len);
+
+void conn_policy_set_activity(conn_activity_t activity);
+
+// more queued for the client than one connection event carries, holds a fast interval for a while
+void conn_policy_burst();
+
+void print_conn_policy();
+
+#endif /* SRC_CONN_POLICY_H_ */
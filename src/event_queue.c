@@ -0,0 +1,172 @@
+/*
+ * event_queue.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Lock-free queue for events and deferred work posted by interrupts and read
+ * by the main loop.
+ *
+ * Any interrupt may post at any time, including one that preempts another
+ * interrupt half way through a post. A producer claims a slot by advancing
+ * the write position with LDREX/STREX; an exception entry or exit between
+ * the two clears the exclusive monitor so the claim is simply retried.
+ * Each slot carries a sequence number that tells the reader when the
+ * producer has finished filling it in. Each ring has a single reader, the
+ * main loop for the priority levels here and the owning active object for
+ * the rings in active_object.c.
+ */
+
+#include "event_queue.h"
+
+#include "em_device.h"
+
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_DEPTH - 1)
+
+#if (EVENT_QUEUE_DEPTH & EVENT_QUEUE_MASK) != 0
+#error "EVENT_QUEUE_DEPTH must be a power of 2"
+#endif
+
+static event_ring_t rings[NUM_EVENT_PRIORITIES];
+
+// events that didn't fit, should always stay 0
+static volatile uint32_t dropped = 0;
+
+// empties a ring, call before anything can post to it
+void event_ring_init(event_ring_t* ring) {
+
+    for (uint32_t i=0; i<EVENT_QUEUE_DEPTH; i++) {
+        ring->slots[i].seq = i;
+    }
+    ring->write_pos = 0;
+    ring->read_pos = 0;
+}
+
+// resets the data structures at initialization
+void init_event_queue() {
+
+    for (int p=0; p<NUM_EVENT_PRIORITIES; p++) {
+        event_ring_init(&rings[p]);
+    }
+
+    dropped = 0;
+}
+
+/*
+ * add an event to a ring, safe to call from any interrupt or the main loop
+ *
+ * ring = ring to post to
+ * event = event value, meaning is up to the reader
+ * payload = event specific value
+ * timestamp = us since startup
+ * work = function the reader runs with payload, 0 for an event
+ *
+ * returns: false if successful or true if the ring is full (the event is counted as dropped)
+ */
+bool event_ring_post(event_ring_t* ring, uint8_t event, uint32_t payload, uint64_t timestamp, deferred_work_t work) {
+
+    event_slot_t* slot;
+    uint32_t pos;
+
+    // claim a slot
+    while (true) {
+        pos = __LDREXW((uint32_t*) &ring->write_pos);
+        slot = &ring->slots[pos & EVENT_QUEUE_MASK];
+
+        int32_t diff = (int32_t) (slot->seq - pos);
+
+        // slot not read yet, queue full
+        if (diff < 0) {
+            __CLREX();
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+
+        // another producer took this position, try the next one
+        if (diff > 0) {
+            __CLREX();
+            continue;
+        }
+
+        if (__STREXW(pos + 1, (uint32_t*) &ring->write_pos) == 0) {
+            break;
+        }
+    }
+
+    slot->entry.event = event;
+    slot->entry.payload = payload;
+    slot->entry.timestamp = timestamp;
+    slot->entry.work = work;
+
+    // publish, the entry must be complete before the reader sees the new sequence
+    __DMB();
+    slot->seq = pos + 1;
+
+    return false;
+}
+
+/*
+ * remove the oldest event of a ring, only the ring's reader may call this
+ *
+ * ring = ring to read
+ * entry = where to save the event
+ *
+ * returns: false if successful or true if the ring is empty
+ */
+bool event_ring_read(event_ring_t* ring, app_event_t* entry) {
+
+    event_slot_t* slot = &ring->slots[ring->read_pos & EVENT_QUEUE_MASK];
+
+    if (slot->seq != ring->read_pos + 1) {
+        return true;
+    }
+
+    __DMB();
+    *entry = slot->entry;
+
+    // hand the slot back to the producers for the next lap
+    __DMB();
+    slot->seq = ring->read_pos + EVENT_QUEUE_DEPTH;
+    ring->read_pos++;
+
+    return false;
+}
+
+/*
+ * add an event to the main loop queue, safe to call from any interrupt or the main loop
+ *
+ * priority = which level to post to
+ * event = server_events_t value
+ * payload = event specific value
+ * timestamp = us since startup
+ * work = function the main loop runs with payload, 0 for an event
+ *
+ * returns: false if successful or true if the level is full (the event is counted as dropped)
+ */
+bool event_queue_post(event_priority_t priority, uint8_t event, uint32_t payload, uint64_t timestamp, deferred_work_t work) {
+    return event_ring_post(&rings[priority], event, payload, timestamp, work);
+}
+
+/*
+ * remove the oldest event of the highest priority level that has one
+ * main loop only
+ *
+ * entry = where to save the event
+ *
+ * returns: false if successful or true if every level is empty
+ */
+bool event_queue_read(app_event_t* entry) {
+
+    for (int p=0; p<NUM_EVENT_PRIORITIES; p++) {
+        if (!event_ring_read(&rings[p], entry)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// returns how many events were lost to a full queue
+uint32_t event_queue_dropped() {
+    return dropped;
+}
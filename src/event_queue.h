@@ -0,0 +1,57 @@
+/*
+ * event_queue.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_EVENT_QUEUE_H_
+#define SRC_EVENT_QUEUE_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// entries per priority level, must be a power of 2
+#define EVENT_QUEUE_DEPTH 16
+
+// priority levels, the main loop empties higher levels first
+typedef enum {
+    EVENT_PRIORITY_HIGH, // completions that keep hardware moving
+    EVENT_PRIORITY_NORMAL, // sensor and user input
+    EVENT_PRIORITY_LOW, // diagnostics, logging
+    NUM_EVENT_PRIORITIES
+} event_priority_t;
+
+// work deferred from an interrupt to the main loop
+typedef void (*deferred_work_t)(uint32_t arg);
+
+// one event or work item posted by an interrupt
+typedef struct {
+    uint8_t event; // server_events_t, unused by work items
+    uint32_t payload; // event specific value, or the argument of a work item
+    uint64_t timestamp; // us since startup when posted
+    deferred_work_t work; // 0 for an event
+} app_event_t;
+
+typedef struct {
+    volatile uint32_t seq; // == position when free, position + 1 when filled
+    app_event_t entry;
+} event_slot_t;
+
+// one lock-free ring, any number of producers and a single reader
+typedef struct {
+    event_slot_t slots[EVENT_QUEUE_DEPTH];
+    volatile uint32_t write_pos; // claimed by producers
+    uint32_t read_pos; // only touched by the reader
+} event_ring_t;
+
+void event_ring_init(event_ring_t* ring);
+bool event_ring_post(event_ring_t* ring, uint8_t event, uint32_t payload, uint64_t timestamp, deferred_work_t work);
+bool event_ring_read(event_ring_t* ring, app_event_t* entry);
+
+void init_event_queue();
+bool event_queue_post(event_priority_t priority, uint8_t event, uint32_t payload, uint64_t timestamp, deferred_work_t work);
+bool event_queue_read(app_event_t* entry);
+uint32_t event_queue_dropped();
+
+#endif /* SRC_EVENT_QUEUE_H_ */
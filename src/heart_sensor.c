@@ -7,41 +7,257 @@
 
 
 #include "heart_sensor.h"
-#include "timers.h"
+#include "sw_timer.h"
+#include "scheduler.h"
+#include "irq.h"
 #include "gpio.h"
 #include "i2c.h"
+#include "ppg_estimator.h"
+#include "sensor_hub.h"
+
+#include "em_core.h"
 
 #define INCLUDE_LOG_DEBUG 1
 #include "log.h"
 
-// 60 us too short for some functions, experimented with values
-#define CMD_DELAY 50000
+// structure for saving sensor data
+heart_sensor_data health_data;
 
-#define DATASHEET_CMD_DELAY 60
+// bytes per MaximFast sample in the output fifo
+#define MAXFAST_SAMPLE_SIZE       6
+
+// bytes of MAX30101 data in front of the algorithm data in sensor + algorithm mode
+// LED1 (IR), LED2 (red), LED3 and LED4 counts, 3 bytes each
+#define MAX30101_LED_ARRAY_SIZE   12
+
+#if defined(PPG_RAW_ONLY_MODE)
+#define FIFO_SAMPLE_SIZE          MAX30101_LED_ARRAY_SIZE
+#elif defined(PPG_STREAMING_MODE)
+#define FIFO_SAMPLE_SIZE          (MAX30101_LED_ARRAY_SIZE + MAXFAST_SAMPLE_SIZE)
+#else
+#define FIFO_SAMPLE_SIZE          MAXFAST_SAMPLE_SIZE
+#endif
+
+// time between hub samples
+#define HEART_SAMPLE_PERIOD_US    (1000000 / PPG_SAMPLE_RATE_HZ)
+
+// bytes returned by a fifo drain: status byte followed by up to HEART_FIFO_MAX_SAMPLES samples
+#define FIFO_ARRAY_SIZE           (1 + (HEART_FIFO_MAX_SAMPLES * FIFO_SAMPLE_SIZE))
+uint8_t bpm_arr[FIFO_ARRAY_SIZE];
+
+// bytes returned by the status and fifo count reads
+uint8_t status_arr[2];
+uint8_t fifo_count_arr[2];
+
+// a reading is done in 2 transactions because the drain length depends on the fifo count
+typedef enum {
+    READ_PHASE_COUNT,
+    READ_PHASE_DRAIN
+} read_phase_t;
+
+static read_phase_t read_phase = READ_PHASE_COUNT;
+static uint8_t samples_to_drain = 0;
+static uint8_t read_attempts = 0;
+
+// background bring-up of the sensor hub, see init_heart_sensor()
+typedef enum {
+    INIT_PHASE_VERIFY, // warm restart, checking the hub kept its configuration
+    INIT_PHASE_RESET, // reset held low
+    INIT_PHASE_BOOT_WAIT, // reset released, hub application starting
+    INIT_PHASE_DEVICE_MODE, // checking the hub responds
+    INIT_PHASE_CONFIGURING, // running init_sequence
+    INIT_PHASE_DONE
+} init_phase_t;
+
+static init_phase_t init_phase = INIT_PHASE_DONE;
+
+// a power on or off sequence is running on the i2c transaction engine
+static bool power_sequence_running = false;
+
+// times the reset pulse and boot wait, expiry is reported as EVENT_TIMER_EXPIRED
+static void hub_wait_expired(void* context);
+static sw_timer_t hub_wait_timer = { .callback = hub_wait_expired, .flags = SW_TIMER_FROM_ISR };
+
+// command sequences run by the executor in sensor_hub.c
+static const hub_cmd_id_t device_mode_sequence[] = {
+    HUB_CMD_READ_DEVICE_MODE,
+    HUB_CMD_READ_VERSION
+};
+
+static const hub_cmd_id_t verify_sequence[] = {
+    HUB_CMD_READ_OUTPUT_MODE
+};
+
+static const hub_cmd_id_t init_sequence[] = {
+    HUB_CMD_SET_OUTPUT_MODE,
+    HUB_CMD_SET_FIFO_THRESHOLD,
+    #ifndef PPG_RAW_ONLY_MODE
+    HUB_CMD_ENABLE_AGC,
+    #endif
+    HUB_CMD_ENABLE_SENSOR,
+    #ifndef PPG_RAW_ONLY_MODE
+    HUB_CMD_ENABLE_ALGO,
+    HUB_CMD_READ_ALGO_SAMPLES
+    #endif
+};
+
+static const hub_cmd_id_t power_on_sequence[] = {
+    HUB_CMD_ENABLE_SENSOR,
+    #ifndef PPG_RAW_ONLY_MODE
+    HUB_CMD_ENABLE_ALGO
+    #endif
+};
+
+static const hub_cmd_id_t power_off_sequence[] = {
+    HUB_CMD_DISABLE_SENSOR,
+    #ifndef PPG_RAW_ONLY_MODE
+    HUB_CMD_DISABLE_ALGO
+    #endif
+};
+
+// ring buffer of parsed samples, oldest sample is dropped when full
+static heart_sensor_data sample_ring[SAMPLE_RING_DEPTH];
+static uint32_t sample_wptr = 0;
+static uint32_t sample_rptr = 0;
+static uint32_t num_ring_samples = 0;
+static uint32_t samples_dropped = 0;
+
+// compute next ring buffer ptr value
+static uint32_t next_sample_ptr(uint32_t ptr) {
+
+    if (ptr + 1 == SAMPLE_RING_DEPTH) {
+        return 0; // wrap back to beginning of ring
+    }
+    else {
+        return ptr + 1; // advance by 1
+    }
 
-uint8_t read_device_mode_cmd[2] = {0x02, 0x00};
-uint8_t read_sensor_hub_version_cmd[2] = {0xFF, 0x03}; // for debugging
+}
 
-uint8_t set_output_mode_cmd[3] = {0x10, 0x00, 0x02}; // mode = algorithm data
-uint8_t set_fifo_threshold_cmd[3] = {0x10, 0x01, 0x01}; // last byte = interrupt threshold for FIFO almost full
-uint8_t agc_algo_control_cmd[3] = {0x52, 0x00, 0x01}; // enable the AGC algorithm
-uint8_t enable_sensor_cmd[3] = {0x44, 0x03, 0x01}; // turn on the MAX 30001 sensor
-uint8_t enable_algo_cmd[3] = {0x52, 0x02, 0x01}; // enable the WHRM, MaximFast algorithm
-uint8_t read_algo_samples_cmd[3] = {0x51, 0x00, 0x03}; // read number of samples being averaged in algorithm -> 5
+// add a parsed sample to the ring buffer
+static void write_sample_ring(heart_sensor_data* sample) {
 
-uint8_t read_sensor_hub_status_cmd[2] = {0x00, 0x00};
-uint8_t num_samples_out_fifo_cmd[2] = {0x12, 0x00}; // get the number of samples available in the fifo
-uint8_t read_fill_array_cmd[2] = {0x12, 0x01}; // get the data
+    // overwrite the oldest sample if the consumer fell behind
+    if (num_ring_samples == SAMPLE_RING_DEPTH) {
+        sample_rptr = next_sample_ptr(sample_rptr);
+        num_ring_samples--;
+        samples_dropped++;
+    }
 
-uint8_t disable_sensor_cmd[3] = {0x44, 0x03, 0x00}; // turn off the MAX 30001 sensor
-uint8_t disable_algo_cmd[3] = {0x52, 0x02, 0x00}; // turn off the WHRM, MaximFast algorithm
+    sample_ring[sample_wptr] = *sample;
+    sample_wptr = next_sample_ptr(sample_wptr);
+    num_ring_samples++;
+}
 
-// structure for saving sensor data
-heart_sensor_data health_data;
+/*
+ * remove the oldest sample from the ring buffer
+ *
+ * sample = where to copy the sample
+ *
+ * returns: false if successful, true if the ring was empty
+ */
+bool read_heart_sample(heart_sensor_data* sample) {
+
+    // the sensor object writes the ring at a higher level than the reader
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    if (num_ring_samples == 0) {
+        CORE_EXIT_CRITICAL();
+        return true;
+    }
+
+    *sample = sample_ring[sample_rptr];
+    sample_rptr = next_sample_ptr(sample_rptr);
+    num_ring_samples--;
+
+    CORE_EXIT_CRITICAL();
+
+    return false;
+}
+
+// number of samples waiting in the ring buffer
+uint32_t heart_samples_available() {
+    return num_ring_samples;
+}
+
+// number of samples overwritten before they were consumed
+uint32_t heart_samples_dropped() {
+    return samples_dropped;
+}
+
+// ring buffer of raw PPG samples, filled in PPG_STREAMING_MODE, oldest sample is dropped when full
+static ppg_sample ppg_ring[PPG_RING_DEPTH];
+static uint32_t ppg_rptr = 0;
+static uint32_t num_ppg_samples = 0;
+
+/*
+ * remove the oldest raw PPG sample from the ring buffer
+ *
+ * sample = where to copy the sample
+ *
+ * returns: false if successful, true if the ring was empty
+ */
+bool read_ppg_sample(ppg_sample* sample) {
+
+    // the sensor object writes the ring at a higher level than the reader
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    if (num_ppg_samples == 0) {
+        CORE_EXIT_CRITICAL();
+        return true;
+    }
+
+    *sample = ppg_ring[ppg_rptr];
+    ppg_rptr = (ppg_rptr + 1) & (PPG_RING_DEPTH - 1);
+    num_ppg_samples--;
+
+    CORE_EXIT_CRITICAL();
 
-// bytes returned by read_fill_array()
-#define MAXFAST_ARRAY_SIZE        7
-uint8_t bpm_arr[MAXFAST_ARRAY_SIZE];
+    return false;
+}
+
+// number of raw PPG samples waiting in the ring buffer
+uint32_t ppg_samples_available() {
+    return num_ppg_samples;
+}
+
+#ifdef PPG_STREAMING_MODE
+
+// only the streaming build writes the ring, the others leave it empty
+static uint32_t ppg_wptr = 0;
+
+/*
+ * decode the red and IR counts of one sample straight into the ring buffer
+ * PPG_RING_DEPTH is a power of 2 so the pointers wrap with a mask
+ *
+ * raw = first byte of the sample
+ *
+ * returns: the decoded sample
+ */
+static ppg_sample* parse_ppg_sample(uint8_t* raw) {
+
+    ppg_sample* slot = &ppg_ring[ppg_wptr];
+
+    // 3 byte big endian counts, upper 6 bits unused
+    slot->ir = ((raw[0] << 16) | (raw[1] << 8) | raw[2]) & 0x3FFFF;
+    slot->red = ((raw[3] << 16) | (raw[4] << 8) | raw[5]) & 0x3FFFF;
+
+    ppg_wptr = (ppg_wptr + 1) & (PPG_RING_DEPTH - 1);
+
+    // overwrite the oldest sample if the consumer fell behind
+    if (num_ppg_samples == PPG_RING_DEPTH) {
+        ppg_rptr = ppg_wptr;
+    }
+    else {
+        num_ppg_samples++;
+    }
+
+    return slot;
+}
+
+#endif
 
 // returns ptr to data read
 heart_sensor_data* get_heart_data_ptr() {
@@ -74,312 +290,379 @@ void set_mfio_interrupt() {
     GPIO_ExtIntConfig (MAX30101_PORT, MAX30101_MFIO_PIN, MAX30101_MFIO_PIN, false, true, true); // interrupts enabled after config complete, on falling edge
 }
 
-// get device mode information
-void read_device_mode() {
-
-    // write family byte and index byte
-    i2c_write(read_device_mode_cmd, sizeof(read_device_mode_cmd));
-
-    // delay 60 microseconds
-    timer_wait_us_polled(CMD_DELAY);
-
-    i2c_read();
-
-    if (status_byte_error())
-        LOG_ERROR("Could not communicate with sensor");
-    else
-        LOG_INFO("Sensor started");
+// returns true while the hub holds MFIO low to signal pending samples
+bool heart_sensor_data_ready() {
+    return (GPIO_PinInGet(MAX30101_PORT, MAX30101_MFIO_PIN) == 0);
 }
 
-// get device version information
-void read_sensor_hub_version() {
-    i2c_write(read_sensor_hub_version_cmd, sizeof(read_sensor_hub_version_cmd));
-
-    timer_wait_us_polled(CMD_DELAY);
+/*
+ * convert one sample into heart rate, blood oxygen, finger status, and confidence values
+ *
+ * raw = first byte of the sample
+ * sample = where to save the converted values
+ */
+static void parse_heart_sample(uint8_t* raw, heart_sensor_data* sample) {
+    /*
+     * bytes 0-1: Heart Rate (bpm): 16-bit, LSB = 0.1 bpm
+     * byte 2: Confidence level (0 - 100%): 8-bit, LSB = 1%
+     * bytes 3-4: SpO 2 value (0 - 100%): 16-bit, LSB = 0.1%
+     * byte 5: MaximFast State Machine Status Codes
+     *         0 = no object detected
+     *         1 = object detected
+     *         2 = object other than finger detected
+     *         3 = finger detected
+     */
 
-    i2c_read();
+    // shift bits and divide by 10
+    sample->heart_rate = raw[0] << 8;
+    sample->heart_rate |= raw[1];
+    sample->heart_rate /= 10;
 
-    if (status_byte_error())
-        LOG_ERROR("read_sensor_hub_version()");
-}
+    // shift bits and divide by 10
+    sample->blood_oxygen = raw[3] << 8;
+    sample->blood_oxygen |= raw[4];
+    sample->blood_oxygen /= 10;
 
-// configure the device for algorithm data output mode
-void set_output_mode() {
+    sample->confidence = raw[2];
 
-    i2c_write(set_output_mode_cmd, sizeof(set_output_mode_cmd));
+    sample->finger_status = raw[5];
+}
 
-    timer_wait_us_polled(CMD_DELAY);
+// convert every drained sample, the newest one becomes the current reading
+void process_raw_heart_data() {
 
-    i2c_read();
+    heart_sensor_data sample;
 
-    if (status_byte_error())
-        LOG_ERROR("set_output_mode()");
-}
+    // byte 0 is the status byte
+    uint8_t* raw = &bpm_arr[1];
 
-// set the fifo threshold to 1
-void set_fifo_threshold() {
-    i2c_write(set_fifo_threshold_cmd, sizeof(set_fifo_threshold_cmd));
+    // the newest sample was taken about now, the others one sample period apart before it
+    uint64_t timestamp = letimerMicroseconds() - ((uint64_t) (samples_to_drain - 1) * HEART_SAMPLE_PERIOD_US);
 
-    timer_wait_us_polled(CMD_DELAY);
+    for (int i=0; i<samples_to_drain; i++) {
 
-    i2c_read();
+        #ifdef PPG_STREAMING_MODE
+        ppg_sample* ppg = parse_ppg_sample(raw);
+        ppg_estimator_add_sample(ppg->red, ppg->ir);
+        raw += MAX30101_LED_ARRAY_SIZE;
+        #endif
 
-    if (status_byte_error())
-        LOG_ERROR("set_fifo_threshold()");
-}
+        #ifdef PPG_RAW_ONLY_MODE
+        ppg_estimator_get(&sample);
+        #else
+        parse_heart_sample(raw, &sample);
+        raw += MAXFAST_SAMPLE_SIZE;
+        #endif
 
-// enable the AGC algorithm
-void agc_algo_control() {
-    i2c_write(agc_algo_control_cmd, sizeof(agc_algo_control_cmd));
+        sample.timestamp = timestamp;
+        timestamp += HEART_SAMPLE_PERIOD_US;
 
-    timer_wait_us_polled(CMD_DELAY);
+        write_sample_ring(&sample);
+    }
 
-    i2c_read();
+    if (samples_to_drain > 0) {
+        health_data = sample;
+    }
+}
 
-    if (status_byte_error())
-        LOG_ERROR("agc_algo_control()");
+// private helper, zero the current reading after a failure
+static void clear_heart_data() {
+    health_data.heart_rate = 0;
+    health_data.blood_oxygen = 0;
+    health_data.confidence = 0;
+    health_data.finger_status = NOTHING_DETECTED;
+    health_data.timestamp = letimerMicroseconds();
 }
 
-// turns on the sensor
-void enable_sensor() {
-    i2c_write(enable_sensor_cmd, sizeof(enable_sensor_cmd));
+// private helper, queue the status and fifo count commands
+static void count_heart_sensor_fifo() {
 
-    timer_wait_us_polled(CMD_DELAY);
+    read_phase = READ_PHASE_COUNT;
+    samples_to_drain = 0;
 
-    i2c_read();
+    hub_queue_command(HUB_CMD_READ_STATUS, status_arr, 0);
+    hub_queue_command(HUB_CMD_NUM_SAMPLES, fifo_count_arr, 0);
 
-    if (status_byte_error())
-        LOG_ERROR("enable_sensor()");
+    i2c_start_transaction(I2C_DEV_MAX32664);
 }
 
-// turns on the data processing algorithm
-void enable_algo() {
-    i2c_write(enable_algo_cmd, sizeof(enable_algo_cmd));
+// private helper, drain every pending sample in a single read
+static void drain_heart_sensor_fifo() {
 
-    timer_wait_us_polled(CMD_DELAY);
+    read_phase = READ_PHASE_DRAIN;
 
-    i2c_read();
+    hub_queue_command(HUB_CMD_READ_FIFO, bpm_arr, 1 + (samples_to_drain * FIFO_SAMPLE_SIZE));
 
-    if (status_byte_error())
-        LOG_ERROR("enable_algo()");
+    i2c_start_transaction(I2C_DEV_MAX32664);
 }
 
-// get the number of samples being averaged
-void read_algo_samples() {
-    i2c_write(read_algo_samples_cmd, sizeof(read_algo_samples_cmd));
-
-    timer_wait_us_polled(CMD_DELAY);
+/*
+ * start the command sequence for doing a reading
+ * the commands run on the i2c transaction engine, EVENT_I2C_DONE is set
+ * when they finish and finish_heart_sensor_read() should be called
+ */
+void read_heart_sensor() {
 
-    i2c_read();
+    //LOG_INFO("** READING HEART SENSOR **");
 
-    if (status_byte_error())
-        LOG_ERROR("read_algo_samples()");
+    read_attempts = 0;
+    count_heart_sensor_fifo();
 }
 
-// read the status of the sensor
-void read_sensor_hub_status() {
-
-    uint8_t buf[8];
+/*
+ * check the responses of a finished transaction
+ * after the fifo count is known a second transaction drains the fifo
+ * failed transactions are retried per the command table
+ *
+ * returns: HEART_READ_BUSY if another EVENT_I2C_DONE will follow, otherwise how the reading ended
+ */
+heart_read_status_t finish_heart_sensor_read() {
 
-    i2c_write(read_sensor_hub_status_cmd, sizeof(read_sensor_hub_status_cmd));
+    if (i2c_transaction_status(I2C_DEV_MAX32664) != i2cTransferDone) {
 
-    timer_wait_us_polled(DATASHEET_CMD_DELAY);
+        hub_cmd_id_t failed_cmd = (read_phase == READ_PHASE_COUNT) ? HUB_CMD_NUM_SAMPLES : HUB_CMD_READ_FIFO;
 
-    i2c_read_addr(buf, 8);
+        if (read_attempts < hub_get_cmd(failed_cmd)->retries) {
+            read_attempts++;
 
-    if (buf[0] != 0)
-        LOG_ERROR("read_sensor_hub_status()");
+            // the hub has already removed drained samples, so always start again from the count
+            count_heart_sensor_fifo();
+            return HEART_READ_BUSY;
+        }
 
-    if (buf[1] == 1) {
-        LOG_ERROR("Sensor communication error");
-        health_data.heart_rate = 0;
-        health_data.blood_oxygen = 0;
-        health_data.confidence = 0;
+        LOG_ERROR("Heart sensor read failed");
+        clear_heart_data();
+        return HEART_READ_FAILED;
     }
 
-    //LOG_INFO("DataRdyInt = %d (0=no, 1=yes)", buf[3]);
-}
+    if (read_phase == READ_PHASE_COUNT) {
 
-// get the number of samples in the fifo
-void num_samples_out_fifo() {
+        if (status_arr[0] != HUB_STATUS_SUCCESS)
+            LOG_ERROR("read_sensor_hub_status()");
 
-    uint8_t buf[8];
+        if (status_arr[1] == 1) {
+            LOG_ERROR("Sensor communication error");
+            clear_heart_data();
+            return HEART_READ_FAILED;
+        }
 
-    i2c_write(num_samples_out_fifo_cmd, sizeof(num_samples_out_fifo_cmd));
-
-    timer_wait_us_polled(DATASHEET_CMD_DELAY);
-
-    i2c_read_addr(buf, 8);
-
-    if (buf[0] != 0)
-        LOG_ERROR("num_samples_out_fifo()");
-
-    //LOG_INFO("Num Samples in fifo: %d", buf[1]);
-}
+        if (fifo_count_arr[0] != HUB_STATUS_SUCCESS) {
+            LOG_ERROR("num_samples_out_fifo()");
+            return HEART_READ_NO_DATA;
+        }
 
-// do a reading
-void read_fill_array() {
+        // nothing new, keep the last reading
+        if (fifo_count_arr[1] == 0) {
+            return HEART_READ_NO_DATA;
+        }
 
-    i2c_write(read_fill_array_cmd, sizeof(read_fill_array_cmd));
+        samples_to_drain = fifo_count_arr[1];
 
-    timer_wait_us_polled(DATASHEET_CMD_DELAY);
+        if (samples_to_drain > HEART_FIFO_MAX_SAMPLES) {
+            samples_to_drain = HEART_FIFO_MAX_SAMPLES;
+        }
 
-    i2c_read_addr(bpm_arr, MAXFAST_ARRAY_SIZE);
+        drain_heart_sensor_fifo();
+        return HEART_READ_BUSY;
+    }
 
-    if (bpm_arr[0] != 0)
+    if (bpm_arr[0] != HUB_STATUS_SUCCESS) {
         LOG_ERROR("read_fill_array()");
+        return HEART_READ_NO_DATA;
+    }
 
-}
-
-// turn off the sensor
-void disable_sensor() {
-    uint8_t buf[8];
-
-    i2c_write(disable_sensor_cmd, sizeof(disable_sensor_cmd));
-
-    timer_wait_us_polled(CMD_DELAY);
-
-    i2c_read_addr(buf, 8);
-
-    if (buf[0] != 0)
-        LOG_ERROR("disable_sensor()");
+    process_raw_heart_data();
 
+    return HEART_READ_NEW_DATA;
 }
 
-// turn off the data processing algorithm
-void disable_algo() {
-    uint8_t buf[8];
-
-    i2c_write(disable_algo_cmd, sizeof(disable_algo_cmd));
-
-    timer_wait_us_polled(CMD_DELAY);
+/*
+ * helper function for power savings, call while the hub is idle
+ * the commands run on the i2c transaction engine, EVENT_I2C_DONE is set after each
+ * one and continue_heart_sensor_power() should be called for it
+ *
+ * returns: true if a command was started, false if the hub was already off
+ */
+bool turn_off_heart_sensor() {
+    LOG_INFO("Turning off heart sensor");
 
-    i2c_read_addr(buf, 8);
+    power_sequence_running = hub_start_sequence(power_off_sequence, sizeof(power_off_sequence) / sizeof(power_off_sequence[0]));
 
-    if (buf[0] != 0)
-        LOG_ERROR("disable_algo()");
+    return power_sequence_running;
 }
 
+/*
+ * helper function for power savings, call while the hub is idle
+ * same as turn_off_heart_sensor()
+ *
+ * returns: true if a command was started, false if the hub was already on
+ */
+bool turn_on_heart_sensor() {
+    LOG_INFO("Turning on heart sensor");
 
-// convert bytes returned into heart rate, blood oxygen, finger status, and confidence values
-void process_raw_heart_data() {
-    /*
-     * bytes 0-1: Heart Rate (bpm): 16-bit, LSB = 0.1 bpm
-     * byte 2: Confidence level (0 - 100%): 8-bit, LSB = 1%
-     * bytes 3-4: SpO 2 value (0 - 100%): 16-bit, LSB = 0.1%
-     * byte 5: MaximFast State Machine Status Codes
-     *         0 = no object detected
-     *         1 = object detected
-     *         2 = object other than finger detected
-     *         3 = finger detected
-     */
-
-    // shift bits and divide by 10
-    health_data.heart_rate = bpm_arr[1] << 8;
-    health_data.heart_rate |= bpm_arr[2];
-    health_data.heart_rate /= 10;
-
-    // shift bits and divide by 10
-    health_data.blood_oxygen = bpm_arr[4] << 8;
-    health_data.blood_oxygen |= bpm_arr[5];
-    health_data.blood_oxygen /= 10;
+    ppg_estimator_reset();
 
-    health_data.confidence = bpm_arr[3];
+    power_sequence_running = hub_start_sequence(power_on_sequence, sizeof(power_on_sequence) / sizeof(power_on_sequence[0]));
 
-    health_data.finger_status = bpm_arr[6];
+    return power_sequence_running;
 }
 
-// perform command sequence for doing a reading
-void read_heart_sensor() {
-
-    //LOG_INFO("** READING HEART SENSOR **");
-
-    // EM <= 1 required during I2C transfers
-    sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1);
-
-    read_sensor_hub_status();
-    //LOG_INFO("Read sensor hub status");
-    //print_heart_data();
-
-    num_samples_out_fifo();
-    //LOG_INFO("Num samples out fifo");
-    //print_heart_data();
-
-    read_fill_array();
-
-    sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
-
-    process_raw_heart_data();
+/*
+ * advance a power sequence after EVENT_I2C_DONE, the 45 ms command delays are spent in EM2
+ *
+ * returns: true once the sequence has finished
+ */
+bool continue_heart_sensor_power() {
 
-    // log captured data for debugging purposes
-    LOG_INFO("Heart Rate: %d   Blood Oxygen: %d    Confidence: %d    Status: %d\n", health_data.heart_rate, health_data.blood_oxygen, health_data.confidence, health_data.finger_status);
+    if (hub_sequence_step() == HUB_SEQ_BUSY) {
+        return false;
+    }
 
+    power_sequence_running = false;
+    return true;
 }
 
-// helper function for power savings
-void turn_off_heart_sensor() {
-    LOG_INFO("Turning off heart sensor\n");
-
-    disable_sensor();
-    disable_algo();
+// returns true while a power sequence owns the hub
+bool heart_sensor_power_changing() {
+    return power_sequence_running;
 }
 
-// helper function for power savings
-void turn_on_heart_sensor() {
-    LOG_INFO("Turning on heart sensor");
-
-    enable_sensor();
-    enable_algo();
+// called from the LETIMER interrupt when a reset wait has elapsed
+static void hub_wait_expired(void* context) {
+    (void) context;
+    scheduler_set_event_timer();
 }
 
-// setup command sequence to get heart sensor ready for readings
-void init_heart_sensor() {
-    LOG_INFO("Initializing heart sensor");
-
-    // GPIO pin modes already configured
+// private helper, pulse the hub reset pin, the cached configuration is lost
+static void start_hub_reset() {
 
-    // EM <= 1 required during I2C transfers
-    sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1);
+    hub_cache_invalidate();
 
     disable_reset();
     enable_mfio();
-    timer_wait_us_polled(10000); // delay 10 ms, maybe unnecessary
+    sw_timer_start(&hub_wait_timer, 10000, 0); // delay 10 ms, maybe unnecessary
 
-    enable_reset();
-    timer_wait_us_polled(1000000); // delay 1 s, 50 ms minimum
+    init_phase = INIT_PHASE_RESET;
+}
 
-    // sensor now in application mode
+// private helper, the hub is ready for readings
+static bool finish_hub_init() {
+    ppg_estimator_reset();
 
-    set_mfio_interrupt();
+    init_phase = INIT_PHASE_DONE;
+    LOG_INFO("Finished heart sensor initialization");
+    return true;
+}
 
-    //LOG_INFO("Read device mode");
-    read_device_mode();
+/*
+ * private helper, send the configuration commands the hub doesn't already have
+ *
+ * returns: true if nothing needed to be sent and the bring-up is finished
+ */
+static bool start_hub_config() {
 
-    /*LOG_INFO("Read sensor hub version");
-    read_sensor_hub_version();
-    print_heart_data();*/
+    if (hub_start_sequence(init_sequence, sizeof(init_sequence) / sizeof(init_sequence[0]))) {
+        init_phase = INIT_PHASE_CONFIGURING;
+        return false;
+    }
 
-    //LOG_INFO("Set output mode");
-    set_output_mode();
+    return finish_hub_init();
+}
 
-    //LOG_INFO("Set fifo threshold");
-    set_fifo_threshold();
+/*
+ * start bringing up the sensor hub in the background
+ * the reset pulse and boot wait use hub_wait_timer (EVENT_TIMER_EXPIRED) and the
+ * commands run on the i2c transaction engine (EVENT_I2C_DONE),
+ * continue_heart_sensor_init() should be called for each of those events
+ *
+ * after a warm restart of the MCU the hub may still be running with the configuration
+ * in the cache, one read checks that and the reset and applied commands are skipped
+ */
+void init_heart_sensor() {
+    LOG_INFO("Initializing heart sensor");
 
-    //LOG_INFO("AGC algo control");
-    agc_algo_control();
+    // GPIO pin modes already configured
 
-    //LOG_INFO("MAX 30101 control");
-    enable_sensor();
+    if (hub_cache_valid()) {
+        set_mfio_interrupt();
 
-    //LOG_INFO("Maxim fast algo control");
-    enable_algo();
+        hub_start_sequence(verify_sequence, sizeof(verify_sequence) / sizeof(verify_sequence[0]));
 
-    //LOG_INFO("Read algo samples");
-    read_algo_samples();
+        init_phase = INIT_PHASE_VERIFY;
+        return;
+    }
 
-    // drop pack down to EM2
-    sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
+    start_hub_reset();
+}
 
-    LOG_INFO("Finished heart sensor initialization");
+/*
+ * advance the sensor hub bring-up after a timer or i2c event
+ * the cpu can sleep in EM2 during the waits, the engine holds EM1 only for transfers
+ *
+ * returns: true once the hub is configured and readings can start
+ */
+bool continue_heart_sensor_init() {
+
+    switch (init_phase) {
+
+        case INIT_PHASE_VERIFY:
+            switch (hub_sequence_step()) {
+                case HUB_SEQ_BUSY:
+                    return false;
+                case HUB_SEQ_DONE:
+                    if (hub_cache_confirm(hub_sequence_response())) {
+                        return start_hub_config();
+                    }
+                    break;
+                case HUB_SEQ_FAILED:
+                    break;
+            }
+
+            // hub was reset or isn't responding, set it up from scratch
+            start_hub_reset();
+            return false;
+
+        case INIT_PHASE_RESET:
+            enable_reset();
+            sw_timer_start(&hub_wait_timer, 1000000, 0); // delay 1 s, 50 ms minimum
+
+            init_phase = INIT_PHASE_BOOT_WAIT;
+            return false;
+
+        case INIT_PHASE_BOOT_WAIT:
+            // sensor now in application mode
+
+            set_mfio_interrupt();
+
+            hub_start_sequence(device_mode_sequence, sizeof(device_mode_sequence) / sizeof(device_mode_sequence[0]));
+
+            init_phase = INIT_PHASE_DEVICE_MODE;
+            return false;
+
+        case INIT_PHASE_DEVICE_MODE:
+            switch (hub_sequence_step()) {
+                case HUB_SEQ_BUSY:
+                    return false;
+                case HUB_SEQ_DONE:
+                    LOG_INFO("Sensor started");
+                    break;
+                case HUB_SEQ_FAILED:
+                    LOG_ERROR("Could not communicate with sensor");
+                    break;
+            }
+
+            return start_hub_config();
+
+        case INIT_PHASE_CONFIGURING:
+            if (hub_sequence_step() == HUB_SEQ_BUSY) {
+                return false;
+            }
+
+            return finish_hub_init();
+
+        case INIT_PHASE_DONE:
+            break;
+    }
 
+    return true;
 }
@@ -9,49 +9,92 @@
 #define SRC_HEART_SENSOR_H_
 
 #include "stdint.h"
+#include "stdbool.h"
 
 //#define LOW_POWER_MODE 0
 
+// hub outputs raw MAX30101 counts along with the algorithm data, they feed ppg_estimator.c
+// and the PPG ring, read_ppg_sample()
+// adds 12 bytes per sample to every fifo read
+//#define PPG_STREAMING_MODE 1
+
+// hub outputs raw counts only and skips its algorithm, heart rate and SpO2
+// come from ppg_estimator.c instead, requires PPG_STREAMING_MODE
+//#define PPG_RAW_ONLY_MODE 1
+
+#if defined(PPG_RAW_ONLY_MODE) && !defined(PPG_STREAMING_MODE)
+#error "PPG_RAW_ONLY_MODE requires PPG_STREAMING_MODE"
+#endif
+
 #define FINGER_DETECTED 3
 #define OBJECT_DETECTED 1
 #define NOTHING_DETECTED 0
 #define CONFIDENCE_THRESHOLD 93
 
+// hub fifo threshold, number of samples collected before MFIO is asserted
+#ifndef HEART_SENSOR_BATCH_SIZE
+#define HEART_SENSOR_BATCH_SIZE 25
+#endif
+
+// most samples pulled from the hub fifo in one read
+#define HEART_FIFO_MAX_SAMPLES 32
+
+// number of parsed samples kept for the rest of the firmware
+#define SAMPLE_RING_DEPTH 32
+
+// number of raw PPG samples kept for the rest of the firmware, > 1 second at 100 Hz
+#define PPG_RING_DEPTH 128
+
+#if (PPG_RING_DEPTH & (PPG_RING_DEPTH - 1)) != 0
+#error "PPG_RING_DEPTH must be a power of 2"
+#endif
+
+// result of finish_heart_sensor_read()
+typedef enum {
+    HEART_READ_BUSY, // another EVENT_I2C_DONE will follow
+    HEART_READ_NEW_DATA, // new samples parsed, the current reading was updated
+    HEART_READ_NO_DATA, // fifo empty or hub error, the current reading is unchanged
+    HEART_READ_FAILED // bus or sensor failure, the current reading was cleared
+} heart_read_status_t;
+
+// structure for saving raw MAX30101 LED counts (18 bit)
+typedef struct ppg_sample {
+    uint32_t red;
+    uint32_t ir;
+} ppg_sample;
+
 // structure for saving BMP mode 1 sensor data
 typedef struct heart_sensor_data {
     uint16_t heart_rate;
     uint16_t blood_oxygen;
     uint16_t confidence;
     uint16_t finger_status;
+    uint64_t timestamp; // us since startup when the hub took the sample
 } heart_sensor_data;
 
 
 heart_sensor_data* get_heart_data_ptr();
+bool read_heart_sample(heart_sensor_data* sample);
+uint32_t heart_samples_available();
+uint32_t heart_samples_dropped();
+bool read_ppg_sample(ppg_sample* sample);
+uint32_t ppg_samples_available();
 
 void disable_reset();
 void enable_reset();
 void disable_mfio();
 void enable_mfio();
 void set_mfio_interrupt();
-
-void read_device_mode();
-void read_sensor_hub_version();
-void set_output_mode();
-void set_fifo_threshold();
-void agc_algo_control();
-void enable_sensor();
-void enable_algo();
-void read_algo_samples();
-void read_sensor_hub_status();
-void num_samples_out_fifo();
-void read_fill_array();
-void disable_sensor();
-void disable_algo();
+bool heart_sensor_data_ready();
 
 void process_raw_heart_data();
 void read_heart_sensor();
-void turn_off_heart_sensor();
-void turn_on_heart_sensor();
+heart_read_status_t finish_heart_sensor_read();
+bool turn_off_heart_sensor();
+bool turn_on_heart_sensor();
+bool continue_heart_sensor_power();
+bool heart_sensor_power_changing();
 void init_heart_sensor();
+bool continue_heart_sensor_init();
 
 #endif /* SRC_HEART_SENSOR_H_ */
@@ -0,0 +1,276 @@
+/*
+ * hsm.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Table driven hierarchical state machine.
+ *
+ * States, guards, actions and timeouts are const tables owned by the
+ * machine (see scheduler.c). At init the transition table is indexed by
+ * state and event, so a dispatch only looks at the rows for the current
+ * state and its parents and never scans the whole table.
+ */
+
+#include "hsm.h"
+#include "irq.h"
+
+#include "em_device.h"
+
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+// private helper, free running cpu cycle counter for the trace
+static void enable_cycle_counter() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// private helper, number of parents above a state
+static uint8_t state_depth(const hsm_def_t* def, uint8_t state) {
+
+    uint8_t depth = 0;
+
+    while (def->states[state].parent != HSM_NONE) {
+        state = def->states[state].parent;
+        depth++;
+    }
+
+    return depth;
+}
+
+// private helper, runs the entry actions from just below ancestor down to state
+static void enter_states(hsm_t* sm, uint8_t ancestor, uint8_t state) {
+
+    if ((state == ancestor) || (state == HSM_NONE)) {
+        return;
+    }
+
+    // parents first
+    enter_states(sm, ancestor, sm->def->states[state].parent);
+
+    if (sm->def->states[state].entry != 0) {
+        sm->def->states[state].entry();
+    }
+
+    if (sm->def->states[state].timeout_ms > 0) {
+        sm->def->set_timer(sm->def->states[state].timeout_ms);
+    }
+}
+
+// private helper, save a transition in the trace ring buffer, oldest entry is dropped when full
+static void record_transition(hsm_t* sm, uint8_t event, uint8_t from, uint8_t to, uint32_t cycles) {
+
+    hsm_trace_t* entry = &sm->trace[sm->trace_wptr];
+
+    entry->timestamp = letimerMicroseconds();
+    entry->cycles = cycles;
+    entry->event = event;
+    entry->from = from;
+    entry->to = to;
+
+    sm->trace_wptr = (sm->trace_wptr + 1) % HSM_TRACE_DEPTH;
+
+    if (sm->trace_entries < HSM_TRACE_DEPTH) {
+        sm->trace_entries++;
+    }
+}
+
+/*
+ * private helper, leave the current state for target
+ * exit actions run from the leaf up to the common parent, then the row's
+ * action, then entry actions down to target
+ *
+ * row = transition being taken
+ * event = event that caused it
+ */
+static void take_transition(hsm_t* sm, const hsm_transition_t* row, uint8_t event) {
+
+    const hsm_def_t* def = sm->def;
+    uint32_t start = DWT->CYCCNT;
+    uint8_t from = sm->cur;
+    uint8_t target = row->target;
+
+    // find the closest state that contains both the source and the target
+    uint8_t a = from;
+    uint8_t b = target;
+    uint8_t depth_a = state_depth(def, a);
+    uint8_t depth_b = state_depth(def, b);
+
+    while (depth_a > depth_b) {
+        a = def->states[a].parent;
+        depth_a--;
+    }
+
+    while (depth_b > depth_a) {
+        b = def->states[b].parent;
+        depth_b--;
+    }
+
+    while (a != b) {
+        a = def->states[a].parent;
+        b = def->states[b].parent;
+    }
+
+    // a transition to the source state itself leaves and re-enters it
+    uint8_t ancestor = (a == target) ? def->states[target].parent : a;
+
+    for (uint8_t s = from; s != ancestor; s = def->states[s].parent) {
+        if (def->states[s].timeout_ms > 0) {
+            def->set_timer(0);
+        }
+        if (def->states[s].exit != 0) {
+            def->states[s].exit();
+        }
+    }
+
+    if (row->action != 0) {
+        row->action();
+    }
+
+    enter_states(sm, ancestor, target);
+    sm->cur = target;
+
+    record_transition(sm, event, from, target, DWT->CYCCNT - start);
+
+    LOG_INFO("State transition: %s -> %s", def->states[from].name, def->states[target].name);
+}
+
+// private helper, handle one event in the current state or the closest parent with a matching row
+static void dispatch_one(hsm_t* sm, uint8_t event) {
+
+    if (event >= HSM_MAX_EVENTS) {
+        return;
+    }
+
+    for (uint8_t s = sm->cur; s != HSM_NONE; s = sm->def->states[s].parent) {
+
+        for (uint8_t r = sm->first_row[s][event]; r != HSM_NONE; r = sm->next_row[r]) {
+
+            const hsm_transition_t* row = &sm->def->transitions[r];
+
+            if ((row->guard != 0) && !row->guard()) {
+                continue;
+            }
+
+            if (row->target == HSM_NONE) {
+                if (row->action != 0) {
+                    row->action();
+                }
+            }
+            else {
+                take_transition(sm, row, event);
+            }
+
+            return;
+        }
+    }
+}
+
+/*
+ * index the transition table and enter the initial state
+ *
+ * sm = machine run time data
+ * def = machine description
+ */
+void hsm_init(hsm_t* sm, const hsm_def_t* def) {
+
+    sm->def = def;
+    sm->internal_rptr = 0;
+    sm->internal_entries = 0;
+    sm->trace_wptr = 0;
+    sm->trace_entries = 0;
+
+    if ((def->num_states > HSM_MAX_STATES) || (def->num_transitions > HSM_MAX_TRANSITIONS)) {
+        LOG_ERROR("State machine tables too large");
+        return;
+    }
+
+    for (int s=0; s<HSM_MAX_STATES; s++) {
+        for (int e=0; e<HSM_MAX_EVENTS; e++) {
+            sm->first_row[s][e] = HSM_NONE;
+        }
+    }
+
+    // chain the rows backwards so each chain stays in table order
+    for (int r=def->num_transitions-1; r>=0; r--) {
+        const hsm_transition_t* row = &def->transitions[r];
+
+        sm->next_row[r] = sm->first_row[row->state][row->event];
+        sm->first_row[row->state][row->event] = r;
+    }
+
+    enable_cycle_counter();
+
+    sm->cur = def->initial;
+    enter_states(sm, HSM_NONE, def->initial);
+}
+
+/*
+ * handle an event, then any events that actions posted while handling it
+ *
+ * sm = machine
+ * event = event to handle
+ */
+void hsm_dispatch(hsm_t* sm, uint8_t event) {
+
+    dispatch_one(sm, event);
+
+    while (sm->internal_entries > 0) {
+        uint8_t next = sm->internal[sm->internal_rptr];
+
+        sm->internal_rptr = (sm->internal_rptr + 1) % HSM_INTERNAL_QUEUE_DEPTH;
+        sm->internal_entries--;
+
+        dispatch_one(sm, next);
+    }
+}
+
+/*
+ * queue an event from inside an action, handled once the current event is finished
+ *
+ * sm = machine
+ * event = event to handle
+ */
+void hsm_post(hsm_t* sm, uint8_t event) {
+
+    if (sm->internal_entries == HSM_INTERNAL_QUEUE_DEPTH) {
+        LOG_ERROR("State machine internal queue full");
+        return;
+    }
+
+    sm->internal[(sm->internal_rptr + sm->internal_entries) % HSM_INTERNAL_QUEUE_DEPTH] = event;
+    sm->internal_entries++;
+}
+
+// returns the current leaf state
+uint8_t hsm_state(hsm_t* sm) {
+    return sm->cur;
+}
+
+// returns true if the current leaf state is state or is inside it
+bool hsm_in_state(hsm_t* sm, uint8_t state) {
+
+    for (uint8_t s = sm->cur; s != HSM_NONE; s = sm->def->states[s].parent) {
+        if (s == state) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// print the recorded transitions for debugging, oldest first
+void hsm_print_trace(hsm_t* sm) {
+
+    uint8_t i = (sm->trace_wptr + HSM_TRACE_DEPTH - sm->trace_entries) % HSM_TRACE_DEPTH;
+
+    for (int n=0; n<sm->trace_entries; n++) {
+        hsm_trace_t* entry = &sm->trace[i];
+
+        LOG_INFO("%u.%03u ms: event %d %s -> %s (%u cycles)", (unsigned int) (entry->timestamp / 1000), (unsigned int) (entry->timestamp % 1000), entry->event,
+                 sm->def->states[entry->from].name, sm->def->states[entry->to].name, (unsigned int) entry->cycles);
+
+        i = (i + 1) % HSM_TRACE_DEPTH;
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * hsm.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_HSM_H_
+#define SRC_HSM_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// limits for the dispatch index kept in RAM
+#define HSM_MAX_STATES 8
+#define HSM_MAX_EVENTS 16
+#define HSM_MAX_TRANSITIONS 32
+
+// events posted by actions, handled after the current event finishes
+#define HSM_INTERNAL_QUEUE_DEPTH 4
+
+// transitions kept for debugging
+#define HSM_TRACE_DEPTH 32
+
+// parent of the top state, target of an internal transition
+#define HSM_NONE 0xFF
+
+typedef bool (*hsm_guard_t)();
+typedef void (*hsm_action_t)();
+
+// one state, timeout_ms > 0 starts the state timer on entry
+typedef struct {
+    const char* name; // for logging
+    uint8_t parent; // HSM_NONE for the top state
+    hsm_action_t entry;
+    hsm_action_t exit;
+    uint32_t timeout_ms;
+} hsm_state_t;
+
+// one row of the transition table
+// rows for the same state and event are tried in table order, the first passing guard wins
+// unhandled events are passed to the parent state
+typedef struct {
+    uint8_t state;
+    uint8_t event;
+    hsm_guard_t guard; // NULL = always
+    hsm_action_t action; // NULL = none
+    uint8_t target; // leaf state, HSM_NONE = internal, no exit or entry
+} hsm_transition_t;
+
+// everything that describes a machine, const data
+typedef struct {
+    const hsm_state_t* states;
+    uint8_t num_states;
+    const hsm_transition_t* transitions;
+    uint8_t num_transitions;
+    uint8_t initial; // leaf state to start in
+    uint8_t timeout_event; // dispatched when a state timer expires
+    void (*set_timer)(uint32_t ms); // starts (ms > 0) or stops (ms = 0) the state timer
+} hsm_def_t;
+
+// one recorded transition
+typedef struct {
+    uint64_t timestamp; // us since startup
+    uint32_t cycles; // cpu cycles spent on exit, action and entry
+    uint8_t event;
+    uint8_t from;
+    uint8_t to;
+} hsm_trace_t;
+
+// run time data of a machine
+typedef struct {
+    const hsm_def_t* def;
+    uint8_t cur; // current leaf state
+
+    // first row and next row with the same state and event, built by hsm_init()
+    uint8_t first_row[HSM_MAX_STATES][HSM_MAX_EVENTS];
+    uint8_t next_row[HSM_MAX_TRANSITIONS];
+
+    uint8_t internal[HSM_INTERNAL_QUEUE_DEPTH];
+    uint8_t internal_rptr;
+    uint8_t internal_entries;
+
+    hsm_trace_t trace[HSM_TRACE_DEPTH];
+    uint8_t trace_wptr;
+    uint8_t trace_entries;
+} hsm_t;
+
+void hsm_init(hsm_t* sm, const hsm_def_t* def);
+void hsm_dispatch(hsm_t* sm, uint8_t event);
+void hsm_post(hsm_t* sm, uint8_t event);
+uint8_t hsm_state(hsm_t* sm);
+bool hsm_in_state(hsm_t* sm, uint8_t state);
+void hsm_print_trace(hsm_t* sm);
+
+#endif /* SRC_HSM_H_ */
@@ -7,12 +7,32 @@
 
 #include "i2c.h"
 #include "gpio.h"
-#include "timers.h"
+#include "sw_timer.h"
+#include "scheduler.h"
+#include "journal.h"
 
 #include "em_cmu.h"
+#include "em_core.h"
+#include "em_emu.h"
 #include "sl_i2cspm.h"
+#include "sl_power_manager.h"
+#include "sl_udelay.h"
 
 #define MAX30101_ADDR 0xAA // 0x55 << 1
+#define SI7021_ADDR 0x80 // 0x40 << 1
+
+// extra attempts for a failed transfer, the bus is recovered first unless the device NACKed
+#define I2C_MAX_RETRIES 2
+
+// consecutive failed transfers before dropping to the next slower speed
+#define I2C_ERRORS_BEFORE_SLOWDOWN 3
+
+// clean transfers at a reduced speed before trying the next faster one again
+#define I2C_SUCCESSES_BEFORE_SPEEDUP 1000
+
+// a device can be stuck part way through a byte, 9 clocks always finish it
+#define I2C_RECOVERY_CLOCKS 9
+#define I2C_RECOVERY_HALF_PERIOD_US 5 // 100 kHz
 
 // enable logging for temperature results to be displayed in console
 #define INCLUDE_LOG_DEBUG 1
@@ -23,6 +43,87 @@ I2C_TransferSeq_TypeDef transfer_sequence;
 // heart sensor global variable for saving i2c read data
 uint8_t heart_data[8];
 
+// states of the non-blocking transaction engine
+typedef enum {
+    ENGINE_IDLE,
+    ENGINE_TRANSFER, // waiting on I2C0_IRQHandler
+    ENGINE_DELAY, // waiting on engine_delay_timer
+    ENGINE_RECOVERING, // waiting for the main loop to recover the bus
+    ENGINE_BLOCKING // bus claimed by a blocking transfer
+} i2c_engine_state_t;
+
+// everything the bus manager needs to know about a device
+typedef struct {
+    uint16_t addr; // 8 bit address
+    void (*done)(); // called from interrupt context when a transaction finishes
+} i2c_device_desc_t;
+
+static const i2c_device_desc_t i2c_devices[NUM_I2C_DEVICES] = {
+    [I2C_DEV_MAX32664] = { MAX30101_ADDR, scheduler_set_event_I2C },
+    [I2C_DEV_SI7021]   = { SI7021_ADDR,   scheduler_set_event_temp }
+};
+
+// each device builds at most one transaction at a time
+typedef struct {
+    i2c_step_t steps[I2C_MAX_STEPS];
+    uint8_t num_steps;
+    volatile bool busy; // started and not finished yet
+    volatile I2C_TransferReturn_TypeDef status; // result of the last finished transaction
+} i2c_transaction_t;
+
+static i2c_transaction_t transactions[NUM_I2C_DEVICES];
+
+// started transactions waiting for the bus, oldest first
+static i2c_dev_t bus_queue[NUM_I2C_DEVICES];
+static uint8_t bus_queue_rptr = 0;
+static uint8_t bus_queue_entries = 0;
+
+// transaction that owns the bus
+static volatile i2c_dev_t engine_dev = I2C_DEV_MAX32664;
+static volatile uint8_t engine_cur_step = 0;
+
+static volatile i2c_engine_state_t engine_state = ENGINE_IDLE;
+
+// result of the failed step while the bus is recovered
+static I2C_TransferReturn_TypeDef engine_failed_status = i2cTransferDone;
+static void engine_recover(uint32_t arg);
+static void engine_claim();
+static void engine_release();
+
+// times delay steps
+static void engine_delay_expired(void* context);
+static sw_timer_t engine_delay_timer = { .callback = engine_delay_expired, .flags = SW_TIMER_FROM_ISR };
+
+// true while the engine holds an EM1 requirement for an active transfer
+static bool engine_em1_held = false;
+
+// counters for comparing bus usage between fifo batch sizes
+static uint32_t engine_bytes = 0;
+static uint32_t engine_transactions = 0;
+
+// bus speeds, fastest first
+typedef struct {
+    uint32_t freq;
+    I2C_ClockHLR_TypeDef clhr;
+} i2c_speed_t;
+
+static const i2c_speed_t i2c_speeds[] = {
+    { I2C_FREQ_FAST_MAX, i2cClockHLRAsymetric }, // 400 kHz fast mode
+    { I2C_FREQ_STANDARD_MAX, i2cClockHLRStandard }, // 100 kHz standard mode
+    { 10000, i2cClockHLRStandard } // 10 kHz for marginal wiring
+};
+
+#define NUM_I2C_SPEEDS (sizeof(i2c_speeds) / sizeof(i2c_speeds[0]))
+
+// index into i2c_speeds of the current bus speed
+static uint8_t speed_level = 0;
+static uint8_t consecutive_errors = 0;
+static uint32_t clean_transfers = 0;
+static uint32_t bus_recoveries = 0;
+
+// retries used by the engine for its current step
+static uint8_t engine_step_attempts = 0;
+
 // data structure for initializing i2c
 static I2CSPM_Init_TypeDef i2c_settings = {
         .port = I2C0,
@@ -33,8 +134,8 @@ static I2CSPM_Init_TypeDef i2c_settings = {
         .portLocationScl = 14,
         .portLocationSda = 16,
         .i2cRefFreq = 0,
-        .i2cMaxFreq = I2C_FREQ_STANDARD_MAX,
-        .i2cClhr = i2cClockHLRStandard
+        .i2cMaxFreq = I2C_FREQ_FAST_MAX,
+        .i2cClhr = i2cClockHLRAsymetric
 };
 
 
@@ -72,6 +173,155 @@ void init_i2c() {
     // call the library setup function
     I2CSPM_Init(&i2c_settings);
 
+    speed_level = 0;
+    consecutive_errors = 0;
+    clean_transfers = 0;
+
+}
+
+// deferred from i2c_set_speed(), logging is too slow for interrupt context
+static void report_i2c_speed(uint32_t freq) {
+    LOG_WARN("I2C bus speed now %u Hz", (unsigned int) freq);
+}
+
+// deferred from the engine, logging is too slow for interrupt context
+static void report_i2c_status(uint32_t status) {
+    process_i2c_status((I2C_TransferReturn_TypeDef) (int32_t) status);
+}
+
+// private helper, change the bus speed to an entry of i2c_speeds
+static void i2c_set_speed(uint8_t level) {
+
+    speed_level = level;
+    I2C_BusFreqSet(I2C0, 0, i2c_speeds[level].freq, i2c_speeds[level].clhr);
+
+    scheduler_defer(EVENT_PRIORITY_LOW, report_i2c_speed, i2c_speeds[level].freq);
+}
+
+/*
+ * free a bus held low by a device that lost track of a transfer
+ * SCL is clocked as a GPIO until the device releases SDA, then a stop is sent
+ * takes about 100 us and does not need a device reset
+ */
+void i2c_bus_recover() {
+
+    bus_recoveries++;
+
+    // take the pins away from the I2C peripheral, pin modes are already open drain with pull ups
+    I2C0->ROUTEPEN &= ~(I2C_ROUTEPEN_SCLPEN | I2C_ROUTEPEN_SDAPEN);
+    GPIO_PinOutSet(i2c_settings.sdaPort, i2c_settings.sdaPin);
+    GPIO_PinOutSet(i2c_settings.sclPort, i2c_settings.sclPin);
+
+    // each clock lets the device shift out one more bit until SDA is released
+    for (int i=0; (i < I2C_RECOVERY_CLOCKS) && (GPIO_PinInGet(i2c_settings.sdaPort, i2c_settings.sdaPin) == 0); i++) {
+        GPIO_PinOutClear(i2c_settings.sclPort, i2c_settings.sclPin);
+        sl_udelay_wait(I2C_RECOVERY_HALF_PERIOD_US);
+        GPIO_PinOutSet(i2c_settings.sclPort, i2c_settings.sclPin);
+        sl_udelay_wait(I2C_RECOVERY_HALF_PERIOD_US);
+    }
+
+    // stop condition, SDA rises while SCL is high
+    GPIO_PinOutClear(i2c_settings.sclPort, i2c_settings.sclPin);
+    GPIO_PinOutClear(i2c_settings.sdaPort, i2c_settings.sdaPin);
+    sl_udelay_wait(I2C_RECOVERY_HALF_PERIOD_US);
+    GPIO_PinOutSet(i2c_settings.sclPort, i2c_settings.sclPin);
+    sl_udelay_wait(I2C_RECOVERY_HALF_PERIOD_US);
+    GPIO_PinOutSet(i2c_settings.sdaPort, i2c_settings.sdaPin);
+    sl_udelay_wait(I2C_RECOVERY_HALF_PERIOD_US);
+
+    // hand the pins back, the peripheral didn't see the stop so abort to make it idle
+    I2C0->ROUTEPEN |= (I2C_ROUTEPEN_SCLPEN | I2C_ROUTEPEN_SDAPEN);
+    I2C0->CMD = I2C_CMD_ABORT;
+    I2C_IntClear(I2C0, _I2C_IFC_MASK);
+}
+
+/*
+ * update the error counters after a transfer and adjust the bus speed
+ * NACKs only mean the device was busy, so they don't count towards a slowdown,
+ * any other error can leave the bus stuck
+ *
+ * transfer_status = returned value from I2C_Transfer()
+ *
+ * returns: true if the bus should be recovered with i2c_bus_recover()
+ */
+static bool i2c_track_result(I2C_TransferReturn_TypeDef transfer_status) {
+
+    if (transfer_status == i2cTransferDone) {
+        consecutive_errors = 0;
+
+        // try the next faster speed again after a long run without errors
+        if (speed_level > 0) {
+            clean_transfers++;
+
+            if (clean_transfers >= I2C_SUCCESSES_BEFORE_SPEEDUP) {
+                clean_transfers = 0;
+                i2c_set_speed(speed_level - 1);
+            }
+        }
+        return false;
+    }
+
+    // the hub NACKs while it resets or boots, that says nothing about the wiring
+    if (transfer_status == i2cTransferNack) {
+        return false;
+    }
+
+    clean_transfers = 0;
+    consecutive_errors++;
+
+    if ((consecutive_errors >= I2C_ERRORS_BEFORE_SLOWDOWN) && (speed_level < NUM_I2C_SPEEDS - 1)) {
+        consecutive_errors = 0;
+        i2c_set_speed(speed_level + 1);
+    }
+
+    return true;
+}
+
+/*
+ * private helper, do a blocking transfer to the sensor hub with retries
+ *
+ * flags = I2C_FLAG_WRITE or I2C_FLAG_READ
+ * data = buffer to write from or read into
+ * len = num bytes to transfer
+ *
+ * returns: status of the last attempt
+ */
+static I2C_TransferReturn_TypeDef i2c_transfer_blocking(uint16_t flags, uint8_t* data, uint16_t len) {
+
+    I2C_TransferReturn_TypeDef transfer_status = i2cTransferDone;
+
+    // let queued transactions for other devices finish first
+    engine_claim();
+
+    for (int attempt = 0; attempt <= I2C_MAX_RETRIES; attempt++) {
+
+        // set i2c address and mode
+        transfer_sequence.addr = MAX30101_ADDR;
+        transfer_sequence.flags = flags;
+        transfer_sequence.buf[0].data = data;
+        transfer_sequence.buf[0].len = len;
+
+        // start the transfer
+        transfer_status = I2CSPM_Transfer(I2C0, &transfer_sequence);
+
+        if (i2c_track_result(transfer_status)) {
+            i2c_bus_recover();
+        }
+
+        if (transfer_status == i2cTransferDone) {
+            if (flags == I2C_FLAG_READ) {
+                JOURNAL_I2C_READ(I2C_DEV_MAX32664, data, len);
+            }
+            break;
+        }
+
+        // check for errors
+        process_i2c_status(transfer_status);
+    }
+
+    engine_release();
+
+    return transfer_status;
 }
 
 // load power management deinitialization
@@ -94,44 +344,20 @@ void deinit_i2c() {
  *
  * cmd = data to write
  * len = num bytes to write
+ *
+ * returns: transfer status
  */
-void i2c_write(uint8_t* cmd, int len) {
-
-    // set i2c address and mode
-    transfer_sequence.addr = MAX30101_ADDR;
-    transfer_sequence.flags = I2C_FLAG_WRITE;
-    transfer_sequence.buf[0].data = cmd;
-    transfer_sequence.buf[0].len = len;
-
-    // start the transfer
-    I2C_TransferReturn_TypeDef transfer_status = I2CSPM_Transfer(I2C0, &transfer_sequence);
-
-    // check for errors
-    if (transfer_status < 0) {
-        process_i2c_status(transfer_status);
-    }
-
+I2C_TransferReturn_TypeDef i2c_write(uint8_t* cmd, int len) {
+    return i2c_transfer_blocking(I2C_FLAG_WRITE, cmd, len);
 }
 
 /*
  * Do an i2c read
+ *
+ * returns: transfer status
  */
-void i2c_read() {
-
-    // set i2c address and mode
-    transfer_sequence.addr = MAX30101_ADDR;
-    transfer_sequence.flags = I2C_FLAG_READ;
-    transfer_sequence.buf[0].data = heart_data;
-    transfer_sequence.buf[0].len = sizeof(heart_data);
-
-    // start the transfer
-    I2C_TransferReturn_TypeDef transfer_status = I2CSPM_Transfer(I2C0, &transfer_sequence);
-
-    // check for errors
-    if (transfer_status < 0) {
-        process_i2c_status(transfer_status);
-    }
-
+I2C_TransferReturn_TypeDef i2c_read() {
+    return i2c_transfer_blocking(I2C_FLAG_READ, heart_data, sizeof(heart_data));
 }
 
 /*
@@ -139,25 +365,11 @@ void i2c_read() {
  *
  * save_addr = address to save data to
  * num_bytes = num bytes to read
+ *
+ * returns: transfer status
  */
-void i2c_read_addr(uint8_t* save_addr, uint8_t num_bytes) {
-
-    //init_i2c();
-
-    // set i2c address and mode
-    transfer_sequence.addr = MAX30101_ADDR;
-    transfer_sequence.flags = I2C_FLAG_READ;
-    transfer_sequence.buf[0].data = save_addr;
-    transfer_sequence.buf[0].len = num_bytes;
-
-    // start the transfer
-    I2C_TransferReturn_TypeDef transfer_status = I2CSPM_Transfer(I2C0, &transfer_sequence);
-
-    // check for errors
-    if (transfer_status < 0) {
-        process_i2c_status(transfer_status);
-    }
-
+I2C_TransferReturn_TypeDef i2c_read_addr(uint8_t* save_addr, uint8_t num_bytes) {
+    return i2c_transfer_blocking(I2C_FLAG_READ, save_addr, num_bytes);
 }
 
 /*
@@ -195,3 +407,371 @@ void process_i2c_status(I2C_TransferReturn_TypeDef ret_value) {
 
     }
 }
+
+// ---------------------------------------------------------------------
+// Non-blocking bus manager
+//
+// Each device on the bus has its own transaction, a list of write, delay
+// and read steps that is queued from the main loop. Started transactions
+// wait in bus_queue and run one after another entirely from interrupt
+// context: I2C0_IRQHandler finishes each transfer step and an interrupt
+// context software timer finishes each delay step. The core only needs EM1 while the I2C
+// peripheral is busy, so it can drop to EM2 during command delays and
+// conversions. Completion is reported with the device's done callback.
+// Bus recovery and logging are too slow for interrupt context and are
+// deferred to the main loop with scheduler_defer().
+//
+// The blocking i2c_write() / i2c_read() functions sleep in EM1 until the
+// queue is empty and claim the bus before using the shared transfer
+// sequence, transactions started while they hold it wait in bus_queue.
+// Nothing in the firmware uses them any more, host/tests/test_i2c.c
+// measures the engine against them.
+// ---------------------------------------------------------------------
+
+// private helper, adds a step to a device's pending transaction
+static void queue_step(i2c_dev_t dev, i2c_step_type_t type, uint8_t* data, uint16_t len, uint32_t delay_us) {
+
+    i2c_transaction_t* t = &transactions[dev];
+
+    if (t->busy) {
+        LOG_ERROR("Cannot queue I2C step while a transaction is running");
+        return;
+    }
+
+    if (t->num_steps == I2C_MAX_STEPS) {
+        LOG_ERROR("I2C transaction step queue full");
+        return;
+    }
+
+    t->steps[t->num_steps].type = type;
+    t->steps[t->num_steps].data = data;
+    t->steps[t->num_steps].len = len;
+    t->steps[t->num_steps].delay_us = delay_us;
+    t->num_steps++;
+}
+
+// private helper, hold or release the EM1 requirement needed by the I2C peripheral
+static void engine_hold_em1(bool hold) {
+
+    if (hold && !engine_em1_held) {
+        sl_power_manager_add_em_requirement(SL_POWER_MANAGER_EM1);
+        engine_em1_held = true;
+    }
+    else if (!hold && engine_em1_held) {
+        sl_power_manager_remove_em_requirement(SL_POWER_MANAGER_EM1);
+        engine_em1_held = false;
+    }
+}
+
+static void engine_run_step();
+
+// private helper, gives the bus to a device's transaction and runs its first step
+static void engine_begin(i2c_dev_t dev) {
+
+    engine_dev = dev;
+    engine_cur_step = 0;
+    engine_step_attempts = 0;
+
+    engine_run_step();
+}
+
+// private helper, ends the transaction, notifies its owner and starts the next one waiting
+static void engine_finish(I2C_TransferReturn_TypeDef transfer_status) {
+
+    i2c_transaction_t* t = &transactions[engine_dev];
+
+    t->status = transfer_status;
+
+    if (transfer_status == i2cTransferDone) {
+        for (int i=0; i<t->num_steps; i++) {
+            if (t->steps[i].type == I2C_STEP_READ) {
+                JOURNAL_I2C_READ(engine_dev, t->steps[i].data, t->steps[i].len);
+            }
+        }
+    }
+
+    t->num_steps = 0;
+    t->busy = false;
+
+    engine_transactions++;
+    engine_cur_step = 0;
+    engine_state = ENGINE_IDLE;
+
+    i2c_devices[engine_dev].done();
+
+    if (bus_queue_entries > 0) {
+        i2c_dev_t next = bus_queue[bus_queue_rptr];
+        bus_queue_rptr = (bus_queue_rptr + 1) % NUM_I2C_DEVICES;
+        bus_queue_entries--;
+
+        engine_begin(next);
+        return;
+    }
+
+    NVIC_DisableIRQ(I2C0_IRQn);
+    engine_hold_em1(false);
+}
+
+// private helper, starts the current step or finishes the transaction when no steps remain
+static void engine_run_step() {
+
+    i2c_transaction_t* t = &transactions[engine_dev];
+
+    if (engine_cur_step >= t->num_steps) {
+        engine_finish(i2cTransferDone);
+        return;
+    }
+
+    i2c_step_t* step = &t->steps[engine_cur_step];
+
+    // sleep in EM2 until the delay timer fires
+    if (step->type == I2C_STEP_DELAY) {
+        engine_hold_em1(false);
+        engine_state = ENGINE_DELAY;
+        sw_timer_start(&engine_delay_timer, step->delay_us, 0);
+        return;
+    }
+
+    // set i2c address and mode
+    transfer_sequence.addr = i2c_devices[engine_dev].addr;
+    transfer_sequence.flags = (step->type == I2C_STEP_WRITE) ? I2C_FLAG_WRITE : I2C_FLAG_READ;
+    transfer_sequence.buf[0].data = step->data;
+    transfer_sequence.buf[0].len = step->len;
+
+    engine_hold_em1(true);
+    engine_state = ENGINE_TRANSFER;
+
+    // the rest of the transfer is driven by I2C0_IRQHandler
+    I2C_TransferReturn_TypeDef transfer_status = I2C_TransferInit(I2C0, &transfer_sequence);
+
+    if (transfer_status < 0) {
+        scheduler_defer(EVENT_PRIORITY_LOW, report_i2c_status, transfer_status);
+        engine_finish(transfer_status);
+    }
+}
+
+// called from the LETIMER interrupt when a delay step has elapsed
+static void engine_delay_expired(void* context) {
+    (void) context;
+
+    if (engine_state != ENGINE_DELAY) {
+        return;
+    }
+
+    engine_cur_step++;
+    engine_run_step();
+}
+
+// private helper, run a failed step again or give up on the transaction
+static void engine_retry_step(I2C_TransferReturn_TypeDef transfer_status) {
+
+    if (engine_step_attempts < I2C_MAX_RETRIES) {
+        engine_step_attempts++;
+        engine_run_step();
+    }
+    else {
+        engine_finish(transfer_status);
+    }
+}
+
+/*
+ * deferred from I2C0_IRQHandler, recover the bus after a failed step, then retry it
+ * does nothing if there is no recovery pending, a blocking transfer may have run it first
+ *
+ * arg = unused
+ */
+static void engine_recover(uint32_t arg) {
+    (void) arg;
+
+    if (engine_state != ENGINE_RECOVERING) {
+        return;
+    }
+
+    // the engine is stopped, nothing else uses the bus while it is clocked free
+    i2c_bus_recover();
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    engine_retry_step(engine_failed_status);
+    CORE_EXIT_CRITICAL();
+}
+
+/*
+ * private helper, takes the bus for a blocking transfer, sleeping in EM1 until the engine is idle
+ * checked and set in one critical section, so a transaction started from an
+ * interrupt either runs first or waits in bus_queue until engine_release()
+ * transactions are interrupt driven, except for bus recovery, which waits on
+ * the main loop we are blocking and is run from here
+ */
+static void engine_claim() {
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    while (engine_state != ENGINE_IDLE) {
+
+        if (engine_state == ENGINE_RECOVERING) {
+            CORE_EXIT_CRITICAL();
+            engine_recover(0);
+            CORE_ENTER_CRITICAL();
+            continue;
+        }
+
+        // WFI still wakes on an interrupt masked by PRIMASK, checking the state with
+        // interrupts off means the engine can't finish between the check and the sleep
+        EMU_EnterEM1();
+
+        // let the interrupt that woke us run
+        CORE_EXIT_CRITICAL();
+        CORE_ENTER_CRITICAL();
+    }
+
+    engine_state = ENGINE_BLOCKING;
+
+    CORE_EXIT_CRITICAL();
+}
+
+// private helper, gives the bus back after a blocking transfer and starts the next transaction waiting
+static void engine_release() {
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    engine_state = ENGINE_IDLE;
+
+    if (bus_queue_entries > 0) {
+        i2c_dev_t next = bus_queue[bus_queue_rptr];
+        bus_queue_rptr = (bus_queue_rptr + 1) % NUM_I2C_DEVICES;
+        bus_queue_entries--;
+
+        NVIC_ClearPendingIRQ(I2C0_IRQn);
+        NVIC_EnableIRQ(I2C0_IRQn);
+
+        engine_begin(next);
+    }
+
+    CORE_EXIT_CRITICAL();
+}
+
+/*
+ * Queue a write step for a device's next transaction
+ *
+ * dev = device to talk to
+ * cmd = data to write, must stay valid until the transaction completes
+ * len = num bytes to write
+ */
+void i2c_queue_write(i2c_dev_t dev, uint8_t* cmd, uint16_t len) {
+    queue_step(dev, I2C_STEP_WRITE, cmd, len, 0);
+}
+
+/*
+ * Queue a delay step for a device's next transaction
+ * the bus is held for the delay so the device sees the steps back to back
+ *
+ * dev = device to talk to
+ * us_wait = delay duration in us
+ */
+void i2c_queue_delay(i2c_dev_t dev, uint32_t us_wait) {
+    queue_step(dev, I2C_STEP_DELAY, 0, 0, us_wait);
+}
+
+/*
+ * Queue a read step for a device's next transaction
+ *
+ * dev = device to talk to
+ * save_addr = address to save data to, must stay valid until the transaction completes
+ * num_bytes = num bytes to read
+ */
+void i2c_queue_read(i2c_dev_t dev, uint8_t* save_addr, uint16_t num_bytes) {
+    queue_step(dev, I2C_STEP_READ, save_addr, num_bytes, 0);
+}
+
+/*
+ * start running a device's queued steps, right away if the bus is free
+ * or after the transactions already waiting for it
+ * the device's done callback is called when they have all finished
+ *
+ * dev = device to talk to
+ */
+void i2c_start_transaction(i2c_dev_t dev) {
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    if (transactions[dev].busy) {
+        CORE_EXIT_CRITICAL();
+        LOG_ERROR("I2C transaction already running");
+        return;
+    }
+
+    transactions[dev].busy = true;
+
+    if (engine_state != ENGINE_IDLE) {
+        bus_queue[(bus_queue_rptr + bus_queue_entries) % NUM_I2C_DEVICES] = dev;
+        bus_queue_entries++;
+    }
+    else {
+        NVIC_ClearPendingIRQ(I2C0_IRQn);
+        NVIC_EnableIRQ(I2C0_IRQn);
+
+        engine_begin(dev);
+    }
+
+    CORE_EXIT_CRITICAL();
+}
+
+// returns true while a device's transaction has not finished
+bool i2c_transaction_busy(i2c_dev_t dev) {
+    return transactions[dev].busy;
+}
+
+// returns true while any transaction or blocking transfer is running or waiting for the bus
+bool i2c_bus_busy() {
+    return (engine_state != ENGINE_IDLE);
+}
+
+// returns the result of a device's last finished transaction
+I2C_TransferReturn_TypeDef i2c_transaction_status(i2c_dev_t dev) {
+    return transactions[dev].status;
+}
+
+/*
+ * called from I2C0_IRQHandler when a transfer step is no longer in progress
+ *
+ * transfer_status = returned value from I2C_Transfer()
+ */
+void i2c_transaction_transfer_done(I2C_TransferReturn_TypeDef transfer_status) {
+
+    if (engine_state != ENGINE_TRANSFER) {
+        return;
+    }
+
+    bool recover = i2c_track_result(transfer_status);
+
+    if (transfer_status != i2cTransferDone) {
+        scheduler_defer(EVENT_PRIORITY_LOW, report_i2c_status, transfer_status);
+
+        // clocking the bus free takes about 100 us, too long for interrupt context
+        if (recover) {
+            engine_state = ENGINE_RECOVERING;
+            engine_failed_status = transfer_status;
+            scheduler_defer(EVENT_PRIORITY_HIGH, engine_recover, 0);
+            return;
+        }
+
+        engine_retry_step(transfer_status);
+        return;
+    }
+
+    engine_bytes += transactions[engine_dev].steps[engine_cur_step].len;
+
+    engine_step_attempts = 0;
+    engine_cur_step++;
+    engine_run_step();
+}
+
+// print bus usage counters for debugging
+void print_i2c_stats() {
+    LOG_INFO("I2C transactions: %u   bytes: %u   bus recoveries: %u   speed: %u Hz", (unsigned int) engine_transactions, (unsigned int) engine_bytes,
+             (unsigned int) bus_recoveries, (unsigned int) i2c_speeds[speed_level].freq);
+}
@@ -9,8 +9,34 @@
 #define SRC_I2C_H_
 
 #include "stdint.h"
+#include "stdbool.h"
 #include "em_i2c.h"
 
+// maximum number of write/delay/read steps in one queued transaction
+#define I2C_MAX_STEPS 12
+
+// devices on the shared bus, each has its own transaction
+typedef enum {
+    I2C_DEV_MAX32664, // sensor hub
+    I2C_DEV_SI7021, // temperature / humidity sensor
+    NUM_I2C_DEVICES
+} i2c_dev_t;
+
+// kinds of steps the transaction engine can execute
+typedef enum {
+    I2C_STEP_WRITE,
+    I2C_STEP_DELAY,
+    I2C_STEP_READ
+} i2c_step_type_t;
+
+// one step of a queued transaction
+typedef struct {
+    i2c_step_type_t type;
+    uint8_t* data; // buffer to write from or read into
+    uint16_t len; // num bytes to transfer
+    uint32_t delay_us; // only used by delay steps
+} i2c_step_t;
+
 uint8_t* get_heart_data();
 
 void reset_heart_data();
@@ -23,12 +49,27 @@ void init_i2c();
 
 void deinit_i2c();
 
-void i2c_write(uint8_t* cmd, int len);
+void i2c_bus_recover();
 
-void i2c_read();
+I2C_TransferReturn_TypeDef i2c_write(uint8_t* cmd, int len);
 
-void i2c_read_addr(uint8_t* save_addr, uint8_t num_bytes);
+I2C_TransferReturn_TypeDef i2c_read();
+
+I2C_TransferReturn_TypeDef i2c_read_addr(uint8_t* save_addr, uint8_t num_bytes);
 
 void process_i2c_status(I2C_TransferReturn_TypeDef ret_value);
 
+// non-blocking bus manager
+void i2c_queue_write(i2c_dev_t dev, uint8_t* cmd, uint16_t len);
+void i2c_queue_delay(i2c_dev_t dev, uint32_t us_wait);
+void i2c_queue_read(i2c_dev_t dev, uint8_t* save_addr, uint16_t num_bytes);
+void i2c_start_transaction(i2c_dev_t dev);
+bool i2c_transaction_busy(i2c_dev_t dev);
+bool i2c_bus_busy();
+I2C_TransferReturn_TypeDef i2c_transaction_status(i2c_dev_t dev);
+void print_i2c_stats();
+
+// called from I2C0_IRQHandler to advance the engine
+void i2c_transaction_transfer_done(I2C_TransferReturn_TypeDef transfer_status);
+
 #endif /* SRC_I2C_H_ */
@@ -11,6 +11,8 @@
 #include "app.h"
 #include "timers.h"
 #include "i2c.h"
+#include "sw_timer.h"
+#include "irq_timing.h"
 
 #include "em_core.h"
 #include "em_letimer.h"
@@ -21,26 +23,29 @@
 //#define INCLUDE_LOG_DEBUG 1
 #include "log.h"
 
+#define USEC_PER_MSEC 1000
+
 // global variables
 uint32_t num_underflows = 0;
 
 
 // I2C interrupt service routine
 void I2C0_IRQHandler() {
-    I2C_TransferReturn_TypeDef transfer_status = I2C_Transfer(I2C0);
+    IRQ_TIMING_START();
 
-    if (transfer_status == i2cTransferDone) {
-        scheduler_set_event_I2C();
-    }
+    I2C_TransferReturn_TypeDef transfer_status = I2C_Transfer(I2C0);
 
-    if (transfer_status < 0) {
-        process_i2c_status(transfer_status);
+    // advance the transaction engine once the current step is complete
+    if (transfer_status != i2cTransferInProgress) {
+        i2c_transaction_transfer_done(transfer_status);
     }
 
+    IRQ_TIMING_END(IRQ_SRC_I2C0);
 }
 
 // LE Timer interrupt service routine
 void LETIMER0_IRQHandler() {
+  IRQ_TIMING_START();
 
   // get enabled and pending LETIMER interrupt flags
   uint32_t flags = LETIMER_IntGetEnabled(LETIMER0);
@@ -54,57 +59,97 @@ void LETIMER0_IRQHandler() {
       // update timestamps in logging
       count_underflows();
 
-      // tell scheduler to request a temperature measurement
-      scheduler_set_event_UF();
-
   }
 
   // check if CNT == COMP1 was source of interrupt
   if (flags & LETIMER_IF_COMP1) {
       LETIMER_IntDisable(LETIMER0, LETIMER_IEN_COMP1);
-      scheduler_set_event_COMP1();
   }
 
+  // run expired software timers and set COMP1 for the next one,
+  // deadlines in a later period are checked again at each underflow
+  sw_timer_irq();
+
+  IRQ_TIMING_END(IRQ_SRC_LETIMER0);
 }
 
-// push button 0 interrupt service routine
-void GPIO_EVEN_IRQHandler() {
+// push button 0 changed state
+static void pb0_irq() {
+    if (GPIO_PinInGet(PB0_PORT, PB0_PIN) == true) {
+        scheduler_set_event_PB0_released();
+    }
+    else {
+        scheduler_set_event_PB0_pressed();
+    }
+}
 
-    // get interrupts
-    uint32_t flags = GPIO_IntGetEnabled();
+// push button 1 changed state
+static void pb1_irq() {
+    if (GPIO_PinInGet(PB1_PORT, PB1_PIN) == true) {
+        scheduler_set_event_PB1_released();
+    }
+    else {
+        scheduler_set_event_PB1_pressed();
+    }
+}
 
-    GPIO_IntClear(flags);
+// sensor hub asserted MFIO, samples are waiting in its fifo
+static void mfio_irq() {
+    scheduler_set_event_data_ready();
+}
 
+// GPIO interrupt dispatch table, indexed by external interrupt number (= pin number)
+static void (*const gpio_irq_handlers[GPIO_EXTINTNO_MAX + 1])() = {
+    [PB0_PIN] = pb0_irq,
+    [PB1_PIN] = pb1_irq,
+    [MAX30101_MFIO_PIN] = mfio_irq
+};
 
-    if (flags == (1 << PB0_PIN)) {
-        if (GPIO_PinInGet(PB0_PORT, PB0_PIN) == true) {
-            scheduler_set_event_PB0_released();
-        }
-        else {
-            scheduler_set_event_PB0_pressed();
+/*
+ * calls the handler of every external interrupt that is set in flags
+ * more than one pin can be pending in the same interrupt
+ *
+ * flags = pending interrupt flags
+ */
+static void dispatch_gpio_irq(uint32_t flags) {
+
+    while (flags != 0) {
+        uint32_t int_no = SL_CTZ(flags);
+        flags &= ~(1 << int_no);
+
+        if (gpio_irq_handlers[int_no] != 0) {
+            gpio_irq_handlers[int_no]();
         }
     }
 
 }
 
-// push button 1 interrupt service routine
-void GPIO_ODD_IRQHandler() {
+// even numbered pins: push button 0, sensor hub MFIO
+void GPIO_EVEN_IRQHandler() {
+    IRQ_TIMING_START();
 
     // get interrupts
-    uint32_t flags = GPIO_IntGetEnabled();
+    uint32_t flags = GPIO_IntGetEnabled() & _GPIO_IF_EXT_MASK & 0x5555;
 
     GPIO_IntClear(flags);
 
+    dispatch_gpio_irq(flags);
 
-    if (flags == (1 << PB1_PIN)) {
-        if (GPIO_PinInGet(PB1_PORT, PB1_PIN) == true) {
-            scheduler_set_event_PB1_released();
-        }
-        else {
-            scheduler_set_event_PB1_pressed();
-        }
-    }
+    IRQ_TIMING_END(IRQ_SRC_GPIO_EVEN);
+}
 
+// odd numbered pins: push button 1
+void GPIO_ODD_IRQHandler() {
+    IRQ_TIMING_START();
+
+    // get interrupts
+    uint32_t flags = GPIO_IntGetEnabled() & _GPIO_IF_EXT_MASK & 0xAAAA;
+
+    GPIO_IntClear(flags);
+
+    dispatch_gpio_irq(flags);
+
+    IRQ_TIMING_END(IRQ_SRC_GPIO_ODD);
 }
 
 // counts number of times underflow interrupt occurred
@@ -113,17 +158,47 @@ void count_underflows() {
 }
 
 /*
- * Calculates the amount of time since system startup
+ * Calculates the number of LETIMER ticks since system startup
+ * an underflow that hasn't been counted yet (interrupts disabled) is included
  *
- * returns: time value in milliseconds
+ * returns: ticks since startup
  */
-uint32_t letimerMilliseconds() {
+uint64_t letimerTicks() {
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
 
+    uint32_t underflows = num_underflows;
     uint32_t timer_cur_ticks = LETIMER_CounterGet(LETIMER0);
-    uint32_t timer_elapsed_ticks = timer_max_ticks - timer_cur_ticks;
-    uint32_t timer_elapsed_ms = timer_elapsed_ticks * LETIMER_PERIOD_MS / timer_max_ticks;
 
-    uint32_t result = (num_underflows * LETIMER_PERIOD_MS) + timer_elapsed_ms;
+    // the first read could be from either side of the reload, the second is after it
+    if (LETIMER_IntGet(LETIMER0) & LETIMER_IF_UF) {
+        underflows++;
+        timer_cur_ticks = LETIMER_CounterGet(LETIMER0);
+    }
+
+    CORE_EXIT_CRITICAL();
 
-    return result;
+    // the counter reloads to timer_max_ticks, so a period is timer_max_ticks + 1 ticks
+    return ((uint64_t) underflows * (timer_max_ticks + 1)) + (timer_max_ticks - timer_cur_ticks);
+}
+
+/*
+ * Calculates the amount of time since system startup
+ * constant cost, no division
+ *
+ * returns: time value in microseconds
+ */
+uint64_t letimerMicroseconds() {
+    return (letimerTicks() * usec_per_tick_q12) >> 12;
+}
+
+/*
+ * Calculates the amount of time since system startup
+ * for log timestamps and short durations, wraps after 49 days
+ *
+ * returns: time value in milliseconds
+ */
+uint32_t letimerMilliseconds() {
+    return letimerMicroseconds() / USEC_PER_MSEC;
 }
@@ -16,6 +16,8 @@ void GPIO_EVEN_IRQHandler();
 void GPIO_ODD_IRQHandler();
 
 void count_underflows();
+uint64_t letimerTicks();
+uint64_t letimerMicroseconds();
 uint32_t letimerMilliseconds();
 
 #endif /* SRC_IRQ_H_ */
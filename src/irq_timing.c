@@ -0,0 +1,97 @@
+/*
+ * irq_timing.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Worst case interrupt latency added by the application, enabled with IRQ_TIMING.
+ * The link layer is delayed by anything that runs with PRIMASK set and by
+ * handlers at the same or a more urgent priority, so both are recorded:
+ * the longest run of every application handler, and the longest critical
+ * section anywhere in the image (emlib's CORE_EnterCritical() and
+ * CORE_ExitCritical() are weak, these versions replace them).
+ */
+
+#include "irq_timing.h"
+
+#include "em_core.h"
+
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#define USEC_PER_SEC 1000000
+
+static const char* const irq_src_names[NUM_IRQ_SRCS] = {
+    [IRQ_SRC_I2C0]      = "I2C0",
+    [IRQ_SRC_LETIMER0]  = "LETIMER0",
+    [IRQ_SRC_GPIO_EVEN] = "GPIO_EVEN",
+    [IRQ_SRC_GPIO_ODD]  = "GPIO_ODD"
+};
+
+// longest handler runs in cycles
+static uint32_t irq_max_cycles[NUM_IRQ_SRCS];
+
+// longest critical section in cycles, and the code that entered it
+static uint32_t critical_max_cycles = 0;
+static void* critical_max_caller = 0;
+
+/*
+ * save the run time of a handler if it is the longest so far
+ *
+ * src = handler that ran
+ * cycles = cpu cycles from entry to exit
+ */
+void irq_timing_record(irq_src_t src, uint32_t cycles) {
+    if (cycles > irq_max_cycles[src]) {
+        irq_max_cycles[src] = cycles;
+    }
+}
+
+#ifdef IRQ_TIMING
+// outermost critical section in progress
+static uint32_t critical_start = 0;
+static void* critical_caller = 0;
+
+// replaces the weak emlib version, times the outermost critical section
+CORE_irqState_t CORE_EnterCritical(void) {
+
+    CORE_irqState_t irqState = __get_PRIMASK();
+    __disable_irq();
+
+    if (irqState == 0U) {
+        critical_start = DWT->CYCCNT;
+        critical_caller = __builtin_return_address(0);
+    }
+
+    return irqState;
+}
+
+// replaces the weak emlib version
+void CORE_ExitCritical(CORE_irqState_t irqState) {
+
+    if (irqState == 0U) {
+        uint32_t cycles = DWT->CYCCNT - critical_start;
+
+        if (cycles > critical_max_cycles) {
+            critical_max_cycles = cycles;
+            critical_max_caller = critical_caller;
+        }
+
+        __enable_irq();
+    }
+}
+#endif
+
+// log the longest handler runs and critical section, in cycles and us
+void print_irq_timing() {
+
+    uint32_t cycles_per_us = SystemCoreClockGet() / USEC_PER_SEC;
+
+    for (int i=0; i<NUM_IRQ_SRCS; i++) {
+        LOG_INFO("%s handler max: %u cycles (%u us)", irq_src_names[i], (unsigned int) irq_max_cycles[i],
+                 (unsigned int) (irq_max_cycles[i] / cycles_per_us));
+    }
+
+    LOG_INFO("Critical section max: %u cycles (%u us), entered from %p", (unsigned int) critical_max_cycles,
+             (unsigned int) (critical_max_cycles / cycles_per_us), critical_max_caller);
+}
@@ -0,0 +1,39 @@
+/*
+ * irq_timing.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_IRQ_TIMING_H_
+#define SRC_IRQ_TIMING_H_
+
+#include "stdint.h"
+
+#include "em_device.h"
+
+// measure interrupt handler and interrupts-disabled times with the cycle counter
+// costs a few cycles per handler and critical section, leave off for energy measurements
+//#define IRQ_TIMING 1
+
+// application interrupt handlers that are timed
+typedef enum {
+    IRQ_SRC_I2C0,
+    IRQ_SRC_LETIMER0,
+    IRQ_SRC_GPIO_EVEN,
+    IRQ_SRC_GPIO_ODD,
+    NUM_IRQ_SRCS
+} irq_src_t;
+
+#ifdef IRQ_TIMING
+#define IRQ_TIMING_START() uint32_t irq_timing_start = DWT->CYCCNT
+#define IRQ_TIMING_END(src) irq_timing_record((src), DWT->CYCCNT - irq_timing_start)
+#else
+#define IRQ_TIMING_START()
+#define IRQ_TIMING_END(src)
+#endif
+
+void irq_timing_record(irq_src_t src, uint32_t cycles);
+void print_irq_timing();
+
+#endif /* SRC_IRQ_TIMING_H_ */
@@ -0,0 +1,345 @@
+/*
+ * journal.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Journal of the inputs that drive the firmware, enabled with JOURNAL.
+ * Every bluetooth event handed to sl_bt_on_event(), every application
+ * event as it is handled and every byte read from an I2C device is
+ * appended to a RAM ring, oldest records are dropped to make room. Given
+ * the same inputs in the same order the state machines do the same
+ * thing, so a journal copied out with journal_dump() or journal_flush()
+ * can be fed back through the handlers off target.
+ *
+ * Records are appended from the main loop, the active objects and the
+ * I2C interrupt, each append is a short critical section.
+ */
+
+#include "journal.h"
+
+#include "stdio.h"
+#include "string.h"
+
+#ifdef JOURNAL
+#include "irq.h"
+
+#include "em_core.h"
+#include "sl_bt_api.h"
+
+#ifdef JOURNAL_FLASH
+#include "em_msc.h"
+#endif
+
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+// bytes per line of journal_dump()
+#define DUMP_LINE_BYTES 32
+
+static uint8_t ring[JOURNAL_SIZE];
+static uint32_t head = 0; // oldest record
+static uint32_t used = 0;
+
+// records dropped to make room or while the ring was being read
+static uint32_t lost = 0;
+
+// set while the ring is copied out, appends are dropped so the copy is consistent
+static bool paused = false;
+
+// private helper, copies bytes into the ring after the newest record, call with interrupts disabled
+static void ring_write(const uint8_t* data, uint32_t len) {
+
+    uint32_t pos = (head + used) % JOURNAL_SIZE;
+
+    for (uint32_t i=0; i<len; i++) {
+        ring[pos] = data[i];
+        pos = (pos + 1 == JOURNAL_SIZE) ? 0 : pos + 1;
+    }
+
+    used += len;
+}
+
+// private helper, copies bytes out of the ring starting offset bytes after the oldest record
+static void ring_read(uint32_t offset, uint8_t* data, uint32_t len) {
+
+    uint32_t pos = (head + offset) % JOURNAL_SIZE;
+
+    for (uint32_t i=0; i<len; i++) {
+        data[i] = ring[pos];
+        pos = (pos + 1 == JOURNAL_SIZE) ? 0 : pos + 1;
+    }
+}
+
+/*
+ * private helper, appends one record made of up to two pieces of payload
+ *
+ * type = kind of record
+ * a, a_len = first part of the payload
+ * b, b_len = second part, may be 0
+ */
+static void append(journal_type_t type, const void* a, uint32_t a_len, const void* b, uint32_t b_len) {
+
+    if (a_len + b_len > JOURNAL_MAX_PAYLOAD) {
+        b_len = JOURNAL_MAX_PAYLOAD - a_len;
+    }
+
+    uint32_t timestamp = letimerMicroseconds();
+    uint8_t header[JOURNAL_HEADER_SIZE] = {
+        type, a_len + b_len,
+        timestamp & 0xFF, (timestamp >> 8) & 0xFF, (timestamp >> 16) & 0xFF, timestamp >> 24
+    };
+    uint32_t total = JOURNAL_HEADER_SIZE + a_len + b_len;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    if (paused) {
+        lost++;
+        CORE_EXIT_CRITICAL();
+        return;
+    }
+
+    // drop the oldest records until this one fits
+    while (JOURNAL_SIZE - used < total) {
+        uint32_t oldest = JOURNAL_HEADER_SIZE + ring[(head + 1) % JOURNAL_SIZE];
+        head = (head + oldest) % JOURNAL_SIZE;
+        used -= oldest;
+        lost++;
+    }
+
+    ring_write(header, JOURNAL_HEADER_SIZE);
+    ring_write(a, a_len);
+    ring_write(b, b_len);
+
+    CORE_EXIT_CRITICAL();
+}
+
+/*
+ * records a bluetooth event as delivered to sl_bt_on_event(), use JOURNAL_BT()
+ *
+ * header = sl_bt_msg_t header, holds the event id and data length
+ * data = event data
+ */
+void journal_bt_event(uint32_t header, const void* data) {
+    uint8_t h[4] = { header & 0xFF, (header >> 8) & 0xFF, (header >> 16) & 0xFF, header >> 24 };
+    append(JOURNAL_BT_EVENT, h, sizeof(h), data, SL_BT_MSG_LEN(header));
+}
+
+/*
+ * records an application event as it is handled, use JOURNAL_APP_EVENT()
+ *
+ * target = JOURNAL_TARGET_MAIN or the level of the active object
+ * event = event value
+ * payload = event specific value
+ */
+void journal_app_event(uint8_t target, uint8_t event, uint32_t payload) {
+    uint8_t p[6] = { target, event, payload & 0xFF, (payload >> 8) & 0xFF, (payload >> 16) & 0xFF, payload >> 24 };
+    append(JOURNAL_APP_EVENT, p, sizeof(p), 0, 0);
+}
+
+/*
+ * records the bytes of a finished I2C read, use JOURNAL_I2C_READ()
+ *
+ * dev = i2c_dev_t that was read
+ * data = bytes read
+ * len = num bytes
+ */
+void journal_i2c_read(uint8_t dev, const uint8_t* data, uint16_t len) {
+    append(JOURNAL_I2C_READ, &dev, 1, data, len);
+}
+
+// private helper, stops appends and returns how many bytes the ring holds
+static uint32_t pause() {
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    paused = true;
+    uint32_t len = used;
+    CORE_EXIT_CRITICAL();
+
+    return len;
+}
+
+static void resume() {
+    paused = false;
+}
+
+/*
+ * copies the journal out, oldest record first
+ *
+ * buffer = where to copy
+ * size = space in buffer, JOURNAL_SIZE always fits
+ *
+ * returns: bytes copied, only whole records
+ */
+size_t journal_copy(uint8_t* buffer, size_t size) {
+
+    uint32_t len = pause();
+    uint32_t copied = 0;
+
+    while (copied < len) {
+        uint32_t record = JOURNAL_HEADER_SIZE + ring[(head + copied + 1) % JOURNAL_SIZE];
+        if (copied + record > size) {
+            break;
+        }
+
+        ring_read(copied, &buffer[copied], record);
+        copied += record;
+    }
+
+    resume();
+
+    return copied;
+}
+
+// log the journal as hex, oldest record first, for capture from VCOM
+void journal_dump() {
+
+    uint32_t len = pause();
+
+    LOG_INFO("Journal: %u bytes, %u records lost", (unsigned int) len, (unsigned int) lost);
+
+    for (uint32_t offset=0; offset<len; offset+=DUMP_LINE_BYTES) {
+        uint8_t bytes[DUMP_LINE_BYTES];
+        char hex[(2 * DUMP_LINE_BYTES) + 1];
+        uint32_t n = (len - offset < DUMP_LINE_BYTES) ? (len - offset) : DUMP_LINE_BYTES;
+
+        ring_read(offset, bytes, n);
+        for (uint32_t i=0; i<n; i++) {
+            snprintf(&hex[2 * i], 3, "%02x", bytes[i]);
+        }
+
+        LOG_INFO("J %04x %s", (unsigned int) offset, hex);
+    }
+
+    resume();
+}
+
+#ifdef JOURNAL_FLASH
+// flash pages below the NVM3 and bootloader storage area
+#define JOURNAL_FLASH_MAGIC 0x4C4E524A // "JRNL"
+#define JOURNAL_FLASH_HEADER 16
+#define JOURNAL_FLASH_SIZE (((JOURNAL_FLASH_HEADER + JOURNAL_SIZE + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE) * FLASH_PAGE_SIZE)
+
+// linker symbols, see autogen/linkerfile.ld
+extern char linker_storage_begin;
+extern char __etext;
+extern char __data_start__;
+extern char __data_end__;
+
+/*
+ * copies the journal to flash, main loop only, the radio waits while pages are erased
+ * layout: u32 magic, u32 bytes, u32 records lost, u32 0, then the records oldest first
+ *
+ * returns: true if the pages overlap the image or a flash operation failed
+ */
+bool journal_flush() {
+
+    uint32_t* base = (uint32_t*) (((uintptr_t) &linker_storage_begin - JOURNAL_FLASH_SIZE) & ~(FLASH_PAGE_SIZE - 1));
+    uintptr_t image_end = (uintptr_t) &__etext + (&__data_end__ - &__data_start__);
+
+    if ((uintptr_t) base < image_end) {
+        LOG_ERROR("No free flash for the journal");
+        return true;
+    }
+
+    uint32_t len = pause();
+    bool failed = false;
+
+    MSC_Init();
+
+    for (uint32_t page=0; page<JOURNAL_FLASH_SIZE; page+=FLASH_PAGE_SIZE) {
+        failed |= (MSC_ErasePage((uint32_t*) ((uintptr_t) base + page)) != mscReturnOk);
+    }
+
+    uint32_t header[JOURNAL_FLASH_HEADER / 4] = { JOURNAL_FLASH_MAGIC, len, lost, 0 };
+    failed |= (MSC_WriteWord(base, header, sizeof(header)) != mscReturnOk);
+
+    // whole words through a small buffer, the tail is padded with the erased value
+    uint32_t words[DUMP_LINE_BYTES / 4];
+
+    for (uint32_t offset=0; offset<len; offset+=sizeof(words)) {
+        uint32_t n = (len - offset < sizeof(words)) ? (len - offset) : sizeof(words);
+
+        memset(words, 0xFF, sizeof(words));
+        ring_read(offset, (uint8_t*) words, n);
+
+        failed |= (MSC_WriteWord((uint32_t*) ((uintptr_t) base + JOURNAL_FLASH_HEADER + offset), words, sizeof(words)) != mscReturnOk);
+    }
+
+    MSC_Deinit();
+
+    resume();
+
+    if (failed) {
+        LOG_ERROR("Journal flash write failed");
+    }
+
+    return failed;
+}
+#else
+bool journal_flush() {
+    return true;
+}
+#endif
+
+#else
+
+size_t journal_copy(uint8_t* buffer, size_t size) {
+    (void) buffer;
+    (void) size;
+    return 0;
+}
+
+void journal_dump() {
+}
+
+bool journal_flush() {
+    return true;
+}
+
+#endif
+
+/*
+ * starts reading a journal, safe to use off target
+ *
+ * r = reader to set up
+ * data = records, oldest first
+ * size = num bytes
+ */
+void journal_reader_init(journal_reader_t* r, const uint8_t* data, size_t size) {
+    r->data = data;
+    r->size = size;
+    r->pos = 0;
+}
+
+/*
+ * decodes the next record
+ *
+ * r = reader
+ * record = where to save the record
+ *
+ * returns: true if a record was read, false at the end or on a record cut short
+ */
+bool journal_next(journal_reader_t* r, journal_record_t* record) {
+
+    if (r->pos + JOURNAL_HEADER_SIZE > r->size) {
+        return false;
+    }
+
+    const uint8_t* p = &r->data[r->pos];
+
+    if (r->pos + JOURNAL_HEADER_SIZE + p[1] > r->size) {
+        return false;
+    }
+
+    record->type = p[0];
+    record->len = p[1];
+    record->timestamp = p[2] | (p[3] << 8) | (p[4] << 16) | ((uint32_t) p[5] << 24);
+    record->payload = &p[JOURNAL_HEADER_SIZE];
+
+    r->pos += JOURNAL_HEADER_SIZE + record->len;
+
+    return true;
+}
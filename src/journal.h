@@ -0,0 +1,80 @@
+/*
+ * journal.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_JOURNAL_H_
+#define SRC_JOURNAL_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stddef.h"
+
+// record every input to the firmware in a RAM ring for replay
+// comment out to compile every JOURNAL_ macro away
+#define JOURNAL 1
+
+// let journal_flush() copy the ring to the flash pages below the storage area
+//#define JOURNAL_FLASH 1
+
+// ring size in bytes, the oldest records are dropped to make room
+// a replay needs the journal from boot on, a build can ask for more
+#ifndef JOURNAL_SIZE
+#define JOURNAL_SIZE 4096
+#endif
+
+/*
+ * Record layout, little endian:
+ *     u8 type, u8 payload length, u32 us since startup (low 32 bits), payload
+ */
+#define JOURNAL_HEADER_SIZE 6
+#define JOURNAL_MAX_PAYLOAD 255
+
+typedef enum {
+    JOURNAL_BT_EVENT = 1, // u32 sl_bt_msg_t header, then the event data, cut at JOURNAL_MAX_PAYLOAD
+    JOURNAL_APP_EVENT, // u8 target, u8 event, u32 event payload
+    JOURNAL_I2C_READ // u8 i2c_dev_t, then the bytes read
+} journal_type_t;
+
+// target of an application event, otherwise the level of the active object that ran it
+#define JOURNAL_TARGET_MAIN 0xFF
+
+// one decoded record, payload points into the journal being read
+typedef struct {
+    journal_type_t type;
+    uint32_t timestamp;
+    uint8_t len;
+    const uint8_t* payload;
+} journal_record_t;
+
+// walks a journal copied out with journal_copy() or read back from flash
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+} journal_reader_t;
+
+#ifdef JOURNAL
+#define JOURNAL_BT(evt) journal_bt_event((evt)->header, &(evt)->data)
+#define JOURNAL_APP_EVENT(target, event, payload) journal_app_event((target), (event), (payload))
+#define JOURNAL_I2C_READ(dev, data, len) journal_i2c_read((dev), (data), (len))
+#else
+#define JOURNAL_BT(evt)
+#define JOURNAL_APP_EVENT(target, event, payload)
+#define JOURNAL_I2C_READ(dev, data, len)
+#endif
+
+void journal_bt_event(uint32_t header, const void* data);
+void journal_app_event(uint8_t target, uint8_t event, uint32_t payload);
+void journal_i2c_read(uint8_t dev, const uint8_t* data, uint16_t len);
+
+size_t journal_copy(uint8_t* buffer, size_t size);
+void journal_dump();
+bool journal_flush();
+
+void journal_reader_init(journal_reader_t* r, const uint8_t* data, size_t size);
+bool journal_next(journal_reader_t* r, journal_record_t* record);
+
+#endif /* SRC_JOURNAL_H_ */
@@ -60,6 +60,9 @@
 
 
 #include "lcd.h"
+#include "active_object.h"
+
+#include "em_core.h"
 
 
 // Include logging specifically for this .c file
@@ -95,6 +98,18 @@ struct display_data {
 static struct display_data     global_display_data;
 
 
+// Rows formatted by displayPrintf() and not drawn yet. Drawing is done by
+// the display active object at the lowest level, so a slow redraw doesn't
+// hold up the caller and anything more urgent can preempt it.
+static char                    pending_rows[DISPLAY_NUMBER_OF_ROWS][DISPLAY_ROW_LEN+1];
+static volatile uint32_t       dirty_rows = 0;   // bit per row
+static bool                    display_started = false;
+
+static void displayRedraw(active_object_t *ao, const app_event_t *e);
+
+static active_object_t         display_ao = { .name = "display", .priority = AO_PRIORITY_LOW, .handler = displayRedraw, .profile = PROFILE_AO_DISPLAY };
+
+
 // private function to return pointer to the display data
 static struct display_data         *displayGetData() {
 	return &global_display_data;
@@ -115,9 +130,9 @@ static struct display_data         *displayGetData() {
  *    Example:
  *       displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp=%d", temp);
  *
- *    The implementation always erases a row first before drawing the
- *    string passed in. This is done so that all pixels from the previously
- *    displayed text will be erased.
+ *    The row is only formatted here, the display active object erases and
+ *    redraws it later so this is safe and quick from any context. Several
+ *    calls before the redraw runs are drawn together.
  *    To erase a row, pass in a format string of either "" or " ".
  *
  *    Row indexes >= DISPLAY_NUMBER_OF_ROWS will throw a LOG_ERROR() msg and
@@ -133,11 +148,8 @@ void displayPrintf(enum display_row row, const char *format, ...)
                           // of handling variable number of arguments passed to
                           // a function.
 
-   EMSTATUS               status;
-   struct display_data    *display = displayGetData();
    size_t                 strLen;
    char                   strToDisplay[DISPLAY_ROW_LEN+1]; // +1 for null terminator
-   char                   strToErase[DISPLAY_ROW_LEN+1];   // +1 for null terminator
 
    // Range check the row number
    if (row >= DISPLAY_NUMBER_OF_ROWS) {
@@ -182,6 +194,54 @@ void displayPrintf(enum display_row row, const char *format, ...)
    } // else
 
 
+   // Hand the row to the display active object, only the first dirty row posts
+   CORE_DECLARE_IRQ_STATE;
+   CORE_ENTER_CRITICAL();
+   bool post = (dirty_rows == 0) && display_started;
+   strcpy(pending_rows[row], strToDisplay);
+   dirty_rows |= (1 << row);
+   CORE_EXIT_CRITICAL();
+
+   if (post) {
+       ao_post(&display_ao, 0, 0);
+   }
+
+} // displayPrintf()
+
+
+
+
+/**
+ * Display active object handler, draws every row written since the last
+ * redraw and sends the frame to the LCD once.
+ */
+static void displayRedraw(active_object_t *ao, const app_event_t *e)
+{
+   (void) ao;
+   (void) e;
+
+   EMSTATUS               status;
+   struct display_data    *display = displayGetData();
+   uint32_t               rows;
+   char                   strToDisplay[DISPLAY_NUMBER_OF_ROWS][DISPLAY_ROW_LEN+1];
+   char                   strToErase[DISPLAY_ROW_LEN+1];   // +1 for null terminator
+
+   // Take the dirty rows, a row written after this posts another redraw
+   CORE_DECLARE_IRQ_STATE;
+   CORE_ENTER_CRITICAL();
+   rows = dirty_rows;
+   dirty_rows = 0;
+   for (int row=0; row<DISPLAY_NUMBER_OF_ROWS; row++) {
+       if (rows & (1 << row)) {
+           strcpy(strToDisplay[row], pending_rows[row]);
+       }
+   }
+   CORE_EXIT_CRITICAL();
+
+   if (rows == 0) {
+       return;
+   }
+
    // We always erase the whole line first, then draw the new string. This way
    // we don't leave any pixels set from the previous characters.
    for (int i=0; i<DISPLAY_ROW_LEN; i++) {
@@ -189,29 +249,35 @@ void displayPrintf(enum display_row row, const char *format, ...)
    }
    strToErase[DISPLAY_ROW_LEN] = 0; // null
 
-   // Erase the row
-   status = GLIB_drawStringOnLine(&display->glibContext,
-                                   &strToErase[0],
-                                   row,
-                                   GLIB_ALIGN_CENTER,
-                                   0,        // x offset
-                                   0,        // y offset
-                                   true);    // opaque
-   if (status != GLIB_OK) {
-       LOG_ERROR("Erase GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
-   }
-
-
-   // Draw the new string on the memory lcd display
-   status = GLIB_drawStringOnLine(&display->glibContext,
-                                  &strToDisplay[0],
-                                  row,
-                                  GLIB_ALIGN_CENTER,
-                                  0,        // x offset
-                                  0,        // y offset
-                                  true);    // opaque
-   if (status != GLIB_OK) {
-       LOG_ERROR("Draw GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
+   for (int row=0; row<DISPLAY_NUMBER_OF_ROWS; row++) {
+       if (!(rows & (1 << row))) {
+           continue;
+       }
+
+       // Erase the row
+       status = GLIB_drawStringOnLine(&display->glibContext,
+                                       &strToErase[0],
+                                       row,
+                                       GLIB_ALIGN_CENTER,
+                                       0,        // x offset
+                                       0,        // y offset
+                                       true);    // opaque
+       if (status != GLIB_OK) {
+           LOG_ERROR("Erase GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
+       }
+
+
+       // Draw the new string on the memory lcd display
+       status = GLIB_drawStringOnLine(&display->glibContext,
+                                      &strToDisplay[row][0],
+                                      row,
+                                      GLIB_ALIGN_CENTER,
+                                      0,        // x offset
+                                      0,        // y offset
+                                      true);    // opaque
+       if (status != GLIB_OK) {
+           LOG_ERROR("Draw GLIB_drawStringOnLine() returned non-zero error code=0x%04x", (unsigned int) status);
+       }
    }
 
 
@@ -221,7 +287,7 @@ void displayPrintf(enum display_row row, const char *format, ...)
        LOG_ERROR("DMD_updateDisplay() returned non-zero error code=0x%04x", (unsigned int) status);
    }
 
-} // displayPrintf()
+} // displayRedraw()
 
 
 
@@ -321,6 +387,21 @@ void displayInit()
         LOG_ERROR("sl_bt_system_set_soft_timer");
     }
 
+
+    // From here on the display active object owns GLIB and DMD, draw any
+    // rows that were written before the display was up
+    ao_start(&display_ao);
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    display_started = true;
+    bool post = (dirty_rows != 0);
+    CORE_EXIT_CRITICAL();
+
+    if (post) {
+        ao_post(&display_ao, 0, 0);
+    }
+
 } // displayInit()
 
 
@@ -7,10 +7,9 @@
 
 #include "stdbool.h"
 #include "ble.h"
-#include "irq.h"
-#include "limits.h"
 #include "led.h"
 #include "gpio.h"
+#include "sw_timer.h"
 
 #define ON 1
 #define OFF 0
@@ -18,8 +17,9 @@
 // LED is currently on or off
 bool ledStatus = OFF;
 
-// set to an actual value in scheduler.c
-uint64_t next_pulse_time = ULLONG_MAX;
+// toggles the LED, restarted with the latest heart rate each time
+static void pulse_LED(void* context);
+static sw_timer_t pulse_timer = { .callback = pulse_LED };
 
 /*
  * calculate the period based on heart rate
@@ -33,22 +33,44 @@ uint16_t get_LED_period(uint16_t bpm) {
 }
 
 /*
- * toggle LED on/off based on next_pulse_time and number of milliseconds since startup
+ * toggle LED on/off and schedule the next toggle from the latest heart rate
+ * runs from the main loop when pulse_timer expires
  */
-void pulse_LED() {
+static void pulse_LED(void* context) {
+    (void) context;
 
-    if (letimerMilliseconds() > next_pulse_time) {
+    uint16_t bpm = get_ble_data_ptr()->heart_rate;
 
-        next_pulse_time = letimerMilliseconds() + get_LED_period(get_ble_data_ptr()->heart_rate);
+    // no heart rate to show, leave the LED off until the next reading
+    if (bpm == 0) {
+        ledStatus = OFF;
+        gpioLed0SetOff();
+        return;
+    }
+
+    if (ledStatus == ON) {
+        ledStatus = OFF;
+        gpioLed0SetOff();
+    }
+    else {
+        ledStatus = ON;
+        gpioLed0SetOn();
+    }
+
+    sw_timer_start(&pulse_timer, get_LED_period(bpm) * USEC_PER_MSEC, 0);
+}
+
+/*
+ * start pulsing the LED at the heart rate, does nothing if it is already pulsing
+ * later toggles follow the published heart rate
+ *
+ * bpm = heart rate of the reading being published
+ */
+void start_LED_pulse(uint16_t bpm) {
 
-        if (ledStatus == ON) {
-            ledStatus = OFF;
-            gpioLed0SetOff();
-        }
-        else {
-            ledStatus = ON;
-            gpioLed0SetOn();
-        }
+    if ((bpm == 0) || sw_timer_running(&pulse_timer)) {
+        return;
     }
 
+    sw_timer_start(&pulse_timer, get_LED_period(bpm) * USEC_PER_MSEC, 0);
 }
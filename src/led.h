@@ -12,10 +12,9 @@
 
 #define SEC_PER_MIN 60
 #define MSEC_PER_SEC 1000
-
-extern uint64_t next_pulse_time;
+#define USEC_PER_MSEC 1000
 
 uint16_t get_LED_period(uint16_t bpm);
-void pulse_LED();
+void start_LED_pulse(uint16_t bpm);
 
 #endif /* SRC_LED_H_ */
@@ -15,12 +15,31 @@
 
 
 #include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
 
 // Include logging for this file
 #define INCLUDE_LOG_DEBUG 1
 #include "log.h"
 
 #include "irq.h"
+#include "scheduler.h"
+
+#include "em_core.h"
+
+// longest line printed, longer lines are cut
+#define LOG_LINE_LEN 160
+
+// lines logged from interrupt context wait here for the main loop,
+// the UART driver and newlib's stdio aren't reentrant and the UART blocks
+#define LOG_DEFERRED_LINES 8
+#define LOG_DEFERRED_LINE_LEN 128
+
+static char deferred_lines[LOG_DEFERRED_LINES][LOG_DEFERRED_LINE_LEN];
+static uint32_t deferred_wptr = 0; // lines written, wraps
+static uint32_t deferred_rptr = 0; // lines printed, wraps
+static uint32_t deferred_lost = 0; // lines dropped while the ring was full
+static bool flush_pending = false; // a flush is queued for the main loop
 
 
 
@@ -55,6 +74,93 @@ uint32_t loggerGetTimestamp()
 
 
 
+// private helper, prints the deferred lines oldest first, main loop only
+static void flush_deferred_lines(uint32_t arg) {
+    (void) arg;
+
+    CORE_DECLARE_IRQ_STATE;
+
+    flush_pending = false;
+
+    while (deferred_rptr != deferred_wptr) {
+        app_log("%s", deferred_lines[deferred_rptr % LOG_DEFERRED_LINES]);
+
+        CORE_ENTER_CRITICAL();
+        deferred_rptr++;
+        CORE_EXIT_CRITICAL();
+    }
+
+    if (deferred_lost > 0) {
+        CORE_ENTER_CRITICAL();
+        uint32_t lost = deferred_lost;
+        deferred_lost = 0;
+        CORE_EXIT_CRITICAL();
+
+        app_log("%5"PRIu32":Warn :%s: %u log lines lost in interrupt context\n", loggerGetTimestamp(), __func__, (unsigned int) lost);
+    }
+}
+
+/**
+ * Print a log line, used by the LOG_*() macros.
+ * From the main loop the line is printed right away, after any lines still
+ * waiting from interrupt context. From an interrupt or an active object it
+ * is only formatted into a small ring and printed later by the main loop.
+ */
+void logPrint(const char* format, ...)
+{
+    va_list args;
+
+    // thread mode, the main loop
+    if (__get_IPSR() == 0) {
+        char line[LOG_LINE_LEN];
+
+        va_start(args, format);
+        if (vsnprintf(line, sizeof(line), format, args) >= (int) sizeof(line)) {
+            line[sizeof(line) - 2] = '\n'; // keep the line break of a cut line
+        }
+        va_end(args);
+
+        flush_deferred_lines(0);
+        app_log("%s", line);
+        return;
+    }
+
+    char line[LOG_DEFERRED_LINE_LEN];
+
+    va_start(args, format);
+    if (vsnprintf(line, sizeof(line), format, args) >= (int) sizeof(line)) {
+        line[sizeof(line) - 2] = '\n';
+    }
+    va_end(args);
+
+    bool post = false;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    if (deferred_wptr - deferred_rptr == LOG_DEFERRED_LINES) {
+        deferred_lost++;
+    }
+    else {
+        memcpy(deferred_lines[deferred_wptr % LOG_DEFERRED_LINES], line, sizeof(line));
+        deferred_wptr++;
+    }
+
+    if (!flush_pending) {
+        flush_pending = true;
+        post = true;
+    }
+
+    CORE_EXIT_CRITICAL();
+
+    if (post) {
+        scheduler_defer(EVENT_PRIORITY_LOW, flush_deferred_lines, 0);
+    }
+
+} // logPrint()
+
+
+
 /**
  * Print a string for the Silicon Labs API error codes defined in sl_status.h
  * Depends on Components:
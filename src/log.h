@@ -42,8 +42,9 @@
 #if INCLUDE_LOG_DEBUG
 
 #define LOG_DO(message,level, ...) \
-  app_log( "%5"PRIu32":%s:%s: " message "\n", loggerGetTimestamp(), level, __func__, ##__VA_ARGS__ )
+  logPrint( "%5"PRIu32":%s:%s: " message "\n", loggerGetTimestamp(), level, __func__, ##__VA_ARGS__ )
 uint32_t loggerGetTimestamp (void);
+void     logPrint (const char* format, ...);
 void     printSLErrorString (sl_status_t status);
 
 #else
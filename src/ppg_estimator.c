@@ -0,0 +1,297 @@
+/*
+ * ppg_estimator.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Heart rate and SpO2 estimation from raw red / IR counts.
+ * Everything is integer math and each sample is processed in O(1) time
+ * with a fixed amount of state, so it can run inside the fifo drain.
+ *
+ * 1. DC of each channel is tracked with a slow one-pole low-pass filter
+ * 2. AC = sample - DC, then smoothed with a fast one-pole low-pass filter
+ *    (together these form the bandpass)
+ * 3. Beats are local maxima of the inverted IR AC signal that rise above the
+ *    trough before them by more than an adaptive threshold, which is reset to
+ *    half of each beat's height and decays between beats
+ * 4. SpO2 uses the ratio of ratios R = (AC red / DC red) / (AC IR / DC IR)
+ *    measured over each beat, SpO2 = 110 - 25 * R
+ */
+
+#include "ppg_estimator.h"
+
+// DC tracker time constant = 2^8 samples = 2.56 s at 100 Hz
+#define DC_SHIFT 8
+
+// low-pass time constant = 2^2 samples, cuts off above ~4 Hz
+#define LP_SHIFT 2
+
+// threshold decays by 1/2^7 per sample between beats
+#define THRESHOLD_DECAY_SHIFT 7
+
+// fixed point fraction bits for the ratio of ratios
+#define R_FRACTION_BITS 10
+
+// beats outside 30 - 200 bpm are ignored
+#define MIN_BEAT_SAMPLES (PPG_SAMPLE_RATE_HZ * 60 / 200)
+#define MAX_BEAT_SAMPLES (PPG_SAMPLE_RATE_HZ * 60 / 30)
+
+// number of beat intervals averaged for the heart rate
+#define NUM_INTERVALS 4
+
+// IR DC level below this means nothing is on the sensor
+#define FINGER_DC_THRESHOLD 30000
+
+// regular beats needed for 100% confidence
+#define MAX_REGULAR_BEATS 5
+
+// estimator state, single sensor so a single private instance
+static struct {
+    int32_t dc_red_q8; // DC << 8
+    int32_t dc_ir_q8;
+    int32_t lp_red; // filtered AC
+    int32_t lp_ir;
+
+    int32_t prev_ir; // for local maximum detection
+    bool rising;
+    int32_t threshold;
+
+    uint32_t samples_since_beat;
+
+    // AC extremes over the current beat
+    int32_t red_max;
+    int32_t red_min;
+    int32_t ir_max;
+    int32_t ir_min;
+
+    // recent beat intervals in samples
+    uint16_t intervals[NUM_INTERVALS];
+    uint8_t interval_idx;
+    uint8_t num_intervals;
+    uint32_t interval_sum;
+    uint8_t regular_beats;
+
+    bool primed; // DC trackers have been seeded
+    heart_sensor_data estimate;
+} est;
+
+// beat to beat intervals in 1/1024 s for the Heart Rate Measurement
+// written here and read from the main loop, each side only moves its own index
+static uint16_t rr_ring[RR_RING_DEPTH];
+static volatile uint8_t rr_wptr = 0;
+static volatile uint8_t rr_rptr = 0;
+
+// private helper, save an interval, the newest is dropped if the reader fell behind
+static void write_rr(uint32_t interval) {
+
+    uint8_t next = (rr_wptr + 1) % RR_RING_DEPTH;
+
+    if (next == rr_rptr) {
+        return;
+    }
+
+    rr_ring[rr_wptr] = (interval * 1024) / PPG_SAMPLE_RATE_HZ;
+    rr_wptr = next;
+}
+
+/*
+ * remove the oldest beat to beat interval
+ *
+ * rr = where to save the interval, 1/1024 s
+ *
+ * returns: false if successful, true if there were none
+ */
+bool ppg_estimator_read_rr(uint16_t* rr) {
+
+    if (rr_rptr == rr_wptr) {
+        return true;
+    }
+
+    *rr = rr_ring[rr_rptr];
+    rr_rptr = (rr_rptr + 1) % RR_RING_DEPTH;
+
+    return false;
+}
+
+// private helper, restart the beat window
+static void start_beat_window() {
+    est.samples_since_beat = 0;
+    est.red_max = INT32_MIN;
+    est.red_min = INT32_MAX;
+    est.ir_max = INT32_MIN;
+    est.ir_min = INT32_MAX;
+}
+
+// private helper, forget beat history after the signal was lost
+static void clear_beats() {
+    est.num_intervals = 0;
+    est.interval_idx = 0;
+    est.interval_sum = 0;
+    est.regular_beats = 0;
+    est.threshold = 0;
+    est.estimate.heart_rate = 0;
+    est.estimate.confidence = 0;
+    start_beat_window();
+}
+
+// clear all estimator state
+void ppg_estimator_reset() {
+    est.primed = false;
+    est.lp_red = 0;
+    est.lp_ir = 0;
+    est.prev_ir = 0;
+    est.rising = false;
+    est.estimate.blood_oxygen = 0;
+    est.estimate.finger_status = NOTHING_DETECTED;
+    clear_beats();
+}
+
+// private helper, update SpO2 from the extremes of the beat that just ended
+static void update_spo2() {
+
+    int64_t ac_red = est.red_max - est.red_min;
+    int64_t ac_ir = est.ir_max - est.ir_min;
+    int64_t dc_red = est.dc_red_q8 >> 8;
+    int64_t dc_ir = est.dc_ir_q8 >> 8;
+
+    if ((ac_ir <= 0) || (dc_red <= 0)) {
+        return;
+    }
+
+    int32_t r = (int32_t) (((ac_red * dc_ir) << R_FRACTION_BITS) / (ac_ir * dc_red));
+    int32_t spo2 = 110 - ((25 * r) >> R_FRACTION_BITS);
+
+    if (spo2 > 100) {
+        spo2 = 100;
+    }
+    if (spo2 < 0) {
+        spo2 = 0;
+    }
+
+    // smooth beat to beat variation
+    if (est.estimate.blood_oxygen == 0) {
+        est.estimate.blood_oxygen = spo2;
+    }
+    else {
+        est.estimate.blood_oxygen = (est.estimate.blood_oxygen * 3 + spo2) / 4;
+    }
+}
+
+/*
+ * private helper, record a detected beat
+ *
+ * interval = samples since the previous beat
+ */
+static void add_beat(uint32_t interval) {
+
+    // confidence grows with each beat close to the running average
+    // the first interval after the signal was lost doesn't start at a beat, so it is no RR interval
+    if (est.num_intervals > 0) {
+        write_rr(interval);
+
+        uint32_t average = est.interval_sum / est.num_intervals;
+        uint32_t diff = (interval > average) ? (interval - average) : (average - interval);
+
+        if ((diff * 4 <= average) && (est.regular_beats < MAX_REGULAR_BEATS)) {
+            est.regular_beats++;
+        }
+        else if (diff * 4 > average) {
+            est.regular_beats = 0;
+        }
+    }
+
+    // replace the oldest interval in the running sum
+    if (est.num_intervals == NUM_INTERVALS) {
+        est.interval_sum -= est.intervals[est.interval_idx];
+    }
+    else {
+        est.num_intervals++;
+    }
+
+    est.intervals[est.interval_idx] = interval;
+    est.interval_sum += interval;
+    est.interval_idx = (est.interval_idx + 1) % NUM_INTERVALS;
+
+    est.estimate.heart_rate = (PPG_SAMPLE_RATE_HZ * 60 * est.num_intervals) / est.interval_sum;
+    est.estimate.confidence = est.regular_beats * 100 / MAX_REGULAR_BEATS;
+
+    update_spo2();
+}
+
+/*
+ * process one raw sample
+ *
+ * red = LED2 count
+ * ir = LED1 count
+ */
+void ppg_estimator_add_sample(uint32_t red, uint32_t ir) {
+
+    // seed the DC trackers so they don't ramp up from 0
+    if (!est.primed) {
+        est.dc_red_q8 = red << 8;
+        est.dc_ir_q8 = ir << 8;
+        est.primed = true;
+        start_beat_window();
+    }
+
+    est.dc_red_q8 += ((int32_t) (red << 8) - est.dc_red_q8) >> DC_SHIFT;
+    est.dc_ir_q8 += ((int32_t) (ir << 8) - est.dc_ir_q8) >> DC_SHIFT;
+
+    // no finger, nothing to measure
+    if ((est.dc_ir_q8 >> 8) < FINGER_DC_THRESHOLD) {
+        if (est.estimate.finger_status != NOTHING_DETECTED) {
+            est.estimate.finger_status = NOTHING_DETECTED;
+            clear_beats();
+        }
+        return;
+    }
+
+    est.estimate.finger_status = FINGER_DETECTED;
+
+    // blood absorbs light, so the pulse is a dip in the counts, invert it
+    int32_t ac_red = (est.dc_red_q8 - (int32_t) (red << 8)) >> 8;
+    int32_t ac_ir = (est.dc_ir_q8 - (int32_t) (ir << 8)) >> 8;
+
+    est.lp_red += (ac_red - est.lp_red) >> LP_SHIFT;
+    est.lp_ir += (ac_ir - est.lp_ir) >> LP_SHIFT;
+
+    if (est.lp_red > est.red_max) est.red_max = est.lp_red;
+    if (est.lp_red < est.red_min) est.red_min = est.lp_red;
+    if (est.lp_ir > est.ir_max) est.ir_max = est.lp_ir;
+    if (est.lp_ir < est.ir_min) est.ir_min = est.lp_ir;
+
+    est.samples_since_beat++;
+    est.threshold -= est.threshold >> THRESHOLD_DECAY_SHIFT;
+
+    // previous sample was a peak, its height is taken from the trough before it so
+    // baseline wander the DC tracker hasn't caught up with moves both together
+    int32_t height = est.prev_ir - est.ir_min;
+
+    if (est.rising && (est.lp_ir < est.prev_ir) && (height > est.threshold) &&
+        (est.samples_since_beat >= MIN_BEAT_SAMPLES)) {
+
+        if (est.samples_since_beat <= MAX_BEAT_SAMPLES) {
+            add_beat(est.samples_since_beat);
+        }
+
+        est.threshold = height / 2;
+        start_beat_window();
+    }
+
+    // signal lost, start over
+    if (est.samples_since_beat > 2 * MAX_BEAT_SAMPLES) {
+        clear_beats();
+    }
+
+    est.rising = (est.lp_ir > est.prev_ir);
+    est.prev_ir = est.lp_ir;
+}
+
+/*
+ * copy the latest estimate
+ *
+ * estimate = where to save heart rate, SpO2, confidence and finger status
+ */
+void ppg_estimator_get(heart_sensor_data* estimate) {
+    *estimate = est.estimate;
+}
@@ -0,0 +1,25 @@
+/*
+ * ppg_estimator.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_PPG_ESTIMATOR_H_
+#define SRC_PPG_ESTIMATOR_H_
+
+#include "stdint.h"
+#include "heart_sensor.h"
+
+// MAX30101 sample rate used by the sensor hub
+#define PPG_SAMPLE_RATE_HZ 100
+
+// beat to beat intervals kept until the next Heart Rate Measurement
+#define RR_RING_DEPTH 16
+
+void ppg_estimator_reset();
+void ppg_estimator_add_sample(uint32_t red, uint32_t ir);
+void ppg_estimator_get(heart_sensor_data* estimate);
+bool ppg_estimator_read_rr(uint16_t* rr);
+
+#endif /* SRC_PPG_ESTIMATOR_H_ */
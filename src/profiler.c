@@ -0,0 +1,394 @@
+/*
+ * profiler.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Where the awake time goes, enabled with PROFILER.
+ * Every timed handler and event keeps a histogram of its run times in
+ * cycles with two buckets per power of 2, 128 bytes per histogram. The
+ * 99th percentile is interpolated inside its bucket. When a bucket fills every
+ * bucket is halved, which keeps the shape and favours recent runs.
+ * Wakeups and awake time come from the power manager's energy mode
+ * transitions. The cost of recording is itself timed, so the overhead can
+ * be checked against the awake time.
+ */
+
+#include "profiler.h"
+#include "irq.h"
+#include "timers.h"
+
+#include "em_core.h"
+#include "sl_power_manager.h"
+
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#define USEC_PER_SEC 1000000
+
+#ifdef PROFILER
+
+// two buckets per power of 2 of a 32 bit cycle count
+#define PROFILE_BUCKETS 64
+#define PROFILE_BUCKET_LIMIT 0xFFFF
+
+// distinct event ids that get their own histogram
+#define PROFILE_MAX_EVENTS 16
+
+// version of the snapshot layout read over GATT
+#define PROFILE_SNAPSHOT_FORMAT 1
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint16_t buckets[PROFILE_BUCKETS];
+} histogram_t;
+
+static const char* const handler_names[NUM_PROFILE_HANDLERS] = {
+    [PROFILE_PROCESS_ACTION] = "process_action",
+    [PROFILE_BT_ON_EVENT]    = "sl_bt_on_event",
+    [PROFILE_HEART_SM]       = "heart_sm",
+    [PROFILE_APP_PROCESS]    = "app_process",
+    [PROFILE_AO_SENSOR]      = "ao sensor",
+    [PROFILE_AO_DISPLAY]     = "ao display",
+    [PROFILE_AO_BLE]         = "ao ble"
+};
+
+static histogram_t handlers[NUM_PROFILE_HANDLERS];
+
+static uint32_t event_keys[PROFILE_MAX_EVENTS];
+static histogram_t events[PROFILE_MAX_EVENTS];
+static uint8_t num_events = 0;
+static uint32_t events_untracked = 0; // events seen after the table filled
+
+// cycles spent recording, and awake
+static uint64_t overhead_cycles = 0;
+static uint64_t active_cycles = 0;
+static uint32_t wake_cycles = 0;
+
+// app_process_action() bracket, see profile_loop_begin()
+static uint32_t loop_mark = 0;
+static uint32_t app_start = 0;
+
+// wakeups counted over windows of at least a second
+static uint32_t window_wakeups = 0;
+static uint64_t window_start = 0; // LETIMER ticks
+static uint32_t wakeups_per_second = 0; // last full window
+static uint32_t max_wakeups_per_second = 0;
+
+static void em_transition(sl_power_manager_em_t from, sl_power_manager_em_t to);
+
+static sl_power_manager_em_transition_event_handle_t em_handle;
+static sl_power_manager_em_transition_event_info_t em_info = {
+    .event_mask = SL_POWER_MANAGER_EVENT_TRANSITION_ENTERING_EM0 | SL_POWER_MANAGER_EVENT_TRANSITION_LEAVING_EM0,
+    .on_event = em_transition
+};
+
+// private helper, bucket for a run time, the bit under the top one picks the half
+static uint8_t bucket_of(uint32_t cycles) {
+
+    if (cycles < 2) {
+        return cycles;
+    }
+
+    uint32_t msb = 31 - __CLZ(cycles);
+    return (msb * 2) + ((cycles >> (msb - 1)) & 1);
+}
+
+// private helper, smallest run time that falls in a bucket
+static uint32_t bucket_floor(uint8_t b) {
+
+    if (b < 2) {
+        return b;
+    }
+
+    uint32_t msb = b / 2;
+    return (1u << msb) + ((b & 1) * (1u << (msb - 1)));
+}
+
+// private helper, number of run times that fall in a bucket
+static uint32_t bucket_width(uint8_t b) {
+    return (b < 2) ? 1 : (1u << ((b / 2) - 1));
+}
+
+// private helper, adds a run time to a histogram, call with interrupts disabled
+static void histogram_add(histogram_t* h, uint32_t cycles) {
+
+    h->count++;
+    h->total_cycles += cycles;
+    if (cycles > h->max_cycles) {
+        h->max_cycles = cycles;
+    }
+
+    uint8_t b = bucket_of(cycles);
+
+    if (h->buckets[b] == PROFILE_BUCKET_LIMIT) {
+        for (int i=0; i<PROFILE_BUCKETS; i++) {
+            h->buckets[i] /= 2;
+        }
+    }
+
+    h->buckets[b]++;
+}
+
+/*
+ * private helper, run time that the given share of runs didn't exceed
+ *
+ * h = histogram to read
+ * per_mille = share of runs, 990 for the 99th percentile
+ *
+ * returns: cycles, interpolated inside the bucket and never above the max
+ */
+static uint32_t histogram_percentile(const histogram_t* h, uint32_t per_mille) {
+
+    uint32_t total = 0;
+    for (int i=0; i<PROFILE_BUCKETS; i++) {
+        total += h->buckets[i];
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    uint32_t target = ((uint64_t) total * per_mille + 999) / 1000;
+    uint32_t seen = 0;
+
+    for (int i=0; i<PROFILE_BUCKETS; i++) {
+
+        if (seen + h->buckets[i] >= target) {
+            uint32_t value = bucket_floor(i) + ((uint64_t) bucket_width(i) * (target - seen) / h->buckets[i]) - 1;
+            return (value < h->max_cycles) ? value : h->max_cycles;
+        }
+
+        seen += h->buckets[i];
+    }
+
+    return h->max_cycles;
+}
+
+// private helper, power manager callback, counts wakeups and awake time
+static void em_transition(sl_power_manager_em_t from, sl_power_manager_em_t to) {
+
+    uint32_t now = DWT->CYCCNT;
+
+    // going to sleep
+    if (from == SL_POWER_MANAGER_EM0) {
+        active_cycles += now - wake_cycles;
+        return;
+    }
+
+    if (to != SL_POWER_MANAGER_EM0) {
+        return;
+    }
+
+    wake_cycles = now;
+    loop_mark = now;
+    window_wakeups++;
+
+    uint64_t ticks = letimerTicks();
+    uint64_t elapsed = ticks - window_start;
+
+    if (elapsed >= clock_freq_hz) {
+        wakeups_per_second = ((uint64_t) window_wakeups * clock_freq_hz) / elapsed;
+        if (wakeups_per_second > max_wakeups_per_second) {
+            max_wakeups_per_second = wakeups_per_second;
+        }
+
+        window_wakeups = 0;
+        window_start = ticks;
+    }
+}
+
+// enables the cycle counter and starts counting wakeups
+void init_profiler() {
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    wake_cycles = DWT->CYCCNT;
+    loop_mark = wake_cycles;
+
+    sl_power_manager_subscribe_em_transition_event(&em_handle, &em_info);
+}
+
+/*
+ * adds one run of a handler, use PROFILE_HANDLER() so it compiles away
+ *
+ * handler = handler that ran
+ * start = cycle counter when it started
+ */
+void profile_record_handler(profile_handler_t handler, uint32_t start) {
+
+    uint32_t end = DWT->CYCCNT;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    histogram_add(&handlers[handler], end - start);
+    overhead_cycles += DWT->CYCCNT - end;
+
+    CORE_EXIT_CRITICAL();
+}
+
+/*
+ * adds one run of an event, use PROFILE_EVENT() so it compiles away
+ * the first PROFILE_MAX_EVENTS distinct keys get a histogram, later ones are only counted
+ *
+ * key = bluetooth message id or PROFILE_SERVER_EVENT()
+ * start = cycle counter when handling started
+ */
+void profile_record_event(uint32_t key, uint32_t start) {
+
+    uint32_t end = DWT->CYCCNT;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    int i = 0;
+    while ((i < num_events) && (event_keys[i] != key)) {
+        i++;
+    }
+
+    if (i == num_events) {
+        if (num_events < PROFILE_MAX_EVENTS) {
+            event_keys[i] = key;
+            num_events++;
+        }
+        else {
+            i = -1;
+            events_untracked++;
+        }
+    }
+
+    if (i >= 0) {
+        histogram_add(&events[i], end - start);
+    }
+
+    overhead_cycles += DWT->CYCCNT - end;
+
+    CORE_EXIT_CRITICAL();
+}
+
+// start of app_process_action(), the rest of the pass since the wakeup was the stack and drivers
+void profile_loop_begin() {
+    app_start = DWT->CYCCNT;
+    profile_record_handler(PROFILE_PROCESS_ACTION, loop_mark);
+}
+
+// end of app_process_action()
+void profile_loop_end() {
+    profile_record_handler(PROFILE_APP_PROCESS, app_start);
+    loop_mark = DWT->CYCCNT;
+}
+
+// private helper, little endian like the rest of GATT
+static uint8_t* put_u16(uint8_t* p, uint16_t value) {
+    *p++ = value & 0xFF;
+    *p++ = value >> 8;
+    return p;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t value) {
+    p = put_u16(p, value & 0xFFFF);
+    return put_u16(p, value >> 16);
+}
+
+// private helper, recording cost in hundredths of a percent of the awake time
+static uint32_t overhead_basis_points() {
+    if (active_cycles == 0) {
+        return 0;
+    }
+
+    return (overhead_cycles * 10000) / active_cycles;
+}
+
+/*
+ * packs the handler statistics for the diagnostic characteristic
+ * format 1: u8 format, u8 handler count, u16 wakeups/s, u16 overhead in 0.01%,
+ *           then per handler u32 runs, u32 99th percentile cycles, u32 max cycles
+ *
+ * buffer = where to write
+ * size = space in buffer
+ *
+ * returns: bytes written, 0 if it doesn't fit
+ */
+size_t profile_snapshot(uint8_t* buffer, size_t size) {
+
+    if (size < PROFILE_SNAPSHOT_SIZE) {
+        return 0;
+    }
+
+    uint8_t* p = buffer;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    *p++ = PROFILE_SNAPSHOT_FORMAT;
+    *p++ = NUM_PROFILE_HANDLERS;
+    p = put_u16(p, wakeups_per_second);
+    p = put_u16(p, overhead_basis_points());
+
+    for (int i=0; i<NUM_PROFILE_HANDLERS; i++) {
+        p = put_u32(p, handlers[i].count);
+        p = put_u32(p, histogram_percentile(&handlers[i], 990));
+        p = put_u32(p, handlers[i].max_cycles);
+    }
+
+    CORE_EXIT_CRITICAL();
+
+    return PROFILE_SNAPSHOT_SIZE;
+}
+
+// private helper, one line per histogram
+static void print_histogram(const char* name, uint32_t key, const histogram_t* h, uint32_t cycles_per_us) {
+
+    uint32_t avg = (h->count > 0) ? (h->total_cycles / h->count) : 0;
+    uint32_t p99 = histogram_percentile(h, 990);
+
+    LOG_INFO("  %-16s %08x %7u runs, avg %7u, p99 %8u (%u us), max %8u (%u us) cycles",
+             name, (unsigned int) key, (unsigned int) h->count, (unsigned int) avg,
+             (unsigned int) p99, (unsigned int) (p99 / cycles_per_us),
+             (unsigned int) h->max_cycles, (unsigned int) (h->max_cycles / cycles_per_us));
+}
+
+// log every histogram, the wakeup rate and the profiler's own cost
+void print_profile() {
+
+    uint32_t cycles_per_us = SystemCoreClockGet() / USEC_PER_SEC;
+
+    LOG_INFO("Profile: %u wakeups/s (max %u), awake %u ms, overhead %u.%02u%%",
+             (unsigned int) wakeups_per_second, (unsigned int) max_wakeups_per_second,
+             (unsigned int) (active_cycles / cycles_per_us / 1000),
+             (unsigned int) (overhead_basis_points() / 100), (unsigned int) (overhead_basis_points() % 100));
+
+    for (int i=0; i<NUM_PROFILE_HANDLERS; i++) {
+        print_histogram(handler_names[i], i, &handlers[i], cycles_per_us);
+    }
+
+    for (int i=0; i<num_events; i++) {
+        const char* name = ((event_keys[i] & 0xFFFF0000) == PROFILE_SERVER_EVENT(0)) ? "server event" : "bt event";
+        print_histogram(name, event_keys[i], &events[i], cycles_per_us);
+    }
+
+    if (events_untracked > 0) {
+        LOG_INFO("  %u runs of other events not tracked", (unsigned int) events_untracked);
+    }
+}
+
+#else
+
+void init_profiler() {
+}
+
+size_t profile_snapshot(uint8_t* buffer, size_t size) {
+    (void) buffer;
+    (void) size;
+    return 0;
+}
+
+void print_profile() {
+    LOG_INFO("Profiler compiled out");
+}
+
+#endif
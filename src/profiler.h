@@ -0,0 +1,64 @@
+/*
+ * profiler.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_PROFILER_H_
+#define SRC_PROFILER_H_
+
+#include "stdint.h"
+#include "stddef.h"
+
+#include "em_device.h"
+
+// time the event loop handlers and events with the cycle counter
+// comment out to compile every PROFILE_ macro away
+#define PROFILER 1
+
+// handlers that are timed, times are inclusive of anything they call or that preempts them
+typedef enum {
+    PROFILE_PROCESS_ACTION, // sl_system_process_action(), including the sl_bt_on_event() calls it makes
+    PROFILE_BT_ON_EVENT, // sl_bt_on_event()
+    PROFILE_HEART_SM, // heart_sensor_state_machine()
+    PROFILE_APP_PROCESS, // app_process_action()
+    PROFILE_AO_SENSOR, // active object handlers
+    PROFILE_AO_DISPLAY,
+    PROFILE_AO_BLE,
+    NUM_PROFILE_HANDLERS
+} profile_handler_t;
+
+// bytes written by profile_snapshot()
+#define PROFILE_SNAPSHOT_SIZE (6 + (12 * NUM_PROFILE_HANDLERS))
+
+// event keys are bluetooth message ids, application events are tagged to keep them apart
+#define PROFILE_SERVER_EVENT(event) (0xFFFF0000 | (event))
+
+#ifdef PROFILER
+#define PROFILE_START(t) uint32_t t = DWT->CYCCNT
+#define PROFILE_HANDLER(handler, t) profile_record_handler((handler), (t))
+#define PROFILE_EVENT(key, t) profile_record_event((key), (t))
+#define PROFILE_LOOP_BEGIN() profile_loop_begin()
+#define PROFILE_LOOP_END() profile_loop_end()
+#else
+#define PROFILE_START(t)
+#define PROFILE_HANDLER(handler, t)
+#define PROFILE_EVENT(key, t)
+#define PROFILE_LOOP_BEGIN()
+#define PROFILE_LOOP_END()
+#endif
+
+void init_profiler();
+void profile_record_handler(profile_handler_t handler, uint32_t start);
+void profile_record_event(uint32_t key, uint32_t start);
+
+// bracket app_process_action(), the time before it since the wakeup or the last pass is
+// counted as sl_system_process_action()
+void profile_loop_begin();
+void profile_loop_end();
+
+size_t profile_snapshot(uint8_t* buffer, size_t size);
+void print_profile();
+
+#endif /* SRC_PROFILER_H_ */
@@ -13,82 +13,199 @@
 #include "ble.h"
 #include "lcd.h"
 #include "heart_sensor.h"
+#include "temp_sensor.h"
 #include "irq.h"
 #include "led.h"
+#include "event_queue.h"
+#include "hsm.h"
+#include "sw_timer.h"
+#include "active_object.h"
+#include "journal.h"
 
 #include "em_letimer.h"
 
 #define INCLUDE_LOG_DEBUG 1
 #include "log.h"
 
-// status variables for the current state of the system
-static heart_states_t cur_state;
+// heart sensor workflow, tables at the end of this file
+static hsm_t heart_sm;
+static const hsm_def_t heart_sm_def;
+
+// boot trace, only the first valid reading is logged
+static bool first_reading_reported;
+
+// the heart sensor workflow runs as an active object above the main loop and the display
+static void sensor_handler(active_object_t* ao, const app_event_t* e);
+static active_object_t sensor_ao = { .name = "sensor", .priority = AO_PRIORITY_HIGH, .handler = sensor_handler, .profile = PROFILE_AO_SENSOR };
+
+// external signal bit used to wake the stack, the events themselves are in event_queue.c
+#define EVENT_QUEUE_SIGNAL 0x01
+
+// queue level for each main loop event, completions first so hardware isn't left waiting
+static const event_priority_t event_priorities[] = {
+    [EVENT_IDLE]          = EVENT_PRIORITY_NORMAL,
+    [EVENT_MEASURE_TEMP]  = EVENT_PRIORITY_NORMAL,
+    [EVENT_TIMER_EXPIRED] = EVENT_PRIORITY_HIGH,
+    [EVENT_I2C_DONE]      = EVENT_PRIORITY_HIGH,
+    [EVENT_PB0]           = EVENT_PRIORITY_NORMAL,
+    [EVENT_PB1]           = EVENT_PRIORITY_NORMAL,
+    [EVENT_CHECK_SENSOR]  = EVENT_PRIORITY_NORMAL,
+    [EVENT_DATA_READY]    = EVENT_PRIORITY_NORMAL,
+    [EVENT_TEMP_DONE]     = EVENT_PRIORITY_HIGH,
+    [EVENT_SW_TIMER]      = EVENT_PRIORITY_NORMAL
+};
+
+// active object for each event, events without one go to the main loop
+static active_object_t* const event_targets[NUM_SERVER_EVENTS] = {
+    [EVENT_TIMER_EXPIRED] = &sensor_ao,
+    [EVENT_I2C_DONE]      = &sensor_ao,
+    [EVENT_CHECK_SENSOR]  = &sensor_ao,
+    [EVENT_DATA_READY]    = &sensor_ao,
+    [EVENT_TEMP_DONE]     = &sensor_ao,
+    [EVENT_BOOT]          = &sensor_ao,
+    [EVENT_STATE_TIMEOUT] = &sensor_ao
+};
+
+// event being handled by the main loop
+static app_event_t cur_event;
 
 // resets the data structures at initialization
 void init_scheduler() {
-    cur_state = STATE_WAITING;
+    first_reading_reported = false;
+    init_event_queue();
+    hsm_init(&heart_sm, &heart_sm_def);
+    ao_start(&sensor_ao);
     //LOG_INFO("Scheduler started");
 }
 
-// signals to bluetooth stack that external event occurred (5 second timer elapsed)
-void scheduler_set_event_UF() {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    //sl_bt_external_signal(EVENT_MEASURE_TEMP);
-    sl_bt_external_signal(EVENT_CHECK_SENSOR);
-    CORE_EXIT_CRITICAL();
+/*
+ * private helper, queue an event for its active object, or for the main loop and wake the bluetooth stack
+ * safe from any interrupt, no critical section needed
+ *
+ * event = event that occurred
+ * payload = event specific value
+ */
+static void post_event(server_events_t event, uint32_t payload) {
+
+    if (event_targets[event] != 0) {
+        ao_post(event_targets[event], event, payload);
+        return;
+    }
+
+    event_queue_post(event_priorities[event], event, payload, letimerMicroseconds(), 0);
+    sl_bt_external_signal(EVENT_QUEUE_SIGNAL);
+}
+
+/*
+ * hand work from an interrupt to the main loop, the interrupt only pays for the post
+ * work items run in priority order together with the events
+ *
+ * priority = queue level, EVENT_PRIORITY_LOW for logging
+ * work = function to run
+ * arg = passed to work
+ */
+void scheduler_defer(event_priority_t priority, deferred_work_t work, uint32_t arg) {
+#ifdef SCHEDULER_DEFER_INLINE
+    (void) priority;
+    work(arg);
+#else
+    event_queue_post(priority, 0, arg, letimerMicroseconds(), work);
+    sl_bt_external_signal(EVENT_QUEUE_SIGNAL);
+#endif
 }
 
-// signals to bluetooth stack that external event occurred (custom timer finished)
-void scheduler_set_event_COMP1() {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    sl_bt_external_signal(EVENT_TIMER_EXPIRED);
-    CORE_EXIT_CRITICAL();
+// signals to bluetooth stack that external event occurred (sensor hub reset wait finished)
+void scheduler_set_event_timer() {
+    post_event(EVENT_TIMER_EXPIRED, 0);
+}
+
+// signals to bluetooth stack that external event occurred (software timer callbacks to run)
+void scheduler_set_event_sw_timer() {
+    post_event(EVENT_SW_TIMER, 0);
 }
 
 // signals to bluetooth stack that external event occurred (i2c operation finished)
 void scheduler_set_event_I2C() {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    sl_bt_external_signal(EVENT_I2C_DONE);
-    CORE_EXIT_CRITICAL();
+    post_event(EVENT_I2C_DONE, 0);
+}
+
+// signals to bluetooth stack that external event occurred (sensor hub fifo reached its threshold)
+void scheduler_set_event_data_ready() {
+    post_event(EVENT_DATA_READY, 0);
+}
+
+// signals to bluetooth stack that external event occurred (temperature measurement finished)
+void scheduler_set_event_temp() {
+    post_event(EVENT_TEMP_DONE, 0);
 }
 
-// signals to bluetooth stack that external event occurred (button 0 pressed)
+// signals to bluetooth stack that external event occurred (button 0 pressed), payload = pressed
 void scheduler_set_event_PB0_pressed() {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    get_ble_data_ptr()->pb0Pressed = true;
-    sl_bt_external_signal(EVENT_PB0);
-    CORE_EXIT_CRITICAL();
+    post_event(EVENT_PB0, true);
 }
 
-// signals to bluetooth stack that external event occurred (button 0 released)
+// signals to bluetooth stack that external event occurred (button 0 released), payload = pressed
 void scheduler_set_event_PB0_released() {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    get_ble_data_ptr()->pb0Pressed = false;
-    sl_bt_external_signal(EVENT_PB0); // trigger on rising and falling edge
-    CORE_EXIT_CRITICAL();
+    post_event(EVENT_PB0, false); // trigger on rising and falling edge
+}
+
+// main loop side of the button 1 interrupts, ble_data is only written from the main loop
+static void pb1_changed(uint32_t pressed) {
+    get_ble_data_ptr()->pb1Pressed = pressed;
 }
 
 // signals to bluetooth stack that external event occurred (button 1 pressed)
 void scheduler_set_event_PB1_pressed() {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    get_ble_data_ptr()->pb1Pressed = true;
-    sl_bt_external_signal(EVENT_PB1); // trigger on rising and falling edge
-    CORE_EXIT_CRITICAL();
+    scheduler_defer(EVENT_PRIORITY_NORMAL, pb1_changed, true);
+    post_event(EVENT_PB1, true);
 }
 
 // signals to bluetooth stack that external event occurred (button 1 released)
 void scheduler_set_event_PB1_released() {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    get_ble_data_ptr()->pb1Pressed = false;
-    //sl_bt_external_signal(EVENT_PB1); // don't trigger on falling edge
-    CORE_EXIT_CRITICAL();
+    scheduler_defer(EVENT_PRIORITY_NORMAL, pb1_changed, false);
+    //post_event(EVENT_PB1, false); // don't trigger on falling edge
+}
+
+/*
+ * take the next queued event and present it as an external signal event,
+ * so each event reaches the handlers on its own instead of OR'ed into one mask
+ * deferred work items queued ahead of it are run here
+ * called in a loop by sl_bt_on_event() until it returns false
+ *
+ * evt = where to build the event
+ *
+ * returns: true if an event was taken, false if the queue is empty
+ */
+bool scheduler_next_event(sl_bt_msg_t* evt) {
+
+    while (true) {
+        if (event_queue_read(&cur_event)) {
+            return false;
+        }
+
+        if (cur_event.work == 0) {
+            break;
+        }
+
+        cur_event.work(cur_event.payload);
+    }
+
+    JOURNAL_APP_EVENT(JOURNAL_TARGET_MAIN, cur_event.event, cur_event.payload);
+
+    evt->header = sl_bt_evt_system_external_signal_id;
+    evt->data.evt_system_external_signal.extsignals = cur_event.event;
+
+    return true;
+}
+
+// returns the payload of the event being handled
+uint32_t scheduler_event_payload() {
+    return cur_event.payload;
+}
+
+// returns when the event being handled was posted, us since startup
+uint64_t scheduler_event_timestamp() {
+    return cur_event.timestamp;
 }
 
 /*
@@ -110,135 +227,329 @@ uint8_t external_signal_event_match(sl_bt_msg_t* evt, uint8_t event_id) {
 
 }
 
-/*
- *
- * state machine for getting heart data
- *
- * evt = bluetooth event
- */
-void heart_sensor_state_machine(sl_bt_msg_t* evt) {
+// ---------------------------------------------------------------------
+// Heart sensor workflow
+//
+// ROOT
+//  |- INITIALIZING       sensor hub bring-up after the boot event
+//  '- MEASURING          starts hub reads on DATA_READY, turns finished reads into READING_DONE
+//      |- WAITING        no finger
+//      |- ACQUIRING_DATA finger present, waiting for confidence
+//      '- RETURNING_DATA publishing readings
+//
+// The measurement policy lives in the guards and the transition table,
+// the control flow is in hsm.c.
+// ---------------------------------------------------------------------
+
+// time in acquiring data before asking the user to hold still
+#define ACQUIRE_TIMEOUT_MS 20000
+
+// each start of the state timer, a timeout queued before a restart or stop is ignored
+static uint32_t state_timer_generation = 0;
+
+// state timeouts are queued for the sensor object like any other event
+static void state_timer_expired(void* context) {
+    (void) context;
+    post_event(EVENT_STATE_TIMEOUT, state_timer_generation);
+}
 
-    // initially assume system will remain in current state
-    uint8_t next_state = cur_state;
+static sw_timer_t state_timer = { .callback = state_timer_expired, .flags = SW_TIMER_FROM_ISR };
 
-    switch (cur_state) {
+#ifdef LOW_POWER_MODE
+// time between checks for a finger while the hub is powered down, MFIO wakes us otherwise
+#define SENSOR_CHECK_PERIOD_MS 5000
 
-        case STATE_WAITING:
-            //LOG_INFO("State Waiting for Readings");
+static void sensor_check_due(void* context) {
+    (void) context;
+    post_event(EVENT_CHECK_SENSOR, 0);
+}
 
-            if (external_signal_event_match(evt, EVENT_CHECK_SENSOR)) {
+static sw_timer_t sensor_check_timer = { .callback = sensor_check_due, .flags = SW_TIMER_FROM_ISR };
 
-                #ifdef LOW_POWER_MODE
-                turn_on_heart_sensor();
+// needs to be on for 0.5 seconds before object detected in low power mode
+#define SENSOR_WARMUP_US 500000
 
-                // needs to be on for 0.5 seconds before object detected in low power mode
-                timer_wait_us_polled(500000);
-                #endif
+static void sensor_warmed_up(void* context) {
+    (void) context;
+    post_event(EVENT_DATA_READY, 0);
+}
 
-                read_heart_sensor();
+static sw_timer_t sensor_warmup_timer = { .callback = sensor_warmed_up, .flags = SW_TIMER_FROM_ISR };
 
-                // acquire data if finger detected
-                if ((get_heart_data_ptr()->finger_status == OBJECT_DETECTED) || get_heart_data_ptr()->finger_status == FINGER_DETECTED) {
-                    LOG_INFO("State transition: waiting -> acquiring data");
+// the warm-up starts once the power on sequence has finished
+static bool warmup_after_power_on = false;
+#endif
 
-                    displayPrintf(DISPLAY_ROW_ACTION, "Acquiring data...");
-                    next_state = STATE_ACQUIRING_DATA;
+// private helper, start a temperature conversion in the same wake window as a hub read
+static void sample_temperature_if_due() {
+    if (temp_sensor_due() && !i2c_transaction_busy(I2C_DEV_SI7021)) {
+        read_temp_sensor();
+    }
+}
 
-                    timer_wait_us_IRQ(1000000);
-                }
-                // turn the sensor back off if nothing detected
-                else {
-                    #ifdef LOW_POWER_MODE
-                    turn_off_heart_sensor();
-                    #endif
-                }
+// starts or stops the state timer, ms = 0 to stop
+static void set_state_timer(uint32_t ms) {
+    state_timer_generation++;
 
-            }
-            break;
+    if (ms == 0) {
+        sw_timer_stop(&state_timer);
+    }
+    else {
+        sw_timer_start(&state_timer, ms * USEC_PER_MSEC, 0);
+    }
+}
+
+// guards
+
+static bool hub_idle() {
+    return !i2c_transaction_busy(I2C_DEV_MAX32664) && !heart_sensor_power_changing();
+}
+
+static bool hub_power_changing() {
+    return heart_sensor_power_changing();
+}
+
+static bool something_detected() {
+    return ((get_heart_data_ptr()->finger_status == OBJECT_DETECTED) || (get_heart_data_ptr()->finger_status == FINGER_DETECTED));
+}
+
+static bool nothing_detected() {
+    return (get_heart_data_ptr()->finger_status == NOTHING_DETECTED);
+}
 
-        case STATE_ACQUIRING_DATA:
-            //LOG_INFO("State Acquiring Readings");
+static bool confident_finger() {
+    return ((get_heart_data_ptr()->confidence > CONFIDENCE_THRESHOLD) && (get_heart_data_ptr()->finger_status == FINGER_DETECTED));
+}
 
-            // 1 second timer finished
-            if (external_signal_event_match(evt, EVENT_TIMER_EXPIRED)) {
+static bool not_confident() {
+    return (get_heart_data_ptr()->confidence < CONFIDENCE_THRESHOLD);
+}
 
-                read_heart_sensor();
+// actions
 
-                // go back to waiting state if finger removed
-                if ((get_heart_data_ptr()->finger_status == NOTHING_DETECTED)) {
-                    LOG_INFO("State transition: acquiring data -> waiting");
+// advance the hub bring-up, reset waits finish on hub_wait_timer and hub commands on the i2c engine
+static void hub_init_step() {
+    if (continue_heart_sensor_init()) {
+        hsm_post(&heart_sm, EVENT_HUB_READY);
+    }
+}
 
-                    displayPrintf(DISPLAY_ROW_ACTION, "Place Finger!");
-                    next_state = STATE_WAITING;
+static void hub_ready() {
+    LOG_INFO("Boot trace: sensor hub ready at %d ms", letimerMilliseconds());
 
-                    #ifdef LOW_POWER_MODE
-                    turn_off_heart_sensor();
-                    #endif
-                }
-                // move to next state if confidence value high enough
-                else if ((get_heart_data_ptr()->confidence > CONFIDENCE_THRESHOLD) && (get_heart_data_ptr()->finger_status == FINGER_DETECTED)) {
-                    LOG_INFO("State transition: acquiring data -> returning data");
+    // turn it off until next check
+    #ifdef LOW_POWER_MODE
+    turn_off_heart_sensor();
+    sw_timer_start(&sensor_check_timer, SENSOR_CHECK_PERIOD_MS * USEC_PER_MSEC, SENSOR_CHECK_PERIOD_MS * USEC_PER_MSEC);
+    #endif
+}
+
+// MFIO is level low while the fifo is above threshold, an edge that came
+// in while it couldn't be handled would have been ignored so check the pin again
+static void check_data_ready() {
+    if (hub_idle() && heart_sensor_data_ready()) {
+        scheduler_set_event_data_ready();
+    }
+}
 
-                    next_state = STATE_RETURNING_DATA;
-                }
+// samples waiting in the hub fifo, start a reading
+static void start_reading() {
+    read_heart_sensor();
+    sample_temperature_if_due();
+}
 
-                timer_wait_us_IRQ(1000000);
-            }
+// advance a hub power sequence, they only run in LOW_POWER_MODE
+static void power_step() {
+    if (continue_heart_sensor_power()) {
+        #ifdef LOW_POWER_MODE
+        if (warmup_after_power_on) {
+            warmup_after_power_on = false;
+            sw_timer_start(&sensor_warmup_timer, SENSOR_WARMUP_US, 0);
+        }
+        #endif
+
+        check_data_ready();
+    }
+}
 
+// only new samples are published, a failed read cleared the reading so the
+// workflow still sees it and drops back to waiting
+static void reading_step() {
+    switch (finish_heart_sensor_read()) {
+        case HEART_READ_NEW_DATA:
+            ble_publish_samples();
+            hsm_post(&heart_sm, EVENT_READING_DONE);
             break;
+        case HEART_READ_FAILED:
+            hsm_post(&heart_sm, EVENT_READING_DONE);
+            break;
+        case HEART_READ_NO_DATA:
+        case HEART_READ_BUSY:
+            break;
+    }
 
-        case STATE_RETURNING_DATA:
-            //LOG_INFO("State Returning Readings");
+    check_data_ready();
+}
 
-            // 1 second timer finished
-            if (external_signal_event_match(evt, EVENT_TIMER_EXPIRED)) {
+#ifdef LOW_POWER_MODE
+// periodic check, power the sensor up, the reading starts from EVENT_DATA_READY
+// once it has warmed up so the wait is spent in EM2
+static void power_up_and_read() {
+    if (turn_on_heart_sensor()) {
+        warmup_after_power_on = true;
+        return;
+    }
 
-                read_heart_sensor();
+    sw_timer_start(&sensor_warmup_timer, SENSOR_WARMUP_US, 0);
+}
 
-                if ((get_heart_data_ptr()->finger_status == NOTHING_DETECTED)) {
-                    displayPrintf(DISPLAY_ROW_ACTION, "Place Finger!");
+// turn the sensor back off if nothing detected
+static void power_down() {
+    turn_off_heart_sensor();
+}
+#endif
 
-                    #ifdef LOW_POWER_MODE
-                    turn_off_heart_sensor();
-                    #endif
+static void show_acquiring() {
+    displayPrintf(DISPLAY_ROW_ACTION, "Acquiring data...");
 
-                    next_state = STATE_WAITING;
-                    LOG_INFO("State transition: returning data -> waiting");
-                }
-                // wait longer until returning data
-                else if (get_heart_data_ptr()->confidence < CONFIDENCE_THRESHOLD) {
-                    displayPrintf(DISPLAY_ROW_ACTION, "Acquiring data...");
-                    next_state = STATE_ACQUIRING_DATA;
-                    LOG_INFO("State transition: returning data -> acquiring data");
-                }
+    ble_publish_activity(CONN_ACTIVITY_MEASURING);
+}
 
-                // save results, transmit data over BLE, and update the LCD display
-                else {
-                    get_ble_data_ptr()->heart_rate = get_heart_data_ptr()->heart_rate;
-                    get_ble_data_ptr()->blood_oxygen = get_heart_data_ptr()->blood_oxygen;
-                    get_ble_data_ptr()->confidence = get_heart_data_ptr()->confidence;
+// no finger, the link can slow down until one shows up
+static void link_idle() {
+    ble_publish_activity(CONN_ACTIVITY_IDLE);
+}
 
-                    displayPrintf(DISPLAY_ROW_ACTION, "");
-                    displayPrintf(DISPLAY_ROW_8, "Heart Rate: %d BPM", get_ble_data_ptr()->heart_rate);
-                    displayPrintf(DISPLAY_ROW_9, "Blood Oxygen: %d%%", get_ble_data_ptr()->blood_oxygen);
-                    displayPrintf(DISPLAY_ROW_10, "Confidence: %d%%", get_ble_data_ptr()->confidence);
+static void show_place_finger() {
+    displayPrintf(DISPLAY_ROW_ACTION, "Place Finger!");
 
-                    ble_transmit_heart_data();
+    #ifdef LOW_POWER_MODE
+    turn_off_heart_sensor();
+    #endif
+}
 
-                    // update variable for LED pulsing
-                    next_pulse_time = letimerMilliseconds() + get_LED_period(get_ble_data_ptr()->heart_rate);
+static void show_hold_still() {
+    displayPrintf(DISPLAY_ROW_ACTION, "Hold finger still");
+}
 
-                }
+// hand the results to the BLE publisher and the display
+static void publish_reading() {
+    uint16_t heart_rate = get_heart_data_ptr()->heart_rate;
+    uint8_t blood_oxygen = get_heart_data_ptr()->blood_oxygen;
+    uint8_t confidence = get_heart_data_ptr()->confidence;
 
-                timer_wait_us_IRQ(1000000);
-            }
+    displayPrintf(DISPLAY_ROW_ACTION, "");
+    displayPrintf(DISPLAY_ROW_8, "Heart Rate: %d BPM", heart_rate);
+    displayPrintf(DISPLAY_ROW_9, "Blood Oxygen: %d%%", blood_oxygen);
+    displayPrintf(DISPLAY_ROW_10, "Confidence: %d%%", confidence);
 
-            break;
+    ble_publish_heart_data(heart_rate, blood_oxygen, confidence);
+
+    if (!first_reading_reported) {
+        LOG_INFO("Boot trace: first valid reading at %d ms", letimerMilliseconds());
+        first_reading_reported = true;
+    }
+
+    #ifndef LOW_POWER_MODE
+    start_LED_pulse(heart_rate);
+    #endif
+}
+
+// temperature is independent of the heart sensor state
+static void publish_temperature() {
+    if (finish_temp_sensor_read()) {
+        displayPrintf(DISPLAY_ROW_TEMPVALUE, "Temp: %d C", get_temperature() / 1000);
+
+        ble_publish_temperature(get_temperature());
     }
+}
+
+static const hsm_state_t heart_states[NUM_HEART_STATES] = {
+    //                        name              parent           entry              exit  timeout
+    [STATE_ROOT]           = { "root",           HSM_NONE,        0,                 0,    0 },
+    [STATE_INITIALIZING]   = { "initializing",   STATE_ROOT,      0,                 0,    0 },
+    [STATE_MEASURING]      = { "measuring",      STATE_ROOT,      check_data_ready,  0,    0 },
+    [STATE_WAITING]        = { "waiting",        STATE_MEASURING, link_idle,         0,    0 },
+    [STATE_ACQUIRING_DATA] = { "acquiring data", STATE_MEASURING, show_acquiring,    0,    ACQUIRE_TIMEOUT_MS },
+    [STATE_RETURNING_DATA] = { "returning data", STATE_MEASURING, 0,                 0,    0 }
+};
+
+static const hsm_transition_t heart_transitions[] = {
+    // state                 event                 guard               action               target
+    { STATE_ROOT,            EVENT_TEMP_DONE,      0,                  publish_temperature, HSM_NONE },
+
+    // advertising has started, bring up the sensor hub in the background
+    { STATE_INITIALIZING,    EVENT_BOOT,           0,                  init_heart_sensor,   HSM_NONE },
+    { STATE_INITIALIZING,    EVENT_TIMER_EXPIRED,  0,                  hub_init_step,       HSM_NONE },
+    { STATE_INITIALIZING,    EVENT_I2C_DONE,       0,                  hub_init_step,       HSM_NONE },
+    { STATE_INITIALIZING,    EVENT_HUB_READY,      0,                  hub_ready,           STATE_WAITING },
+
+    { STATE_MEASURING,       EVENT_DATA_READY,     hub_idle,           start_reading,       HSM_NONE },
+    { STATE_MEASURING,       EVENT_I2C_DONE,       hub_power_changing, power_step,          HSM_NONE },
+    { STATE_MEASURING,       EVENT_I2C_DONE,       0,                  reading_step,        HSM_NONE },
+
+    #ifdef LOW_POWER_MODE
+    { STATE_WAITING,         EVENT_CHECK_SENSOR,   hub_idle,           power_up_and_read,   HSM_NONE },
+    #endif
+    { STATE_WAITING,         EVENT_READING_DONE,   something_detected, 0,                   STATE_ACQUIRING_DATA },
+    #ifdef LOW_POWER_MODE
+    { STATE_WAITING,         EVENT_READING_DONE,   0,                  power_down,          HSM_NONE },
+    #endif
+
+    { STATE_ACQUIRING_DATA,  EVENT_READING_DONE,   nothing_detected,   show_place_finger,   STATE_WAITING },
+    { STATE_ACQUIRING_DATA,  EVENT_READING_DONE,   confident_finger,   0,                   STATE_RETURNING_DATA },
+    { STATE_ACQUIRING_DATA,  EVENT_STATE_TIMEOUT,  0,                  show_hold_still,     HSM_NONE },
+
+    { STATE_RETURNING_DATA,  EVENT_READING_DONE,   nothing_detected,   show_place_finger,   STATE_WAITING },
+    { STATE_RETURNING_DATA,  EVENT_READING_DONE,   not_confident,      0,                   STATE_ACQUIRING_DATA },
+    { STATE_RETURNING_DATA,  EVENT_READING_DONE,   0,                  publish_reading,     HSM_NONE }
+};
+
+static const hsm_def_t heart_sm_def = {
+    .states = heart_states,
+    .num_states = NUM_HEART_STATES,
+    .transitions = heart_transitions,
+    .num_transitions = sizeof(heart_transitions) / sizeof(heart_transitions[0]),
+    .initial = STATE_INITIALIZING,
+    .timeout_event = EVENT_STATE_TIMEOUT,
+    .set_timer = set_state_timer
+};
+
+/*
+ * sensor active object handler, the only place the workflow is dispatched from
+ *
+ * ao = sensor object
+ * e = event to handle
+ */
+static void sensor_handler(active_object_t* ao, const app_event_t* e) {
+    (void) ao;
 
-    if (cur_state != next_state) {
-        cur_state = next_state; // update global status variable
+    // restarted or stopped after this timeout was queued
+    if ((e->event == EVENT_STATE_TIMEOUT) && (e->payload != state_timer_generation)) {
+        return;
     }
 
+    PROFILE_START(cycles);
+    hsm_dispatch(&heart_sm, e->event);
+    PROFILE_EVENT(PROFILE_SERVER_EVENT(e->event), cycles);
 }
 
+/*
+ *
+ * state machine for getting heart data
+ * starts the workflow on the boot event, everything after that is posted straight to the sensor object
+ *
+ * evt = bluetooth event
+ */
+void heart_sensor_state_machine(sl_bt_msg_t* evt) {
+
+    if (SL_BT_MSG_ID(evt->header) == sl_bt_evt_system_boot_id) {
+        post_event(EVENT_BOOT, 0);
+    }
+
+}
+
+// print the recent state transitions for debugging
+void print_state_trace() {
+    hsm_print_trace(&heart_sm);
+}
@@ -9,7 +9,9 @@
 #define SRC_SCHEDULER_H_
 
 #include "stdint.h"
+#include "stdbool.h"
 #include "ble.h"
+#include "event_queue.h"
 
 typedef enum {
     EVENT_IDLE,
@@ -18,27 +20,55 @@ typedef enum {
     EVENT_I2C_DONE,
     EVENT_PB0,
     EVENT_PB1,
-    EVENT_CHECK_SENSOR
+    EVENT_CHECK_SENSOR,
+    EVENT_DATA_READY,
+    EVENT_TEMP_DONE,
+    EVENT_SW_TIMER, // main loop software timers expired
+
+    // only used inside the state machine
+    EVENT_BOOT, // bluetooth stack booted
+    EVENT_HUB_READY, // sensor hub bring-up finished
+    EVENT_READING_DONE, // new heart sensor reading available, or cleared after a failed read
+    EVENT_STATE_TIMEOUT, // state timer expired
+    NUM_SERVER_EVENTS
 } server_events_t;
 
+// states of the heart sensor workflow, see heart_states[] in scheduler.c
 typedef enum {
+    STATE_ROOT,
+    STATE_INITIALIZING,
+    STATE_MEASURING,
     STATE_WAITING,
     STATE_ACQUIRING_DATA,
-    STATE_RETURNING_DATA
+    STATE_RETURNING_DATA,
+    NUM_HEART_STATES
 } heart_states_t;
 
 void init_scheduler();
 
-void scheduler_set_event_UF();
-void scheduler_set_event_COMP1();
+void scheduler_set_event_timer();
+void scheduler_set_event_sw_timer();
 void scheduler_set_event_I2C();
+void scheduler_set_event_data_ready();
+void scheduler_set_event_temp();
 void scheduler_set_event_PB0_pressed();
 void scheduler_set_event_PB0_released();
 void scheduler_set_event_PB1_pressed();
 void scheduler_set_event_PB1_released();
 
+// scheduler_defer() runs the work right away, in the interrupt that asked for it, the way
+// it was done before work was deferred, for measuring the difference with IRQ_TIMING
+//#define SCHEDULER_DEFER_INLINE 1
+
+void scheduler_defer(event_priority_t priority, deferred_work_t work, uint32_t arg);
+
+bool scheduler_next_event(sl_bt_msg_t* evt);
+uint32_t scheduler_event_payload();
+uint64_t scheduler_event_timestamp();
+
 uint8_t external_signal_event_match(sl_bt_msg_t* evt, uint8_t event_id);
 
 void heart_sensor_state_machine(sl_bt_msg_t* evt);
+void print_state_trace();
 
 #endif /* SRC_SCHEDULER_H_ */
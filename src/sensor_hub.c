@@ -0,0 +1,313 @@
+/*
+ * sensor_hub.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * MAX32664 sensor hub command table and executor.
+ * Each command is described once with its bytes, the delay the hub needs
+ * before the response can be read, the response length and how many times
+ * to retry it. New commands only need a new entry in hub_cmds[].
+ */
+
+#include "sensor_hub.h"
+#include "heart_sensor.h"
+#include "i2c.h"
+
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+// delays from the MAX32664 user guide
+#define HUB_READ_DELAY 60 // status and fifo reads
+#define HUB_CMD_DELAY 6000 // configuration reads and writes
+#define HUB_ENABLE_DELAY 45000 // sensor / algorithm enable and disable
+
+// sequence running on the i2c transaction engine, one command per transaction
+static const hub_cmd_id_t* async_seq;
+static uint8_t async_len = 0;
+static uint8_t async_index = 0;
+static uint8_t async_attempts = 0;
+static uint8_t async_resp[HUB_MAX_RESP_LEN];
+
+// configuration applied to the hub, kept in RAM that the startup code doesn't clear
+// so it survives watchdog, brown-out and software resets of the MCU
+#define HUB_CACHE_MAGIC 0x48554243 // "HUBC"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t config_id; // hash of the command table, changes with the firmware configuration
+    uint32_t applied; // one bit per hub_cmd_id_t that is in effect on the hub
+    uint8_t version[3]; // hub firmware major, minor, revision
+    uint8_t output_mode; // value written by HUB_CMD_SET_OUTPUT_MODE
+    uint32_t check; // guards against random RAM contents after power on
+} hub_cache_t;
+
+static hub_cache_t hub_cache __attribute__((section(".noinit")));
+
+#if defined(PPG_RAW_ONLY_MODE)
+#define HUB_OUTPUT_MODE 0x01 // mode = sensor data
+#elif defined(PPG_STREAMING_MODE)
+#define HUB_OUTPUT_MODE 0x03 // mode = sensor + algorithm data
+#else
+#define HUB_OUTPUT_MODE 0x02 // mode = algorithm data
+#endif
+
+static const hub_cmd_desc_t hub_cmds[NUM_HUB_CMDS] = {
+    [HUB_CMD_READ_DEVICE_MODE]   = { "read_device_mode",      {0x02, 0x00},       2, HUB_CMD_DELAY,    2, 2 },
+    [HUB_CMD_READ_VERSION]       = { "read_sensor_hub_version", {0xFF, 0x03},     2, HUB_CMD_DELAY,    4, 1 },
+    [HUB_CMD_READ_OUTPUT_MODE]   = { "read_output_mode",      {0x11, 0x00},       2, HUB_CMD_DELAY,    2, 1 },
+    [HUB_CMD_SET_OUTPUT_MODE]    = { "set_output_mode",       {0x10, 0x00, HUB_OUTPUT_MODE}, 3, HUB_CMD_DELAY, 1, 2 },
+    [HUB_CMD_SET_FIFO_THRESHOLD] = { "set_fifo_threshold",    {0x10, 0x01, HEART_SENSOR_BATCH_SIZE}, 3, HUB_CMD_DELAY, 1, 2 }, // interrupt threshold for FIFO almost full
+    [HUB_CMD_ENABLE_AGC]         = { "agc_algo_control",      {0x52, 0x00, 0x01}, 3, HUB_ENABLE_DELAY, 1, 2 },
+    [HUB_CMD_ENABLE_SENSOR]      = { "enable_sensor",         {0x44, 0x03, 0x01}, 3, HUB_ENABLE_DELAY, 1, 2 }, // MAX30101
+    [HUB_CMD_ENABLE_ALGO]        = { "enable_algo",           {0x52, 0x02, 0x01}, 3, HUB_ENABLE_DELAY, 1, 2 }, // WHRM, MaximFast
+    [HUB_CMD_READ_ALGO_SAMPLES]  = { "read_algo_samples",     {0x51, 0x00, 0x03}, 3, HUB_CMD_DELAY,    2, 1 }, // samples being averaged
+    [HUB_CMD_DISABLE_SENSOR]     = { "disable_sensor",        {0x44, 0x03, 0x00}, 3, HUB_ENABLE_DELAY, 1, 2 },
+    [HUB_CMD_DISABLE_ALGO]       = { "disable_algo",          {0x52, 0x02, 0x00}, 3, HUB_ENABLE_DELAY, 1, 2 },
+    [HUB_CMD_READ_STATUS]        = { "read_sensor_hub_status", {0x00, 0x00},      2, HUB_READ_DELAY,   2, 1 },
+    [HUB_CMD_NUM_SAMPLES]        = { "num_samples_out_fifo",  {0x12, 0x00},       2, HUB_READ_DELAY,   2, 1 },
+    [HUB_CMD_READ_FIFO]          = { "read_fill_array",       {0x12, 0x01},       2, HUB_READ_DELAY,   0, 0 }
+};
+
+/*
+ * look up a command descriptor
+ *
+ * id = command to look up
+ *
+ * returns: pointer into the command table
+ */
+const hub_cmd_desc_t* hub_get_cmd(hub_cmd_id_t id) {
+    return &hub_cmds[id];
+}
+
+// ---------------------------------------------------------------------
+// Warm restart cache
+// ---------------------------------------------------------------------
+
+// private helper, hash every command in the table so a reflash with new settings drops the cache
+static uint32_t hub_config_id() {
+
+    uint32_t id = 0;
+
+    for (int i=0; i<NUM_HUB_CMDS; i++) {
+        for (int j=0; j<hub_cmds[i].cmd_len; j++) {
+            id = ((id << 5) | (id >> 27)) ^ hub_cmds[i].cmd[j];
+        }
+    }
+
+    return id;
+}
+
+// private helper, checksum over every field but check
+static uint32_t hub_cache_checksum() {
+    return ~(hub_cache.magic ^ hub_cache.config_id ^ hub_cache.applied ^
+             ((uint32_t) hub_cache.version[0] << 24) ^ ((uint32_t) hub_cache.version[1] << 16) ^
+             ((uint32_t) hub_cache.version[2] << 8) ^ hub_cache.output_mode);
+}
+
+// private helper, start a new empty cache
+static void hub_cache_reset() {
+    hub_cache.magic = HUB_CACHE_MAGIC;
+    hub_cache.config_id = hub_config_id();
+    hub_cache.applied = 0;
+    hub_cache.version[0] = 0;
+    hub_cache.version[1] = 0;
+    hub_cache.version[2] = 0;
+    hub_cache.output_mode = 0;
+    hub_cache.check = hub_cache_checksum();
+}
+
+/*
+ * private helper, remember what a successful command changed on the hub
+ *
+ * id = command that succeeded
+ * resp = its response, status byte first
+ */
+static void hub_cache_record(hub_cmd_id_t id, const uint8_t* resp) {
+
+    if (!hub_cache_valid()) {
+        hub_cache_reset();
+    }
+
+    switch (id) {
+        case HUB_CMD_READ_VERSION:
+            hub_cache.version[0] = resp[1];
+            hub_cache.version[1] = resp[2];
+            hub_cache.version[2] = resp[3];
+            break;
+        case HUB_CMD_SET_OUTPUT_MODE:
+            hub_cache.output_mode = hub_cmds[id].cmd[2];
+            hub_cache.applied |= (1 << id);
+            break;
+        case HUB_CMD_SET_FIFO_THRESHOLD:
+        case HUB_CMD_ENABLE_AGC:
+        case HUB_CMD_ENABLE_SENSOR:
+        case HUB_CMD_ENABLE_ALGO:
+        case HUB_CMD_READ_ALGO_SAMPLES:
+            hub_cache.applied |= (1 << id);
+            break;
+        case HUB_CMD_DISABLE_SENSOR:
+            hub_cache.applied &= ~(1 << HUB_CMD_ENABLE_SENSOR);
+            break;
+        case HUB_CMD_DISABLE_ALGO:
+            hub_cache.applied &= ~(1 << HUB_CMD_ENABLE_ALGO);
+            break;
+        default:
+            return; // reads don't change the hub
+    }
+
+    hub_cache.check = hub_cache_checksum();
+}
+
+// returns true if the cache holds the configuration of a hub that was set up by this firmware
+bool hub_cache_valid() {
+    return ((hub_cache.magic == HUB_CACHE_MAGIC) &&
+            (hub_cache.check == hub_cache_checksum()) &&
+            (hub_cache.config_id == hub_config_id()));
+}
+
+// forget the cached configuration, call when the hub is reset
+void hub_cache_invalidate() {
+    hub_cache.magic = 0;
+}
+
+/*
+ * check if a command is already in effect on the hub
+ *
+ * id = command to check
+ *
+ * returns: true if the command can be skipped
+ */
+bool hub_cache_applied(hub_cmd_id_t id) {
+    return (hub_cache_valid() && (hub_cache.applied & (1 << id)));
+}
+
+/*
+ * check the response of HUB_CMD_READ_OUTPUT_MODE against the cache
+ * a hub that lost power comes back with its default output mode
+ * the cache is dropped if it doesn't match
+ *
+ * resp = response of HUB_CMD_READ_OUTPUT_MODE
+ *
+ * returns: true if the hub still has the cached configuration
+ */
+bool hub_cache_confirm(const uint8_t* resp) {
+
+    if (hub_cache_valid() && (resp[0] == HUB_STATUS_SUCCESS) &&
+            (hub_cache.applied & (1 << HUB_CMD_SET_OUTPUT_MODE)) && (resp[1] == hub_cache.output_mode)) {
+
+        LOG_INFO("Sensor hub %d.%d.%d still configured", hub_cache.version[0], hub_cache.version[1], hub_cache.version[2]);
+        return true;
+    }
+
+    hub_cache_invalidate();
+    return false;
+}
+
+/*
+ * add a command's write, delay and read steps to the pending i2c transaction
+ *
+ * id = command to queue
+ * resp = where to save the response (status byte first), must stay valid until the transaction completes
+ * resp_len = response length, 0 to use the table value
+ */
+void hub_queue_command(hub_cmd_id_t id, uint8_t* resp, uint16_t resp_len) {
+
+    const hub_cmd_desc_t* desc = &hub_cmds[id];
+
+    if (resp_len == 0) {
+        resp_len = desc->resp_len;
+    }
+
+    i2c_queue_write(I2C_DEV_MAX32664, (uint8_t*) desc->cmd, desc->cmd_len);
+    i2c_queue_delay(I2C_DEV_MAX32664, desc->delay_us);
+    i2c_queue_read(I2C_DEV_MAX32664, resp, resp_len);
+}
+
+// private helper, send the current command of the running sequence
+static void queue_sequence_command() {
+    hub_queue_command(async_seq[async_index], async_resp, 0);
+    i2c_start_transaction(I2C_DEV_MAX32664);
+}
+
+// private helper, move past commands the cache says are already applied
+static void skip_applied_commands() {
+    while ((async_index < async_len) && hub_cache_applied(async_seq[async_index])) {
+        async_index++;
+    }
+}
+
+/*
+ * start running a list of commands on the i2c transaction engine
+ * EVENT_I2C_DONE is set after each command, hub_sequence_step() should be called for each one
+ * commands the cache says are already applied are skipped
+ *
+ * seq = commands to run, must stay valid until the sequence finishes
+ * len = number of commands
+ *
+ * returns: true if a command was started, false if there was nothing to send
+ */
+bool hub_start_sequence(const hub_cmd_id_t* seq, uint8_t len) {
+
+    async_seq = seq;
+    async_len = len;
+    async_index = 0;
+    async_attempts = 0;
+
+    skip_applied_commands();
+
+    if (async_index == async_len) {
+        return false;
+    }
+
+    queue_sequence_command();
+    return true;
+}
+
+// returns the response of the last command run by the sequence, status byte first
+const uint8_t* hub_sequence_response() {
+    return async_resp;
+}
+
+/*
+ * check the command that just finished and send the next one, stops at the first failure
+ * commands are retried per their table entry
+ *
+ * returns: HUB_SEQ_BUSY if another EVENT_I2C_DONE will follow, HUB_SEQ_DONE or HUB_SEQ_FAILED when finished
+ */
+hub_seq_status_t hub_sequence_step() {
+
+    const hub_cmd_desc_t* desc = &hub_cmds[async_seq[async_index]];
+    uint8_t status = HUB_STATUS_I2C_ERROR;
+
+    if (i2c_transaction_status(I2C_DEV_MAX32664) == i2cTransferDone) {
+        status = async_resp[0];
+    }
+
+    if (status != HUB_STATUS_SUCCESS) {
+
+        // bus error or hub busy, send the same command again
+        if (((status == HUB_STATUS_I2C_ERROR) || (status == HUB_STATUS_TRY_AGAIN)) && (async_attempts < desc->retries)) {
+            async_attempts++;
+            queue_sequence_command();
+            return HUB_SEQ_BUSY;
+        }
+
+        LOG_ERROR("%s() status 0x%02x", desc->name, status);
+        return HUB_SEQ_FAILED;
+    }
+
+    hub_cache_record(async_seq[async_index], async_resp);
+
+    async_index++;
+    async_attempts = 0;
+
+    skip_applied_commands();
+
+    if (async_index == async_len) {
+        return HUB_SEQ_DONE;
+    }
+
+    queue_sequence_command();
+    return HUB_SEQ_BUSY;
+}
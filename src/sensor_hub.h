@@ -0,0 +1,75 @@
+/*
+ * sensor_hub.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_SENSOR_HUB_H_
+#define SRC_SENSOR_HUB_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// longest command (family + index + payload) and fixed response in the table
+#define HUB_MAX_CMD_LEN 3
+#define HUB_MAX_RESP_LEN 4
+
+// status byte values returned by the MAX32664
+#define HUB_STATUS_SUCCESS 0x00
+#define HUB_STATUS_TRY_AGAIN 0xFE
+
+// used when the i2c transfer itself failed, same value as the hub's unknown error
+#define HUB_STATUS_I2C_ERROR 0xFF
+
+// every command the firmware sends to the sensor hub
+typedef enum {
+    HUB_CMD_READ_DEVICE_MODE,
+    HUB_CMD_READ_VERSION,
+    HUB_CMD_READ_OUTPUT_MODE,
+    HUB_CMD_SET_OUTPUT_MODE,
+    HUB_CMD_SET_FIFO_THRESHOLD,
+    HUB_CMD_ENABLE_AGC,
+    HUB_CMD_ENABLE_SENSOR,
+    HUB_CMD_ENABLE_ALGO,
+    HUB_CMD_READ_ALGO_SAMPLES,
+    HUB_CMD_DISABLE_SENSOR,
+    HUB_CMD_DISABLE_ALGO,
+    HUB_CMD_READ_STATUS,
+    HUB_CMD_NUM_SAMPLES,
+    HUB_CMD_READ_FIFO,
+    NUM_HUB_CMDS
+} hub_cmd_id_t;
+
+// everything needed to run one command
+typedef struct {
+    const char* name; // for logging
+    uint8_t cmd[HUB_MAX_CMD_LEN]; // family byte, index byte, payload
+    uint8_t cmd_len;
+    uint32_t delay_us; // datasheet delay between the write and the read
+    uint8_t resp_len; // including the status byte, 0 = variable length
+    uint8_t retries; // extra attempts on bus errors or try again status
+} hub_cmd_desc_t;
+
+// progress of a sequence running on the i2c transaction engine
+typedef enum {
+    HUB_SEQ_BUSY,
+    HUB_SEQ_DONE,
+    HUB_SEQ_FAILED
+} hub_seq_status_t;
+
+const hub_cmd_desc_t* hub_get_cmd(hub_cmd_id_t id);
+
+void hub_queue_command(hub_cmd_id_t id, uint8_t* resp, uint16_t resp_len);
+
+bool hub_start_sequence(const hub_cmd_id_t* seq, uint8_t len);
+hub_seq_status_t hub_sequence_step();
+const uint8_t* hub_sequence_response();
+
+// warm restart cache
+bool hub_cache_valid();
+void hub_cache_invalidate();
+bool hub_cache_applied(hub_cmd_id_t id);
+bool hub_cache_confirm(const uint8_t* resp);
+
+#endif /* SRC_SENSOR_HUB_H_ */
@@ -0,0 +1,339 @@
+/*
+ * sw_timer.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#include "sw_timer.h"
+#include "timers.h"
+#include "irq.h"
+#include "scheduler.h"
+
+#include "em_core.h"
+#include "em_letimer.h"
+
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#define USEC_PER_SEC 1000000
+
+// COMP1 writes take a couple of LF clock cycles to synchronize, a match
+// closer than this to the current count could be missed
+#define MIN_DELAY_TICKS 2
+
+// ---------------------------------------------------------------------
+// Software timers
+//
+// Every timer shares LETIMER COMP1. Running timers are kept in a binary
+// min-heap ordered by deadline, so starting or stopping one is O(log n)
+// and the next deadline is always heap[0]. Expiry takes heap[0] out and
+// refills the root, O(log n) as well, at most 6 levels for SW_TIMER_MAX
+// timers. COMP1 is set for heap[0] when it falls in the current LETIMER
+// period, later deadlines are picked up again at each underflow.
+//
+// Expired timers with SW_TIMER_FROM_ISR run their callback straight from
+// the interrupt. The others are put on the dispatch list and run from
+// the main loop by sw_timer_dispatch() after EVENT_SW_TIMER.
+// ---------------------------------------------------------------------
+
+static sw_timer_t* heap[SW_TIMER_MAX];
+static uint8_t heap_size = 0;
+
+// expired main loop timers, oldest first
+static sw_timer_t* dispatch_head = 0;
+static sw_timer_t* dispatch_tail = 0;
+
+// private helper, rounds a delay up to whole ticks so short delays don't become 0
+static uint32_t us_to_ticks(uint32_t us) {
+    return ((uint64_t) clock_freq_hz * us + USEC_PER_SEC - 1) / USEC_PER_SEC;
+}
+
+// private helper, puts a timer at a heap index
+static void heap_place(uint8_t i, sw_timer_t* t) {
+    heap[i] = t;
+    t->heap_pos = i + 1;
+}
+
+// private helper, moves the timer at index i towards the root while it is earlier than its parent
+static void sift_up(uint8_t i) {
+
+    sw_timer_t* t = heap[i];
+
+    while (i > 0) {
+        uint8_t parent = (i - 1) / 2;
+
+        if (heap[parent]->deadline <= t->deadline) {
+            break;
+        }
+
+        heap_place(i, heap[parent]);
+        i = parent;
+    }
+
+    heap_place(i, t);
+}
+
+// private helper, moves the timer at index i towards the leaves while it is later than a child
+static void sift_down(uint8_t i) {
+
+    sw_timer_t* t = heap[i];
+
+    while (true) {
+        uint8_t child = (2 * i) + 1;
+
+        if (child >= heap_size) {
+            break;
+        }
+
+        if ((child + 1 < heap_size) && (heap[child + 1]->deadline < heap[child]->deadline)) {
+            child++;
+        }
+
+        if (t->deadline <= heap[child]->deadline) {
+            break;
+        }
+
+        heap_place(i, heap[child]);
+        i = child;
+    }
+
+    heap_place(i, t);
+}
+
+// private helper, adds a timer to the heap, call with interrupts disabled
+static void heap_insert(sw_timer_t* t) {
+    heap_place(heap_size, t);
+    heap_size++;
+    sift_up(heap_size - 1);
+}
+
+// private helper, takes a running timer out of the heap, call with interrupts disabled
+static void heap_remove(sw_timer_t* t) {
+
+    uint8_t i = t->heap_pos - 1;
+    t->heap_pos = 0;
+    heap_size--;
+
+    if (i == heap_size) {
+        return;
+    }
+
+    // fill the hole with the last timer and restore the order around it
+    sw_timer_t* last = heap[heap_size];
+    heap_place(i, last);
+    sift_up(i);
+    sift_down(last->heap_pos - 1);
+}
+
+/*
+ * private helper, sets COMP1 for the earliest deadline, call with interrupts disabled
+ * deadlines past the end of this LETIMER period are left for the underflow interrupt
+ */
+static void arm_compare() {
+
+    if (heap_size == 0) {
+        LETIMER_IntDisable(LETIMER0, LETIMER_IEN_COMP1);
+        return;
+    }
+
+    uint32_t period_ticks = timer_max_ticks + 1;
+    uint64_t now = letimerTicks();
+    uint64_t target = heap[0]->deadline;
+
+    LETIMER_IntClear(LETIMER0, LETIMER_IFC_COMP1);
+
+    // already due, take the interrupt right away
+    if (target <= now) {
+        LETIMER_IntSet(LETIMER0, LETIMER_IFS_COMP1);
+        LETIMER_IntEnable(LETIMER0, LETIMER_IEN_COMP1);
+        return;
+    }
+
+    // late rather than early, the hub command delays are minimums
+    if (target < now + MIN_DELAY_TICKS) {
+        target = now + MIN_DELAY_TICKS;
+    }
+
+    uint64_t period_start = now - (now % period_ticks);
+
+    if (target - period_start >= period_ticks) {
+        LETIMER_IntDisable(LETIMER0, LETIMER_IEN_COMP1);
+        return;
+    }
+
+    // the counter counts down from timer_max_ticks
+    LETIMER_CompareSet(LETIMER0, 1, timer_max_ticks - (uint32_t) (target - period_start));
+    LETIMER_IntEnable(LETIMER0, LETIMER_IEN_COMP1);
+
+    // the counter moved past the match while the write was synchronizing
+    if (letimerTicks() >= target) {
+        LETIMER_IntSet(LETIMER0, LETIMER_IFS_COMP1);
+    }
+}
+
+/*
+ * Starts a timer, or restarts it if it is already running
+ * safe to call from interrupts and from the timer's own callback
+ *
+ * t = timer to start
+ * delay_us = time until the first expiry
+ * period_us = time between later expiries, 0 for a one-shot timer
+ *
+ * returns: true if too many timers are running
+ */
+bool sw_timer_start(sw_timer_t* t, uint32_t delay_us, uint32_t period_us) {
+
+    uint32_t delay_ticks = us_to_ticks(delay_us);
+    if (delay_ticks == 0) {
+        delay_ticks = 1;
+    }
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    if (t->heap_pos != 0) {
+        heap_remove(t);
+    }
+    else if (heap_size == SW_TIMER_MAX) {
+        CORE_EXIT_CRITICAL();
+        LOG_ERROR("Too many software timers running");
+        return true;
+    }
+
+    t->deadline = letimerTicks() + delay_ticks;
+    t->period = us_to_ticks(period_us);
+    t->fire = false;
+
+    heap_insert(t);
+
+    if (heap[0] == t) {
+        arm_compare();
+    }
+
+    CORE_EXIT_CRITICAL();
+
+    return false;
+}
+
+/*
+ * Stops a timer, an expiry that is waiting for the main loop is dropped too
+ *
+ * t = timer to stop
+ */
+void sw_timer_stop(sw_timer_t* t) {
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    t->fire = false;
+
+    if (t->heap_pos != 0) {
+        bool was_next = (heap[0] == t);
+
+        heap_remove(t);
+
+        if (was_next) {
+            arm_compare();
+        }
+    }
+
+    CORE_EXIT_CRITICAL();
+}
+
+// returns true if the timer is running or its callback hasn't run yet
+bool sw_timer_running(sw_timer_t* t) {
+    return (t->heap_pos != 0) || t->fire;
+}
+
+/*
+ * Handles expired timers and sets COMP1 for the next deadline
+ * interrupt callbacks run here, main loop callbacks are passed to sw_timer_dispatch()
+ */
+void sw_timer_irq() {
+
+    bool post = false;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+
+    uint64_t now = letimerTicks();
+
+    while ((heap_size > 0) && (heap[0]->deadline <= now)) {
+        sw_timer_t* t = heap[0];
+        heap_remove(t);
+
+        // periodic timers keep their phase unless whole periods were missed
+        if (t->period != 0) {
+            t->deadline += t->period;
+            if (t->deadline <= now) {
+                t->deadline = now + t->period;
+            }
+            heap_insert(t);
+        }
+
+        if (t->flags & SW_TIMER_FROM_ISR) {
+            CORE_EXIT_CRITICAL();
+            t->callback(t->context);
+            CORE_ENTER_CRITICAL();
+        }
+        else {
+            t->fire = true;
+
+            if (!t->linked) {
+                t->linked = true;
+                t->next = 0;
+
+                if (dispatch_tail != 0) {
+                    dispatch_tail->next = t;
+                }
+                else {
+                    dispatch_head = t;
+                }
+                dispatch_tail = t;
+            }
+
+            post = true;
+        }
+    }
+
+    arm_compare();
+
+    CORE_EXIT_CRITICAL();
+
+    if (post) {
+        scheduler_set_event_sw_timer();
+    }
+}
+
+// runs the callbacks of the expired main loop timers
+void sw_timer_dispatch() {
+
+    CORE_DECLARE_IRQ_STATE;
+
+    while (true) {
+        CORE_ENTER_CRITICAL();
+
+        sw_timer_t* t = dispatch_head;
+        if (t == 0) {
+            CORE_EXIT_CRITICAL();
+            return;
+        }
+
+        dispatch_head = t->next;
+        if (dispatch_head == 0) {
+            dispatch_tail = 0;
+        }
+        t->linked = false;
+
+        bool fire = t->fire;
+        t->fire = false;
+
+        CORE_EXIT_CRITICAL();
+
+        // stopped or restarted since it expired
+        if (fire) {
+            t->callback(t->context);
+        }
+    }
+}
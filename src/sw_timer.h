@@ -0,0 +1,51 @@
+/*
+ * sw_timer.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_SW_TIMER_H_
+#define SRC_SW_TIMER_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// maximum number of timers running at the same time
+#define SW_TIMER_MAX 64
+
+// callback runs in the LETIMER interrupt instead of the main loop, for drivers
+#define SW_TIMER_FROM_ISR 0x01
+
+typedef void (*sw_timer_callback_t)(void* context);
+
+/*
+ * one timer, owned by the caller and usually static
+ * only callback, context and flags are set by the caller, e.g.
+ *     static sw_timer_t t = { .callback = expired, .flags = SW_TIMER_FROM_ISR };
+ */
+typedef struct sw_timer {
+    sw_timer_callback_t callback;
+    void* context; // passed to the callback
+    uint8_t flags; // SW_TIMER_ flags
+
+    // private
+    uint64_t deadline; // LETIMER ticks since startup
+    uint32_t period; // ticks, 0 = one-shot
+    uint8_t heap_pos; // index in the heap + 1, 0 = not running
+    bool fire; // expired, waiting for sw_timer_dispatch()
+    bool linked; // on the dispatch list
+    struct sw_timer* next; // dispatch list
+} sw_timer_t;
+
+bool sw_timer_start(sw_timer_t* t, uint32_t delay_us, uint32_t period_us);
+void sw_timer_stop(sw_timer_t* t);
+bool sw_timer_running(sw_timer_t* t);
+
+// called from LETIMER0_IRQHandler on underflow and COMP1
+void sw_timer_irq();
+
+// called from the main loop on EVENT_SW_TIMER
+void sw_timer_dispatch();
+
+#endif /* SRC_SW_TIMER_H_ */
@@ -0,0 +1,88 @@
+/*
+ * temp_sensor.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ *
+ * Si7021 temperature readings on the shared I2C bus.
+ * The sensor is powered by SENSOR_ENABLE, which the LCD already keeps on.
+ */
+
+#include "temp_sensor.h"
+#include "i2c.h"
+#include "irq.h"
+
+#define INCLUDE_LOG_DEBUG 1
+#include "log.h"
+
+#define SI7021_MEASURE_TEMP_CMD 0xF3 // measure temperature, no hold master mode
+
+// 14 bit conversion time from the datasheet, max
+#define SI7021_CONVERSION_US 10800
+
+static uint8_t measure_temp_cmd[1] = {SI7021_MEASURE_TEMP_CMD};
+static uint8_t temp_data[2];
+
+// last reading in millidegrees C
+static int32_t temperature = 0;
+
+#define USEC_PER_MSEC 1000
+
+// when the last conversion was started and finished, us since startup
+static bool temp_sampled = false;
+static uint64_t last_sample_us = 0;
+static uint64_t temperature_timestamp = 0;
+
+// returns true if a new reading should be started
+bool temp_sensor_due() {
+    return (!temp_sampled || ((letimerMicroseconds() - last_sample_us) >= (uint64_t) TEMP_SAMPLE_PERIOD_MS * USEC_PER_MSEC));
+}
+
+/*
+ * start a temperature conversion on the i2c bus manager
+ * EVENT_TEMP_DONE is set when the result has been read, finish_temp_sensor_read() should be called
+ */
+void read_temp_sensor() {
+
+    temp_sampled = true;
+    last_sample_us = letimerMicroseconds();
+
+    i2c_queue_write(I2C_DEV_SI7021, measure_temp_cmd, sizeof(measure_temp_cmd));
+    i2c_queue_delay(I2C_DEV_SI7021, SI7021_CONVERSION_US);
+    i2c_queue_read(I2C_DEV_SI7021, temp_data, sizeof(temp_data));
+
+    i2c_start_transaction(I2C_DEV_SI7021);
+}
+
+/*
+ * convert the result of a finished conversion
+ *
+ * returns: true if a new temperature is available
+ */
+bool finish_temp_sensor_read() {
+
+    if (i2c_transaction_status(I2C_DEV_SI7021) != i2cTransferDone) {
+        LOG_ERROR("Temperature read failed");
+        return false;
+    }
+
+    uint32_t raw = (temp_data[0] << 8) | temp_data[1];
+
+    // datasheet: temp C = 175.72 * raw / 65536 - 46.85
+    temperature = (int32_t) (((uint64_t) 175720 * raw) >> 16) - 46850;
+    temperature_timestamp = letimerMicroseconds();
+
+    //LOG_INFO("Temperature: %d mC", (int) temperature);
+
+    return true;
+}
+
+// returns the last reading in millidegrees C
+int32_t get_temperature() {
+    return temperature;
+}
+
+// returns when the last reading was taken, us since startup
+uint64_t get_temperature_timestamp() {
+    return temperature_timestamp;
+}
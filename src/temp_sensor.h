@@ -0,0 +1,23 @@
+/*
+ * temp_sensor.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: bjornnelson
+ */
+
+#ifndef SRC_TEMP_SENSOR_H_
+#define SRC_TEMP_SENSOR_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// how often the Si7021 is sampled along with the sensor hub reads
+#define TEMP_SAMPLE_PERIOD_MS 5000
+
+bool temp_sensor_due();
+void read_temp_sensor();
+bool finish_temp_sensor_read();
+int32_t get_temperature();
+uint64_t get_temperature_timestamp();
+
+#endif /* SRC_TEMP_SENSOR_H_ */
@@ -7,20 +7,36 @@
 
 #include "timers.h"
 #include "oscillators.h"
+#include "sw_timer.h"
 #include "app.h"
 
 #include "em_cmu.h"
+#include "em_core.h"
+#include "em_emu.h"
 #include "em_letimer.h"
 
 #include "stdint.h"
 
 #define USEC_PER_MSEC 1000
 #define MSEC_PER_SEC 1000
-#define USEC_TO_SEC 1000000
+#define USEC_PER_SEC 1000000
+
+// delays shorter than this spin on the cycle counter, the LETIMER tick (122 us)
+// is too coarse for them and sleeping wouldn't save anything
+#define DELAY_SLEEP_MIN_US 1000
 
 // global variables
 uint32_t clock_freq_hz; // system clock frequency = oscillator frequency / prescaler
 uint16_t timer_max_ticks; // saving COMP 0 register for use in wait function
+uint32_t usec_per_tick_q12; // tick length in us, 20.12 fixed point, exact for 2^n Hz and 1 kHz clocks
+
+// core cycles per us for the spinning delay, 20.12 fixed point rounded up, 38.4 MHz isn't a whole number
+static uint32_t cycles_per_us_q12;
+
+// wakes timer_delay_us() from EM1
+static volatile bool delay_done = false;
+static void delay_expired(void* context);
+static sw_timer_t delay_timer = { .callback = delay_expired, .flags = SW_TIMER_FROM_ISR };
 
 
 /*
@@ -48,6 +64,7 @@ void init_timer() {
 
     // save system clock frequency into global variable
     clock_freq_hz = get_oscillator_freq() / PRESCALER;
+    usec_per_tick_q12 = ((uint64_t) USEC_PER_SEC << 12) / clock_freq_hz;
 
     // initialize with settings in structure
     LETIMER_Init(LETIMER0, &letimer_settings);
@@ -65,94 +82,69 @@ void init_timer() {
     // set compare registers for timer
     LETIMER_CompareSet(LETIMER0, 0, comp0_value);
 
-    // enable interrupts for doing si7021 measurements
+    // underflows keep the time since startup, see letimerTicks()
     LETIMER_IntEnable(LETIMER0, LETIMER_IEN_UF);
 
     // start running the timer
     LETIMER_Enable(LETIMER0, true);
 
-}
+    // cycle counter for short delays
+    cycles_per_us_q12 = (((uint64_t) SystemCoreClockGet() << 12) + USEC_PER_SEC - 1) / USEC_PER_SEC;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 
-/*
- * Delays for a specified number of microseconds using polling
- * Maximum supported delay = 3 seconds
- *
- * us_wait = delay duration in us
- */
-void timer_wait_us_polled(uint32_t us_wait) {
-
-    uint16_t ms_wait = us_wait / USEC_PER_MSEC;
-
-    // range checking
-    if (ms_wait >= LETIMER_PERIOD_MS) {
-      ms_wait = LETIMER_PERIOD_MS - 1;
-      //LOG_WARN("Requested delay exceeds supported maximum. Delay time capped to %d msecs", LETIMER_PERIOD_MS);
-    }
-
-    // compute how many ticks for specified delay
-    uint16_t delay_ticks = clock_freq_hz * ms_wait / MSEC_PER_SEC;
-    uint16_t start_tick = LETIMER_CounterGet(LETIMER0);
+}
 
-    uint16_t stop_tick = 0;
+// private helper, busy waits on the DWT cycle counter, the subtraction handles wraparound
+static void spin_us(uint32_t us_wait) {
 
-    // case 1: normal counting
-    if (delay_ticks < start_tick) {
-      stop_tick = start_tick - delay_ticks;
-    }
-    // case 2: wraparound from 0 -> COMP0
-    else {
-      stop_tick = timer_max_ticks - (delay_ticks - start_tick);
-    }
+    uint32_t start = DWT->CYCCNT;
+    uint32_t cycles = (((uint64_t) us_wait * cycles_per_us_q12) + 0xFFF) >> 12;
 
-    // do nothing until reaching the correct stop tick
-    while (LETIMER_CounterGet(LETIMER0) != stop_tick);
+    while ((DWT->CYCCNT - start) < cycles);
+}
 
+// called from the LETIMER interrupt when a sleeping delay has elapsed
+static void delay_expired(void* context) {
+    (void) context;
+    delay_done = true;
 }
 
 /*
- * Delays for a specified number of microseconds using interrupts
- * Maximum supported delay = 3 seconds
+ * Delays for at least the specified number of microseconds
+ * short delays spin on the cycle counter, longer ones sleep in EM1 until
+ * a software timer on LETIMER COMP1 fires
+ * EM2 needs the bluetooth stack's agreement, which it can't give in the middle
+ * of an event handler, so delays that should reach EM2 use an sw_timer instead,
+ * the sensor command delays are I2C engine delay steps for that reason and
+ * nothing in the firmware calls this now
  *
  * us_wait = delay duration in us
  */
-void timer_wait_us_IRQ(uint32_t us_wait) {
+void timer_delay_us(uint32_t us_wait) {
 
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-
-    uint16_t ms_wait = us_wait / USEC_PER_MSEC;
-
-    // range checking
-    if (ms_wait >= LETIMER_PERIOD_MS) {
-      ms_wait = LETIMER_PERIOD_MS - 1;
-      //LOG_WARN("Requested delay exceeds supported maximum. Delay time capped to %d msecs", LETIMER_PERIOD_MS);
+    if (us_wait < DELAY_SLEEP_MIN_US) {
+        spin_us(us_wait);
+        return;
     }
 
-    // compute how many ticks for specified delay
-    uint16_t delay_ticks = clock_freq_hz * ms_wait / MSEC_PER_SEC;
-    uint16_t start_tick = LETIMER_CounterGet(LETIMER0);
-
-    uint16_t stop_tick = 0;
+    delay_done = false;
+    sw_timer_start(&delay_timer, us_wait, 0);
 
-    // case 1: normal counting
-    if (delay_ticks < start_tick) {
-      stop_tick = start_tick - delay_ticks;
-    }
-    // case 2: wraparound from 0 -> COMP0
-    else {
-      stop_tick = timer_max_ticks - (delay_ticks - start_tick);
-    }
-
-    // clear pending interrupts
-    LETIMER_IntClear(LETIMER0, LETIMER_IFC_COMP1);
+    // WFI still wakes on an interrupt masked by PRIMASK, checking the flag with
+    // interrupts off means the expiry can't slip in between the check and the sleep
+    CORE_DECLARE_IRQ_STATE;
 
-    // set COMP 1 value
-    LETIMER_CompareSet(LETIMER0, 1, stop_tick);
+    while (true) {
+        CORE_ENTER_CRITICAL();
 
-    // enable the interrupt for COMP 1
-    LETIMER_IntEnable(LETIMER0, LETIMER_IEN_COMP1);
+        if (delay_done) {
+            CORE_EXIT_CRITICAL();
+            break;
+        }
 
-    CORE_EXIT_CRITICAL();
+        EMU_EnterEM1();
 
+        CORE_EXIT_CRITICAL();
+    }
 }
-
@@ -13,9 +13,9 @@
 
 extern uint32_t clock_freq_hz;
 extern uint16_t timer_max_ticks;
+extern uint32_t usec_per_tick_q12;
 
 void init_timer();
-void timer_wait_us_polled(uint32_t us_wait);
-void timer_wait_us_IRQ(uint32_t us_wait);
+void timer_delay_us(uint32_t us_wait);
 
 #endif /* SRC_TIMERS_H_ */